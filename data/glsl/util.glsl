@@ -25,3 +25,36 @@ float compute_eye_z_from_depth(float depth, float near, float far)
    return far * near  / (depth * (far - near) - far);
 }
 
+
+/**
+ * Decodes a normal stored with VKDF_VERTEX_ENCODING_OCTAHEDRAL.
+ */
+vec3
+oct_decode(vec2 e)
+{
+   vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+   if (n.z < 0.0) {
+      vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+      n.xy = (1.0 - abs(n.yx)) * s;
+   }
+   return normalize(n);
+}
+
+/**
+ * Decodes a tangent frame stored with VKDF_VERTEX_ENCODING_QTANGENT. The
+ * returned matrix has the tangent, bitangent and normal as its columns.
+ */
+mat3
+qtangent_to_tbn(vec4 q)
+{
+   q = normalize(q);
+   float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+   float xx = q.x * x2, xy = q.x * y2, xz = q.x * z2;
+   float yy = q.y * y2, yz = q.y * z2, zz = q.z * z2;
+   float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+   vec3 t = vec3(1.0 - (yy + zz), xy + wz, xz - wy);
+   vec3 n = vec3(xz + wy, yz - wx, 1.0 - (xx + yy));
+   vec3 b = cross(n, t) * (q.w < 0.0 ? -1.0 : 1.0);
+   return mat3(t, b, n);
+}
@@ -0,0 +1,1265 @@
+#include "vkdf.hpp"
+#include "../demo-scene.hpp"
+
+// ----------------------------------------------------------------------------
+// Scene benchmark
+//
+// Replays a camera path through a scene for a fixed number of frames and
+// writes the CPU and GPU frame time distributions, per-zone timings and
+// average scene statistics to a JSON report.
+//
+// The scene is a procedural field of cubes by default. --scene selects one
+// of the demo scenes instead (see demo-scene.hpp), so the bench can measure
+// assimp models with textured materials, the deferred renderer with SSAO
+// and SSR (sponza) and multiple shadow maps (scenelight, shadow). Demo
+// scenes load their shaders and models from the demo's build directory,
+// or from --data-dir.
+//
+// Camera paths are text files with a keyframe per line:
+//
+//    <frames> <pos.x> <pos.y> <pos.z> <rot.x> <rot.y> <rot.z>
+//
+// where <frames> is the number of frames it takes to get to the keyframe
+// from the previous one (it is ignored for the first keyframe). The camera
+// is interpolated linearly between keyframes, a fixed step per frame, so
+// every run renders exactly the same views no matter how fast it goes.
+// Lines starting with '#' are ignored. Paths can be recorded by flying
+// around the scene with --record. Without a path, the camera orbits the
+// center of the scene.
+//
+// The benchmark renders offscreen (see vkdf_init_headless()), so it runs
+// without a display, unless --window is given. Recording always opens a
+// window. With --dump, headless runs also write frames to disk as PPM
+// images for golden-image comparisons. With --gpu-culling, the instance
+// counts written by the GPU culling pass are checked against the CPU after
+// the run, and the bench fails if they differ.
+// ----------------------------------------------------------------------------
+
+const float WIN_WIDTH  = 1280.0f;
+const float WIN_HEIGHT = 720.0f;
+
+const uint32_t MAX_LIGHTS = 4;
+const uint32_t RECORD_INTERVAL = 30;   // Frames between recorded keyframes
+const uint32_t NUM_WALLS = 3;
+
+typedef struct {
+   uint32_t frames;
+   glm::vec3 pos;
+   glm::vec3 rot;
+} CameraKeyframe;
+
+typedef struct {
+   const char *name;
+   const DemoSceneBuilder *builder;    // NULL for the field of cubes
+
+   // Default camera path: an orbit around the center of the scene
+   float orbit_radius;
+   float orbit_height;
+   float orbit_pitch;
+} BenchScene;
+
+static const BenchScene bench_scenes[] = {
+   { "cubes",      NULL,                      120.0f, 20.0f, -10.0f },
+   { "sponza",     &sponza_scene_builder,      12.0f,  4.0f,  -5.0f },
+   { "scenelight", &scenelight_scene_builder,  40.0f, 15.0f, -15.0f },
+   { "shadow",     &shadow_scene_builder,      30.0f, 12.0f, -20.0f },
+};
+
+typedef struct {
+   const BenchScene *scene;
+   const char *data_dir;               // Data directory of demo scenes
+   uint32_t frames;                    // Frames measured
+   uint32_t warmup;                    // Frames rendered before measuring
+   uint32_t num_objects;
+   uint32_t num_lights;                // Shadow casting spotlights
+   uint32_t num_threads;
+   bool pipelined;
+   bool sw_occlusion;                  // Cull against the walls on the CPU
+   bool geometry_arena;                // Draw static sets from the arena
+   bool gpu_culling;                   // Cull static objects on the GPU
+   const char *path_file;              // Camera path to replay
+   const char *record_file;            // Record a camera path instead
+   const char *output_file;            // JSON report
+   const char *trace_file;             // Chrome trace of the last frames
+   bool window;                        // Render to a window, not offscreen
+   const char *dump_dir;               // Directory for frame dumps
+   uint32_t dump_interval;             // Frames between dumps
+} BenchOptions;
+
+struct PCBData {
+   uint8_t proj[sizeof(glm::mat4)];
+};
+
+typedef struct {
+   VkdfContext *ctx;
+   BenchOptions *opts;
+
+   VkdfScene *scene;
+
+   // Demo scenes: the builder's resources and where it loads them from
+   void *demo_scene;
+   char *data_dir;
+
+   VkdfCamera *camera;
+
+   VkdfLight *lights[MAX_LIGHTS];
+
+   VkdfProfiler *profiler;
+
+   struct {
+      VkDescriptorPool static_ubo_pool;
+   } descriptor_pool;
+
+   struct {
+      struct {
+         VkPipeline pipeline;
+         VkPipelineLayout layout;
+         struct {
+            VkDescriptorSetLayout camera_view_layout;
+            VkDescriptorSet camera_view_set;
+            VkDescriptorSetLayout obj_layout;
+            VkDescriptorSet obj_set;
+         } descr;
+      } obj;
+   } pipelines;
+
+   struct {
+      struct {
+         VkdfBuffer buf;
+         VkDeviceSize size;
+      } camera_view;
+   } ubos;
+
+   struct {
+      struct {
+         VkShaderModule vs;
+         VkShaderModule fs;
+      } obj;
+   } shaders;
+
+   VkdfMesh *cube_mesh;
+   VkdfModel *cube_model;
+
+   struct {
+      CameraKeyframe *keyframes;
+      uint32_t count;
+      uint32_t frames;                 // Frames to go through the path
+   } path;
+
+   GString *recording;
+
+   uint32_t frame;                     // Frames updated so far
+
+   // Scene statistics added up for the measured frames
+   struct {
+      uint64_t last_frame;
+      uint32_t count;
+      double visible_tiles;
+      double visible_static_objs;
+      double shadow_maps_updated;
+      double secondaries_recorded;
+      double secondaries_reused;
+      double resource_update_bytes;
+      double draw_calls;
+      double submits;
+   } stats;
+} BenchResources;
+
+// ----------------------------------------------------------------------------
+// Camera paths
+// ----------------------------------------------------------------------------
+
+static void
+add_keyframe(BenchResources *res,
+             uint32_t frames, glm::vec3 pos, glm::vec3 rot)
+{
+   uint32_t idx = res->path.count++;
+   res->path.keyframes =
+      g_renew(CameraKeyframe, res->path.keyframes, res->path.count);
+
+   res->path.keyframes[idx].frames = idx > 0 ? MAX2(frames, 1u) : 0;
+   res->path.keyframes[idx].pos = pos;
+   res->path.keyframes[idx].rot = rot;
+   res->path.frames += res->path.keyframes[idx].frames;
+}
+
+static bool
+load_camera_path(BenchResources *res, const char *path)
+{
+   char *contents;
+   GError *error = NULL;
+   if (!g_file_get_contents(path, &contents, NULL, &error)) {
+      vkdf_error("bench: failed to read camera path '%s': %s",
+                 path, error->message);
+      g_error_free(error);
+      return false;
+   }
+
+   char **lines = g_strsplit(contents, "\n", -1);
+   for (uint32_t i = 0; lines[i]; i++) {
+      const char *line = g_strstrip(lines[i]);
+      if (line[0] == '\0' || line[0] == '#')
+         continue;
+
+      uint32_t frames;
+      glm::vec3 pos, rot;
+      if (sscanf(line, "%u %f %f %f %f %f %f", &frames,
+                 &pos.x, &pos.y, &pos.z, &rot.x, &rot.y, &rot.z) != 7) {
+         vkdf_error("bench: invalid keyframe at line %u of '%s'",
+                    i + 1, path);
+         continue;
+      }
+
+      add_keyframe(res, frames, pos, rot);
+   }
+
+   g_strfreev(lines);
+   g_free(contents);
+
+   return res->path.count > 0;
+}
+
+static void
+init_default_camera_path(BenchResources *res)
+{
+   // Orbit the scene looking at its center
+   const BenchScene *scene = res->opts->scene;
+   const uint32_t steps = 8;
+   const float radius = scene->orbit_radius;
+   for (uint32_t i = 0; i <= steps; i++) {
+      float angle = 360.0f * i / steps;
+      glm::vec3 pos = glm::vec3(radius * sinf(DEG_TO_RAD(angle)),
+                                scene->orbit_height,
+                                radius * cosf(DEG_TO_RAD(angle)));
+      glm::vec3 rot = glm::vec3(scene->orbit_pitch, angle, 0.0f);
+      add_keyframe(res, 120, pos, rot);
+   }
+}
+
+/**
+ * Places the camera at its position in the path for the current frame.
+ * Paths that are shorter than the benchmark start over.
+ */
+static void
+replay_camera_path(BenchResources *res)
+{
+   VkdfCamera *cam = vkdf_scene_get_camera(res->scene);
+   const CameraKeyframe *keys = res->path.keyframes;
+
+   glm::vec3 pos = keys[0].pos;
+   glm::vec3 rot = keys[0].rot;
+
+   if (res->path.frames > 0) {
+      uint32_t frame = res->frame % res->path.frames;
+      uint32_t i = 1;
+      while (frame >= keys[i].frames) {
+         frame -= keys[i].frames;
+         i++;
+      }
+      assert(i < res->path.count);
+
+      float t = frame / (float) keys[i].frames;
+      pos = glm::mix(keys[i - 1].pos, keys[i].pos, t);
+      rot = glm::mix(keys[i - 1].rot, keys[i].rot, t);
+   }
+
+   vkdf_camera_set_position(cam, pos.x, pos.y, pos.z);
+   vkdf_camera_set_rotation(cam, rot.x, rot.y, rot.z);
+}
+
+static void
+record_camera_path(BenchResources *res)
+{
+   const float mov_speed = 0.5f;
+   const float rot_speed = 1.0f;
+
+   VkdfCamera *cam = vkdf_scene_get_camera(res->scene);
+   VkdfPlatform *platform = &res->ctx->platform;
+
+   // Rotation
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_LEFT))
+      vkdf_camera_rotate(cam, 0.0f, rot_speed, 0.0f);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_RIGHT))
+      vkdf_camera_rotate(cam, 0.0f, -rot_speed, 0.0f);
+
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_PAGE_UP))
+      vkdf_camera_rotate(cam, rot_speed, 0.0f, 0.0f);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_PAGE_DOWN))
+      vkdf_camera_rotate(cam, -rot_speed, 0.0f, 0.0f);
+
+   // Stepping
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_UP))
+      vkdf_camera_step(cam, mov_speed, 1, 1, 1);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_DOWN))
+      vkdf_camera_step(cam, -mov_speed, 1, 1, 1);
+
+   if (res->frame % RECORD_INTERVAL == 0) {
+      glm::vec3 pos = vkdf_camera_get_position(cam);
+      glm::vec3 rot = vkdf_camera_get_rotation(cam);
+      g_string_append_printf(res->recording, "%u %f %f %f %f %f %f\n",
+                             res->frame > 0 ? RECORD_INTERVAL : 0,
+                             pos.x, pos.y, pos.z, rot.x, rot.y, rot.z);
+   }
+}
+
+// ----------------------------------------------------------------------------
+// Scene
+// ----------------------------------------------------------------------------
+
+static inline VkdfBuffer
+create_ubo(VkdfContext *ctx, uint32_t size, uint32_t usage, uint32_t mem_props)
+{
+   usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+   VkdfBuffer buf = vkdf_create_buffer(ctx, 0, size, usage, mem_props);
+   return buf;
+}
+
+static void
+init_ubos(BenchResources *res)
+{
+   // Camera view
+   res->ubos.camera_view.size = sizeof(glm::mat4);
+   res->ubos.camera_view.buf = create_ubo(res->ctx,
+                                          res->ubos.camera_view.size,
+                                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
+
+static bool
+record_update_resources_command(VkdfContext *ctx,
+                                VkCommandBuffer cmd_buf,
+                                void *data)
+{
+   BenchResources *res = (BenchResources *) data;
+
+   VkdfCamera *camera = vkdf_scene_get_camera(res->scene);
+   if (!vkdf_camera_is_dirty(camera))
+      return false;
+
+   glm::mat4 view = vkdf_camera_get_view_matrix(res->camera);
+   vkCmdUpdateBuffer(cmd_buf,
+                     res->ubos.camera_view.buf.buf,
+                     0, sizeof(glm::mat4),
+                     &view[0][0]);
+
+   return true;
+}
+
+static void
+record_scene_commands(VkdfContext *ctx,
+                      VkCommandBuffer cmd_buf,
+                      GHashTable *sets, bool is_dynamic,
+                      bool is_depth_prepass, uint32_t lod, void *data)
+{
+   BenchResources *res = (BenchResources *) data;
+
+   VkdfSceneSetInfo *cube_info =
+      (VkdfSceneSetInfo *) g_hash_table_lookup(sets, "cube");
+   if (!cube_info || cube_info->count == 0)
+      return;
+
+   // Pipeline
+   vkCmdBindPipeline(cmd_buf,
+                     VK_PIPELINE_BIND_POINT_GRAPHICS,
+                     res->pipelines.obj.pipeline);
+
+   // Push constants
+   struct PCBData pcb_data;
+   glm::mat4 *proj = vkdf_camera_get_projection_ptr(res->scene->camera);
+   memcpy(&pcb_data.proj, &(*proj)[0][0], sizeof(pcb_data.proj));
+
+   vkCmdPushConstants(cmd_buf,
+                      res->pipelines.obj.layout,
+                      VK_SHADER_STAGE_VERTEX_BIT,
+                      0, sizeof(pcb_data), &pcb_data);
+
+   // Descriptors
+   VkDescriptorSet descriptor_sets[] = {
+      res->pipelines.obj.descr.camera_view_set,
+      res->pipelines.obj.descr.obj_set,
+   };
+
+   vkCmdBindDescriptorSets(cmd_buf,
+                           VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           res->pipelines.obj.layout,
+                           0,                        // First decriptor set
+                           2,                        // Descriptor set count
+                           descriptor_sets,          // Descriptor sets
+                           0,                        // Dynamic offset count
+                           NULL);                    // Dynamic offsets
+
+   vkdf_scene_draw_batches(res->scene, cmd_buf, cube_info, lod);
+}
+
+/**
+ * Sweeps the spotlights around the scene so their shadow maps need to be
+ * rendered every frame.
+ */
+static void
+update_lights(BenchResources *res)
+{
+   for (uint32_t i = 0; i < res->opts->num_lights; i++) {
+      float angle = DEG_TO_RAD((res->frame + i * 90) % 360);
+      vkdf_light_look_at(res->lights[i],
+                         glm::vec3(40.0f * cosf(angle),
+                                   0.0f,
+                                   40.0f * sinf(angle)));
+   }
+}
+
+static void
+collect_scene_stats(BenchResources *res)
+{
+   VkdfSceneStats stats;
+   vkdf_scene_get_stats(res->scene, &stats);
+
+   if (stats.frame <= res->stats.last_frame || stats.frame <= res->opts->warmup)
+      return;
+
+   res->stats.last_frame = stats.frame;
+   res->stats.count++;
+   res->stats.visible_tiles += stats.visible_tiles;
+   res->stats.visible_static_objs += stats.visible_static_objs;
+   res->stats.shadow_maps_updated += stats.shadow_maps_updated;
+   res->stats.secondaries_recorded += stats.secondaries_recorded;
+   res->stats.secondaries_reused += stats.secondaries_reused;
+   res->stats.resource_update_bytes += stats.resource_update_bytes;
+   res->stats.draw_calls += stats.draw_calls;
+   res->stats.submits += stats.submits;
+}
+
+/**
+ * Moves the camera and accounts for the frame. Demo scenes call this at the
+ * end of their own update.
+ */
+static void
+bench_update(void *data)
+{
+   BenchResources *res = (BenchResources *) data;
+
+   if (res->recording) {
+      record_camera_path(res);
+   } else {
+      replay_camera_path(res);
+      collect_scene_stats(res);
+
+      if (res->frame + 1 >= res->opts->warmup + res->opts->frames)
+         vkdf_event_loop_quit(res->ctx);
+   }
+
+   res->frame++;
+}
+
+static void
+scene_update(void *data)
+{
+   BenchResources *res = (BenchResources *) data;
+
+   if (!res->recording)
+      update_lights(res);
+
+   bench_update(res);
+}
+
+/**
+ * Enables the scene features selected on the command line that all scenes
+ * support. Runs before the scene is prepared.
+ */
+static void
+configure_scene(VkdfScene *s, void *data)
+{
+   BenchResources *res = (BenchResources *) data;
+
+   if (res->opts->pipelined)
+      vkdf_scene_enable_pipelined_update(s);
+
+   if (res->opts->sw_occlusion)
+      vkdf_scene_enable_sw_occlusion_culling(s);
+}
+
+static void
+init_scene(BenchResources *res)
+{
+   VkdfContext *ctx = res->ctx;
+
+   res->camera = vkdf_camera_new(0.0f, 20.0f, 120.0f,
+                                 -10.0f, 0.0f, 0.0f,
+                                 45.0f, 0.1f, 500.0f, WIN_WIDTH / WIN_HEIGHT);
+
+   glm::vec3 scene_origin = glm::vec3(-100.0f, -25.0f, -100.0f);
+   glm::vec3 scene_size = glm::vec3(200.0f, 50.0f, 200.0f);
+   glm::vec3 tile_size = glm::vec3(25.0f, 25.0f, 25.0f);
+   VkDeviceSize cache_budget = 4 * 1024 * 1024;
+   res->scene = vkdf_scene_new(ctx,
+                               WIN_WIDTH, WIN_HEIGHT,
+                               res->camera,
+                               scene_origin, scene_size, tile_size, 2,
+                               cache_budget, res->opts->num_threads);
+
+   vkdf_scene_set_scene_callbacks(res->scene,
+                                  scene_update,
+                                  record_update_resources_command,
+                                  record_scene_commands,
+                                  res);
+
+   configure_scene(res->scene, res);
+
+   // The bench only draws the cubes through vkdf_scene_draw_batches(), so
+   // it does not need their per-mesh buffers once they are in the arena
+   if (res->opts->geometry_arena || res->opts->gpu_culling) {
+      vkdf_scene_enable_geometry_arena(res->scene);
+      vkdf_scene_release_static_geometry_buffers(res->scene);
+   }
+
+   if (res->opts->gpu_culling)
+      vkdf_scene_enable_gpu_culling(res->scene);
+}
+
+static void
+init_lights(BenchResources *res)
+{
+   glm::vec4 diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+   glm::vec4 ambient = glm::vec4(0.02f, 0.02f, 0.02f, 1.0f);
+   glm::vec4 specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+   glm::vec4 attenuation = glm::vec4(0.1f, 0.05f, 0.005f, 0.0f);
+   glm::vec4 angle_attenuation = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+   float cutoff_angle = DEG_TO_RAD(45.0f);
+
+   VkdfSceneShadowSpec shadow_spec;
+   vkdf_scene_shadow_spec_set(&shadow_spec,
+                              0, 1024, 0.1f, 100.0f, 4.0f, 1.5f,
+                              0.0f, glm::vec3(0.0f), 2);
+
+   for (uint32_t i = 0; i < res->opts->num_lights; i++) {
+      float angle = DEG_TO_RAD(i * 90.0f + 45.0f);
+      glm::vec4 origin = glm::vec4(60.0f * cosf(angle),
+                                   40.0f,
+                                   60.0f * sinf(angle),
+                                   2.0f);
+
+      res->lights[i] =
+         vkdf_light_new_spotlight(origin, cutoff_angle,
+                                  diffuse, ambient, specular,
+                                  attenuation, angle_attenuation);
+
+      vkdf_light_look_at(res->lights[i], glm::vec3(0.0f, 0.0f, 0.0f));
+
+      vkdf_scene_add_light(res->scene, res->lights[i], &shadow_spec);
+   }
+}
+
+static void
+init_obj_pipeline(BenchResources *res)
+{
+   VkPushConstantRange pcb_range;
+   pcb_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+   pcb_range.offset = 0;
+   pcb_range.size = sizeof(PCBData);
+
+   VkPushConstantRange pcb_ranges[] = {
+      pcb_range,
+   };
+
+   res->pipelines.obj.descr.camera_view_layout =
+      vkdf_create_ubo_descriptor_set_layout(res->ctx, 0, 1,
+                                            VK_SHADER_STAGE_VERTEX_BIT,
+                                            false);
+
+   // Object data goes in a storage buffer (see vkdf_scene_get_object_ubo()),
+   // materials in a uniform buffer
+   VkDescriptorSetLayoutBinding obj_bindings[2];
+   for (uint32_t i = 0; i < 2; i++) {
+      obj_bindings[i].binding = i;
+      obj_bindings[i].descriptorType = i == 0 ?
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      obj_bindings[i].descriptorCount = 1;
+      obj_bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT |
+                                   VK_SHADER_STAGE_FRAGMENT_BIT;
+      obj_bindings[i].pImmutableSamplers = NULL;
+   }
+
+   VkDescriptorSetLayoutCreateInfo obj_layout_info;
+   obj_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+   obj_layout_info.pNext = NULL;
+   obj_layout_info.bindingCount = 2;
+   obj_layout_info.pBindings = obj_bindings;
+   obj_layout_info.flags = 0;
+
+   VK_CHECK(vkCreateDescriptorSetLayout(res->ctx->device,
+                                        &obj_layout_info,
+                                        NULL,
+                                        &res->pipelines.obj.descr.obj_layout));
+
+   VkDescriptorSetLayout layouts[] = {
+      res->pipelines.obj.descr.camera_view_layout,
+      res->pipelines.obj.descr.obj_layout,
+   };
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = pcb_ranges;
+   pipeline_layout_info.setLayoutCount = 2;
+   pipeline_layout_info.pSetLayouts = layouts;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(res->ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &res->pipelines.obj.layout));
+
+   res->pipelines.obj.descr.camera_view_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.obj.descr.camera_view_layout);
+
+   VkDeviceSize ubo_offset = 0;
+   VkDeviceSize ubo_size = res->ubos.camera_view.size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.obj.descr.camera_view_set,
+                                     res->ubos.camera_view.buf.buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, true);
+
+   res->pipelines.obj.descr.obj_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.obj.descr.obj_layout);
+
+   VkdfBuffer *obj_ubo = vkdf_scene_get_object_ubo(res->scene);
+   ubo_offset = 0;
+   ubo_size = vkdf_scene_get_object_ubo_size(res->scene);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.obj.descr.obj_set,
+                                     obj_ubo->buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, false);
+
+   VkdfBuffer *material_ubo = vkdf_scene_get_material_ubo(res->scene);
+   ubo_offset = 0;
+   ubo_size = vkdf_scene_get_material_ubo_size(res->scene);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.obj.descr.obj_set,
+                                     material_ubo->buf,
+                                     1, 1, &ubo_offset, &ubo_size, false, true);
+
+   VkVertexInputBindingDescription vi_bindings[1];
+   VkVertexInputAttributeDescription vi_attribs[2];
+
+   // Vertex attribute binding 0: position, normal
+   uint32_t stride = 2 * sizeof(glm::vec3);
+   vkdf_vertex_binding_set(&vi_bindings[0],
+                           0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
+
+   /* binding 0, location 0: position
+    * binding 0, location 1: normal
+    */
+   vkdf_vertex_attrib_set(&vi_attribs[0], 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+   vkdf_vertex_attrib_set(&vi_attribs[1], 0, 1, VK_FORMAT_R32G32B32_SFLOAT, 12);
+
+   VkRenderPass renderpass = vkdf_scene_get_static_render_pass(res->scene);
+
+   VkPrimitiveTopology primitive = vkdf_mesh_get_primitive(res->cube_mesh);
+   res->pipelines.obj.pipeline =
+      vkdf_create_gfx_pipeline(res->ctx,
+                               NULL,
+                               1,
+                               vi_bindings,
+                               2,
+                               vi_attribs,
+                               true,
+                               VK_COMPARE_OP_LESS,
+                               renderpass,
+                               res->pipelines.obj.layout,
+                               primitive,
+                               VK_CULL_MODE_BACK_BIT,
+                               1,
+                               res->shaders.obj.vs,
+                               res->shaders.obj.fs);
+}
+
+static void
+init_shaders(BenchResources *res)
+{
+   res->shaders.obj.vs = vkdf_create_shader_module(res->ctx, "obj.vert.spv");
+   res->shaders.obj.fs = vkdf_create_shader_module(res->ctx, "obj.frag.spv");
+}
+
+static void
+init_meshes(BenchResources *res)
+{
+   VkdfMaterial red;
+   red.diffuse = glm::vec4(0.5f, 0.0f, 0.0f, 1.0f);
+   red.ambient = glm::vec4(0.5f, 0.0f, 0.0f, 1.0f);
+   red.specular = glm::vec4(1.0f, 0.75f, 0.75f, 1.0f);
+   red.shininess = 48.0f;
+
+   VkdfMaterial green;
+   green.diffuse = glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
+   green.ambient = glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
+   green.specular = glm::vec4(0.75f, 1.0f, 0.75f, 1.0f);
+   green.shininess = 48.0f;
+
+   VkdfMaterial blue;
+   blue.diffuse = glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
+   blue.ambient = glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
+   blue.specular = glm::vec4(0.75f, 0.75f, 1.0f, 1.0f);
+   blue.shininess = 48.0f;
+
+   res->cube_mesh = vkdf_cube_mesh_new(res->ctx);
+   vkdf_mesh_fill_vertex_buffer(res->ctx, res->cube_mesh);
+
+   res->cube_model = vkdf_model_new();
+   vkdf_model_add_mesh(res->cube_model, res->cube_mesh);
+   vkdf_model_compute_box(res->cube_model);
+
+   vkdf_model_add_material(res->cube_model, &red);
+   vkdf_model_add_material(res->cube_model, &green);
+   vkdf_model_add_material(res->cube_model, &blue);
+}
+
+static void
+init_objects(BenchResources *res)
+{
+   // Fixed seed so all runs benchmark the same scene
+   srandom(1);
+
+   glm::vec3 origin = res->scene->scene_area.origin;
+   for (uint32_t i = 0; i < res->opts->num_objects; i++) {
+      glm::vec3 pos;
+      pos.x = origin.x + random() % ((uint32_t) (res->scene->scene_area.w - 1.0f));
+      pos.y = origin.y + random() % ((uint32_t) (res->scene->scene_area.h - 1.0f));
+      pos.z = origin.z + random() % ((uint32_t) (res->scene->scene_area.d - 1.0f));
+      pos.x += (random() % 100) / 100.0f;
+      pos.y += (random() % 100) / 100.0f;
+      pos.z += (random() % 100) / 100.0f;
+
+      VkdfObject *obj = vkdf_object_new_from_model(pos, res->cube_model);
+      vkdf_object_set_material_idx_base(obj, random() % 3);
+      vkdf_object_set_lighting_behavior(obj, true, true);
+      vkdf_scene_add_object(res->scene, "cube", obj);
+   }
+
+   // A few large walls across the camera path, alternating sides, so part
+   // of the scene is hidden behind them. They are the occluders used with
+   // --sw-occlusion.
+   for (uint32_t i = 0; i < NUM_WALLS; i++) {
+      glm::vec3 pos = glm::vec3((i % 2 ? 40.0f : -40.0f),
+                                0.0f,
+                                -50.0f + 50.0f * i);
+
+      VkdfObject *obj = vkdf_object_new_from_model(pos, res->cube_model);
+      vkdf_object_set_scale(obj, glm::vec3(60.0f, 20.0f, 1.0f));
+      vkdf_object_set_material_idx_base(obj, i % 3);
+      vkdf_object_set_lighting_behavior(obj, true, true);
+      vkdf_object_set_occluder(obj, true);
+      vkdf_scene_add_object(res->scene, "cube", obj);
+   }
+
+   VkClearValue color_clear;
+   vkdf_color_clear_set(&color_clear, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+   VkClearValue depth_clear;
+   vkdf_depth_stencil_clear_set(&depth_clear, 1.0f, 0);
+
+   vkdf_scene_set_clear_values(res->scene, &color_clear, &depth_clear);
+
+   vkdf_scene_prepare(res->scene);
+}
+
+static void
+init_descriptor_pools(BenchResources *res)
+{
+   // Object descriptor sets mix storage and uniform buffers
+   VkDescriptorPoolSize pool_sizes[2];
+   pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   pool_sizes[0].descriptorCount = 8;
+   pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   pool_sizes[1].descriptorCount = 2;
+
+   VkDescriptorPoolCreateInfo pool_ci;
+   pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+   pool_ci.pNext = NULL;
+   pool_ci.maxSets = 8;
+   pool_ci.poolSizeCount = 2;
+   pool_ci.pPoolSizes = pool_sizes;
+   pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+   VK_CHECK(vkCreateDescriptorPool(res->ctx->device, &pool_ci, NULL,
+                                   &res->descriptor_pool.static_ubo_pool));
+}
+
+static void
+init_demo_scene(BenchResources *res)
+{
+   const BenchScene *scene = res->opts->scene;
+
+   if (res->opts->data_dir)
+      res->data_dir = g_strdup(res->opts->data_dir);
+   else
+      res->data_dir = g_build_filename(DEMOS_DIR, scene->name, NULL);
+
+   DemoSceneOptions scene_opts;
+   demo_scene_options_init(&scene_opts, WIN_WIDTH, WIN_HEIGHT);
+   scene_opts.data_dir = res->data_dir;
+   scene_opts.num_threads = res->opts->num_threads;
+   scene_opts.interactive = false;
+   scene_opts.configure_cb = configure_scene;
+   scene_opts.update_cb = bench_update;
+   scene_opts.cb_data = res;
+
+   res->demo_scene = scene->builder->build(res->ctx, &scene_opts);
+   res->scene = scene->builder->get_scene(res->demo_scene);
+}
+
+static void
+init_resources(VkdfContext *ctx, BenchOptions *opts, BenchResources *res)
+{
+   memset(res, 0, sizeof(BenchResources));
+
+   res->ctx = ctx;
+   res->opts = opts;
+
+   if (opts->record_file) {
+      res->recording = g_string_new("# frames pos.x pos.y pos.z "
+                                    "rot.x rot.y rot.z\n");
+   } else if (!opts->path_file) {
+      init_default_camera_path(res);
+   } else if (!load_camera_path(res, opts->path_file)) {
+      vkdf_fatal("bench: no keyframes in camera path '%s'", opts->path_file);
+   }
+
+   if (opts->scene->builder) {
+      init_demo_scene(res);
+   } else {
+      init_scene(res);
+      init_meshes(res);
+      init_objects(res);
+      init_lights(res);
+      init_ubos(res);
+      init_shaders(res);
+      init_descriptor_pools(res);
+      init_obj_pipeline(res);
+   }
+
+   // The ring keeps the last 'frames' frames, so warmup frames are dropped
+   if (!res->recording) {
+      res->profiler = vkdf_profiler_new(ctx, opts->frames);
+      vkdf_set_profiler(ctx, res->profiler);
+   }
+}
+
+// ----------------------------------------------------------------------------
+// Report
+// ----------------------------------------------------------------------------
+
+static void
+append_summary(GString *str, const char *indent, const char *name,
+               VkdfProfilerSummary *s, bool last)
+{
+   g_string_append_printf(str,
+                          "%s\"%s\": { \"count\": %u, \"avg\": %.4f, "
+                          "\"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, "
+                          "\"p95\": %.4f, \"p99\": %.4f }%s\n",
+                          indent, name, s->count,
+                          s->avg * 1000.0, s->min * 1000.0, s->max * 1000.0,
+                          s->p50 * 1000.0, s->p95 * 1000.0, s->p99 * 1000.0,
+                          last ? "" : ",");
+}
+
+static void
+append_zone_summaries(GString *str, VkdfProfiler *p, bool gpu)
+{
+   uint32_t count = 0;
+   VkdfProfilerSummary summaries[VKDF_PROFILER_MAX_ZONES];
+   const char *names[VKDF_PROFILER_MAX_ZONES];
+
+   for (uint32_t i = 0; i < p->num_zones; i++) {
+      if (p->zones[i].gpu != gpu)
+         continue;
+
+      bool found = gpu ?
+         vkdf_profiler_get_gpu_summary(p, p->zones[i].name, &summaries[count]) :
+         vkdf_profiler_get_cpu_summary(p, p->zones[i].name, &summaries[count]);
+      if (found)
+         names[count++] = p->zones[i].name;
+   }
+
+   for (uint32_t i = 0; i < count; i++)
+      append_summary(str, "    ", names[i], &summaries[i], i == count - 1);
+}
+
+static void
+append_stat(GString *str, const char *name, double total, uint32_t count,
+            bool last)
+{
+   g_string_append_printf(str, "    \"%s\": %.2f%s\n",
+                          name, count > 0 ? total / count : 0.0,
+                          last ? "" : ",");
+}
+
+/**
+ * Writes the report, with times in milliseconds and the average of each
+ * scene statistic over the measured frames.
+ */
+static bool
+write_report(BenchResources *res)
+{
+   BenchOptions *opts = res->opts;
+   VkdfProfiler *p = res->profiler;
+
+   GString *str = g_string_new("{\n");
+
+   g_string_append_printf(str, "  \"device\": \"%s\",\n",
+                          res->ctx->phy_device_props.deviceName);
+   g_string_append_printf(str, "  \"width\": %u,\n", (uint32_t) WIN_WIDTH);
+   g_string_append_printf(str, "  \"height\": %u,\n", (uint32_t) WIN_HEIGHT);
+   g_string_append_printf(str, "  \"scene_name\": \"%s\",\n",
+                          opts->scene->name);
+   g_string_append_printf(str, "  \"objects\": %u,\n",
+                          vkdf_scene_get_object_count(res->scene));
+   g_string_append_printf(str, "  \"lights\": %u,\n",
+                          vkdf_scene_get_num_lights(res->scene));
+   g_string_append_printf(str, "  \"threads\": %u,\n", opts->num_threads);
+   g_string_append_printf(str, "  \"pipelined\": %s,\n",
+                          opts->pipelined ? "true" : "false");
+   g_string_append_printf(str, "  \"sw_occlusion\": %s,\n",
+                          opts->sw_occlusion ? "true" : "false");
+   g_string_append_printf(str, "  \"geometry_arena\": %s,\n",
+                          opts->geometry_arena ? "true" : "false");
+   g_string_append_printf(str, "  \"gpu_culling\": %s,\n",
+                          opts->gpu_culling ? "true" : "false");
+   g_string_append_printf(str, "  \"warmup\": %u,\n", opts->warmup);
+   g_string_append_printf(str, "  \"headless\": %s,\n",
+                          res->ctx->headless ? "true" : "false");
+
+   VkdfProfilerSummary summary;
+   g_string_append(str, "  \"frame\": {\n");
+   vkdf_profiler_get_frame_summary(p, &summary);
+   append_summary(str, "    ", "cpu", &summary, false);
+   vkdf_profiler_get_gpu_frame_summary(p, &summary);
+   append_summary(str, "    ", "gpu", &summary, true);
+   g_string_append(str, "  },\n");
+
+   g_string_append(str, "  \"cpu_zones\": {\n");
+   append_zone_summaries(str, p, false);
+   g_string_append(str, "  },\n");
+
+   g_string_append(str, "  \"gpu_zones\": {\n");
+   append_zone_summaries(str, p, true);
+   g_string_append(str, "  },\n");
+
+   uint32_t n = res->stats.count;
+   g_string_append(str, "  \"scene\": {\n");
+   g_string_append_printf(str, "    \"frames\": %u,\n", n);
+   append_stat(str, "visible_tiles", res->stats.visible_tiles, n, false);
+   append_stat(str, "visible_static_objs",
+               res->stats.visible_static_objs, n, false);
+   append_stat(str, "shadow_maps_updated",
+               res->stats.shadow_maps_updated, n, false);
+   append_stat(str, "secondaries_recorded",
+               res->stats.secondaries_recorded, n, false);
+   append_stat(str, "secondaries_reused",
+               res->stats.secondaries_reused, n, false);
+   append_stat(str, "resource_update_bytes",
+               res->stats.resource_update_bytes, n, false);
+   append_stat(str, "draw_calls", res->stats.draw_calls, n, false);
+   append_stat(str, "submits", res->stats.submits, n, true);
+   g_string_append(str, "  }\n");
+
+   g_string_append(str, "}\n");
+
+   GError *error = NULL;
+   bool result = g_file_set_contents(opts->output_file, str->str, str->len,
+                                     &error);
+   if (!result) {
+      vkdf_error("bench: failed to write report '%s': %s",
+                 opts->output_file, error->message);
+      g_error_free(error);
+   } else {
+      vkdf_info("bench: report written to '%s'.\n", opts->output_file);
+   }
+
+   g_string_free(str, TRUE);
+   return result;
+}
+
+static bool
+write_recording(BenchResources *res)
+{
+   GError *error = NULL;
+   bool result = g_file_set_contents(res->opts->record_file,
+                                     res->recording->str,
+                                     res->recording->len,
+                                     &error);
+   if (!result) {
+      vkdf_error("bench: failed to write camera path '%s': %s",
+                 res->opts->record_file, error->message);
+      g_error_free(error);
+   } else {
+      vkdf_info("bench: camera path written to '%s'.\n",
+                res->opts->record_file);
+   }
+
+   return result;
+}
+
+// ----------------------------------------------------------------------------
+// Cleanup
+// ----------------------------------------------------------------------------
+
+static void
+destroy_pipelines(BenchResources *res)
+{
+   vkDestroyPipeline(res->ctx->device, res->pipelines.obj.pipeline, NULL);
+
+   vkDestroyPipelineLayout(res->ctx->device, res->pipelines.obj.layout, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.obj.descr.obj_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->pipelines.obj.descr.obj_layout, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.obj.descr.camera_view_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->pipelines.obj.descr.camera_view_layout, NULL);
+
+   vkDestroyDescriptorPool(res->ctx->device,
+                           res->descriptor_pool.static_ubo_pool, NULL);
+}
+
+static void
+destroy_shader_modules(BenchResources *res)
+{
+   vkDestroyShaderModule(res->ctx->device, res->shaders.obj.vs, NULL);
+   vkDestroyShaderModule(res->ctx->device, res->shaders.obj.fs, NULL);
+}
+
+static void
+cleanup_resources(VkdfContext *ctx, BenchResources *res)
+{
+   if (res->profiler) {
+      vkdf_set_profiler(ctx, NULL);
+      vkdf_profiler_free(res->profiler);
+   }
+
+   if (res->recording)
+      g_string_free(res->recording, TRUE);
+   g_free(res->path.keyframes);
+
+   if (res->demo_scene) {
+      res->opts->scene->builder->free(ctx, res->demo_scene);
+      g_free(res->data_dir);
+      return;
+   }
+
+   vkdf_scene_free(res->scene);
+   vkdf_model_free(ctx, res->cube_model);
+   destroy_shader_modules(res);
+   destroy_pipelines(res);
+   vkdf_destroy_buffer(ctx, &res->ubos.camera_view.buf);
+
+   vkdf_camera_free(ctx, res->camera);
+}
+
+// ----------------------------------------------------------------------------
+// Main
+// ----------------------------------------------------------------------------
+
+static void
+usage()
+{
+   printf("Usage: ./vkdf-bench [options]\n"
+          "  -f, --frames N      Frames to measure (default: 1000)\n"
+          "  -w, --warmup N      Frames to render before measuring "
+          "(default: 100)\n"
+          "  -s, --scene NAME    Scene to render: cubes, sponza, scenelight "
+          "or shadow\n"
+          "                      (default: cubes)\n"
+          "  --data-dir DIR      Shaders and models of demo scenes "
+          "(default: the\n"
+          "                      demo's build directory)\n"
+          "  -n, --objects N     Cubes in the scene (default: 20000)\n"
+          "  -l, --lights N      Shadow casting spotlights among the cubes, "
+          "up to %u\n"
+          "                      (default: 1)\n"
+          "  -t, --threads N     Scene threads (default: 4)\n"
+          "  --pipelined         Update frame N+1 while rendering frame N\n"
+          "  --sw-occlusion      Cull objects hidden behind the walls on "
+          "the CPU\n"
+          "  --geometry-arena    Draw the cubes from the scene geometry "
+          "arena (cubes only)\n"
+          "  --gpu-culling       Cull the cubes on the GPU and check the "
+          "results\n"
+          "                      (cubes only)\n"
+          "  -p, --path FILE     Camera path to replay\n"
+          "  -r, --record FILE   Record a camera path instead of measuring\n"
+          "  -o, --output FILE   JSON report (default: vkdf-bench.json)\n"
+          "  --trace FILE        Chrome trace of the measured frames\n"
+          "  --window            Render to a window instead of offscreen\n"
+          "  -d, --dump DIR      Write rendered frames to DIR as PPM images\n"
+          "  --dump-interval N   Frames between dumped frames (default: 100)\n",
+          MAX_LIGHTS);
+   exit(1);
+}
+
+static uint32_t
+parse_uint(const char *value)
+{
+   char *end;
+   unsigned long n = value ? strtoul(value, &end, 10) : 0;
+   if (!value || *end != '\0')
+      usage();
+   return (uint32_t) n;
+}
+
+static const BenchScene *
+find_scene(const char *name)
+{
+   const uint32_t num_scenes = sizeof(bench_scenes) / sizeof(bench_scenes[0]);
+   for (uint32_t i = 0; i < num_scenes; i++) {
+      if (!strcmp(bench_scenes[i].name, name))
+         return &bench_scenes[i];
+   }
+   usage();
+   return NULL;
+}
+
+static void
+process_cmd_line(int argc, char **argv, BenchOptions *opts)
+{
+   memset(opts, 0, sizeof(BenchOptions));
+   opts->scene = &bench_scenes[0];
+   opts->frames = 1000;
+   opts->warmup = 100;
+   opts->num_objects = 20000;
+   opts->num_lights = 1;
+   opts->num_threads = 4;
+   opts->output_file = "vkdf-bench.json";
+   opts->dump_interval = 100;
+
+   for (int32_t i = 1; i < argc; i++) {
+      const char *arg = argv[i];
+      const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+      if (!strcmp(arg, "--pipelined")) {
+         opts->pipelined = true;
+         continue;
+      }
+
+      if (!strcmp(arg, "--sw-occlusion")) {
+         opts->sw_occlusion = true;
+         continue;
+      }
+
+      if (!strcmp(arg, "--geometry-arena")) {
+         opts->geometry_arena = true;
+         continue;
+      }
+
+      if (!strcmp(arg, "--gpu-culling")) {
+         opts->gpu_culling = true;
+         continue;
+      }
+
+      if (!strcmp(arg, "--window")) {
+         opts->window = true;
+         continue;
+      }
+
+      if (!value)
+         usage();
+      i++;
+
+      if (!strcmp(arg, "-s") || !strcmp(arg, "--scene"))
+         opts->scene = find_scene(value);
+      else if (!strcmp(arg, "--data-dir"))
+         opts->data_dir = value;
+      else if (!strcmp(arg, "-f") || !strcmp(arg, "--frames"))
+         opts->frames = parse_uint(value);
+      else if (!strcmp(arg, "-w") || !strcmp(arg, "--warmup"))
+         opts->warmup = parse_uint(value);
+      else if (!strcmp(arg, "-n") || !strcmp(arg, "--objects"))
+         opts->num_objects = parse_uint(value);
+      else if (!strcmp(arg, "-l") || !strcmp(arg, "--lights"))
+         opts->num_lights = parse_uint(value);
+      else if (!strcmp(arg, "-t") || !strcmp(arg, "--threads"))
+         opts->num_threads = parse_uint(value);
+      else if (!strcmp(arg, "-p") || !strcmp(arg, "--path"))
+         opts->path_file = value;
+      else if (!strcmp(arg, "-r") || !strcmp(arg, "--record"))
+         opts->record_file = value;
+      else if (!strcmp(arg, "-o") || !strcmp(arg, "--output"))
+         opts->output_file = value;
+      else if (!strcmp(arg, "--trace"))
+         opts->trace_file = value;
+      else if (!strcmp(arg, "-d") || !strcmp(arg, "--dump"))
+         opts->dump_dir = value;
+      else if (!strcmp(arg, "--dump-interval"))
+         opts->dump_interval = parse_uint(value);
+      else
+         usage();
+   }
+
+   // Recording needs keyboard input
+   if (opts->record_file)
+      opts->window = true;
+
+   if (opts->frames == 0 || opts->num_objects == 0 ||
+       opts->num_threads == 0 || opts->num_lights > MAX_LIGHTS ||
+       opts->dump_interval == 0 || (opts->dump_dir && opts->window))
+      usage();
+
+   // Demo scenes draw their own sets, so they can't drop the per-mesh
+   // buffers that the geometry arena replaces
+   if (opts->scene->builder && (opts->geometry_arena || opts->gpu_culling))
+      usage();
+}
+
+int
+main(int argc, char *argv[])
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+   BenchResources resources;
+
+   process_cmd_line(argc, argv, &opts);
+
+   if (opts.window) {
+      vkdf_init(&ctx, WIN_WIDTH, WIN_HEIGHT, false, false, false);
+   } else {
+      vkdf_init_headless(&ctx, WIN_WIDTH, WIN_HEIGHT, false);
+      if (opts.dump_dir)
+         vkdf_headless_set_frame_dump(&ctx, opts.dump_dir, opts.dump_interval);
+   }
+   init_resources(&ctx, &opts, &resources);
+
+   vkdf_scene_event_loop_run(resources.scene);
+
+   bool result;
+   if (resources.recording) {
+      result = write_recording(&resources);
+   } else {
+      vkdf_profiler_log_summary(resources.profiler);
+      result = write_report(&resources);
+      if (opts.trace_file)
+         result = vkdf_profiler_write_chrome_trace(resources.profiler,
+                                                   opts.trace_file) && result;
+   }
+
+   if (opts.gpu_culling) {
+      uint32_t mismatches = vkdf_scene_check_gpu_culling(resources.scene);
+      if (mismatches > 0) {
+         vkdf_error("bench: GPU culling differs from the CPU in %u sets",
+                    mismatches);
+         result = false;
+      }
+   }
+
+   cleanup_resources(&ctx, &resources);
+   vkdf_cleanup(&ctx);
+
+   return result ? 0 : 1;
+}
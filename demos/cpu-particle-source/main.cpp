@@ -281,7 +281,7 @@ init_resources(VkdfContext *ctx, DemoResources *res)
                                  VK_ATTACHMENT_LOAD_OP_CLEAR,
                                  VK_ATTACHMENT_STORE_OP_STORE,
                                  VK_IMAGE_LAYOUT_UNDEFINED,
-                                 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                 vkdf_get_present_layout(ctx),
                                  res->depth_image.format,
                                  VK_ATTACHMENT_LOAD_OP_CLEAR,
                                  VK_ATTACHMENT_STORE_OP_STORE,
@@ -417,8 +417,7 @@ destroy_particle_source_resources(VkdfContext *ctx, DemoResources *res)
                         1, &res->psr_descriptor_set);
    vkDestroyDescriptorSetLayout(ctx->device, res->psr_descriptor_set_layout, NULL);
 
-   vkDestroyBuffer(ctx->device, res->psr_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->psr_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->psr_ubo);
 
   vkDestroyShaderModule(ctx->device, res->psr_vs_module, NULL);
   vkDestroyShaderModule(ctx->device, res->psr_fs_module, NULL);
@@ -0,0 +1,88 @@
+#ifndef __DEMO_SCENE_H__
+#define __DEMO_SCENE_H__
+
+#include "vkdf.hpp"
+
+// ----------------------------------------------------------------------------
+// Demo scene builders
+//
+// Demos that render a VkdfScene build it through a DemoSceneBuilder, so
+// other programs (like the bench) can build the same scene and drive it
+// themselves. A builder loads its shaders and models from a data directory,
+// which is the demo's directory when the demo runs it.
+// ----------------------------------------------------------------------------
+
+typedef struct {
+   const char *data_dir;         // Where the shaders and models are
+   float width;
+   float height;
+   uint32_t num_threads;         // Scene threads
+
+   // Let the user move the camera and enable debug views. Otherwise, the
+   // camera is left alone for the caller to drive.
+   bool interactive;
+
+   // Called right before the scene is prepared, to enable scene features
+   void (*configure_cb)(VkdfScene *s, void *data);
+
+   // Called at the end of every scene update
+   void (*update_cb)(void *data);
+
+   void *cb_data;
+} DemoSceneOptions;
+
+typedef struct {
+   const char *name;
+
+   /**
+    * Builds and prepares the scene. Returns the builder's resources, which
+    * are passed to the other hooks.
+    */
+   void *(*build)(VkdfContext *ctx, const DemoSceneOptions *opts);
+
+   VkdfScene *(*get_scene)(void *data);
+
+   void (*free)(VkdfContext *ctx, void *data);
+} DemoSceneBuilder;
+
+extern const DemoSceneBuilder sponza_scene_builder;
+extern const DemoSceneBuilder scenelight_scene_builder;
+extern const DemoSceneBuilder shadow_scene_builder;
+
+/**
+ * Options to run a scene as its own demo: loaded from the current
+ * directory, with a single scene thread and user input.
+ */
+static inline void
+demo_scene_options_init(DemoSceneOptions *opts, float width, float height)
+{
+   memset(opts, 0, sizeof(DemoSceneOptions));
+   opts->data_dir = ".";
+   opts->width = width;
+   opts->height = height;
+   opts->num_threads = 1;
+   opts->interactive = true;
+}
+
+/**
+ * Returns the path to a file in the scene's data directory. The caller
+ * takes ownership of the string.
+ */
+static inline char *
+demo_scene_get_path(const DemoSceneOptions *opts, const char *file)
+{
+   return g_build_filename(opts->data_dir, file, NULL);
+}
+
+static inline VkShaderModule
+demo_scene_create_shader_module(VkdfContext *ctx,
+                                const DemoSceneOptions *opts,
+                                const char *file)
+{
+   char *path = demo_scene_get_path(opts, file);
+   VkShaderModule module = vkdf_create_shader_module(ctx, path);
+   g_free(path);
+   return module;
+}
+
+#endif
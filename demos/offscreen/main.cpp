@@ -240,7 +240,7 @@ present_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
       vkdf_create_image_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
                                 VK_ACCESS_MEMORY_READ_BIT,
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                vkdf_get_present_layout(ctx),
                                 ctx->swap_chain_images[index].image,
                                 subresource_range);
 
@@ -536,8 +536,7 @@ destroy_descriptor_resources(VkdfContext *ctx, DemoResources *res)
 static void
 destroy_ubo_resources(VkdfContext *ctx, DemoResources *res)
 {
-   vkDestroyBuffer(ctx->device, res->ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->ubo);
 }
 
 void
@@ -141,7 +141,7 @@ create_render_pass(VkdfContext *ctx, DemoResources *res)
    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-   attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   attachments[0].finalLayout = vkdf_get_present_layout(ctx);
    attachments[0].flags = 0;
 
    // Depth attachment
@@ -1050,21 +1050,17 @@ destroy_descriptor_resources(VkdfContext *ctx, DemoResources *res)
 static void
 destroy_ubo_resources(VkdfContext *ctx, DemoResources *res)
 {
-   vkDestroyBuffer(ctx->device, res->light_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->light_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->light_ubo);
 
-   vkDestroyBuffer(ctx->device, res->VP_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->VP_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->VP_ubo);
 
-   vkDestroyBuffer(ctx->device, res->M_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->M_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->M_ubo);
 }
 
 void
 cleanup_resources(VkdfContext *ctx, DemoResources *res)
 {
-   vkDestroyBuffer(ctx->device, res->instance_buf.buf, NULL);
-   vkFreeMemory(ctx->device, res->instance_buf.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->instance_buf);
    for (uint32_t i = 0; i < NUM_OBJECTS; i++)
       vkdf_object_free(res->objs[i]);
 
@@ -106,7 +106,7 @@ static void
 record_scene_commands(VkdfContext *ctx,
                       VkCommandBuffer cmd_buf,
                       GHashTable *sets, bool is_dynamic,
-                      bool is_depth_prepass, void *data)
+                      bool is_depth_prepass, uint32_t lod, void *data)
 {
    SceneResources *res = (SceneResources *) data;
 
@@ -215,7 +215,7 @@ init_scene(SceneResources *res)
 
    glm::vec3 scene_origin = glm::vec3(-500.0f, -500.0f, -500.0f);
    glm::vec3 scene_size = glm::vec3(1000.0f, 1000.0f, 1000.0f);
-   uint32_t cache_size = 8;
+   VkDeviceSize cache_budget = 4 * 1024 * 1024;
 #if 1
    // Final
    glm::vec3 tile_size = glm::vec3(250.0f, 250.0f, 250.0f);
@@ -223,7 +223,7 @@ init_scene(SceneResources *res)
                                WIN_WIDTH, WIN_HEIGHT,
                                res->camera,
                                scene_origin, scene_size, tile_size, 2,
-                               cache_size, 4);
+                               cache_budget, 4);
 #elif 0
    // Naive CPU clipping
    glm::vec3 tile_size = glm::vec3(25.0f, 25.0f, 25.0f);
@@ -231,7 +231,7 @@ init_scene(SceneResources *res)
                                WIN_WIDTH, WIN_HEIGHT,
                                res->camera,
                                scene_origin, scene_size, tile_size, 1,
-                               cache_size, 1);
+                               cache_budget, 1);
 #else
    // GPU clipping only
    glm::vec3 tile_size = glm::vec3(1000.0f, 1000.0f, 1000.0f);
@@ -239,7 +239,7 @@ init_scene(SceneResources *res)
                                WIN_WIDTH, WIN_HEIGHT,
                                res->camera,
                                scene_origin, scene_size, tile_size, 1,
-                               cache_size, 1);
+                               cache_budget, 1);
 #endif
 
    vkdf_scene_set_scene_callbacks(res->scene,
@@ -523,8 +523,7 @@ destroy_shader_modules(SceneResources *res)
 static void
 destroy_ubos(SceneResources *res)
 {
-   vkDestroyBuffer(res->ctx->device, res->ubos.camera_view.buf.buf, NULL);
-   vkFreeMemory(res->ctx->device, res->ubos.camera_view.buf.mem, NULL);
+   vkdf_destroy_buffer(res->ctx, &res->ubos.camera_view.buf);
 }
 
 void
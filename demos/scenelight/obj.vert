@@ -1,9 +1,8 @@
-#version 400
+#version 450
 
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-const int MAX_INSTANCES = 16 * 1024;
 const int MAX_MATERIALS_PER_MODEL = 32;
 const int NUM_LIGHTS = 2;
 
@@ -25,8 +24,10 @@ struct ObjData {
    uvec4 priv_data;
 };
 
-layout(std140, set = 1, binding = 0) uniform ubo_obj_data {
-   ObjData data[MAX_INSTANCES];
+// A storage buffer, since the culled object data of the scene can be larger
+// than what we can bind as a uniform buffer
+layout(std430, set = 1, binding = 0) readonly buffer ssbo_obj_data {
+   ObjData data[];
 } OID;
 
 struct ShadowMapData {
@@ -0,0 +1,1305 @@
+#include "../demo-scene.hpp"
+
+const uint32_t NUM_LIGHTS = 2;
+const bool LIGHT_IS_DYNAMIC[NUM_LIGHTS] = { true, false };
+
+// FIXME: we only show the shadow map for one light, would be nice
+// to allow the user to switch the shadow map to display at run-time
+const uint32_t debug_light_idx = 0;
+
+// ----------------------------------------------------------------------------
+// Renders a scene with lighting
+//
+// The scene contains different object models with varying material sets
+// ----------------------------------------------------------------------------
+
+struct PCBData {
+   uint8_t proj[sizeof(glm::mat4)];
+};
+
+typedef struct {
+   VkdfContext *ctx;
+   DemoSceneOptions opts;
+
+   VkdfScene *scene;
+
+   VkdfCamera *camera;
+   VkdfLight *lights[NUM_LIGHTS];
+
+   struct {
+      VkDescriptorPool static_ubo_pool;
+      VkDescriptorPool sampler_pool;
+   } descriptor_pool;
+
+   VkCommandPool cmd_pool;
+
+   struct {
+      struct {
+         VkDescriptorSetLayout camera_view_layout;
+         VkDescriptorSet camera_view_set;
+         VkDescriptorSetLayout obj_layout;
+         VkDescriptorSet obj_set;
+         VkDescriptorSet dyn_obj_set;
+         VkDescriptorSetLayout light_layout;
+         VkDescriptorSet light_set;
+         VkDescriptorSetLayout shadow_map_sampler_layout;
+         VkDescriptorSet shadow_map_sampler_set;
+      } descr;
+
+      struct {
+         VkPipelineLayout common;
+      } layout;
+
+      struct {
+         VkPipeline static_pipeline;
+         VkPipeline dynamic_pipeline;
+      } obj;
+
+      struct {
+         VkPipeline pipeline;
+      } floor;
+   } pipelines;
+
+   struct {
+      struct {
+         VkdfBuffer buf;
+         VkDeviceSize size;
+      } camera_view;
+   } ubos;
+
+   struct {
+      struct {
+         VkShaderModule vs;
+         VkShaderModule fs;
+      } obj;
+      struct {
+         VkShaderModule vs;
+         VkShaderModule fs;
+      } floor;
+   } shaders;
+
+   struct {
+      struct {
+         VkShaderModule vs;
+         VkShaderModule fs;
+      } shaders;
+      struct {
+         VkDescriptorSetLayout sampler_set_layout;
+         VkDescriptorSet sampler_set;
+         VkPipelineLayout layout;
+         VkPipeline pipeline;
+      } pipeline;
+      VkRenderPass renderpass;
+      VkFramebuffer framebuffer;
+   } debug;
+
+   VkdfMesh *cube_mesh;
+   VkdfModel *cube_model;
+
+   VkdfMesh *floor_mesh;
+   VkdfModel *floor_model;
+
+   VkdfModel *tree_model;
+
+   VkdfMesh *tile_mesh;
+} SceneLightResources;
+
+typedef struct {
+   glm::vec4 pos;
+} VertexData;
+
+static void
+postprocess_draw(VkdfContext *ctx, VkCommandBuffer cmd_buf, void *data);
+
+static inline VkdfBuffer
+create_ubo(VkdfContext *ctx, uint32_t size, uint32_t usage, uint32_t mem_props)
+{
+   usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+   VkdfBuffer buf = vkdf_create_buffer(ctx, 0, size, usage, mem_props);
+   return buf;
+}
+
+static void
+init_ubos(SceneLightResources *res)
+{
+   // Camera view
+   res->ubos.camera_view.size = 2 * sizeof(glm::mat4);
+   res->ubos.camera_view.buf = create_ubo(res->ctx,
+                                          res->ubos.camera_view.size,
+                                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
+
+static bool
+record_update_resources_command(VkdfContext *ctx,
+                                VkCommandBuffer cmd_buf,
+                                void *data)
+{
+   SceneLightResources *res = (SceneLightResources *) data;
+
+   VkdfCamera *camera = vkdf_scene_get_camera(res->scene);
+   if (!vkdf_camera_is_dirty(camera))
+      return false;
+
+   glm::mat4 view = vkdf_camera_get_view_matrix(res->camera);
+   vkCmdUpdateBuffer(cmd_buf,
+                     res->ubos.camera_view.buf.buf,
+                     0, sizeof(glm::mat4),
+                     &view[0][0]);
+
+   glm::mat4 view_inv = glm::inverse(view);
+   vkCmdUpdateBuffer(cmd_buf,
+                     res->ubos.camera_view.buf.buf,
+                     sizeof(glm::mat4), sizeof(glm::mat4),
+                     &view_inv[0][0]);
+
+   return true;
+}
+
+static void
+record_instanced_draw(VkCommandBuffer cmd_buf,
+                      VkPipeline pipeline,
+                      VkdfScene *scene,
+                      VkdfSceneSetInfo *set_info,
+                      uint32_t lod)
+{
+   vkCmdBindPipeline(cmd_buf,
+                     VK_PIPELINE_BIND_POINT_GRAPHICS,
+                     pipeline);
+
+   vkdf_scene_draw_batches(scene, cmd_buf, set_info, lod);
+}
+
+static void
+record_scene_commands(VkdfContext *ctx, VkCommandBuffer cmd_buf,
+                      GHashTable *sets, bool is_dynamic,
+                      bool is_deth_prepass, uint32_t lod, void *data)
+{
+   SceneLightResources *res = (SceneLightResources *) data;
+
+   // Push constants
+   struct PCBData pcb_data;
+   glm::mat4 *proj = vkdf_camera_get_projection_ptr(res->scene->camera);
+   memcpy(&pcb_data.proj, &(*proj)[0][0], sizeof(pcb_data.proj));
+
+   vkCmdPushConstants(cmd_buf,
+                      res->pipelines.layout.common,
+                      VK_SHADER_STAGE_VERTEX_BIT,
+                      0, sizeof(pcb_data), &pcb_data);
+
+   // Descriptors
+   VkDescriptorSet descriptor_sets[] = {
+      res->pipelines.descr.camera_view_set,
+      !is_dynamic ? res->pipelines.descr.obj_set :
+                    res->pipelines.descr.dyn_obj_set,
+      res->pipelines.descr.light_set,
+      res->pipelines.descr.shadow_map_sampler_set
+   };
+
+   vkCmdBindDescriptorSets(cmd_buf,
+                           VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           res->pipelines.layout.common,
+                           0,                        // First decriptor set
+                           4,                        // Descriptor set count
+                           descriptor_sets,          // Descriptor sets
+                           0,                        // Dynamic offset count
+                           NULL);                    // Dynamic offsets
+
+   char *set_id;
+   VkdfSceneSetInfo *set_info;
+   GHashTableIter iter;
+   g_hash_table_iter_init(&iter, sets);
+   while (g_hash_table_iter_next(&iter, (void **)&set_id, (void **)&set_info)) {
+      if (!set_info || set_info->count == 0)
+         continue;
+
+      if (!strcmp(set_id, "cube") || !strcmp(set_id, "dyn-cube")) {
+         VkPipeline *pipeline = is_dynamic ?
+                                   &res->pipelines.obj.dynamic_pipeline :
+                                   &res->pipelines.obj.static_pipeline;
+
+         record_instanced_draw(cmd_buf,
+                               *pipeline,
+                               res->scene, set_info, lod);
+         continue;
+      }
+
+      if (!strcmp(set_id, "tree")) {
+         record_instanced_draw(cmd_buf,
+                               res->pipelines.obj.static_pipeline,
+                               res->scene, set_info, lod);
+         continue;
+      }
+
+      if (!strcmp(set_id, "floor")) {
+         record_instanced_draw(cmd_buf,
+                               res->pipelines.floor.pipeline,
+                               res->scene, set_info, lod);
+         continue;
+      }
+   }
+}
+
+static void
+update_camera(SceneLightResources *res)
+{
+   const float mov_speed = 0.15f;
+   const float rot_speed = 1.0f;
+
+   VkdfCamera *cam = vkdf_scene_get_camera(res->scene);
+   VkdfPlatform *platform = &res->ctx->platform;
+   float base_speed = 1.0f;
+
+   // Rotation
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_LEFT))
+      vkdf_camera_rotate(cam, 0.0f, base_speed * rot_speed, 0.0f);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_RIGHT))
+      vkdf_camera_rotate(cam, 0.0f, -base_speed * rot_speed, 0.0f);
+
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_PAGE_UP))
+      vkdf_camera_rotate(cam, base_speed * rot_speed, 0.0f, 0.0f);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_PAGE_DOWN))
+      vkdf_camera_rotate(cam, -base_speed * rot_speed, 0.0f, 0.0f);
+
+   // Stepping
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_UP)) {
+      float step_speed = base_speed * mov_speed;
+      vkdf_camera_step(cam, step_speed, 1, 1, 1);
+   } else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_DOWN)) {
+      float step_speed = -base_speed * mov_speed;
+      vkdf_camera_step(cam, step_speed, 1, 1, 1);
+   }
+}
+
+static void
+update_objects(SceneLightResources *res)
+{
+   VkdfSceneSetInfo *info =
+      vkdf_scene_get_dynamic_object_set(res->scene, "dyn-cube");
+   if (!info || info->count == 0)
+      return;
+
+   GList *iter = info->objs;
+   while (iter) {
+      VkdfObject *obj = (VkdfObject *) iter->data;
+      glm::vec3 rot = obj->rot;
+      rot.x += 0.1f;
+      rot.y += 0.5f;
+      rot.z += 1.0f;
+      vkdf_object_set_rotation(obj, rot);
+      iter = g_list_next(iter);
+   }
+}
+
+static void
+update_lights(SceneLightResources *res)
+{
+   const float rot_speeds[NUM_LIGHTS] = { 1.5f, 2.0f };
+
+   for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+      if (LIGHT_IS_DYNAMIC[i]) {
+         VkdfLight *l = res->lights[i];
+         glm::vec3 rot = vkdf_light_get_rotation(l);
+         rot.y += rot_speeds[i];
+         if (rot.y > 360.0f)
+            rot.y -= 360.0f;
+         vkdf_light_set_rotation(l, rot);
+      }
+   }
+}
+
+static void
+scene_update(void *data)
+{
+   SceneLightResources *res = (SceneLightResources *) data;
+
+   if (res->opts.interactive)
+      update_camera(res);
+
+   if (res->opts.update_cb)
+      res->opts.update_cb(res->opts.cb_data);
+
+   update_objects(res);
+   update_lights(res);
+}
+
+static void
+init_scene(SceneLightResources *res)
+{
+   VkdfContext *ctx = res->ctx;
+
+   res->camera = vkdf_camera_new(0.0f, 10.0f, -30.0f,
+                                 0.0f, 180.0f, 0.0f,
+                                 45.0f, 0.1f, 500.0f,
+                                 res->opts.width / res->opts.height);
+
+   vkdf_camera_look_at(res->camera, 0.0f, 3.0f, 0.0f);
+
+   glm::vec3 scene_origin = glm::vec3(-50.0f, -50.0f, -50.0f);
+   glm::vec3 scene_size = glm::vec3(100.0f, 100.0f, 100.0f);
+   glm::vec3 tile_size = glm::vec3(25.0f, 25.0f, 25.0f);
+   VkDeviceSize cache_budget = 4 * 1024 * 1024;
+   res->scene = vkdf_scene_new(ctx,
+                               res->opts.width, res->opts.height,
+                               res->camera,
+                               scene_origin, scene_size, tile_size, 2,
+                               cache_budget, res->opts.num_threads);
+
+   vkdf_scene_set_scene_callbacks(res->scene,
+                                  scene_update,
+                                  record_update_resources_command,
+                                  record_scene_commands,
+                                  res);
+
+   // Trees far from the camera use simplified meshes
+   const float lod_distances[] = { 25.0f, 50.0f };
+   vkdf_scene_set_lod_distances(res->scene, 3, lod_distances);
+
+   // Pack all static geometry together, draw each set at once and
+   // frustum-cull its instances on the GPU
+   vkdf_scene_enable_gpu_culling(res->scene);
+
+   // Show the shadow map of the first light
+   if (res->opts.interactive)
+      vkdf_scene_enable_postprocessing(res->scene, postprocess_draw, NULL);
+}
+
+static void
+init_pipeline_descriptors(SceneLightResources *res)
+{
+   if (res->pipelines.layout.common)
+      return;
+
+   VkPushConstantRange pcb_range;
+   pcb_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+   pcb_range.offset = 0;
+   pcb_range.size = sizeof(PCBData);
+
+   VkPushConstantRange pcb_ranges[] = {
+      pcb_range,
+   };
+
+   res->pipelines.descr.camera_view_layout =
+      vkdf_create_ubo_descriptor_set_layout(res->ctx, 0, 1,
+                                            VK_SHADER_STAGE_VERTEX_BIT,
+                                            false);
+
+   // Object data goes in a storage buffer (see vkdf_scene_get_object_ubo()),
+   // materials in a uniform buffer
+   VkDescriptorSetLayoutBinding obj_bindings[2];
+   for (uint32_t i = 0; i < 2; i++) {
+      obj_bindings[i].binding = i;
+      obj_bindings[i].descriptorType = i == 0 ?
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      obj_bindings[i].descriptorCount = 1;
+      obj_bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT |
+                                   VK_SHADER_STAGE_FRAGMENT_BIT;
+      obj_bindings[i].pImmutableSamplers = NULL;
+   }
+
+   VkDescriptorSetLayoutCreateInfo obj_layout_info;
+   obj_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+   obj_layout_info.pNext = NULL;
+   obj_layout_info.bindingCount = 2;
+   obj_layout_info.pBindings = obj_bindings;
+   obj_layout_info.flags = 0;
+
+   VK_CHECK(vkCreateDescriptorSetLayout(res->ctx->device,
+                                        &obj_layout_info,
+                                        NULL,
+                                        &res->pipelines.descr.obj_layout));
+
+   res->pipelines.descr.light_layout =
+      vkdf_create_ubo_descriptor_set_layout(res->ctx, 0, 2,
+                                            VK_SHADER_STAGE_VERTEX_BIT |
+                                                VK_SHADER_STAGE_FRAGMENT_BIT,
+                                            false);
+
+   res->pipelines.descr.shadow_map_sampler_layout =
+      vkdf_create_sampler_descriptor_set_layout(res->ctx, 0, NUM_LIGHTS,
+                                                VK_SHADER_STAGE_FRAGMENT_BIT);
+
+   VkDescriptorSetLayout layouts[] = {
+      res->pipelines.descr.camera_view_layout,
+      res->pipelines.descr.obj_layout,
+      res->pipelines.descr.light_layout,
+      res->pipelines.descr.shadow_map_sampler_layout,
+   };
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = pcb_ranges;
+   pipeline_layout_info.setLayoutCount = 4;
+   pipeline_layout_info.pSetLayouts = layouts;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(res->ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &res->pipelines.layout.common));
+
+   // Camera descriptor
+   res->pipelines.descr.camera_view_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.camera_view_layout);
+
+   VkDeviceSize ubo_offset = 0;
+   VkDeviceSize ubo_size = res->ubos.camera_view.size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.camera_view_set,
+                                     res->ubos.camera_view.buf.buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Static objects descriptor
+   res->pipelines.descr.obj_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.obj_layout);
+
+   VkdfBuffer *obj_ubo = vkdf_scene_get_object_ubo(res->scene);
+   VkDeviceSize obj_ubo_size = vkdf_scene_get_object_ubo_size(res->scene);
+   ubo_offset = 0;
+   ubo_size = obj_ubo_size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.obj_set,
+                                     obj_ubo->buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, false);
+
+   VkdfBuffer *material_ubo = vkdf_scene_get_material_ubo(res->scene);
+   VkDeviceSize material_ubo_size = vkdf_scene_get_material_ubo_size(res->scene);
+   ubo_offset = 0;
+   ubo_size = material_ubo_size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.obj_set,
+                                     material_ubo->buf,
+                                     1, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Dynamic objects descriptor
+   res->pipelines.descr.dyn_obj_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.obj_layout);
+
+   obj_ubo = vkdf_scene_get_dynamic_object_ubo(res->scene);
+   obj_ubo_size = vkdf_scene_get_dynamic_object_ubo_size(res->scene);
+   ubo_offset = 0;
+   ubo_size = obj_ubo_size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.dyn_obj_set,
+                                     obj_ubo->buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, false);
+
+   material_ubo = vkdf_scene_get_dynamic_material_ubo(res->scene);
+   material_ubo_size = vkdf_scene_get_dynamic_material_ubo_size(res->scene);
+   ubo_offset = 0;
+   ubo_size = material_ubo_size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.dyn_obj_set,
+                                     material_ubo->buf,
+                                     1, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Lihgts descriptor
+   res->pipelines.descr.light_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.light_layout);
+
+   VkdfBuffer *light_ubo = vkdf_scene_get_light_ubo(res->scene);
+   vkdf_scene_get_light_ubo_range(res->scene, &ubo_offset, &ubo_size);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.light_set,
+                                     light_ubo->buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, true);
+
+
+   // Shadow map data descriptor
+   vkdf_scene_get_shadow_map_ubo_range(res->scene, &ubo_offset, &ubo_size);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.light_set,
+                                     light_ubo->buf,
+                                     1, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Shadow map sampler descriptors
+   res->pipelines.descr.shadow_map_sampler_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.sampler_pool,
+                                 res->pipelines.descr.shadow_map_sampler_layout);
+
+   for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+      VkSampler shadow_map_sampler =
+         vkdf_scene_light_get_shadow_map_sampler(res->scene, i);
+
+      VkdfImage *shadow_map_image =
+         vkdf_scene_light_get_shadow_map_image(res->scene, i);
+
+      vkdf_descriptor_set_sampler_update(res->ctx,
+                                         res->pipelines.descr.shadow_map_sampler_set,
+                                         shadow_map_sampler,
+                                         shadow_map_image->view,
+                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                         i, 1);
+   }
+}
+
+static void
+init_obj_pipeline(SceneLightResources *res, bool dynamic)
+{
+   VkVertexInputBindingDescription vi_bindings[1];
+   VkVertexInputAttributeDescription vi_attribs[3];
+
+   // Vertex attribute binding 0: position, normal, material
+   uint32_t stride =
+      vkdf_mesh_get_vertex_data_stride(res->cube_mesh);
+   vkdf_vertex_binding_set(&vi_bindings[0],
+                           0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
+
+   assert(vkdf_mesh_get_vertex_data_stride(res->tree_model->meshes[0]) ==
+          vi_bindings[0].stride);
+   assert(vkdf_mesh_get_vertex_data_stride(res->tree_model->meshes[1]) ==
+          vi_bindings[0].stride);
+
+   /* binding 0, location 0: position
+    * binding 0, location 1: normal
+    * binding 0, location 2: material
+    */
+   vkdf_vertex_attrib_set(&vi_attribs[0], 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+   vkdf_vertex_attrib_set(&vi_attribs[1], 0, 1, VK_FORMAT_R32G32B32_SFLOAT, 12);
+   vkdf_vertex_attrib_set(&vi_attribs[2], 0, 2, VK_FORMAT_R32_UINT, 24);
+
+   VkPipeline *pipeline = dynamic ?
+         &res->pipelines.obj.dynamic_pipeline :
+         &res->pipelines.obj.static_pipeline;
+
+   VkRenderPass renderpass = dynamic ?
+         vkdf_scene_get_dynamic_render_pass(res->scene) :
+         vkdf_scene_get_static_render_pass(res->scene);
+
+   *pipeline =
+      vkdf_create_gfx_pipeline(res->ctx,
+                               NULL,
+                               1,
+                               vi_bindings,
+                               3,
+                               vi_attribs,
+                               true,
+                               VK_COMPARE_OP_LESS,
+                               renderpass,
+                               res->pipelines.layout.common,
+                               VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                               VK_CULL_MODE_BACK_BIT,
+                               1,
+                               res->shaders.obj.vs,
+                               res->shaders.obj.fs);
+}
+
+static void
+init_floor_pipeline(SceneLightResources *res, bool init_cache)
+{
+   VkVertexInputBindingDescription vi_bindings[1];
+   VkVertexInputAttributeDescription vi_attribs[3];
+
+   // Vertex attribute binding 0: position, normal, material
+   uint32_t stride =
+      vkdf_mesh_get_vertex_data_stride(res->floor_mesh);
+   vkdf_vertex_binding_set(&vi_bindings[0],
+                           0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
+
+   /* binding 0, location 0: position
+    * binding 0, location 1: normal
+    * binding 0, location 2: material
+    */
+   vkdf_vertex_attrib_set(&vi_attribs[0], 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+   vkdf_vertex_attrib_set(&vi_attribs[1], 0, 1, VK_FORMAT_R32G32B32_SFLOAT, 12);
+   vkdf_vertex_attrib_set(&vi_attribs[2], 0, 2, VK_FORMAT_R32_UINT, 24);
+
+   res->pipelines.floor.pipeline =
+      vkdf_create_gfx_pipeline(res->ctx,
+                               NULL,
+                               1,
+                               vi_bindings,
+                               3,
+                               vi_attribs,
+                               true,
+                               VK_COMPARE_OP_LESS,
+                               vkdf_scene_get_static_render_pass(res->scene),
+                               res->pipelines.layout.common,
+                               VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                               VK_CULL_MODE_BACK_BIT,
+                               1,
+                               res->shaders.floor.vs,
+                               res->shaders.floor.fs);
+}
+
+static void
+init_cmd_bufs(SceneLightResources *res)
+{
+   if (!res->cmd_pool)
+      res->cmd_pool = vkdf_create_gfx_command_pool(res->ctx, 0);
+}
+
+static inline VkShaderModule
+create_shader_module(SceneLightResources *res, const char *file)
+{
+   return demo_scene_create_shader_module(res->ctx, &res->opts, file);
+}
+
+static void
+init_shaders(SceneLightResources *res)
+{
+   res->shaders.obj.vs = create_shader_module(res, "obj.vert.spv");
+   res->shaders.obj.fs = create_shader_module(res, "obj.frag.spv");
+
+   res->shaders.floor.vs = create_shader_module(res, "floor.vert.spv");
+   res->shaders.floor.fs = create_shader_module(res, "floor.frag.spv");
+
+   res->debug.shaders.vs = create_shader_module(res, "debug-tile.vert.spv");
+   res->debug.shaders.fs = create_shader_module(res, "debug-tile.frag.spv");
+}
+
+static inline void
+init_pipelines(SceneLightResources *res)
+{
+   init_pipeline_descriptors(res);
+   init_obj_pipeline(res, false);
+   init_obj_pipeline(res, true);
+   init_floor_pipeline(res, true);
+}
+
+static void
+init_meshes(SceneLightResources *res)
+{
+   // Cube
+   VkdfMaterial red;
+   red.diffuse = glm::vec4(0.80f, 0.15f, 0.15f, 1.0f);
+   red.ambient = glm::vec4(0.80f, 0.15f, 0.15f, 1.0f);
+   red.specular = glm::vec4(1.0f, 0.75f, 0.75f, 1.0f);
+   red.shininess = 8.0f;
+
+   VkdfMaterial green;
+   green.diffuse = glm::vec4(0.15f, 0.80f, 0.15f, 1.0f);
+   green.ambient = glm::vec4(0.15f, 0.80f, 0.15f, 1.0f);
+   green.specular = glm::vec4(0.75f, 1.0f, 0.75f, 1.0f);
+   green.shininess = 8.0f;
+
+   VkdfMaterial blue;
+   blue.diffuse = glm::vec4(0.15f, 0.15f, 0.80f, 1.0f);
+   blue.ambient = glm::vec4(0.15f, 0.15f, 0.80f, 1.0f);
+   blue.specular = glm::vec4(0.75f, 0.75f, 1.0f, 1.0f);
+   blue.shininess = 8.0f;
+
+   VkdfMaterial white;
+   white.diffuse = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+   white.ambient = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+   white.specular = glm::vec4(0.75f, 0.75f, 1.0f, 1.0f);
+   white.shininess = 8.0f;
+
+   VkdfMaterial yellow;
+   yellow.diffuse = glm::vec4(0.7f, 0.7f, 0.15f, 1.0f);
+   yellow.ambient = glm::vec4(0.7f, 0.7f, 0.15f, 1.0f);
+   yellow.specular = glm::vec4(0.75f, 0.75f, 1.0f, 1.0f);
+   yellow.shininess = 8.0f;
+
+   res->cube_mesh = vkdf_cube_mesh_new(res->ctx);
+   res->cube_mesh->material_idx = 0;
+   vkdf_mesh_fill_vertex_buffer(res->ctx, res->cube_mesh);
+
+   res->cube_model = vkdf_model_new();
+   vkdf_model_add_mesh(res->cube_model, res->cube_mesh);
+   vkdf_model_compute_box(res->cube_model);
+
+   vkdf_model_add_material(res->cube_model, &red);
+   vkdf_model_add_material(res->cube_model, &green);
+   vkdf_model_add_material(res->cube_model, &blue);
+   vkdf_model_add_material(res->cube_model, &white);
+
+   // Floor
+   VkdfMaterial grey1;
+   grey1.diffuse = glm::vec4(0.75f, 0.75f, 0.75f, 1.0f);
+   grey1.ambient = glm::vec4(0.75f, 0.75f, 0.75f, 1.0f);
+   grey1.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+   grey1.shininess = 4.0f;
+
+   VkdfMaterial grey2;
+   grey2.diffuse = glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);
+   grey2.ambient = glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);
+   grey2.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+   grey2.shininess = 4.0f;
+
+   res->floor_mesh = vkdf_cube_mesh_new(res->ctx);
+   res->floor_mesh->material_idx = 0;
+   vkdf_mesh_fill_vertex_buffer(res->ctx, res->floor_mesh);
+
+   res->floor_model = vkdf_model_new();
+   vkdf_model_add_mesh(res->floor_model, res->floor_mesh);
+   vkdf_model_compute_box(res->floor_model);
+
+   vkdf_model_add_material(res->floor_model, &grey1);
+   vkdf_model_add_material(res->floor_model, &grey2);
+
+   // Tree
+   char *path = demo_scene_get_path(&res->opts, "tree.obj");
+   res->tree_model = vkdf_model_load(path);
+   g_free(path);
+   vkdf_model_generate_lods(res->tree_model, 3);
+   vkdf_model_fill_vertex_buffers(res->ctx, res->tree_model, true);
+
+   /* Add another set of materials so we can have a tree variant */
+   vkdf_model_add_material(res->tree_model, &white);
+   vkdf_model_add_material(res->tree_model, &red);
+   vkdf_model_add_material(res->tree_model, &yellow);
+
+   // Debug tile
+   res->tile_mesh = vkdf_2d_tile_mesh_new(res->ctx);
+   vkdf_mesh_fill_vertex_buffer(res->ctx, res->tile_mesh);
+
+}
+
+static void
+init_objects(SceneLightResources *res)
+{
+   // Cubes
+   glm::vec3 pos = glm::vec3(0.0f, 3.0f, 0.0f);
+   VkdfObject *obj = vkdf_object_new_from_model(pos, res->cube_model);
+   vkdf_object_set_scale(obj, glm::vec3(2.0f, 3.0f, 2.0f));
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_material_idx_base(obj, 0);
+   vkdf_scene_add_object(res->scene, "cube", obj);
+
+   pos = glm::vec3(0.0f, 1.0f, -12.0f);
+   obj = vkdf_object_new_from_model(pos, res->cube_model);
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_scale(obj, glm::vec3(3.0f, 1.0f, 3.0f));
+   vkdf_object_set_material_idx_base(obj, 1);
+   vkdf_scene_add_object(res->scene, "cube", obj);
+
+   pos = glm::vec3(-12.0f, 2.0f, -5.0f);
+   obj = vkdf_object_new_from_model(pos, res->cube_model);
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_rotation(obj, glm::vec3(0.0f, 45.0f, 0.0f));
+   vkdf_object_set_scale(obj, glm::vec3(3.0f, 2.0f, 2.0f));
+   vkdf_object_set_material_idx_base(obj, 2);
+   vkdf_scene_add_object(res->scene, "cube", obj);
+
+   pos = glm::vec3(0.0f, 10.0f, 10.0f);
+   obj = vkdf_object_new_from_model(pos, res->cube_model);
+   vkdf_object_set_scale(obj, glm::vec3(20.0f, 10.0f, 1.0f));
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_material_idx_base(obj, 3);
+   vkdf_scene_add_object(res->scene, "cube", obj);
+
+   // Dynamic cube
+   pos = glm::vec3(0.0f, 8.0f, 6.0f);
+   obj = vkdf_object_new_from_model(pos, res->cube_model);
+   vkdf_object_set_rotation(obj, glm::vec3(45.0f, 45.0f, 45.0f));
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_material_idx_base(obj, 0);
+   vkdf_object_set_dynamic(obj, true);
+   vkdf_scene_add_object(res->scene, "dyn-cube", obj);
+
+   // Trees
+   pos = glm::vec3(5.0f, 3.0f, -5.0f);
+   obj = vkdf_object_new_from_model(pos, res->tree_model);
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_scale(obj, glm::vec3(2.0f, 2.0f, 2.0f));
+   vkdf_object_set_material_idx_base(obj, 0);
+   vkdf_scene_add_object(res->scene, "tree", obj);
+
+   pos = glm::vec3(-5.0f, 5.0f, 4.0f);
+   obj = vkdf_object_new_from_model(pos, res->tree_model);
+   vkdf_object_set_lighting_behavior(obj, true, true);
+   vkdf_object_set_scale(obj, glm::vec3(3.0f, 3.0f, 3.0f));
+   vkdf_object_set_material_idx_base(obj, 3);
+   vkdf_scene_add_object(res->scene, "tree", obj);
+
+   // Floor
+   // FIXME: this should be handled in untiled-mode, maybe we should do that
+   // automatically for any object that is too big or something...
+   pos = glm::vec3(0.0f, 0.0f - 0.1f / 2.0f, 0.0f);
+   VkdfObject *floor = vkdf_object_new_from_model(pos, res->floor_model);
+   vkdf_object_set_scale(floor, glm::vec3(res->scene->scene_area.w / 2.0f,
+                                          0.1f,
+                                          res->scene->scene_area.d / 2.0f));
+   vkdf_object_set_lighting_behavior(floor, false, true);
+   vkdf_scene_add_object(res->scene, "floor", floor);
+   vkdf_object_set_material_idx_base(floor, 0);
+}
+
+static void
+init_lights(SceneLightResources *res)
+{
+   // Light 0
+   uint32_t idx = 0;
+   glm::vec4 origin = glm::vec4(10.0f, 10.0f, -5.0f, 2.0f);
+   glm::vec4 diffuse = glm::vec4(0.25f, 1.0f, 0.25f, 0.0f);
+   glm::vec4 ambient = glm::vec4(0.01f, 0.04f, 0.01f, 1.0f);
+   glm::vec4 specular = glm::vec4(0.7f, 1.0f, 0.7f, 0.0f);
+   glm::vec4 attenuation = glm::vec4(0.1f, 0.05f, 0.005f, 0.0f);
+   glm::vec4 angle_attenuation = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+   float cutoff_angle = DEG_TO_RAD(45.0f);
+
+   res->lights[idx] =
+      vkdf_light_new_spotlight(origin, cutoff_angle,
+                               diffuse, ambient, specular,
+                               attenuation, angle_attenuation);
+
+   vkdf_light_look_at(res->lights[idx], glm::vec3(0.0f, 0.0f, 0.0f));
+
+   VkdfSceneShadowSpec shadow_spec;
+   vkdf_scene_shadow_spec_set(&shadow_spec,
+                              0, 1024, 0.1f, 100.0f, 4.0f, 1.5f,
+                              0.0f, glm::vec3(0.0f), 2);
+
+   vkdf_scene_add_light(res->scene, res->lights[idx], &shadow_spec);
+
+   // Light 1
+   idx++;
+   origin = glm::vec4(-15.0f, 5.0f, -30.0f, 2.0f);
+   diffuse = glm::vec4(1.0f, 0.25f, 0.25f, 0.0f);
+   ambient = glm::vec4(0.04f, 0.01f, 0.01f, 1.0f);
+   specular = glm::vec4(1.0f, 0.7f, 0.7f, 0.0f);
+   attenuation = glm::vec4(0.1f, 0.05f, 0.005f, 0.0f);
+   angle_attenuation = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+   cutoff_angle = DEG_TO_RAD(25.0f);
+
+   res->lights[idx] =
+      vkdf_light_new_spotlight(origin, cutoff_angle,
+                               diffuse, ambient, specular,
+                               attenuation, angle_attenuation);
+
+   vkdf_light_look_at(res->lights[idx], glm::vec3(0.0f, 0.0f, 10.0f));
+
+   vkdf_scene_shadow_spec_set(&shadow_spec,
+                              0, 1024, 0.1f, 100.0f, 4.0f, 1.5f,
+                              0.0f, glm::vec3(0.0f), 2);
+
+   vkdf_scene_add_light(res->scene, res->lights[idx], &shadow_spec);
+}
+
+static void
+init_descriptor_pools(SceneLightResources *res)
+{
+   // Object descriptor sets mix storage and uniform buffers
+   VkDescriptorPoolSize pool_sizes[2];
+   pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   pool_sizes[0].descriptorCount = 8;
+   pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   pool_sizes[1].descriptorCount = 2;
+
+   VkDescriptorPoolCreateInfo pool_ci;
+   pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+   pool_ci.pNext = NULL;
+   pool_ci.maxSets = 64;
+   pool_ci.poolSizeCount = 2;
+   pool_ci.pPoolSizes = pool_sizes;
+   pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+   VK_CHECK(vkCreateDescriptorPool(res->ctx->device, &pool_ci, NULL,
+                                   &res->descriptor_pool.static_ubo_pool));
+   res->descriptor_pool.sampler_pool =
+      vkdf_create_descriptor_pool(res->ctx,
+                                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8);
+}
+
+static void
+create_debug_tile_pipeline(SceneLightResources *res)
+{
+   // Sampler binding (for the first light's shadow map)
+   res->debug.pipeline.sampler_set_layout =
+      vkdf_create_sampler_descriptor_set_layout(res->ctx,
+                                                0, 1,
+                                                VK_SHADER_STAGE_FRAGMENT_BIT);
+
+   res->debug.pipeline.sampler_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.sampler_pool,
+                                 res->debug.pipeline.sampler_set_layout);
+
+   // FIXME: only showing the first light in the scene
+   VkSampler shadow_map_sampler =
+      vkdf_scene_light_get_shadow_map_sampler(res->scene, debug_light_idx);
+
+    VkdfImage *shadow_map_image =
+      vkdf_scene_light_get_shadow_map_image(res->scene, debug_light_idx);
+
+
+   vkdf_descriptor_set_sampler_update(res->ctx,
+                                      res->debug.pipeline.sampler_set,
+                                      shadow_map_sampler,
+                                      shadow_map_image->view,
+                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      0, 1);
+
+   VkDescriptorSetLayout layouts[1] = {
+      res->debug.pipeline.sampler_set_layout
+   };
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 0;
+   pipeline_layout_info.pPushConstantRanges = NULL;
+   pipeline_layout_info.setLayoutCount = 1;
+   pipeline_layout_info.pSetLayouts = layouts;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(res->ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &res->debug.pipeline.layout));
+
+   // Pipeline
+   VkVertexInputBindingDescription vi_binding[1];
+   VkVertexInputAttributeDescription vi_attribs[2];
+
+   // Vertex attribute binding 0: position, uv
+   uint32_t stride = vkdf_mesh_get_vertex_data_stride(res->tile_mesh);
+   vkdf_vertex_binding_set(&vi_binding[0],
+                           0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
+
+   /* binding 0, location 0: position
+    * binding 0, location 1: uv
+    */
+   vkdf_vertex_attrib_set(&vi_attribs[0], 0, 0, VK_FORMAT_R32G32_SFLOAT, 0);
+   vkdf_vertex_attrib_set(&vi_attribs[1], 0, 1, VK_FORMAT_R32G32_SFLOAT, 12);
+
+   res->debug.pipeline.pipeline =
+      vkdf_create_gfx_pipeline(res->ctx,
+                               NULL,
+                               1,
+                               vi_binding,
+                               2,
+                               vi_attribs,
+                               false,
+                               VK_COMPARE_OP_LESS,
+                               res->debug.renderpass,
+                               res->debug.pipeline.layout,
+                               VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+                               VK_CULL_MODE_BACK_BIT,
+                               1,
+                               res->debug.shaders.vs,
+                               res->debug.shaders.fs);
+}
+
+static void
+record_debug_tile_cmd_buf(SceneLightResources *res, VkCommandBuffer cmd_buf)
+{
+   const VkdfMesh *mesh = res->tile_mesh;
+
+   VkRenderPassBeginInfo rp_begin;
+   rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+   rp_begin.pNext = NULL;
+   rp_begin.renderPass = res->debug.renderpass;
+   rp_begin.framebuffer = res->debug.framebuffer;
+   rp_begin.renderArea.offset.x = 0;
+   rp_begin.renderArea.offset.y = 0;
+   rp_begin.renderArea.extent.width = res->ctx->width;
+   rp_begin.renderArea.extent.height = res->ctx->height;
+   rp_begin.clearValueCount = 0;
+   rp_begin.pClearValues = NULL;
+
+   vkCmdBeginRenderPass(cmd_buf,
+                        &rp_begin,
+                        VK_SUBPASS_CONTENTS_INLINE);
+
+   // Viewport and Scissor
+   uint32_t width = res->ctx->width / 3;
+   uint32_t height = res->ctx->height / 3;
+
+   VkViewport viewport;
+   viewport.width = width;
+   viewport.height = height;
+   viewport.minDepth = 0.0f;
+   viewport.maxDepth = 1.0f;
+   viewport.x = 0;
+   viewport.y = 0;
+   vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+
+   VkRect2D scissor;
+   scissor.extent.width = width;
+   scissor.extent.height = height;
+   scissor.offset.x = 0;
+   scissor.offset.y = 0;
+   vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+
+   // Pipeline
+   vkCmdBindPipeline(cmd_buf,
+                     VK_PIPELINE_BIND_POINT_GRAPHICS,
+                     res->debug.pipeline.pipeline);
+
+   // Vertex buffer: position, uv
+   const VkDeviceSize offsets[1] = { 0 };
+   vkCmdBindVertexBuffers(cmd_buf,
+                          0,                       // Start Binding
+                          1,                       // Binding Count
+                          &mesh->vertex_buf.buf,   // Buffers
+                          offsets);                // Offsets
+
+   // Descriptors
+   vkCmdBindDescriptorSets(cmd_buf,
+                           VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           res->debug.pipeline.layout,
+                           0,                                // First decriptor set
+                           1,                                // Descriptor set count
+                           &res->debug.pipeline.sampler_set, // Descriptor sets
+                           0,                                // Dynamic offset count
+                           NULL);                            // Dynamic offsets
+
+   // Draw
+   vkCmdDraw(cmd_buf,
+             mesh->vertices.size(),                // vertex count
+             1,                                    // instance count
+             0,                                    // first vertex
+             0);                                   // first instance
+
+   vkCmdEndRenderPass(cmd_buf);
+}
+
+static VkRenderPass
+create_debug_tile_renderpass(SceneLightResources *res, VkFormat format)
+{
+   VkAttachmentDescription attachments[1];
+
+   attachments[0].format = format;
+   attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+   attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+   attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+   attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+   attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+   attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+   attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+   attachments[0].flags = 0;
+
+   VkAttachmentReference color_ref;
+   color_ref.attachment = 0;
+   color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+   VkSubpassDescription subpass[1];
+   subpass[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+   subpass[0].flags = 0;
+   subpass[0].inputAttachmentCount = 0;
+   subpass[0].pInputAttachments = NULL;
+   subpass[0].colorAttachmentCount = 1;
+   subpass[0].pColorAttachments = &color_ref;
+   subpass[0].pResolveAttachments = NULL;
+   subpass[0].pDepthStencilAttachment = NULL;
+   subpass[0].preserveAttachmentCount = 0;
+   subpass[0].pPreserveAttachments = NULL;
+
+   VkRenderPassCreateInfo rp_info;
+   rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+   rp_info.pNext = NULL;
+   rp_info.attachmentCount = 1;
+   rp_info.pAttachments = attachments;
+   rp_info.subpassCount = 1;
+   rp_info.pSubpasses = subpass;
+   rp_info.dependencyCount = 0;
+   rp_info.pDependencies = NULL;
+   rp_info.flags = 0;
+
+   VkRenderPass renderpass;
+   VK_CHECK(vkCreateRenderPass(res->ctx->device, &rp_info, NULL, &renderpass));
+
+   return renderpass;
+}
+
+static void
+init_debug_tile_resources(SceneLightResources *res)
+{
+   VkdfImage *color_image = vkdf_scene_get_color_render_target(res->scene);
+
+   res->debug.renderpass =
+      create_debug_tile_renderpass(res, color_image->format);
+
+   res->debug.framebuffer =
+      vkdf_create_framebuffer(res->ctx,
+                              res->debug.renderpass,
+                              color_image->view,
+                              res->ctx->width, res->ctx->height,
+                              0, NULL);
+
+   create_debug_tile_pipeline(res);
+}
+
+static void
+init_resources(VkdfContext *ctx, const DemoSceneOptions *opts,
+               SceneLightResources *res)
+{
+   memset(res, 0, sizeof(SceneLightResources));
+
+   res->ctx = ctx;
+   res->opts = *opts;
+
+   init_scene(res);
+   init_descriptor_pools(res);
+   init_lights(res);
+   init_meshes(res);
+   init_objects(res);
+   init_ubos(res);
+   init_shaders(res);
+   init_cmd_bufs(res);
+
+   VkClearValue color_clear;
+   vkdf_color_clear_set(&color_clear, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+   VkClearValue depth_clear;
+   vkdf_depth_stencil_clear_set(&depth_clear, 1.0f, 0);
+
+   vkdf_scene_set_clear_values(res->scene, &color_clear, &depth_clear);
+
+   if (opts->configure_cb)
+      opts->configure_cb(res->scene, opts->cb_data);
+
+   vkdf_scene_prepare(res->scene);
+
+   init_pipelines(res);
+}
+
+static void
+postprocess_draw(VkdfContext *ctx, VkCommandBuffer cmd_buf, void *data)
+{
+   SceneLightResources *res = (SceneLightResources *) data;
+   init_debug_tile_resources(res);
+   record_debug_tile_cmd_buf(res, cmd_buf);
+}
+
+static void
+destroy_models(SceneLightResources *res)
+{
+   vkdf_model_free(res->ctx, res->cube_model);
+   vkdf_model_free(res->ctx, res->floor_model);
+   vkdf_model_free(res->ctx, res->tree_model);
+   vkdf_mesh_free(res->ctx, res->tile_mesh);
+}
+
+static void
+destroy_cmd_bufs(SceneLightResources *res)
+{
+   vkDestroyCommandPool(res->ctx->device, res->cmd_pool, NULL);
+}
+
+static void
+destroy_pipelines(SceneLightResources *res)
+{
+   vkDestroyPipeline(res->ctx->device, res->pipelines.obj.static_pipeline, NULL);
+   vkDestroyPipeline(res->ctx->device, res->pipelines.obj.dynamic_pipeline, NULL);
+   vkDestroyPipeline(res->ctx->device, res->pipelines.floor.pipeline, NULL);
+
+   vkDestroyPipelineLayout(res->ctx->device, res->pipelines.layout.common, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.camera_view_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->pipelines.descr.camera_view_layout, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.obj_set);
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.dyn_obj_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->pipelines.descr.obj_layout, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.light_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->pipelines.descr.light_layout, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.sampler_pool,
+                        1, &res->pipelines.descr.shadow_map_sampler_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->pipelines.descr.shadow_map_sampler_layout,
+                                NULL);
+
+   vkDestroyDescriptorPool(res->ctx->device,
+                           res->descriptor_pool.static_ubo_pool, NULL);
+   vkDestroyDescriptorPool(res->ctx->device,
+                           res->descriptor_pool.sampler_pool, NULL);
+
+}
+
+static void
+destroy_shader_modules(SceneLightResources *res)
+{
+   vkDestroyShaderModule(res->ctx->device, res->shaders.obj.vs, NULL);
+   vkDestroyShaderModule(res->ctx->device, res->shaders.obj.fs, NULL);
+   vkDestroyShaderModule(res->ctx->device, res->shaders.floor.vs, NULL);
+   vkDestroyShaderModule(res->ctx->device, res->shaders.floor.fs, NULL);
+}
+
+static void
+destroy_ubos(SceneLightResources *res)
+{
+   vkdf_destroy_buffer(res->ctx, &res->ubos.camera_view.buf);
+}
+
+static void
+destroy_debug_tile_resources(SceneLightResources *res)
+{
+   vkDestroyShaderModule(res->ctx->device, res->debug.shaders.vs, NULL);
+   vkDestroyShaderModule(res->ctx->device, res->debug.shaders.fs, NULL);
+
+   vkDestroyRenderPass(res->ctx->device, res->debug.renderpass, NULL);
+
+
+   vkDestroyPipelineLayout(res->ctx->device, res->debug.pipeline.layout, NULL);
+   vkDestroyPipeline(res->ctx->device, res->debug.pipeline.pipeline, NULL);
+
+   vkFreeDescriptorSets(res->ctx->device,
+                        res->descriptor_pool.sampler_pool,
+                        1, &res->debug.pipeline.sampler_set);
+   vkDestroyDescriptorSetLayout(res->ctx->device,
+                                res->debug.pipeline.sampler_set_layout, NULL);
+
+   vkDestroyFramebuffer(res->ctx->device, res->debug.framebuffer, NULL);
+}
+
+static void
+cleanup_resources(VkdfContext *ctx, SceneLightResources *res)
+{
+   vkdf_scene_free(res->scene);
+   if (res->opts.interactive)
+      destroy_debug_tile_resources(res);
+   destroy_models(res);
+   destroy_cmd_bufs(res);
+   destroy_shader_modules(res);
+   destroy_pipelines(res);
+   destroy_ubos(res);
+
+   vkdf_camera_free(ctx, res->camera);
+}
+
+static void *
+scenelight_scene_build(VkdfContext *ctx, const DemoSceneOptions *opts)
+{
+   SceneLightResources *res = g_new(SceneLightResources, 1);
+   init_resources(ctx, opts, res);
+   return res;
+}
+
+static VkdfScene *
+scenelight_scene_get_scene(void *data)
+{
+   return ((SceneLightResources *) data)->scene;
+}
+
+static void
+scenelight_scene_free(VkdfContext *ctx, void *data)
+{
+   SceneLightResources *res = (SceneLightResources *) data;
+   cleanup_resources(ctx, res);
+   g_free(res);
+}
+
+const DemoSceneBuilder scenelight_scene_builder = {
+   "scenelight",
+   scenelight_scene_build,
+   scenelight_scene_get_scene,
+   scenelight_scene_free,
+};
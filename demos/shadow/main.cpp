@@ -1,4 +1,4 @@
-#include "vkdf.hpp"
+#include "shadow-scene.hpp"
 
 // ----------------------------------------------------------------------------
 // Renders a scene with a spotlight and shadows
@@ -9,34 +9,6 @@ const uint32_t WIN_WIDTH  = 800;
 const uint32_t WIN_HEIGHT = 600;
 const bool FULLSCREEN     = false;
 
-// Scene depth range
-const float SCENE_NEAR =   0.1f;
-const float SCENE_FAR  = 100.0f;
-
-// Number of objects in the scene
-const int32_t NUM_CUBES = 3;
-
-// Number of floor tiles and their size
-const int32_t ROOM_WIDTH = 20;
-const int32_t ROOM_DEPTH = 20;
-const int32_t TILE_WIDTH = 2.0f;
-const int32_t TILE_DEPTH = 2.0f;
-const int32_t NUM_TILES  = ROOM_WIDTH * ROOM_DEPTH;
-
-// Depth range of the light. We want this to be as tightly packed as possible
-const float LIGHT_NEAR =  0.1f;
-const float LIGHT_FAR  = 50.0f;
-
-// Shadow map resolution. Lowering this may cause more self-shadowing
-// artifacts and require to increase depth bias factors
-const uint32_t SHADOW_MAP_WIDTH  = 2048;
-const uint32_t SHADOW_MAP_HEIGHT = 2048;
-
-// Shadow map depth bias factors. Too large values can cause shadows to
-// be dettached from the objects that cast them
-const float SHADOW_MAP_DEPTH_BIAS_CONST = 4.0f;
-const float SHADOW_MAP_DEPTH_BIAS_SLOPE = 1.8f;
-
 // For debugging only (shows the shadow map texture on the top-left corner)
 const bool SHOW_SHADOW_MAP_TILE = true;
 const uint32_t SHADOW_MAP_TILE_WIDTH  = 200;
@@ -82,13 +54,8 @@ typedef struct {
    glm::mat4 view;
    glm::mat4 projection;
 
-   // Objects (cubes and tiles)
-   VkdfModel *cube_model;
-   VkdfModel *tile_model;
-   VkdfMesh *cube_mesh;
-   VkdfMesh *tile_mesh;
-   VkdfObject *cubes[NUM_CUBES];
-   VkdfObject *tiles[NUM_TILES];
+   // Objects (cubes and tiles) and light source
+   ShadowSceneContent content;
 
    // Vertex buffer with material indices for each object
    VkdfBuffer cube_material_buf;
@@ -104,7 +71,6 @@ typedef struct {
    VkDescriptorSet cube_materials_descriptor_set;
 
    // Light source
-   VkdfLight *light;
    glm::mat4 light_projection;
    const glm::mat4 *light_view;
 
@@ -180,7 +146,7 @@ create_and_fill_material_buffers(VkdfContext *ctx, SceneResources *res)
 
    uint32_t tile_materials[NUM_TILES];
    for (uint32_t i = 0; i < NUM_TILES; i++)
-      tile_materials[i] = res->tiles[i]->material_idx_base;
+      tile_materials[i] = res->content.tiles[i]->material_idx_base;
 
    vkdf_buffer_map_and_fill(ctx,
                             res->tile_material_buf,
@@ -197,7 +163,7 @@ create_and_fill_material_buffers(VkdfContext *ctx, SceneResources *res)
 
    uint32_t cube_materials[NUM_CUBES];
    for (uint32_t i = 0; i < NUM_CUBES; i++)
-      cube_materials[i] = res->cubes[i]->material_idx_base;
+      cube_materials[i] = res->content.cubes[i]->material_idx_base;
 
    vkdf_buffer_map_and_fill(ctx,
                             res->cube_material_buf,
@@ -418,8 +384,8 @@ render_pass_commands(VkdfContext *ctx, SceneResources *res)
                         &rp_begin,
                         VK_SUBPASS_CONTENTS_INLINE);
 
-   const VkdfMesh *cube_mesh = res->cubes[0]->model->meshes[0];
-   const VkdfMesh *tile_mesh = res->tiles[0]->model->meshes[0];
+   const VkdfMesh *cube_mesh = res->content.cubes[0]->model->meshes[0];
+   const VkdfMesh *tile_mesh = res->content.tiles[0]->model->meshes[0];
 
    // ------------------- Subpass 0: scene rendering -------------------
 
@@ -572,7 +538,7 @@ shadow_render_pass_commands(VkdfContext *ctx, SceneResources *res)
                         VK_SUBPASS_CONTENTS_INLINE);
 
    /* No need to render tiles to the shadow map */
-   const VkdfMesh *mesh = res->cubes[0]->model->meshes[0];
+   const VkdfMesh *mesh = res->content.cubes[0]->model->meshes[0];
 
    // ------------------- Subpass 0: scene rendering ------------------- 
 
@@ -753,7 +719,7 @@ present_commands(VkdfContext *ctx, SceneResources *res, uint32_t index)
       vkdf_create_image_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
                                 VK_ACCESS_MEMORY_READ_BIT,
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                vkdf_get_present_layout(ctx),
                                 ctx->swap_chain_images[index].image,
                                 subresource_range);
 
@@ -964,113 +930,6 @@ create_depth_image(VkdfContext *ctx, uint32_t width, uint32_t height,
                             VK_IMAGE_VIEW_TYPE_2D);
 }
 
-static void
-init_meshes(VkdfContext *ctx, SceneResources *res)
-{
-   res->cube_mesh = vkdf_cube_mesh_new(ctx);
-   res->cube_mesh->material_idx = 0;
-   vkdf_mesh_fill_vertex_buffer(ctx, res->cube_mesh);
-
-   res->cube_model = vkdf_model_new();
-
-   VkdfMaterial red;
-   red.diffuse = glm::vec4(0.5f, 0.0f, 0.0f, 1.0f);
-   red.ambient = glm::vec4(0.5f, 0.0f, 0.0f, 1.0f);
-   red.specular = glm::vec4(1.0f, 0.75f, 0.75f, 1.0f);
-   red.shininess = 48.0f;
-
-   VkdfMaterial green;
-   green.diffuse = glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
-   green.ambient = glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
-   green.specular = glm::vec4(0.75f, 1.0f, 0.75f, 1.0f);
-   green.shininess = 48.0f;
-
-   VkdfMaterial blue;
-   blue.diffuse = glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
-   blue.ambient = glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
-   blue.specular = glm::vec4(0.75f, 0.75f, 1.0f, 1.0f);
-   blue.shininess = 48.0f;
-
-   vkdf_model_add_mesh(res->cube_model, res->cube_mesh);
-   vkdf_model_add_material(res->cube_model, &red);
-   vkdf_model_add_material(res->cube_model, &green);
-   vkdf_model_add_material(res->cube_model, &blue);
-
-   res->tile_mesh = vkdf_tile_mesh_new(ctx);
-   res->tile_mesh->material_idx = 0;
-   vkdf_mesh_fill_vertex_buffer(ctx, res->tile_mesh);
-
-   res->tile_model = vkdf_model_new();
-
-   VkdfMaterial white;
-   white.diffuse = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
-   white.ambient = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
-   white.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-   white.shininess = 24.0f;
-
-   VkdfMaterial black;
-   black.diffuse = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
-   black.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
-   black.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-   black.shininess = 24.0f;
-
-   vkdf_model_add_mesh(res->tile_model, res->tile_mesh);
-   vkdf_model_add_material(res->tile_model, &white);
-   vkdf_model_add_material(res->tile_model, &black);
-}
-
-static void
-init_objects(VkdfContext *ctx, SceneResources *res)
-{
-   // Create room tiles
-   for (uint32_t x = 0; x < ROOM_WIDTH; x++) {
-      uint32_t color_idx = x % 2;
-      for (uint32_t z = 0; z < ROOM_DEPTH; z++) {
-         uint32_t idx = x * ROOM_DEPTH + z;
-
-         float tx = (-ROOM_WIDTH * TILE_WIDTH + TILE_WIDTH) / 2.0f +
-                    TILE_WIDTH * x;
-         float tz = (-ROOM_DEPTH * TILE_DEPTH + TILE_DEPTH) / 2.0f +
-                    TILE_DEPTH * z;
-         glm::vec3 pos = glm::vec3(tx, 0.0f, tz);
-
-         res->tiles[idx] = vkdf_object_new_from_model(pos, res->tile_model);
-         vkdf_object_set_material_idx_base(res->tiles[idx],
-                                           (color_idx + z) % 2);
-         vkdf_object_set_scale(res->tiles[idx],
-                               glm::vec3(TILE_WIDTH / 2.0f,
-                                         1.0f,
-                                         TILE_DEPTH / 2.0f));
-      }
-   }
-
-   // Create scene cubes
-   uint32_t idx = 0;
-   res->cubes[idx] =
-      vkdf_object_new_from_model(glm::vec3(0.0f, 2.0f, 0.0f), res->cube_model);
-   vkdf_object_set_material_idx_base(res->cubes[idx],  idx % 3);
-   vkdf_object_set_scale(res->cubes[idx],
-                         glm::vec3(1.0f, 3.0f, 1.0f));
-
-   idx++;
-   res->cubes[idx] =
-      vkdf_object_new_from_model(glm::vec3(5.0f, 2.0f, -5.0f), res->cube_model);
-   vkdf_object_set_material_idx_base(res->cubes[idx], idx % 3);
-   vkdf_object_set_scale(res->cubes[idx],
-                         glm::vec3(1.0f, 6.0f, 1.0f));
-   res->cubes[idx]->rot = glm::vec3(-25.0f, 35.0f, 0.0f);
-
-   idx++;
-   res->cubes[idx] =
-      vkdf_object_new_from_model(glm::vec3(-9.0f, 2.0f, -9.0f), res->cube_model);
-   vkdf_object_set_material_idx_base(res->cubes[idx], idx % 3);
-   vkdf_object_set_scale(res->cubes[idx],
-                         glm::vec3(1.0f, 4.0f, 1.0f));
-   res->cubes[idx]->rot = glm::vec3(0.0f, 0.0f, 30.0f);
-
-   assert(++idx == NUM_CUBES);
-}
-
 static inline void
 default_pipeline_input_assembly_state(VkPipelineInputAssemblyStateCreateInfo *ia)
 {
@@ -1206,14 +1065,14 @@ create_pipeline(VkdfContext *ctx, SceneResources *res, bool init_cache)
 
    // Since we use the same pipeline for all meshes, make sure they are
    // compatible
-   assert(vkdf_mesh_get_vertex_data_stride(res->cube_mesh) ==
-          vkdf_mesh_get_vertex_data_stride(res->tile_mesh));
+   assert(vkdf_mesh_get_vertex_data_stride(res->content.cube_mesh) ==
+          vkdf_mesh_get_vertex_data_stride(res->content.tile_mesh));
 
    VkVertexInputBindingDescription vi_binding[2];
    VkVertexInputAttributeDescription vi_attribs[3];
 
    // Vertex attribute binding 0: position, normal
-   uint32_t stride = vkdf_mesh_get_vertex_data_stride(res->cube_mesh);;
+   uint32_t stride = vkdf_mesh_get_vertex_data_stride(res->content.cube_mesh);;
    vkdf_vertex_binding_set(&vi_binding[0],
                            0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
 
@@ -1294,7 +1153,7 @@ create_shadow_pipeline(VkdfContext *ctx, SceneResources *res, bool init_cache)
    VkVertexInputAttributeDescription vi_attribs[1];
 
    // Vertex attribute binding 0, location 0: position
-   uint32_t stride = vkdf_mesh_get_vertex_data_stride(res->cube_mesh);;
+   uint32_t stride = vkdf_mesh_get_vertex_data_stride(res->content.cube_mesh);;
    vkdf_vertex_binding_set(&vi_binding[0],
                            0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
 
@@ -1387,36 +1246,6 @@ create_ui_tile_pipeline(VkdfContext *ctx, SceneResources *res)
                                    res->ui_tile_fs_module);
 }
 
-static void
-init_light_sources(VkdfContext *ctx, SceneResources *res)
-{
-   glm::vec4 pos = glm::vec4(-15.0f, 2.0f, -15.0f, 2.0f);
-   glm::vec4 diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-   glm::vec4 ambient = glm::vec4(0.01f, 0.01f, 0.01f, 1.0f);
-   glm::vec4 specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-   glm::vec4 attenuation = glm::vec4(0.1f, 0.05f, 0.01f, 0.0f);
-   glm::vec4 angle_attenuation = glm::vec4(1.0f, 0.01f, 0.001f, 0.0f);
-
-   res->light =
-      vkdf_light_new_spotlight(pos, DEG_TO_RAD(22.5f),
-                               diffuse, ambient, specular,
-                               attenuation, angle_attenuation);
-
-   vkdf_light_look_at(res->light, glm::vec3(0.0f, 0.0f, 0.0f));
-}
-
-static VkdfCamera *
-init_camera(VkdfContext *ctx)
-{
-   float cam_z = -ROOM_DEPTH / 2.0 * TILE_DEPTH - 10.0f;
-   VkdfCamera *camera = vkdf_camera_new(0.0f, 10.0f, cam_z,   // Position
-                                        0.0f, 0.0f, 1.0f,     // View dir
-                                        45.0f, SCENE_NEAR, SCENE_FAR,
-                                        (float) WIN_WIDTH / WIN_HEIGHT);
-   vkdf_camera_look_at(camera, 0.0f, 0.0f, 0.0f);
-   return camera;
-}
-
 static inline VkFramebuffer
 create_framebuffer(VkdfContext *ctx, SceneResources *res)
 {
@@ -1630,7 +1459,7 @@ fill_model_matrices_ubos(VkdfContext *ctx, SceneResources *res)
    // Fill cubes
    glm::mat4 ModelCubes[NUM_CUBES];
    for (uint32_t i = 0; i < NUM_CUBES; i++)
-      ModelCubes[i] = vkdf_object_get_model_matrix(res->cubes[i]);
+      ModelCubes[i] = vkdf_object_get_model_matrix(res->content.cubes[i]);
 
    vkdf_buffer_map_and_fill(ctx,
                             res->M_cubes_ubo,
@@ -1641,7 +1470,7 @@ fill_model_matrices_ubos(VkdfContext *ctx, SceneResources *res)
    // Fill tiles
    glm::mat4 ModelTiles[NUM_TILES];
    for (uint32_t i = 0; i < NUM_TILES; i++)
-      ModelTiles[i] = vkdf_object_get_model_matrix(res->tiles[i]);
+      ModelTiles[i] = vkdf_object_get_model_matrix(res->content.tiles[i]);
 
    vkdf_buffer_map_and_fill(ctx,
                             res->M_tiles_ubo,
@@ -1656,14 +1485,14 @@ fill_material_ubos(VkdfContext *ctx, SceneResources *res)
    vkdf_buffer_map_and_fill(ctx,
                             res->tile_materials_ubo,
                             0,
-                            res->tile_model->materials.size() * sizeof(VkdfMaterial),
-                            &res->tile_model->materials[0]);
+                            res->content.tile_model->materials.size() * sizeof(VkdfMaterial),
+                            &res->content.tile_model->materials[0]);
 
    vkdf_buffer_map_and_fill(ctx,
                             res->cube_materials_ubo,
                             0,
-                            res->cube_model->materials.size() * sizeof(VkdfMaterial),
-                            &res->cube_model->materials[0]);
+                            res->content.cube_model->materials.size() * sizeof(VkdfMaterial),
+                            &res->content.cube_model->materials[0]);
 }
 
 static void
@@ -1672,23 +1501,17 @@ init_resources(VkdfContext *ctx, SceneResources *res)
    memset(res, 0, sizeof(SceneResources));
 
    // Create camera
-   res->camera = init_camera(ctx);
+   res->camera = shadow_scene_camera_new((float) WIN_WIDTH / WIN_HEIGHT);
 
    // Compute View, Projection and Clip matrices
    init_matrices(res);
 
-   // Load meshes
-   init_meshes(ctx, res);
-
-   // Create the object and its mesh
-   init_objects(ctx, res);
+   // Load meshes, create the objects and setup lights
+   shadow_scene_content_init(ctx, &res->content);
 
    // Fill vertex buffers with material index data for scene cubes and tiles
    create_and_fill_material_buffers(ctx, res);
 
-   // Setup lights
-   init_light_sources(ctx, res);
-
    // Setup UI tile vertex buffer
    init_ui_tile_mesh(ctx, res);
 
@@ -1727,7 +1550,7 @@ init_resources(VkdfContext *ctx, SceneResources *res)
                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
    vkdf_buffer_map_and_fill(ctx, res->Light_ubo,
-                            0, sizeof(VkdfLight), res->light);
+                            0, sizeof(VkdfLight), res->content.light);
 
    // Create UBO for light View/Projection matrix (we may update this every
    // frame so we fill the buffer at scene update time)
@@ -1854,22 +1677,6 @@ update_camera(VkdfContext *ctx, VkdfCamera *cam)
    vkdf_camera_step(cam, step_speed, 1, 1, 1);
 }
 
-static void
-update_lights(SceneResources *res)
-{
-   static float rotY = 0.0f;
-
-   glm::mat4 model(1.0f);
-   model = glm::rotate(model, DEG_TO_RAD(rotY), glm::vec3(0, 1, 0));
-   vkdf_light_set_position(res->light,
-                           model * glm::vec4(-15.0f, 2.0f, -15.0f, 2.0f));
-   vkdf_light_look_at(res->light, glm::vec3(0.0f, 0.0f, 0.0f));
-
-   rotY += 0.25f;
-   if (rotY >= 360.0f)
-      rotY -= 360.0f;
-}
-
 static void
 scene_update(VkdfContext *ctx, void *data)
 {
@@ -1879,14 +1686,14 @@ scene_update(VkdfContext *ctx, void *data)
 
    // Animate lights
    if (!initialized || enable_dynamic_lights) {
-      update_lights(res);
+      shadow_scene_content_update_light(&res->content);
 
       // Light description
       vkdf_buffer_map_and_fill(ctx, res->Light_ubo,
-                               0, sizeof(VkdfLight), res->light);
+                               0, sizeof(VkdfLight), res->content.light);
 
       // Light View/Projection
-      res->light_view = vkdf_light_get_view_matrix(res->light);
+      res->light_view = vkdf_light_get_view_matrix(res->content.light);
       glm::mat4 vp = res->light_projection * (*res->light_view);
 
       vkdf_buffer_map_and_fill(ctx, res->Light_VP_ubo,
@@ -2039,29 +1846,21 @@ destroy_descriptor_resources(VkdfContext *ctx, SceneResources *res)
 static void
 destroy_ubo_resources(VkdfContext *ctx, SceneResources *res)
 {
-   vkDestroyBuffer(ctx->device, res->VP_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->VP_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->VP_ubo);
 
-   vkDestroyBuffer(ctx->device, res->M_cubes_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->M_cubes_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->M_cubes_ubo);
 
-   vkDestroyBuffer(ctx->device, res->M_tiles_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->M_tiles_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->M_tiles_ubo);
 
-   vkDestroyBuffer(ctx->device, res->tile_materials_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->tile_materials_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->tile_materials_ubo);
 
-   vkDestroyBuffer(ctx->device, res->cube_materials_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->cube_materials_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->cube_materials_ubo);
 
-   vkDestroyBuffer(ctx->device, res->Light_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->Light_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->Light_ubo);
 
-   vkDestroyBuffer(ctx->device, res->Light_VP_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->Light_VP_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->Light_VP_ubo);
 
-   vkDestroyBuffer(ctx->device, res->ui_tile_mvp_ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->ui_tile_mvp_ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->ui_tile_mvp_ubo);
 }
 
 static void
@@ -2077,11 +1876,11 @@ cleanup_resources(VkdfContext *ctx, SceneResources *res)
 {
    vkdf_camera_free(ctx, res->camera);
    for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++)
-      vkdf_object_free(res->tiles[i]);
+      vkdf_object_free(res->content.tiles[i]);
    for (uint32_t i = 0; i < NUM_CUBES; i++)
-      vkdf_object_free(res->cubes[i]);
-   vkdf_mesh_free(ctx, res->cube_mesh);
-   vkdf_mesh_free(ctx, res->tile_mesh);
+      vkdf_object_free(res->content.cubes[i]);
+   vkdf_mesh_free(ctx, res->content.cube_mesh);
+   vkdf_mesh_free(ctx, res->content.tile_mesh);
    vkdf_mesh_free(ctx, res->ui_tile_mesh);
    vkdf_destroy_buffer(ctx, &res->cube_material_buf);
    vkdf_destroy_buffer(ctx, &res->tile_material_buf);
@@ -2102,7 +1901,7 @@ cleanup_resources(VkdfContext *ctx, SceneResources *res)
    vkDestroyCommandPool(ctx->device, res->cmd_pool, NULL);
    destroy_scene_sync_objects(ctx, res);
    vkDestroySemaphore(ctx->device, res->shadow_draw_sem, NULL);
-   g_free(res->light);
+   g_free(res->content.light);
 }
 
 static void
@@ -0,0 +1,744 @@
+#include "shadow-scene.hpp"
+
+// ----------------------------------------------------------------------------
+// Scene content
+// ----------------------------------------------------------------------------
+
+static void
+init_models(VkdfContext *ctx, ShadowSceneContent *c)
+{
+   c->cube_mesh = vkdf_cube_mesh_new(ctx);
+   c->cube_mesh->material_idx = 0;
+   vkdf_mesh_fill_vertex_buffer(ctx, c->cube_mesh);
+
+   c->cube_model = vkdf_model_new();
+
+   VkdfMaterial red;
+   red.diffuse = glm::vec4(0.5f, 0.0f, 0.0f, 1.0f);
+   red.ambient = glm::vec4(0.5f, 0.0f, 0.0f, 1.0f);
+   red.specular = glm::vec4(1.0f, 0.75f, 0.75f, 1.0f);
+   red.shininess = 48.0f;
+
+   VkdfMaterial green;
+   green.diffuse = glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
+   green.ambient = glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
+   green.specular = glm::vec4(0.75f, 1.0f, 0.75f, 1.0f);
+   green.shininess = 48.0f;
+
+   VkdfMaterial blue;
+   blue.diffuse = glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
+   blue.ambient = glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
+   blue.specular = glm::vec4(0.75f, 0.75f, 1.0f, 1.0f);
+   blue.shininess = 48.0f;
+
+   vkdf_model_add_mesh(c->cube_model, c->cube_mesh);
+   vkdf_model_compute_box(c->cube_model);
+   vkdf_model_add_material(c->cube_model, &red);
+   vkdf_model_add_material(c->cube_model, &green);
+   vkdf_model_add_material(c->cube_model, &blue);
+
+   c->tile_mesh = vkdf_tile_mesh_new(ctx);
+   c->tile_mesh->material_idx = 0;
+   vkdf_mesh_fill_vertex_buffer(ctx, c->tile_mesh);
+
+   c->tile_model = vkdf_model_new();
+
+   VkdfMaterial white;
+   white.diffuse = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+   white.ambient = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+   white.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+   white.shininess = 24.0f;
+
+   VkdfMaterial black;
+   black.diffuse = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+   black.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+   black.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+   black.shininess = 24.0f;
+
+   vkdf_model_add_mesh(c->tile_model, c->tile_mesh);
+   vkdf_model_compute_box(c->tile_model);
+   vkdf_model_add_material(c->tile_model, &white);
+   vkdf_model_add_material(c->tile_model, &black);
+}
+
+static void
+init_content_objects(ShadowSceneContent *c)
+{
+   // Create room tiles
+   for (uint32_t x = 0; x < ROOM_WIDTH; x++) {
+      uint32_t color_idx = x % 2;
+      for (uint32_t z = 0; z < ROOM_DEPTH; z++) {
+         uint32_t idx = x * ROOM_DEPTH + z;
+
+         float tx = (-ROOM_WIDTH * TILE_WIDTH + TILE_WIDTH) / 2.0f +
+                    TILE_WIDTH * x;
+         float tz = (-ROOM_DEPTH * TILE_DEPTH + TILE_DEPTH) / 2.0f +
+                    TILE_DEPTH * z;
+         glm::vec3 pos = glm::vec3(tx, 0.0f, tz);
+
+         c->tiles[idx] = vkdf_object_new_from_model(pos, c->tile_model);
+         vkdf_object_set_material_idx_base(c->tiles[idx],
+                                           (color_idx + z) % 2);
+         vkdf_object_set_scale(c->tiles[idx],
+                               glm::vec3(TILE_WIDTH / 2.0f,
+                                         1.0f,
+                                         TILE_DEPTH / 2.0f));
+      }
+   }
+
+   // Create scene cubes
+   uint32_t idx = 0;
+   c->cubes[idx] =
+      vkdf_object_new_from_model(glm::vec3(0.0f, 2.0f, 0.0f), c->cube_model);
+   vkdf_object_set_material_idx_base(c->cubes[idx],  idx % 3);
+   vkdf_object_set_scale(c->cubes[idx],
+                         glm::vec3(1.0f, 3.0f, 1.0f));
+
+   idx++;
+   c->cubes[idx] =
+      vkdf_object_new_from_model(glm::vec3(5.0f, 2.0f, -5.0f), c->cube_model);
+   vkdf_object_set_material_idx_base(c->cubes[idx], idx % 3);
+   vkdf_object_set_scale(c->cubes[idx],
+                         glm::vec3(1.0f, 6.0f, 1.0f));
+   c->cubes[idx]->rot = glm::vec3(-25.0f, 35.0f, 0.0f);
+
+   idx++;
+   c->cubes[idx] =
+      vkdf_object_new_from_model(glm::vec3(-9.0f, 2.0f, -9.0f), c->cube_model);
+   vkdf_object_set_material_idx_base(c->cubes[idx], idx % 3);
+   vkdf_object_set_scale(c->cubes[idx],
+                         glm::vec3(1.0f, 4.0f, 1.0f));
+   c->cubes[idx]->rot = glm::vec3(0.0f, 0.0f, 30.0f);
+
+   assert(++idx == NUM_CUBES);
+}
+
+static void
+init_light(ShadowSceneContent *c)
+{
+   glm::vec4 pos = glm::vec4(-15.0f, 2.0f, -15.0f, 2.0f);
+   glm::vec4 diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+   glm::vec4 ambient = glm::vec4(0.01f, 0.01f, 0.01f, 1.0f);
+   glm::vec4 specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+   glm::vec4 attenuation = glm::vec4(0.1f, 0.05f, 0.01f, 0.0f);
+   glm::vec4 angle_attenuation = glm::vec4(1.0f, 0.01f, 0.001f, 0.0f);
+
+   c->light =
+      vkdf_light_new_spotlight(pos, DEG_TO_RAD(22.5f),
+                               diffuse, ambient, specular,
+                               attenuation, angle_attenuation);
+
+   vkdf_light_look_at(c->light, glm::vec3(0.0f, 0.0f, 0.0f));
+   c->light_rot = 0.0f;
+}
+
+void
+shadow_scene_content_init(VkdfContext *ctx, ShadowSceneContent *content)
+{
+   memset(content, 0, sizeof(ShadowSceneContent));
+   init_models(ctx, content);
+   init_content_objects(content);
+   init_light(content);
+}
+
+void
+shadow_scene_content_update_light(ShadowSceneContent *content)
+{
+   glm::mat4 model(1.0f);
+   model = glm::rotate(model, DEG_TO_RAD(content->light_rot),
+                       glm::vec3(0, 1, 0));
+   vkdf_light_set_position(content->light,
+                           model * glm::vec4(-15.0f, 2.0f, -15.0f, 2.0f));
+   vkdf_light_look_at(content->light, glm::vec3(0.0f, 0.0f, 0.0f));
+
+   content->light_rot += 0.25f;
+   if (content->light_rot >= 360.0f)
+      content->light_rot -= 360.0f;
+}
+
+VkdfCamera *
+shadow_scene_camera_new(float aspect_ratio)
+{
+   float cam_z = -ROOM_DEPTH / 2.0 * TILE_DEPTH - 10.0f;
+   VkdfCamera *camera = vkdf_camera_new(0.0f, 10.0f, cam_z,   // Position
+                                        0.0f, 0.0f, 1.0f,     // View dir
+                                        45.0f, SCENE_NEAR, SCENE_FAR,
+                                        aspect_ratio);
+   vkdf_camera_look_at(camera, 0.0f, 0.0f, 0.0f);
+   return camera;
+}
+
+// ----------------------------------------------------------------------------
+// Scene builder
+//
+// Renders the same content through a VkdfScene, which takes care of the
+// shadow map of the light.
+// ----------------------------------------------------------------------------
+
+struct PCBData {
+   uint8_t proj[sizeof(glm::mat4)];
+};
+
+typedef struct {
+   VkdfContext *ctx;
+   DemoSceneOptions opts;
+
+   VkdfScene *scene;
+
+   VkdfCamera *camera;
+
+   ShadowSceneContent content;
+
+   struct {
+      VkDescriptorPool static_ubo_pool;
+      VkDescriptorPool sampler_pool;
+   } descriptor_pool;
+
+   struct {
+      struct {
+         VkDescriptorSetLayout camera_view_layout;
+         VkDescriptorSet camera_view_set;
+         VkDescriptorSetLayout obj_layout;
+         VkDescriptorSet obj_set;
+         VkDescriptorSetLayout light_layout;
+         VkDescriptorSet light_set;
+         VkDescriptorSetLayout shadow_map_sampler_layout;
+         VkDescriptorSet shadow_map_sampler_set;
+      } descr;
+
+      VkPipelineLayout layout;
+      VkPipeline obj;
+   } pipelines;
+
+   struct {
+      struct {
+         VkdfBuffer buf;
+         VkDeviceSize size;
+      } camera_view;
+   } ubos;
+
+   struct {
+      VkShaderModule vs;
+      VkShaderModule fs;
+   } shaders;
+} ShadowSceneResources;
+
+static inline VkdfBuffer
+create_ubo(VkdfContext *ctx, uint32_t size, uint32_t usage, uint32_t mem_props)
+{
+   usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+   VkdfBuffer buf = vkdf_create_buffer(ctx, 0, size, usage, mem_props);
+   return buf;
+}
+
+static void
+init_ubos(ShadowSceneResources *res)
+{
+   // Camera view (and inverse view)
+   res->ubos.camera_view.size = 2 * sizeof(glm::mat4);
+   res->ubos.camera_view.buf = create_ubo(res->ctx,
+                                          res->ubos.camera_view.size,
+                                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
+
+static bool
+record_update_resources_command(VkdfContext *ctx,
+                                VkCommandBuffer cmd_buf,
+                                void *data)
+{
+   ShadowSceneResources *res = (ShadowSceneResources *) data;
+
+   VkdfCamera *camera = vkdf_scene_get_camera(res->scene);
+   if (!vkdf_camera_is_dirty(camera))
+      return false;
+
+   glm::mat4 view = vkdf_camera_get_view_matrix(camera);
+   vkCmdUpdateBuffer(cmd_buf,
+                     res->ubos.camera_view.buf.buf,
+                     0, sizeof(glm::mat4),
+                     &view[0][0]);
+
+   glm::mat4 view_inv = glm::inverse(view);
+   vkCmdUpdateBuffer(cmd_buf,
+                     res->ubos.camera_view.buf.buf,
+                     sizeof(glm::mat4), sizeof(glm::mat4),
+                     &view_inv[0][0]);
+
+   return true;
+}
+
+static void
+record_scene_commands(VkdfContext *ctx, VkCommandBuffer cmd_buf,
+                      GHashTable *sets, bool is_dynamic,
+                      bool is_depth_prepass, uint32_t lod, void *data)
+{
+   ShadowSceneResources *res = (ShadowSceneResources *) data;
+
+   // There are no dynamic objects in the scene
+   if (is_dynamic)
+      return;
+
+   vkCmdBindPipeline(cmd_buf,
+                     VK_PIPELINE_BIND_POINT_GRAPHICS,
+                     res->pipelines.obj);
+
+   // Push constants
+   struct PCBData pcb_data;
+   glm::mat4 *proj = vkdf_camera_get_projection_ptr(res->scene->camera);
+   memcpy(&pcb_data.proj, &(*proj)[0][0], sizeof(pcb_data.proj));
+
+   vkCmdPushConstants(cmd_buf,
+                      res->pipelines.layout,
+                      VK_SHADER_STAGE_VERTEX_BIT,
+                      0, sizeof(pcb_data), &pcb_data);
+
+   // Descriptors
+   VkDescriptorSet descriptor_sets[] = {
+      res->pipelines.descr.camera_view_set,
+      res->pipelines.descr.obj_set,
+      res->pipelines.descr.light_set,
+      res->pipelines.descr.shadow_map_sampler_set
+   };
+
+   vkCmdBindDescriptorSets(cmd_buf,
+                           VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           res->pipelines.layout,
+                           0,                        // First decriptor set
+                           4,                        // Descriptor set count
+                           descriptor_sets,          // Descriptor sets
+                           0,                        // Dynamic offset count
+                           NULL);                    // Dynamic offsets
+
+   // Cubes and tiles have the same vertex format, so they share the pipeline
+   const char *set_ids[] = { "cube", "tile" };
+   for (uint32_t i = 0; i < 2; i++) {
+      VkdfSceneSetInfo *set_info =
+         (VkdfSceneSetInfo *) g_hash_table_lookup(sets, set_ids[i]);
+      if (!set_info || set_info->count == 0)
+         continue;
+
+      vkdf_scene_draw_batches(res->scene, cmd_buf, set_info, lod);
+   }
+}
+
+static void
+update_camera(ShadowSceneResources *res)
+{
+   const float mov_speed = 0.15f;
+   const float rot_speed = 1.0f;
+
+   VkdfCamera *cam = vkdf_scene_get_camera(res->scene);
+   VkdfPlatform *platform = &res->ctx->platform;
+
+   // Rotation
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_LEFT))
+      vkdf_camera_rotate(cam, 0.0f, rot_speed, 0.0f);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_RIGHT))
+      vkdf_camera_rotate(cam, 0.0f, -rot_speed, 0.0f);
+
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_PAGE_UP))
+      vkdf_camera_rotate(cam, rot_speed, 0.0f, 0.0f);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_PAGE_DOWN))
+      vkdf_camera_rotate(cam, -rot_speed, 0.0f, 0.0f);
+
+   // Stepping
+   if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_UP))
+      vkdf_camera_step(cam, mov_speed, 1, 1, 1);
+   else if (vkdf_platform_key_is_pressed(platform, VKDF_KEY_DOWN))
+      vkdf_camera_step(cam, -mov_speed, 1, 1, 1);
+}
+
+static void
+scene_update(void *data)
+{
+   ShadowSceneResources *res = (ShadowSceneResources *) data;
+
+   if (res->opts.interactive)
+      update_camera(res);
+
+   if (res->opts.update_cb)
+      res->opts.update_cb(res->opts.cb_data);
+
+   shadow_scene_content_update_light(&res->content);
+}
+
+static void
+init_scene(ShadowSceneResources *res)
+{
+   VkdfContext *ctx = res->ctx;
+
+   res->camera = shadow_scene_camera_new(res->opts.width / res->opts.height);
+
+   glm::vec3 scene_origin = glm::vec3(-25.0f, -5.0f, -25.0f);
+   glm::vec3 scene_size = glm::vec3(50.0f, 20.0f, 50.0f);
+   glm::vec3 tile_size = glm::vec3(10.0f, 10.0f, 10.0f);
+   VkDeviceSize cache_budget = 4 * 1024 * 1024;
+   res->scene = vkdf_scene_new(ctx,
+                               res->opts.width, res->opts.height,
+                               res->camera,
+                               scene_origin, scene_size, tile_size, 2,
+                               cache_budget, res->opts.num_threads);
+
+   vkdf_scene_set_scene_callbacks(res->scene,
+                                  scene_update,
+                                  record_update_resources_command,
+                                  record_scene_commands,
+                                  res);
+}
+
+static void
+init_objects(ShadowSceneResources *res)
+{
+   ShadowSceneContent *c = &res->content;
+
+   // The scene takes ownership of the objects and the light
+   for (uint32_t i = 0; i < NUM_TILES; i++) {
+      vkdf_object_set_lighting_behavior(c->tiles[i], false, true);
+      vkdf_scene_add_object(res->scene, "tile", c->tiles[i]);
+   }
+
+   for (uint32_t i = 0; i < NUM_CUBES; i++) {
+      vkdf_object_set_lighting_behavior(c->cubes[i], true, true);
+      vkdf_scene_add_object(res->scene, "cube", c->cubes[i]);
+   }
+
+   VkdfSceneShadowSpec shadow_spec;
+   vkdf_scene_shadow_spec_set(&shadow_spec,
+                              0, SHADOW_MAP_WIDTH, LIGHT_NEAR, LIGHT_FAR,
+                              SHADOW_MAP_DEPTH_BIAS_CONST,
+                              SHADOW_MAP_DEPTH_BIAS_SLOPE,
+                              0.0f, glm::vec3(0.0f), 2);
+
+   vkdf_scene_add_light(res->scene, c->light, &shadow_spec);
+}
+
+static void
+init_descriptor_pools(ShadowSceneResources *res)
+{
+   // Object descriptor sets mix storage and uniform buffers
+   VkDescriptorPoolSize pool_sizes[2];
+   pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   pool_sizes[0].descriptorCount = 8;
+   pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   pool_sizes[1].descriptorCount = 2;
+
+   VkDescriptorPoolCreateInfo pool_ci;
+   pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+   pool_ci.pNext = NULL;
+   pool_ci.maxSets = 8;
+   pool_ci.poolSizeCount = 2;
+   pool_ci.pPoolSizes = pool_sizes;
+   pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+   VK_CHECK(vkCreateDescriptorPool(res->ctx->device, &pool_ci, NULL,
+                                   &res->descriptor_pool.static_ubo_pool));
+   res->descriptor_pool.sampler_pool =
+      vkdf_create_descriptor_pool(res->ctx,
+                                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2);
+}
+
+static void
+init_pipeline_descriptors(ShadowSceneResources *res)
+{
+   VkPushConstantRange pcb_range;
+   pcb_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+   pcb_range.offset = 0;
+   pcb_range.size = sizeof(PCBData);
+
+   res->pipelines.descr.camera_view_layout =
+      vkdf_create_ubo_descriptor_set_layout(res->ctx, 0, 1,
+                                            VK_SHADER_STAGE_VERTEX_BIT,
+                                            false);
+
+   // Object data goes in a storage buffer (see vkdf_scene_get_object_ubo()),
+   // materials in a uniform buffer
+   VkDescriptorSetLayoutBinding obj_bindings[2];
+   for (uint32_t i = 0; i < 2; i++) {
+      obj_bindings[i].binding = i;
+      obj_bindings[i].descriptorType = i == 0 ?
+         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      obj_bindings[i].descriptorCount = 1;
+      obj_bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT |
+                                   VK_SHADER_STAGE_FRAGMENT_BIT;
+      obj_bindings[i].pImmutableSamplers = NULL;
+   }
+
+   VkDescriptorSetLayoutCreateInfo obj_layout_info;
+   obj_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+   obj_layout_info.pNext = NULL;
+   obj_layout_info.bindingCount = 2;
+   obj_layout_info.pBindings = obj_bindings;
+   obj_layout_info.flags = 0;
+
+   VK_CHECK(vkCreateDescriptorSetLayout(res->ctx->device,
+                                        &obj_layout_info,
+                                        NULL,
+                                        &res->pipelines.descr.obj_layout));
+
+   res->pipelines.descr.light_layout =
+      vkdf_create_ubo_descriptor_set_layout(res->ctx, 0, 2,
+                                            VK_SHADER_STAGE_VERTEX_BIT |
+                                                VK_SHADER_STAGE_FRAGMENT_BIT,
+                                            false);
+
+   res->pipelines.descr.shadow_map_sampler_layout =
+      vkdf_create_sampler_descriptor_set_layout(res->ctx, 0, 1,
+                                                VK_SHADER_STAGE_FRAGMENT_BIT);
+
+   VkDescriptorSetLayout layouts[] = {
+      res->pipelines.descr.camera_view_layout,
+      res->pipelines.descr.obj_layout,
+      res->pipelines.descr.light_layout,
+      res->pipelines.descr.shadow_map_sampler_layout,
+   };
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = &pcb_range;
+   pipeline_layout_info.setLayoutCount = 4;
+   pipeline_layout_info.pSetLayouts = layouts;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(res->ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &res->pipelines.layout));
+
+   // Camera descriptor
+   res->pipelines.descr.camera_view_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.camera_view_layout);
+
+   VkDeviceSize ubo_offset = 0;
+   VkDeviceSize ubo_size = res->ubos.camera_view.size;
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.camera_view_set,
+                                     res->ubos.camera_view.buf.buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Objects descriptor
+   res->pipelines.descr.obj_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.obj_layout);
+
+   VkdfBuffer *obj_ubo = vkdf_scene_get_object_ubo(res->scene);
+   ubo_offset = 0;
+   ubo_size = vkdf_scene_get_object_ubo_size(res->scene);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.obj_set,
+                                     obj_ubo->buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, false);
+
+   VkdfBuffer *material_ubo = vkdf_scene_get_material_ubo(res->scene);
+   ubo_offset = 0;
+   ubo_size = vkdf_scene_get_material_ubo_size(res->scene);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.obj_set,
+                                     material_ubo->buf,
+                                     1, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Light and shadow map data descriptor
+   res->pipelines.descr.light_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.static_ubo_pool,
+                                 res->pipelines.descr.light_layout);
+
+   VkdfBuffer *light_ubo = vkdf_scene_get_light_ubo(res->scene);
+   vkdf_scene_get_light_ubo_range(res->scene, &ubo_offset, &ubo_size);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.light_set,
+                                     light_ubo->buf,
+                                     0, 1, &ubo_offset, &ubo_size, false, true);
+
+   vkdf_scene_get_shadow_map_ubo_range(res->scene, &ubo_offset, &ubo_size);
+   vkdf_descriptor_set_buffer_update(res->ctx,
+                                     res->pipelines.descr.light_set,
+                                     light_ubo->buf,
+                                     1, 1, &ubo_offset, &ubo_size, false, true);
+
+   // Shadow map sampler descriptor
+   res->pipelines.descr.shadow_map_sampler_set =
+      vkdf_descriptor_set_create(res->ctx,
+                                 res->descriptor_pool.sampler_pool,
+                                 res->pipelines.descr.shadow_map_sampler_layout);
+
+   VkSampler shadow_map_sampler =
+      vkdf_scene_light_get_shadow_map_sampler(res->scene, 0);
+   VkdfImage *shadow_map_image =
+      vkdf_scene_light_get_shadow_map_image(res->scene, 0);
+
+   vkdf_descriptor_set_sampler_update(res->ctx,
+                                      res->pipelines.descr.shadow_map_sampler_set,
+                                      shadow_map_sampler,
+                                      shadow_map_image->view,
+                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      0, 1);
+}
+
+static void
+init_obj_pipeline(ShadowSceneResources *res)
+{
+   VkVertexInputBindingDescription vi_bindings[1];
+   VkVertexInputAttributeDescription vi_attribs[3];
+
+   // Vertex attribute binding 0: position, normal, material
+   uint32_t stride = vkdf_mesh_get_vertex_data_stride(res->content.cube_mesh);
+   vkdf_vertex_binding_set(&vi_bindings[0],
+                           0, VK_VERTEX_INPUT_RATE_VERTEX, stride);
+
+   assert(vkdf_mesh_get_vertex_data_stride(res->content.tile_mesh) == stride);
+
+   /* binding 0, location 0: position
+    * binding 0, location 1: normal
+    * binding 0, location 2: material
+    */
+   vkdf_vertex_attrib_set(&vi_attribs[0], 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+   vkdf_vertex_attrib_set(&vi_attribs[1], 0, 1, VK_FORMAT_R32G32B32_SFLOAT, 12);
+   vkdf_vertex_attrib_set(&vi_attribs[2], 0, 2, VK_FORMAT_R32_UINT, 24);
+
+   res->pipelines.obj =
+      vkdf_create_gfx_pipeline(res->ctx,
+                               NULL,
+                               1,
+                               vi_bindings,
+                               3,
+                               vi_attribs,
+                               true,
+                               VK_COMPARE_OP_LESS,
+                               vkdf_scene_get_static_render_pass(res->scene),
+                               res->pipelines.layout,
+                               VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                               VK_CULL_MODE_BACK_BIT,
+                               1,
+                               res->shaders.vs,
+                               res->shaders.fs);
+}
+
+static void
+init_shaders(ShadowSceneResources *res)
+{
+   res->shaders.vs =
+      demo_scene_create_shader_module(res->ctx, &res->opts,
+                                      "scene-obj.vert.spv");
+   res->shaders.fs =
+      demo_scene_create_shader_module(res->ctx, &res->opts,
+                                      "scene-obj.frag.spv");
+}
+
+static void
+init_resources(VkdfContext *ctx, const DemoSceneOptions *opts,
+               ShadowSceneResources *res)
+{
+   memset(res, 0, sizeof(ShadowSceneResources));
+
+   res->ctx = ctx;
+   res->opts = *opts;
+
+   shadow_scene_content_init(ctx, &res->content);
+
+   init_scene(res);
+   init_descriptor_pools(res);
+   init_objects(res);
+   init_ubos(res);
+   init_shaders(res);
+
+   VkClearValue color_clear;
+   vkdf_color_clear_set(&color_clear, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+   VkClearValue depth_clear;
+   vkdf_depth_stencil_clear_set(&depth_clear, 1.0f, 0);
+
+   vkdf_scene_set_clear_values(res->scene, &color_clear, &depth_clear);
+
+   if (opts->configure_cb)
+      opts->configure_cb(res->scene, opts->cb_data);
+
+   vkdf_scene_prepare(res->scene);
+
+   init_pipeline_descriptors(res);
+   init_obj_pipeline(res);
+}
+
+static void
+destroy_pipelines(ShadowSceneResources *res)
+{
+   VkDevice device = res->ctx->device;
+
+   vkDestroyPipeline(device, res->pipelines.obj, NULL);
+   vkDestroyPipelineLayout(device, res->pipelines.layout, NULL);
+
+   vkFreeDescriptorSets(device, res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.camera_view_set);
+   vkDestroyDescriptorSetLayout(device,
+                                res->pipelines.descr.camera_view_layout, NULL);
+
+   vkFreeDescriptorSets(device, res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.obj_set);
+   vkDestroyDescriptorSetLayout(device,
+                                res->pipelines.descr.obj_layout, NULL);
+
+   vkFreeDescriptorSets(device, res->descriptor_pool.static_ubo_pool,
+                        1, &res->pipelines.descr.light_set);
+   vkDestroyDescriptorSetLayout(device,
+                                res->pipelines.descr.light_layout, NULL);
+
+   vkFreeDescriptorSets(device, res->descriptor_pool.sampler_pool,
+                        1, &res->pipelines.descr.shadow_map_sampler_set);
+   vkDestroyDescriptorSetLayout(device,
+                                res->pipelines.descr.shadow_map_sampler_layout,
+                                NULL);
+
+   vkDestroyDescriptorPool(device, res->descriptor_pool.static_ubo_pool, NULL);
+   vkDestroyDescriptorPool(device, res->descriptor_pool.sampler_pool, NULL);
+}
+
+static void
+cleanup_resources(VkdfContext *ctx, ShadowSceneResources *res)
+{
+   // Also frees the objects and the light
+   vkdf_scene_free(res->scene);
+
+   destroy_pipelines(res);
+   vkDestroyShaderModule(ctx->device, res->shaders.vs, NULL);
+   vkDestroyShaderModule(ctx->device, res->shaders.fs, NULL);
+   vkdf_destroy_buffer(ctx, &res->ubos.camera_view.buf);
+
+   vkdf_model_free(ctx, res->content.cube_model);
+   vkdf_model_free(ctx, res->content.tile_model);
+
+   vkdf_camera_free(ctx, res->camera);
+}
+
+static void *
+shadow_scene_build(VkdfContext *ctx, const DemoSceneOptions *opts)
+{
+   ShadowSceneResources *res = g_new(ShadowSceneResources, 1);
+   init_resources(ctx, opts, res);
+   return res;
+}
+
+static VkdfScene *
+shadow_scene_get_scene(void *data)
+{
+   return ((ShadowSceneResources *) data)->scene;
+}
+
+static void
+shadow_scene_free(VkdfContext *ctx, void *data)
+{
+   ShadowSceneResources *res = (ShadowSceneResources *) data;
+   cleanup_resources(ctx, res);
+   g_free(res);
+}
+
+const DemoSceneBuilder shadow_scene_builder = {
+   "shadow",
+   shadow_scene_build,
+   shadow_scene_get_scene,
+   shadow_scene_free,
+};
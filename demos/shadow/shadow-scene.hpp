@@ -0,0 +1,67 @@
+#ifndef __SHADOW_SCENE_H__
+#define __SHADOW_SCENE_H__
+
+#include "../demo-scene.hpp"
+
+// ----------------------------------------------------------------------------
+// A room with a few cubes lit by a spotlight that casts shadows
+//
+// The shadow demo renders the scene by hand to show how shadow mapping
+// works, shadow_scene_builder renders it through a VkdfScene.
+// ----------------------------------------------------------------------------
+
+// Scene depth range
+const float SCENE_NEAR =   0.1f;
+const float SCENE_FAR  = 100.0f;
+
+// Number of objects in the scene
+const int32_t NUM_CUBES = 3;
+
+// Number of floor tiles and their size
+const int32_t ROOM_WIDTH = 20;
+const int32_t ROOM_DEPTH = 20;
+const int32_t TILE_WIDTH = 2.0f;
+const int32_t TILE_DEPTH = 2.0f;
+const int32_t NUM_TILES  = ROOM_WIDTH * ROOM_DEPTH;
+
+// Depth range of the light. We want this to be as tightly packed as possible
+const float LIGHT_NEAR =  0.1f;
+const float LIGHT_FAR  = 50.0f;
+
+// Shadow map resolution. Lowering this may cause more self-shadowing
+// artifacts and require to increase depth bias factors
+const uint32_t SHADOW_MAP_WIDTH  = 2048;
+const uint32_t SHADOW_MAP_HEIGHT = 2048;
+
+// Shadow map depth bias factors. Too large values can cause shadows to
+// be dettached from the objects that cast them
+const float SHADOW_MAP_DEPTH_BIAS_CONST = 4.0f;
+const float SHADOW_MAP_DEPTH_BIAS_SLOPE = 1.8f;
+
+typedef struct {
+   VkdfModel *cube_model;
+   VkdfModel *tile_model;
+   VkdfMesh *cube_mesh;
+   VkdfMesh *tile_mesh;
+   VkdfObject *cubes[NUM_CUBES];
+   VkdfObject *tiles[NUM_TILES];
+   VkdfLight *light;
+   float light_rot;                    // Degrees around the Y axis
+} ShadowSceneContent;
+
+/**
+ * Creates the models, objects and light of the scene. The caller owns them.
+ */
+void
+shadow_scene_content_init(VkdfContext *ctx, ShadowSceneContent *content);
+
+/**
+ * Moves the light a step around the room.
+ */
+void
+shadow_scene_content_update_light(ShadowSceneContent *content);
+
+VkdfCamera *
+shadow_scene_camera_new(float aspect_ratio);
+
+#endif
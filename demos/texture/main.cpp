@@ -93,7 +93,7 @@ create_render_pass(VkdfContext *ctx)
    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-   attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   attachments[0].finalLayout = vkdf_get_present_layout(ctx);
    attachments[0].flags = 0;
 
    // Single subpass
@@ -629,8 +629,7 @@ destroy_descriptor_resources(VkdfContext *ctx, DemoResources *res)
 static void
 destroy_ubo_resources(VkdfContext *ctx, DemoResources *res)
 {
-   vkDestroyBuffer(ctx->device, res->ubo.buf, NULL);
-   vkFreeMemory(ctx->device, res->ubo.mem, NULL);
+   vkdf_destroy_buffer(ctx, &res->ubo);
 }
 
 void
@@ -23,23 +23,16 @@ vkdf_create_buffer(VkdfContext *ctx,
 
    VK_CHECK(vkCreateBuffer(ctx->device, &buf_info, NULL, &buffer.buf));
 
-   // Look for suitable memory heap
+   // Allocate and bind memory
    vkGetBufferMemoryRequirements(ctx->device, buffer.buf, &buffer.mem_reqs);
 
-   VkMemoryAllocateInfo alloc_info;
-   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-   alloc_info.pNext = NULL;
-   alloc_info.allocationSize = buffer.mem_reqs.size;
-   bool result =
-      vkdf_memory_type_from_properties(ctx, buffer.mem_reqs.memoryTypeBits,
-                                       mem_props,
-                                       &alloc_info.memoryTypeIndex);
-   assert(result);
+   vkdf_memory_alloc(ctx, &buffer.mem_reqs, mem_props,
+                     VKDF_MEMORY_RESOURCE_LINEAR, false, &buffer.alloc);
+   buffer.mem = buffer.alloc.mem;
    buffer.mem_props = mem_props;
 
-   // Allocate and bind memory
-   VK_CHECK(vkAllocateMemory(ctx->device, &alloc_info, NULL, &buffer.mem));
-   VK_CHECK(vkBindBufferMemory(ctx->device, buffer.buf, buffer.mem, 0));
+   VK_CHECK(vkBindBufferMemory(ctx->device, buffer.buf,
+                               buffer.alloc.mem, buffer.alloc.offset));
 
    return buffer;
 }
@@ -97,5 +90,6 @@ void
 vkdf_destroy_buffer(VkdfContext *ctx, VkdfBuffer *buf)
 {
    vkDestroyBuffer(ctx->device, buf->buf, NULL);
-   vkFreeMemory(ctx->device, buf->mem, NULL);
+   vkdf_memory_free(ctx, &buf->alloc);
+   buf->mem = 0;
 }
@@ -3,12 +3,14 @@
 
 #include "vkdf-deps.hpp"
 #include "vkdf-init.hpp"
+#include "vkdf-memory.hpp"
 
 typedef struct {
    VkBuffer buf;
    VkMemoryRequirements mem_reqs;
    VkDeviceMemory mem;
    uint32_t mem_props;
+   VkdfMemoryAllocation alloc;
 } VkdfBuffer;
 
 VkdfBuffer
@@ -169,6 +169,80 @@ vkdf_command_buffer_execute_sync(VkdfContext *ctx,
    vkDestroyFence(ctx->device, fence, NULL);
 }
 
+void
+vkdf_submit_batch_add(VkdfSubmitBatch *batch,
+                      VkCommandBuffer cmd_buf,
+                      VkPipelineStageFlags *pipeline_stage_flags,
+                      uint32_t wait_sem_count,
+                      VkSemaphore *wait_sem,
+                      uint32_t signal_sem_count,
+                      VkSemaphore *signal_sem)
+{
+   assert(batch->count < VKDF_MAX_BATCH_SUBMITS);
+   assert(wait_sem_count <= VKDF_MAX_BATCH_SEMS);
+   assert(signal_sem_count <= VKDF_MAX_BATCH_SEMS);
+
+   const uint32_t idx = batch->count++;
+
+   batch->cmd_buf[idx][0] = cmd_buf;
+   for (uint32_t i = 0; i < wait_sem_count; i++) {
+      batch->wait_sem[idx][i] = wait_sem[i];
+      batch->wait_stage[idx][i] = pipeline_stage_flags[i];
+   }
+   for (uint32_t i = 0; i < signal_sem_count; i++)
+      batch->signal_sem[idx][i] = signal_sem[i];
+
+   VkSubmitInfo *submit_info = &batch->info[idx];
+   submit_info->pNext = NULL;
+   submit_info->sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+   submit_info->waitSemaphoreCount = wait_sem_count;
+   submit_info->pWaitSemaphores = batch->wait_sem[idx];
+   submit_info->signalSemaphoreCount = signal_sem_count;
+   submit_info->pSignalSemaphores = batch->signal_sem[idx];
+   submit_info->pWaitDstStageMask = batch->wait_stage[idx];
+   submit_info->commandBufferCount = 1;
+   submit_info->pCommandBuffers = batch->cmd_buf[idx];
+}
+
+void
+vkdf_submit_batch_wrap_last(VkdfSubmitBatch *batch,
+                            VkCommandBuffer before,
+                            VkCommandBuffer after)
+{
+   assert(batch->count > 0);
+
+   const uint32_t idx = batch->count - 1;
+   VkSubmitInfo *submit_info = &batch->info[idx];
+   VkCommandBuffer *cmd_bufs = batch->cmd_buf[idx];
+   uint32_t count = submit_info->commandBufferCount;
+
+   if (before) {
+      assert(count < VKDF_MAX_BATCH_CMD_BUFS);
+      memmove(&cmd_bufs[1], &cmd_bufs[0], count * sizeof(VkCommandBuffer));
+      cmd_bufs[0] = before;
+      count++;
+   }
+
+   if (after) {
+      assert(count < VKDF_MAX_BATCH_CMD_BUFS);
+      cmd_bufs[count++] = after;
+   }
+
+   submit_info->commandBufferCount = count;
+}
+
+void
+vkdf_submit_batch_flush(VkdfContext *ctx,
+                        VkdfSubmitBatch *batch,
+                        VkFence fence)
+{
+   if (batch->count == 0 && fence == VK_NULL_HANDLE)
+      return;
+
+   VK_CHECK(vkQueueSubmit(ctx->gfx_queue, batch->count, batch->info, fence));
+   batch->count = 0;
+}
+
 static void
 present_commands(VkdfContext *ctx,
                  VkImage image,
@@ -238,7 +312,7 @@ present_commands(VkdfContext *ctx,
       vkdf_create_image_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
                                 VK_ACCESS_MEMORY_READ_BIT,
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                vkdf_get_present_layout(ctx),
                                 ctx->swap_chain_images[index].image,
                                 subresource_range);
 
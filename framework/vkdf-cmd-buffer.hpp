@@ -61,6 +61,68 @@ vkdf_command_buffer_execute_sync(VkdfContext *ctx,
                                  VkCommandBuffer cmd_buf,
                                  VkPipelineStageFlags pipeline_stage_flags);
 
+#define VKDF_MAX_BATCH_SUBMITS  16
+#define VKDF_MAX_BATCH_SEMS     4
+#define VKDF_MAX_BATCH_CMD_BUFS 3
+
+/**
+ * Accumulates command buffer submissions, with their semaphore chains, so
+ * they can be sent to the graphics queue with a single vkQueueSubmit.
+ * Submissions in a batch execute in the order they were added and can wait
+ * on semaphores signaled by earlier submissions in the same batch.
+ *
+ * The batch keeps its own copy of the semaphores and wait stages, so the
+ * caller's arrays don't need to outlive the call that adds them.
+ */
+typedef struct {
+   uint32_t count;
+   VkSubmitInfo info[VKDF_MAX_BATCH_SUBMITS];
+   VkCommandBuffer cmd_buf[VKDF_MAX_BATCH_SUBMITS][VKDF_MAX_BATCH_CMD_BUFS];
+   VkSemaphore wait_sem[VKDF_MAX_BATCH_SUBMITS][VKDF_MAX_BATCH_SEMS];
+   VkPipelineStageFlags wait_stage[VKDF_MAX_BATCH_SUBMITS][VKDF_MAX_BATCH_SEMS];
+   VkSemaphore signal_sem[VKDF_MAX_BATCH_SUBMITS][VKDF_MAX_BATCH_SEMS];
+} VkdfSubmitBatch;
+
+inline void
+vkdf_submit_batch_reset(VkdfSubmitBatch *batch)
+{
+   batch->count = 0;
+}
+
+/**
+ * Same arguments as vkdf_command_buffer_execute(), but the submission is
+ * deferred until the batch is flushed.
+ */
+void
+vkdf_submit_batch_add(VkdfSubmitBatch *batch,
+                      VkCommandBuffer cmd_buf,
+                      VkPipelineStageFlags *pipeline_stage_flags,
+                      uint32_t wait_sem_count,
+                      VkSemaphore *wait_sem,
+                      uint32_t signal_sem_count,
+                      VkSemaphore *signal_sem);
+
+/**
+ * Adds command buffers to execute right before and after the command buffer
+ * of the last submission in the batch, within the same submission (so
+ * after its semaphore waits and before its signals). Either can be
+ * VK_NULL_HANDLE. This is used to wrap jobs with GPU timestamp queries.
+ */
+void
+vkdf_submit_batch_wrap_last(VkdfSubmitBatch *batch,
+                            VkCommandBuffer before,
+                            VkCommandBuffer after);
+
+/**
+ * Submits all the accumulated work with a single vkQueueSubmit and resets
+ * the batch. 'fence' (which can be VK_NULL_HANDLE) is signaled when all of
+ * it has completed.
+ */
+void
+vkdf_submit_batch_flush(VkdfContext *ctx,
+                        VkdfSubmitBatch *batch,
+                        VkFence fence);
+
 VkCommandBuffer *
 vkdf_command_buffer_create_for_present(VkdfContext *ctx,
                                        VkCommandPool cmd_pool,
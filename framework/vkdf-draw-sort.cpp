@@ -0,0 +1,70 @@
+#include "vkdf-draw-sort.hpp"
+
+/* Below this many packets an insertion sort is faster than setting up the
+ * radix sort histograms.
+ */
+#define INSERTION_SORT_THRESHOLD 32
+
+static void
+insertion_sort(VkdfDrawPacket *packets, uint32_t count)
+{
+   for (uint32_t i = 1; i < count; i++) {
+      VkdfDrawPacket p = packets[i];
+      uint32_t j = i;
+      while (j > 0 && packets[j - 1].key > p.key) {
+         packets[j] = packets[j - 1];
+         j--;
+      }
+      packets[j] = p;
+   }
+}
+
+/**
+ * LSD radix sort with 8-bit digits. Digits where all the keys are the same,
+ * which is common for the pass and pipeline bits, are skipped.
+ */
+void
+vkdf_draw_sort(VkdfDrawPacket *packets, uint32_t count, VkdfDrawPacket *tmp)
+{
+   if (count < INSERTION_SORT_THRESHOLD) {
+      insertion_sort(packets, count);
+      return;
+   }
+
+   uint32_t histograms[8][256];
+   memset(histograms, 0, sizeof(histograms));
+   for (uint32_t i = 0; i < count; i++) {
+      const uint64_t key = packets[i].key;
+      for (uint32_t d = 0; d < 8; d++)
+         histograms[d][(key >> (8 * d)) & 0xff]++;
+   }
+
+   VkdfDrawPacket *src = packets;
+   VkdfDrawPacket *dst = tmp;
+   for (uint32_t d = 0; d < 8; d++) {
+      uint32_t *histogram = histograms[d];
+
+      const uint32_t first_digit = (src[0].key >> (8 * d)) & 0xff;
+      if (histogram[first_digit] == count)
+         continue;
+
+      uint32_t offset = 0;
+      for (uint32_t i = 0; i < 256; i++) {
+         const uint32_t n = histogram[i];
+         histogram[i] = offset;
+         offset += n;
+      }
+
+      for (uint32_t i = 0; i < count; i++) {
+         const uint32_t digit = (src[i].key >> (8 * d)) & 0xff;
+         dst[histogram[digit]++] = src[i];
+      }
+
+      VkdfDrawPacket *swap = src;
+      src = dst;
+      dst = swap;
+   }
+
+   if (src != packets)
+      memcpy(packets, src, count * sizeof(VkdfDrawPacket));
+}
@@ -0,0 +1,64 @@
+#ifndef __VKDF_DRAW_SORT_H__
+#define __VKDF_DRAW_SORT_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-util.hpp"
+
+/**
+ * Draw keys pack the state a draw needs into 64 bits so that sorting the
+ * keys groups draws that share state and orders them front-to-back:
+ *
+ *    63..60: pass
+ *    59..48: pipeline
+ *    47..32: material
+ *    31..0:  depth (distance to the camera, float bits)
+ *
+ * Non-negative floats compare like their bit patterns, so depth doesn't
+ * need quantizing. Pipeline and material ids are chosen by the caller.
+ */
+#define VKDF_DRAW_KEY_MAX_PASS     ((1u << 4) - 1)
+#define VKDF_DRAW_KEY_MAX_PIPELINE ((1u << 12) - 1)
+#define VKDF_DRAW_KEY_MAX_MATERIAL ((1u << 16) - 1)
+
+typedef struct {
+   uint64_t key;
+   uint32_t index;                     // Caller data, usually an array index
+} VkdfDrawPacket;
+
+inline uint64_t
+vkdf_draw_key(uint32_t pass, uint32_t pipeline, uint32_t material, float depth)
+{
+   assert(pass <= VKDF_DRAW_KEY_MAX_PASS);
+   assert(pipeline <= VKDF_DRAW_KEY_MAX_PIPELINE);
+   assert(material <= VKDF_DRAW_KEY_MAX_MATERIAL);
+
+   depth = MAX2(depth, 0.0f);
+   uint32_t depth_bits;
+   memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+   return (((uint64_t) pass) << 60) |
+          (((uint64_t) pipeline) << 48) |
+          (((uint64_t) material) << 32) |
+          depth_bits;
+}
+
+inline uint32_t
+vkdf_draw_key_get_pipeline(uint64_t key)
+{
+   return (key >> 48) & VKDF_DRAW_KEY_MAX_PIPELINE;
+}
+
+inline uint32_t
+vkdf_draw_key_get_material(uint64_t key)
+{
+   return (key >> 32) & VKDF_DRAW_KEY_MAX_MATERIAL;
+}
+
+/**
+ * Sorts the packets by key in increasing order. The sort is stable. 'tmp'
+ * must have room for 'count' packets.
+ */
+void
+vkdf_draw_sort(VkdfDrawPacket *packets, uint32_t count, VkdfDrawPacket *tmp);
+
+#endif
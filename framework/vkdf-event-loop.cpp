@@ -4,6 +4,8 @@
 #include "vkdf-error.hpp"
 #include "vkdf-cmd-buffer.hpp"
 #include "vkdf-platform.hpp"
+#include "vkdf-thread-pool.hpp"
+#include "vkdf-profiler.hpp"
 
 #define VKDF_LOG_FPS_ENABLE 1
 
@@ -17,10 +19,19 @@ static double _frame_min_time = 1000000000.0;
 static double _frame_max_time = 0.0;
 #endif
 
+static inline bool
+should_quit(VkdfContext *ctx)
+{
+   return ctx->quit || vkdf_platform_should_quit(&ctx->platform);
+}
+
 static inline void
 frame_start(VkdfContext *ctx)
 {
    _frame_start_time = vkdf_platform_get_time();
+
+   if (ctx->profiler)
+      vkdf_profiler_frame_begin(ctx->profiler);
 }
 
 static inline void
@@ -28,6 +39,12 @@ frame_end(VkdfContext *ctx)
 {
    _frames++;
 
+   /* The profiler measures the work done for the frame, so we end its
+    * frame before we throttle for the FPS target.
+    */
+   if (ctx->profiler)
+      vkdf_profiler_frame_end(ctx->profiler);
+
    /* Compute frame time */
    double frame_end_time = vkdf_platform_get_time();
    _last_frame_time = frame_end_time - _frame_start_time;
@@ -70,6 +87,10 @@ vkdf_rebuild_swap_chain(VkdfContext *ctx)
 {
    int32_t width, height;
 
+   // Headless swap chains have no window to follow
+   if (ctx->headless)
+      return;
+
    if (!ctx->before_rebuild_swap_chain_cb ||
        !ctx->before_rebuild_swap_chain_cb) {
       vkdf_error("Swap chain needs to be resized but no swap chain "
@@ -97,6 +118,11 @@ acquire_next_image(VkdfContext *ctx)
    VkResult res;
    bool image_acquired = false;
 
+   if (ctx->headless) {
+      _headless_acquire_next_image(ctx);
+      return;
+   }
+
    // We only get an updated swap_chain_index after calling
    // vkAcquireNextImageKHR.
    //
@@ -141,6 +167,11 @@ acquire_next_image(VkdfContext *ctx)
 static void
 present_image(VkdfContext *ctx)
 {
+   if (ctx->headless) {
+      _headless_present_image(ctx);
+      return;
+   }
+
    VkPresentInfoKHR present;
    present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
    present.pNext = NULL;
@@ -163,21 +194,85 @@ vkdf_event_loop_run(VkdfContext *ctx,
    do {
       frame_start(ctx);
 
+      vkdf_profiler_cpu_zone_begin(ctx->profiler, "update");
       update_func(ctx, data);
+      vkdf_profiler_cpu_zone_end(ctx->profiler);
 
       acquire_next_image(ctx);
+
+      vkdf_profiler_cpu_zone_begin(ctx->profiler, "render");
       render_func(ctx, data);
+      vkdf_profiler_cpu_zone_end(ctx->profiler);
 
       present_image(ctx);
 
       vkdf_platform_poll_events(&ctx->platform);
 
       frame_end(ctx);
-   } while (!vkdf_platform_should_quit(&ctx->platform));
+   } while (!should_quit(ctx));
 
    vkDeviceWaitIdle(ctx->device);
 }
 
+struct UpdateJobData {
+   VkdfContext *ctx;
+   vkdf_event_loop_update_func *update_func;
+   void *data;
+};
+
+static void
+thread_update_job(uint32_t thread_id, void *arg)
+{
+   struct UpdateJobData *job = (struct UpdateJobData *) arg;
+   VKDF_PROFILE_ZONE(job->ctx->profiler, "update");
+   job->update_func(job->ctx, job->data);
+}
+
+void
+vkdf_event_loop_run_pipelined(VkdfContext *ctx,
+                              vkdf_event_loop_update_func update_func,
+                              vkdf_event_loop_sync_func sync_func,
+                              vkdf_event_loop_render_func render_func,
+                              void *data)
+{
+   VkdfThreadPool *pool = vkdf_thread_pool_new(1);
+
+   struct UpdateJobData job;
+   job.ctx = ctx;
+   job.update_func = update_func;
+   job.data = data;
+
+   // Nothing to overlap with for the first frame
+   update_func(ctx, data);
+
+   do {
+      frame_start(ctx);
+
+      // Both stages are idle: hand the update results over to the render
+      // stage and do anything that may touch state shared by both
+      sync_func(ctx, data);
+      vkdf_platform_poll_events(&ctx->platform);
+      acquire_next_image(ctx);
+
+      // Update frame N+1 while we render frame N
+      vkdf_thread_pool_add_job(pool, thread_update_job, &job);
+
+      vkdf_profiler_cpu_zone_begin(ctx->profiler, "render");
+      render_func(ctx, data);
+      vkdf_profiler_cpu_zone_end(ctx->profiler);
+
+      present_image(ctx);
+
+      vkdf_thread_pool_wait(pool);
+
+      frame_end(ctx);
+   } while (!should_quit(ctx));
+
+   vkDeviceWaitIdle(ctx->device);
+
+   vkdf_thread_pool_free(pool);
+}
+
 /**
  * Applications doing offscreen rendering will call this function right after
  * they are done rendering to the offscreen image in their render_func() hook.
@@ -214,3 +309,39 @@ vkdf_copy_to_swapchain(VkdfContext *ctx,
       1, &ctx->draw_sem[ctx->swap_chain_index],
       fence);
 }
+
+/**
+ * Like vkdf_copy_to_swapchain(), but adds the copy to a submit batch so it
+ * can go to the queue together with the rendering work. The caller flushes
+ * the batch (usually with the presentation fence). If 'signal_sem' is not
+ * VK_NULL_HANDLE it is also signaled when the copy completes.
+ */
+void
+vkdf_batch_copy_to_swapchain(VkdfContext *ctx,
+                             VkdfSubmitBatch *batch,
+                             VkCommandBuffer *copy_cmd_bufs,
+                             VkPipelineStageFlags wait_stage,
+                             VkSemaphore wait_sem,
+                             VkSemaphore signal_sem)
+{
+   VkSemaphore wait_sems[2] = {
+      wait_sem,
+      ctx->acquired_sem[ctx->swap_chain_index]
+   };
+
+   VkPipelineStageFlags wait_stages[2] = {
+      wait_stage,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+   };
+
+   VkSemaphore signal_sems[2] = {
+      ctx->draw_sem[ctx->swap_chain_index],
+      signal_sem
+   };
+
+   vkdf_submit_batch_add(batch,
+                         copy_cmd_bufs[ctx->swap_chain_index],
+                         wait_stages,
+                         2, wait_sems,
+                         signal_sem ? 2 : 1, signal_sems);
+}
@@ -3,9 +3,11 @@
 
 #include "vkdf-deps.hpp"
 #include "vkdf-init.hpp"
+#include "vkdf-cmd-buffer.hpp"
 
 typedef void (vkdf_event_loop_update_func)(VkdfContext *ctx, void *data);
 typedef void (vkdf_event_loop_render_func)(VkdfContext *ctx, void *data);
+typedef void (vkdf_event_loop_sync_func)(VkdfContext *ctx, void *data);
 
 void
 vkdf_event_loop_run(VkdfContext *ctx,
@@ -13,6 +15,35 @@ vkdf_event_loop_run(VkdfContext *ctx,
                     vkdf_event_loop_render_func render_func,
                     void *data);
 
+/**
+ * Pipelined variant of vkdf_event_loop_run(): update_func() for frame N+1
+ * runs on a separate thread while render_func() records and submits frame N
+ * on the calling thread.
+ *
+ * sync_func() runs on the calling thread while neither stage is running,
+ * right before frame N is rendered. This is where applications hand the
+ * state produced by update_func() over to render_func() (for example, by
+ * swapping double-buffered state), so the two stages never access the same
+ * data concurrently. Event polling and swapchain image acquisition (which
+ * may rebuild the swapchain) also happen while both stages are idle.
+ */
+void
+vkdf_event_loop_run_pipelined(VkdfContext *ctx,
+                              vkdf_event_loop_update_func update_func,
+                              vkdf_event_loop_sync_func sync_func,
+                              vkdf_event_loop_render_func render_func,
+                              void *data);
+
+/**
+ * Makes the event loop return after the current frame, as if the user had
+ * asked to quit.
+ */
+inline void
+vkdf_event_loop_quit(VkdfContext *ctx)
+{
+   ctx->quit = true;
+}
+
 void inline
 vkdf_set_rebuild_swapchain_cbs(VkdfContext *ctx,
                                VkdfRebuildSwapChainCB before,
@@ -34,5 +65,13 @@ vkdf_copy_to_swapchain(VkdfContext *ctx,
                        VkSemaphore wait_sem,
                        VkFence fence);
 
+void
+vkdf_batch_copy_to_swapchain(VkdfContext *ctx,
+                             VkdfSubmitBatch *batch,
+                             VkCommandBuffer *copy_cmd_bufs,
+                             VkPipelineStageFlags wait_stage,
+                             VkSemaphore wait_sem,
+                             VkSemaphore signal_sem);
+
 #endif
 
@@ -0,0 +1,236 @@
+#include "vkdf-geometry-arena.hpp"
+
+VkdfGeometryArena *
+vkdf_geometry_arena_new(VkdfContext *ctx)
+{
+   VkdfGeometryArena *arena = g_new0(VkdfGeometryArena, 1);
+   arena->ctx = ctx;
+   arena->ranges = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                         NULL, g_free);
+   return arena;
+}
+
+void
+vkdf_geometry_arena_add_mesh(VkdfGeometryArena *arena, VkdfMesh *mesh)
+{
+   assert(!arena->built);
+
+   if (mesh->vertices.size() == 0 ||
+       g_hash_table_contains(arena->ranges, mesh))
+      return;
+
+   VkdfGeometryRange *range = g_new0(VkdfGeometryRange, 1);
+   g_hash_table_insert(arena->ranges, mesh, range);
+   arena->meshes.push_back(mesh);
+}
+
+void
+vkdf_geometry_arena_add_model(VkdfGeometryArena *arena, VkdfModel *model)
+{
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      vkdf_geometry_arena_add_mesh(arena, model->meshes[i]);
+}
+
+static uint32_t
+get_pool(VkdfGeometryArena *arena, uint32_t stride, VkPrimitiveTopology primitive)
+{
+   for (uint32_t i = 0; i < arena->pools.size(); i++) {
+      if (arena->pools[i].stride == stride &&
+          arena->pools[i].primitive == primitive) {
+         return i;
+      }
+   }
+
+   VkdfGeometryPool pool;
+   memset(&pool, 0, sizeof(pool));
+   pool.stride = stride;
+   pool.primitive = primitive;
+   arena->pools.push_back(pool);
+
+   return arena->pools.size() - 1;
+}
+
+/**
+ * Assigns each mesh its pool, vertex offset and index ranges, which
+ * determines the sizes of all the arena buffers.
+ */
+static void
+layout_meshes(VkdfGeometryArena *arena)
+{
+   for (uint32_t i = 0; i < arena->meshes.size(); i++) {
+      VkdfMesh *mesh = arena->meshes[i];
+      VkdfGeometryRange *range = (VkdfGeometryRange *)
+         g_hash_table_lookup(arena->ranges, mesh);
+
+      range->pool = get_pool(arena,
+                             vkdf_mesh_get_vertex_data_stride(mesh),
+                             vkdf_mesh_get_primitive(mesh));
+
+      VkdfGeometryPool *pool = &arena->pools[range->pool];
+      range->vertex_offset = pool->vertex_count;
+      pool->vertex_count += mesh->vertices.size();
+
+      const uint32_t first_index = arena->index_count;
+      if (mesh->indices.size() == 0) {
+         range->num_lods = 1;
+         range->lods[0].first_index = first_index;
+         range->lods[0].index_count = mesh->vertices.size();
+         range->lods[0].error = 0.0f;
+         arena->index_count += mesh->vertices.size();
+         continue;
+      }
+
+      range->num_lods = vkdf_mesh_get_num_lods(mesh);
+      range->lods[0].first_index = first_index;
+      range->lods[0].index_count = mesh->indices.size();
+      range->lods[0].error = 0.0f;
+      for (uint32_t l = 1; l < range->num_lods; l++) {
+         range->lods[l] = mesh->lods[l];
+         range->lods[l].first_index += first_index;
+      }
+
+      arena->index_count += mesh->indices.size() + mesh->lod_indices.size();
+   }
+}
+
+void
+vkdf_geometry_arena_build(VkdfGeometryArena *arena, VkdfStaging *staging)
+{
+   assert(!arena->built);
+   arena->built = true;
+
+   if (arena->meshes.size() == 0)
+      return;
+
+   VkdfContext *ctx = arena->ctx;
+
+   layout_meshes(arena);
+
+   VkDeviceSize total_size = arena->index_count * sizeof(uint32_t);
+   for (uint32_t i = 0; i < arena->pools.size(); i++) {
+      VkdfGeometryPool *pool = &arena->pools[i];
+      total_size += ((VkDeviceSize) pool->vertex_count) * pool->stride;
+   }
+
+   VkdfStaging *st = staging;
+   if (!st && !ctx->host_visible_geometry)
+      st = vkdf_staging_new(ctx, total_size);
+
+   // Vertex data, one buffer per pool
+   std::vector<uint8_t *> pool_maps(arena->pools.size());
+   for (uint32_t i = 0; i < arena->pools.size(); i++) {
+      VkdfGeometryPool *pool = &arena->pools[i];
+      pool_maps[i] =
+         vkdf_staging_create_geometry_buffer(ctx, st,
+                                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                             ((VkDeviceSize) pool->vertex_count) *
+                                                pool->stride,
+                                             &pool->vertex_buf);
+   }
+
+   // Index data, shared by all pools since indices are relative to the
+   // vertex offset of each draw
+   uint8_t *index_map =
+      vkdf_staging_create_geometry_buffer(ctx, st,
+                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                          arena->index_count * sizeof(uint32_t),
+                                          &arena->index_buf);
+
+   for (uint32_t i = 0; i < arena->meshes.size(); i++) {
+      VkdfMesh *mesh = arena->meshes[i];
+      const VkdfGeometryRange *range = vkdf_geometry_arena_lookup(arena, mesh);
+      const VkdfGeometryPool *pool = &arena->pools[range->pool];
+
+      vkdf_mesh_write_vertex_data(mesh,
+                                  pool_maps[range->pool] +
+                                     ((VkDeviceSize) range->vertex_offset) *
+                                     pool->stride);
+
+      uint8_t *map = index_map + range->lods[0].first_index * sizeof(uint32_t);
+      if (mesh->indices.size() > 0) {
+         vkdf_mesh_write_index_data(mesh, map);
+      } else {
+         uint32_t *indices = (uint32_t *) map;
+         for (uint32_t v = 0; v < mesh->vertices.size(); v++)
+            indices[v] = v;
+      }
+   }
+
+   for (uint32_t i = 0; i < arena->pools.size(); i++)
+      vkdf_staging_finish_geometry_buffer(ctx, &arena->pools[i].vertex_buf);
+   vkdf_staging_finish_geometry_buffer(ctx, &arena->index_buf);
+
+   if (st && st != staging)
+      vkdf_staging_free(st);
+
+   vkdf_info("geometry-arena: %u meshes, %u pools, %u indices (%.2f MB).\n",
+             (uint32_t) arena->meshes.size(), (uint32_t) arena->pools.size(),
+             arena->index_count, total_size / (1024.0f * 1024.0f));
+
+   // We only need the mesh pointers as lookup keys from now on
+   arena->meshes.clear();
+   std::vector<VkdfMesh *>(arena->meshes).swap(arena->meshes);
+}
+
+bool
+vkdf_geometry_arena_get_model_pool(VkdfGeometryArena *arena,
+                                   VkdfModel *model,
+                                   uint32_t *pool)
+{
+   if (model->meshes.size() == 0)
+      return false;
+
+   for (uint32_t i = 0; i < model->meshes.size(); i++) {
+      const VkdfGeometryRange *range =
+         vkdf_geometry_arena_lookup(arena, model->meshes[i]);
+      if (!range)
+         return false;
+      if (i == 0)
+         *pool = range->pool;
+      else if (range->pool != *pool)
+         return false;
+   }
+
+   return true;
+}
+
+void
+vkdf_geometry_arena_bind(VkdfGeometryArena *arena,
+                         VkCommandBuffer cmd_buf,
+                         uint32_t pool)
+{
+   assert(arena->built && pool < arena->pools.size());
+
+   const VkDeviceSize offsets[1] = { 0 };
+   vkCmdBindVertexBuffers(cmd_buf,
+                          0,                                   // Start Binding
+                          1,                                   // Binding Count
+                          &arena->pools[pool].vertex_buf.buf,  // Buffers
+                          offsets);                            // Offsets
+
+   vkCmdBindIndexBuffer(cmd_buf,
+                        arena->index_buf.buf,                  // Buffer
+                        0,                                     // Offset
+                        VK_INDEX_TYPE_UINT32);                 // Index type
+}
+
+void
+vkdf_geometry_arena_free(VkdfGeometryArena *arena)
+{
+   for (uint32_t i = 0; i < arena->pools.size(); i++) {
+      if (arena->pools[i].vertex_buf.buf)
+         vkdf_destroy_buffer(arena->ctx, &arena->pools[i].vertex_buf);
+   }
+   arena->pools.clear();
+   std::vector<VkdfGeometryPool>(arena->pools).swap(arena->pools);
+
+   if (arena->index_buf.buf)
+      vkdf_destroy_buffer(arena->ctx, &arena->index_buf);
+
+   arena->meshes.clear();
+   std::vector<VkdfMesh *>(arena->meshes).swap(arena->meshes);
+
+   g_hash_table_destroy(arena->ranges);
+
+   g_free(arena);
+}
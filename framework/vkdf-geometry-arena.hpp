@@ -0,0 +1,124 @@
+#ifndef __VKDF_GEOMETRY_ARENA_H__
+#define __VKDF_GEOMETRY_ARENA_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-init.hpp"
+#include "vkdf-buffer.hpp"
+#include "vkdf-staging.hpp"
+#include "vkdf-mesh.hpp"
+#include "vkdf-model.hpp"
+
+/**
+ * A vertex buffer shared by all arena meshes with the same vertex stride
+ * and primitive type, so they can all be drawn with the same pipeline
+ * and a single vertex buffer binding.
+ */
+typedef struct {
+   uint32_t stride;
+   VkPrimitiveTopology primitive;
+   uint32_t vertex_count;
+   VkdfBuffer vertex_buf;
+} VkdfGeometryPool;
+
+/**
+ * Location of a mesh in the arena. 'lods' index the arena index buffer
+ * and 'vertex_offset' is the first vertex of the mesh in its pool.
+ */
+typedef struct {
+   uint32_t pool;
+   int32_t vertex_offset;
+   uint32_t num_lods;
+   VkdfMeshLod lods[VKDF_MESH_MAX_LODS];
+} VkdfGeometryRange;
+
+/**
+ * Packs vertex and index data for many meshes into a few large buffers so
+ * that geometry from different meshes and models can be drawn without
+ * rebinding buffers, and with indirect draw commands.
+ *
+ * All meshes share a single index buffer and meshes with the same vertex
+ * stride and primitive type share a vertex buffer. Meshes without indices
+ * get a trivial index list so all arena geometry can be drawn indexed.
+ */
+typedef struct {
+   VkdfContext *ctx;
+
+   std::vector<VkdfMesh *> meshes;
+   GHashTable *ranges;                  // VkdfMesh * -> VkdfGeometryRange *
+
+   std::vector<VkdfGeometryPool> pools;
+   VkdfBuffer index_buf;
+   uint32_t index_count;
+
+   bool built;
+} VkdfGeometryArena;
+
+VkdfGeometryArena *
+vkdf_geometry_arena_new(VkdfContext *ctx);
+
+/**
+ * Registers a mesh with the arena. Meshes can be added more than once,
+ * and only before vkdf_geometry_arena_build().
+ */
+void
+vkdf_geometry_arena_add_mesh(VkdfGeometryArena *arena, VkdfMesh *mesh);
+
+void
+vkdf_geometry_arena_add_model(VkdfGeometryArena *arena, VkdfModel *model);
+
+/**
+ * Creates the arena buffers and uploads the geometry of all registered
+ * meshes. If 'staging' is not NULL the uploads are only recorded there and
+ * the buffers can't be used until it is flushed.
+ */
+void
+vkdf_geometry_arena_build(VkdfGeometryArena *arena,
+                          VkdfStaging *staging = NULL);
+
+void
+vkdf_geometry_arena_free(VkdfGeometryArena *arena);
+
+inline const VkdfGeometryRange *
+vkdf_geometry_arena_lookup(VkdfGeometryArena *arena, VkdfMesh *mesh)
+{
+   return (const VkdfGeometryRange *) g_hash_table_lookup(arena->ranges, mesh);
+}
+
+/**
+ * Returns true if all the meshes in the model are in the arena and live in
+ * the same pool, which is returned in 'pool'.
+ */
+bool
+vkdf_geometry_arena_get_model_pool(VkdfGeometryArena *arena,
+                                   VkdfModel *model,
+                                   uint32_t *pool);
+
+/**
+ * Binds the vertex buffer of the pool to binding 0 and the arena index
+ * buffer.
+ */
+void
+vkdf_geometry_arena_bind(VkdfGeometryArena *arena,
+                         VkCommandBuffer cmd_buf,
+                         uint32_t pool);
+
+/**
+ * Fills an indexed draw command for the requested level of detail of a
+ * mesh, or the coarsest available if it doesn't have that many.
+ */
+inline void
+vkdf_geometry_range_get_draw(const VkdfGeometryRange *range,
+                             uint32_t lod,
+                             uint32_t instance_count,
+                             uint32_t first_instance,
+                             VkDrawIndexedIndirectCommand *draw)
+{
+   lod = MIN2(lod, range->num_lods - 1);
+   draw->indexCount = range->lods[lod].index_count;
+   draw->instanceCount = instance_count;
+   draw->firstIndex = range->lods[lod].first_index;
+   draw->vertexOffset = range->vertex_offset;
+   draw->firstInstance = first_instance;
+}
+
+#endif
@@ -0,0 +1,385 @@
+#include "vkdf-headless.hpp"
+#include "vkdf-init-priv.hpp"
+#include "vkdf-util.hpp"
+#include "vkdf-image.hpp"
+#include "vkdf-buffer.hpp"
+#include "vkdf-memory.hpp"
+#include "vkdf-barrier.hpp"
+#include "vkdf-cmd-buffer.hpp"
+#include "vkdf-semaphore.hpp"
+
+// Same as the triple-buffering we ask for on real swap chains
+#define HEADLESS_SWAP_CHAIN_LENGTH 3
+
+struct _VkdfHeadlessOutput {
+   VkdfImage images[HEADLESS_SWAP_CHAIN_LENGTH];
+
+   // Copies swap chain images to a host-visible buffer
+   struct {
+      VkCommandPool pool;
+      VkCommandBuffer cmd_bufs[HEADLESS_SWAP_CHAIN_LENGTH];
+      VkdfBuffer buf;
+      VkFence fence;
+   } readback;
+
+   struct {
+      char *dir;
+      uint32_t interval;
+   } dump;
+
+   uint64_t frame;                     // Frames presented
+};
+
+typedef struct _VkdfHeadlessOutput VkdfHeadlessOutput;
+
+static VkFormat
+choose_format(VkdfContext *ctx)
+{
+   const VkFormatFeatureFlags features =
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+
+   const VkFormat formats[] = {
+      VK_FORMAT_R8G8B8A8_SRGB,
+      VK_FORMAT_B8G8R8A8_SRGB,
+   };
+
+   for (uint32_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+      VkFormatProperties props;
+      vkGetPhysicalDeviceFormatProperties(ctx->phy_device, formats[i], &props);
+      if ((props.optimalTilingFeatures & features) == features)
+         return formats[i];
+   }
+
+   vkdf_fatal("headless: device can't render to any sRGB8 format");
+   return VK_FORMAT_UNDEFINED;
+}
+
+static void
+record_readback_commands(VkdfContext *ctx,
+                         VkdfHeadlessOutput *h,
+                         uint32_t index)
+{
+   VkCommandBuffer cmd_buf = h->readback.cmd_bufs[index];
+   VkImage image = ctx->swap_chain_images[index].image;
+   VkImageLayout layout = vkdf_get_present_layout(ctx);
+
+   vkdf_command_buffer_begin(cmd_buf, 0);
+
+   // Wait for any rendering or copies to the image submitted before us
+   VkImageSubresourceRange subresource_range =
+      vkdf_create_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1);
+
+   VkImageMemoryBarrier image_barrier =
+      vkdf_create_image_barrier(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                                VK_ACCESS_TRANSFER_READ_BIT,
+                                layout,
+                                layout,
+                                image,
+                                subresource_range);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0,
+                        0, NULL,
+                        0, NULL,
+                        1, &image_barrier);
+
+   VkBufferImageCopy region = {};
+   region.bufferOffset = 0;
+   region.bufferRowLength = 0;
+   region.bufferImageHeight = 0;
+   region.imageSubresource =
+      vkdf_create_image_subresource_layers(VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1);
+   region.imageOffset.x = 0;
+   region.imageOffset.y = 0;
+   region.imageOffset.z = 0;
+   region.imageExtent.width = ctx->width;
+   region.imageExtent.height = ctx->height;
+   region.imageExtent.depth = 1;
+
+   vkCmdCopyImageToBuffer(cmd_buf,
+                          image,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                          h->readback.buf.buf,
+                          1, &region);
+
+   VkBufferMemoryBarrier buf_barrier =
+      vkdf_create_buffer_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
+                                 VK_ACCESS_HOST_READ_BIT,
+                                 h->readback.buf.buf,
+                                 0, VK_WHOLE_SIZE);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_HOST_BIT,
+                        0,
+                        0, NULL,
+                        1, &buf_barrier,
+                        0, NULL);
+
+   vkdf_command_buffer_end(cmd_buf);
+}
+
+static void
+init_readback(VkdfContext *ctx, VkdfHeadlessOutput *h)
+{
+   h->readback.buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         ctx->width * ctx->height * 4,
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+   h->readback.fence = vkdf_create_fence(ctx);
+
+   h->readback.pool = vkdf_create_gfx_command_pool(ctx, 0);
+   vkdf_create_command_buffer(ctx,
+                              h->readback.pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              ctx->swap_chain_length,
+                              h->readback.cmd_bufs);
+
+   for (uint32_t i = 0; i < ctx->swap_chain_length; i++)
+      record_readback_commands(ctx, h, i);
+}
+
+/**
+ * Submits 'cmd_buf', which may be VK_NULL_HANDLE, waiting on 'wait_sem' and
+ * signaling 'signal_sem' if they are not VK_NULL_HANDLE.
+ */
+static void
+submit(VkdfContext *ctx,
+       VkCommandBuffer cmd_buf,
+       VkSemaphore wait_sem,
+       VkSemaphore signal_sem,
+       VkFence fence)
+{
+   VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+   VkSubmitInfo submit_info = { };
+   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+   submit_info.pNext = NULL;
+   submit_info.waitSemaphoreCount = wait_sem ? 1 : 0;
+   submit_info.pWaitSemaphores = &wait_sem;
+   submit_info.pWaitDstStageMask = &wait_stage;
+   submit_info.commandBufferCount = cmd_buf ? 1 : 0;
+   submit_info.pCommandBuffers = &cmd_buf;
+   submit_info.signalSemaphoreCount = signal_sem ? 1 : 0;
+   submit_info.pSignalSemaphores = &signal_sem;
+
+   VK_CHECK(vkQueueSubmit(ctx->gfx_queue, 1, &submit_info, fence));
+}
+
+void
+_init_headless_swap_chain(VkdfContext *ctx)
+{
+   VkdfHeadlessOutput *h = g_new0(VkdfHeadlessOutput, 1);
+   ctx->headless_output = h;
+
+   ctx->surface_format.format = choose_format(ctx);
+   ctx->surface_format.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+   ctx->swap_chain_length = HEADLESS_SWAP_CHAIN_LENGTH;
+   ctx->swap_chain_images = g_new(VkdfSwapChainImage, ctx->swap_chain_length);
+   ctx->acquired_sem = g_new(VkSemaphore, ctx->swap_chain_length);
+   ctx->draw_sem = g_new(VkSemaphore, ctx->swap_chain_length);
+
+   for (uint32_t i = 0; i < ctx->swap_chain_length; i++) {
+      h->images[i] =
+         vkdf_create_image(ctx,
+                           ctx->width,
+                           ctx->height,
+                           1,
+                           VK_IMAGE_TYPE_2D,
+                           ctx->surface_format.format,
+                           VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+                              VK_FORMAT_FEATURE_BLIT_DST_BIT,
+                           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                              VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                           VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_VIEW_TYPE_2D);
+
+      ctx->swap_chain_images[i].image = h->images[i].image;
+      ctx->swap_chain_images[i].view = h->images[i].view;
+
+      ctx->acquired_sem[i] = vkdf_create_semaphore(ctx);
+      ctx->draw_sem[i] = vkdf_create_semaphore(ctx);
+   }
+
+   // Start at the last image, so the first acquire circles back to 0
+   ctx->swap_chain_index = ctx->swap_chain_length - 1;
+
+   /* Images are available as soon as they are presented, so presenting
+    * image N signals the acquire semaphore for image N + 1. The first image
+    * has no previous present, so we signal its semaphore right away.
+    */
+   submit(ctx, VK_NULL_HANDLE, VK_NULL_HANDLE, ctx->acquired_sem[0],
+          VK_NULL_HANDLE);
+
+   init_readback(ctx, h);
+
+   vkdf_info("headless: rendering offscreen at %ux%u\n",
+             ctx->width, ctx->height);
+}
+
+void
+_destroy_headless_swap_chain(VkdfContext *ctx)
+{
+   VkdfHeadlessOutput *h = ctx->headless_output;
+
+   vkFreeCommandBuffers(ctx->device, h->readback.pool,
+                        ctx->swap_chain_length, h->readback.cmd_bufs);
+   vkDestroyCommandPool(ctx->device, h->readback.pool, NULL);
+   vkDestroyFence(ctx->device, h->readback.fence, NULL);
+   vkdf_destroy_buffer(ctx, &h->readback.buf);
+
+   for (uint32_t i = 0; i < ctx->swap_chain_length; i++) {
+      vkDestroySemaphore(ctx->device, ctx->acquired_sem[i], NULL);
+      vkDestroySemaphore(ctx->device, ctx->draw_sem[i], NULL);
+      vkdf_destroy_image(ctx, &h->images[i]);
+   }
+   g_free(ctx->acquired_sem);
+   g_free(ctx->draw_sem);
+   g_free(ctx->swap_chain_images);
+
+   g_free(h->dump.dir);
+   g_free(h);
+   ctx->headless_output = NULL;
+}
+
+void
+_headless_acquire_next_image(VkdfContext *ctx)
+{
+   ctx->swap_chain_index = (ctx->swap_chain_index + 1) % ctx->swap_chain_length;
+}
+
+/**
+ * Waits for the readback of an image to complete and writes it to 'path'
+ * as a binary PPM file.
+ */
+static bool
+write_readback(VkdfContext *ctx, const char *path)
+{
+   VkdfHeadlessOutput *h = ctx->headless_output;
+
+   VK_CHECK(vkWaitForFences(ctx->device, 1, &h->readback.fence,
+                            true, UINT64_MAX));
+   VK_CHECK(vkResetFences(ctx->device, 1, &h->readback.fence));
+
+   const uint32_t num_pixels = ctx->width * ctx->height;
+   const bool bgra = ctx->surface_format.format == VK_FORMAT_B8G8R8A8_SRGB;
+
+   char *header = g_strdup_printf("P6\n%u %u\n255\n", ctx->width, ctx->height);
+   const uint32_t header_size = strlen(header);
+   const uint32_t size = header_size + num_pixels * 3;
+
+   uint8_t *contents = (uint8_t *) g_malloc(size);
+   memcpy(contents, header, header_size);
+   g_free(header);
+
+   uint8_t *pixels;
+   vkdf_memory_map(ctx, h->readback.buf.mem, 0, VK_WHOLE_SIZE,
+                   (void **) &pixels);
+
+   uint8_t *dst = contents + header_size;
+   for (uint32_t i = 0; i < num_pixels; i++) {
+      const uint8_t *src = &pixels[i * 4];
+      dst[0] = src[bgra ? 2 : 0];
+      dst[1] = src[1];
+      dst[2] = src[bgra ? 0 : 2];
+      dst += 3;
+   }
+
+   vkdf_memory_unmap(ctx, h->readback.buf.mem, h->readback.buf.mem_props,
+                     0, VK_WHOLE_SIZE);
+
+   GError *error = NULL;
+   bool result = g_file_set_contents(path, (const gchar *) contents, size,
+                                     &error);
+   if (!result) {
+      vkdf_error("headless: failed to write '%s': %s", path, error->message);
+      g_error_free(error);
+   }
+
+   g_free(contents);
+   return result;
+}
+
+void
+_headless_present_image(VkdfContext *ctx)
+{
+   VkdfHeadlessOutput *h = ctx->headless_output;
+   const uint32_t index = ctx->swap_chain_index;
+   const uint32_t next = (index + 1) % ctx->swap_chain_length;
+
+   const bool dump =
+      h->dump.dir != NULL && h->frame % h->dump.interval == 0;
+
+   // Consume the draw semaphore like the presentation engine would and
+   // make the next image available
+   submit(ctx,
+          dump ? h->readback.cmd_bufs[index] : VK_NULL_HANDLE,
+          ctx->draw_sem[index],
+          ctx->acquired_sem[next],
+          dump ? h->readback.fence : VK_NULL_HANDLE);
+
+   if (dump) {
+      char *name = g_strdup_printf("frame-%06" G_GUINT64_FORMAT ".ppm",
+                                   h->frame);
+      char *path = g_build_filename(h->dump.dir, name, NULL);
+      write_readback(ctx, path);
+      g_free(path);
+      g_free(name);
+   }
+
+   h->frame++;
+}
+
+void
+vkdf_headless_set_frame_dump(VkdfContext *ctx,
+                             const char *dir,
+                             uint32_t interval)
+{
+   assert(ctx->headless);
+
+   VkdfHeadlessOutput *h = ctx->headless_output;
+   g_free(h->dump.dir);
+   h->dump.dir = NULL;
+
+   if (!dir)
+      return;
+
+   if (g_mkdir_with_parents(dir, 0755) != 0) {
+      vkdf_error("headless: can't create directory '%s'.", dir);
+      return;
+   }
+
+   h->dump.dir = g_strdup(dir);
+   h->dump.interval = MAX2(interval, 1u);
+}
+
+bool
+vkdf_headless_dump_last_frame(VkdfContext *ctx, const char *path)
+{
+   assert(ctx->headless);
+
+   VkdfHeadlessOutput *h = ctx->headless_output;
+   if (h->frame == 0) {
+      vkdf_error("headless: no frame has been presented yet.");
+      return false;
+   }
+
+   // The index is only advanced when the next image is acquired
+   submit(ctx,
+          h->readback.cmd_bufs[ctx->swap_chain_index],
+          VK_NULL_HANDLE,
+          VK_NULL_HANDLE,
+          h->readback.fence);
+
+   return write_readback(ctx, path);
+}
@@ -0,0 +1,36 @@
+#ifndef __VKDF_HEADLESS_H__
+#define __VKDF_HEADLESS_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-init.hpp"
+
+/**
+ * Headless contexts (see vkdf_init_headless()) have no window, surface or
+ * swap chain. The swap chain images are regular offscreen images that
+ * applications render (or copy) to as usual, leaving them in
+ * vkdf_get_present_layout(), and "presenting" one just hands it back for
+ * a later frame. Presented frames can be dumped to disk as binary PPM files
+ * for golden-image comparisons.
+ *
+ * Since no presentation engine throttles rendering, the event loop runs as
+ * fast as the GPU allows unless a framerate target is set.
+ */
+
+/**
+ * Dumps every 'interval'-th presented frame to 'dir' as frame-NNNNNN.ppm,
+ * numbered by presented frame. Dumping waits for the GPU to finish the
+ * frame. Pass a NULL 'dir' to stop dumping.
+ */
+void
+vkdf_headless_set_frame_dump(VkdfContext *ctx,
+                             const char *dir,
+                             uint32_t interval);
+
+/**
+ * Writes the last presented image to 'path' as a binary PPM file. Waits for
+ * the GPU to finish rendering it.
+ */
+bool
+vkdf_headless_dump_last_frame(VkdfContext *ctx, const char *path);
+
+#endif
@@ -0,0 +1,150 @@
+#include "vkdf-hiz.hpp"
+#include "vkdf-util.hpp"
+
+VkdfHiZ *
+vkdf_hiz_new(uint32_t width, uint32_t height, uint32_t block)
+{
+   assert(width > 0 && height > 0 && block > 0);
+
+   VkdfHiZ *hiz = g_new0(VkdfHiZ, 1);
+
+   hiz->scale_x = width / (float) block;
+   hiz->scale_y = height / (float) block;
+
+   // Each level halves the one below (rounding up so every texel is
+   // covered) until we reach a single texel
+   uint32_t w = (width + block - 1) / block;
+   uint32_t h = (height + block - 1) / block;
+   uint32_t size = 0;
+   uint32_t l = 0;
+   while (true) {
+      hiz->width[l] = w;
+      hiz->height[l] = h;
+      hiz->offset[l] = size;
+      size += w * h;
+      l++;
+
+      if ((w == 1 && h == 1) || l == VKDF_HIZ_MAX_LEVELS)
+         break;
+
+      w = MAX2((w + 1) / 2, 1);
+      h = MAX2((h + 1) / 2, 1);
+   }
+   hiz->num_levels = l;
+
+   hiz->data.resize(size, 1.0f);
+   hiz->valid = false;
+   hiz->clamp_to_view = false;
+
+   return hiz;
+}
+
+void
+vkdf_hiz_free(VkdfHiZ *hiz)
+{
+   hiz->data.clear();
+   std::vector<float>(hiz->data).swap(hiz->data);
+   g_free(hiz);
+}
+
+void
+vkdf_hiz_update(VkdfHiZ *hiz, const float *depth, const glm::mat4 &view_proj)
+{
+   memcpy(&hiz->data[0], depth,
+          hiz->width[0] * hiz->height[0] * sizeof(float));
+
+   for (uint32_t l = 1; l < hiz->num_levels; l++) {
+      const uint32_t src_w = hiz->width[l - 1];
+      const uint32_t src_h = hiz->height[l - 1];
+      const float *src = &hiz->data[hiz->offset[l - 1]];
+      float *dst = &hiz->data[hiz->offset[l]];
+
+      for (uint32_t y = 0; y < hiz->height[l]; y++) {
+         const uint32_t y0 = 2 * y;
+         const uint32_t y1 = MIN2(2 * y + 1, src_h - 1);
+         for (uint32_t x = 0; x < hiz->width[l]; x++) {
+            const uint32_t x0 = 2 * x;
+            const uint32_t x1 = MIN2(2 * x + 1, src_w - 1);
+            float d = MAX2(src[y0 * src_w + x0], src[y0 * src_w + x1]);
+            d = MAX2(d, src[y1 * src_w + x0]);
+            d = MAX2(d, src[y1 * src_w + x1]);
+            dst[y * hiz->width[l] + x] = d;
+         }
+      }
+   }
+
+   hiz->view_proj = view_proj;
+   hiz->valid = true;
+}
+
+bool
+vkdf_hiz_is_box_occluded(VkdfHiZ *hiz, const VkdfBox *box)
+{
+   if (!hiz->valid)
+      return false;
+
+   // Screen-space bounds and closest depth of the box
+   glm::vec3 ndc_min = glm::vec3(G_MAXFLOAT);
+   glm::vec3 ndc_max = glm::vec3(-G_MAXFLOAT);
+   for (uint32_t i = 0; i < 8; i++) {
+      glm::vec3 p = box->center +
+         glm::vec3((i & 1) ? box->w : -box->w,
+                   (i & 2) ? box->h : -box->h,
+                   (i & 4) ? box->d : -box->d);
+      glm::vec4 clip = hiz->view_proj * glm::vec4(p, 1.0f);
+
+      // Crosses the camera plane
+      if (clip.w <= 1e-5f)
+         return false;
+
+      glm::vec3 ndc = glm::vec3(clip) / clip.w;
+      ndc_min = glm::min(ndc_min, ndc);
+      ndc_max = glm::max(ndc_max, ndc);
+   }
+
+   // Crosses the near plane or is outside the view
+   if (ndc_min.z < 0.0f)
+      return false;
+   if (ndc_max.x < -1.0f || ndc_min.x > 1.0f ||
+       ndc_max.y < -1.0f || ndc_min.y > 1.0f)
+      return false;
+
+   // Partly outside the view the depth was rendered for
+   if (!hiz->clamp_to_view &&
+       (ndc_min.x < -1.0f || ndc_max.x > 1.0f ||
+        ndc_min.y < -1.0f || ndc_max.y > 1.0f))
+      return false;
+
+   // Level 0 texel rectangle covered by the box
+   const int32_t max_x = hiz->width[0] - 1;
+   const int32_t max_y = hiz->height[0] - 1;
+   int32_t x0 = (int32_t) floorf((MAX2(ndc_min.x, -1.0f) * 0.5f + 0.5f) *
+                                 hiz->scale_x);
+   int32_t x1 = (int32_t) floorf((MIN2(ndc_max.x, 1.0f) * 0.5f + 0.5f) *
+                                 hiz->scale_x);
+   int32_t y0 = (int32_t) floorf((MAX2(ndc_min.y, -1.0f) * 0.5f + 0.5f) *
+                                 hiz->scale_y);
+   int32_t y1 = (int32_t) floorf((MIN2(ndc_max.y, 1.0f) * 0.5f + 0.5f) *
+                                 hiz->scale_y);
+   x0 = CLAMP(x0, 0, max_x);
+   x1 = CLAMP(x1, 0, max_x);
+   y0 = CLAMP(y0, 0, max_y);
+   y1 = CLAMP(y1, 0, max_y);
+
+   // Pick the finest level where the rectangle spans at most 4x4 texels
+   uint32_t l = 0;
+   while (l + 1 < hiz->num_levels &&
+          ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3)) {
+      l++;
+   }
+
+   const float *level = &hiz->data[hiz->offset[l]];
+   const uint32_t w = hiz->width[l];
+   float max_depth = 0.0f;
+   for (int32_t y = y0 >> l; y <= (y1 >> l); y++) {
+      for (int32_t x = x0 >> l; x <= (x1 >> l); x++)
+         max_depth = MAX2(max_depth, level[y * w + x]);
+   }
+
+   return ndc_min.z > max_depth;
+}
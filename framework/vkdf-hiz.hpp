@@ -0,0 +1,76 @@
+#ifndef __VKDF_HIZ_H__
+#define __VKDF_HIZ_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-box.hpp"
+
+#define VKDF_HIZ_MAX_LEVELS 16
+
+/**
+ * A hierarchical depth buffer: a pyramid where each texel holds the
+ * farthest depth of the texels it covers in the level below, so a whole
+ * screen region can be tested for occlusion with a few reads.
+ *
+ * Level 0 is built from a depth buffer already reduced to 'block' x 'block'
+ * pixel tiles (see vkdf_hiz_update()). Depth values follow the Vulkan
+ * convention, with 0.0 at the near plane and 1.0 at the far plane.
+ */
+typedef struct {
+   float scale_x;                      // Level 0 texels per NDC unit
+   float scale_y;
+   uint32_t num_levels;
+   uint32_t width[VKDF_HIZ_MAX_LEVELS];
+   uint32_t height[VKDF_HIZ_MAX_LEVELS];
+   uint32_t offset[VKDF_HIZ_MAX_LEVELS];
+   std::vector<float> data;
+
+   glm::mat4 view_proj;                // View-projection of the depth source
+   bool valid;
+
+   // Whether boxes partly outside the view are tested against the part
+   // that is inside it. This is only safe if the depth was rendered for
+   // the same view the boxes are tested for, such as with occluders
+   // rasterized for the current frame. With depth from a previous frame,
+   // the part outside the view may become visible with the new camera.
+   bool clamp_to_view;
+} VkdfHiZ;
+
+/**
+ * Creates a pyramid for a 'width' x 'height' depth buffer where each level 0
+ * texel covers 'block' x 'block' pixels.
+ */
+VkdfHiZ *
+vkdf_hiz_new(uint32_t width, uint32_t height, uint32_t block);
+
+void
+vkdf_hiz_free(VkdfHiZ *hiz);
+
+inline uint32_t
+vkdf_hiz_get_base_width(VkdfHiZ *hiz)
+{
+   return hiz->width[0];
+}
+
+inline uint32_t
+vkdf_hiz_get_base_height(VkdfHiZ *hiz)
+{
+   return hiz->height[0];
+}
+
+/**
+ * Rebuilds the pyramid from 'depth', the farthest depth of each pixel
+ * block in row-major order (top row first), as rendered with 'view_proj'.
+ */
+void
+vkdf_hiz_update(VkdfHiZ *hiz, const float *depth, const glm::mat4 &view_proj);
+
+/**
+ * Returns true if the box (world-space) is fully hidden behind the depth
+ * in the pyramid when seen with the pyramid's view-projection. Boxes that
+ * cross the near plane or fall outside the view are never occluded, and
+ * neither are boxes partly outside the view unless 'clamp_to_view' is set.
+ */
+bool
+vkdf_hiz_is_box_occluded(VkdfHiZ *hiz, const VkdfBox *box);
+
+#endif
@@ -5,6 +5,15 @@
 #include "vkdf-memory.hpp"
 #include "vkdf-barrier.hpp"
 
+/* The SSSE3 paths are compiled for x86 regardless of the -m flags we are
+ * built with and selected at run time, since the default x86-64 target
+ * only guarantees SSE2.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VKDF_IMAGE_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
 VkImage
 create_image(VkdfContext *ctx,
              uint32_t width,
@@ -50,27 +59,23 @@ create_image(VkdfContext *ctx,
    return image;
 }
 
+/**
+ * Render targets get dedicated allocations, everything else (textures)
+ * is sub-allocated from shared memory blocks.
+ */
 static void
 bind_image_memory(VkdfContext *ctx,
                   VkImage image,
                   uint32_t mem_props,
-                  VkDeviceMemory *mem)
+                  bool dedicated,
+                  VkdfMemoryAllocation *alloc)
 {
    VkMemoryRequirements mem_reqs;
    vkGetImageMemoryRequirements(ctx->device, image, &mem_reqs);
 
-   VkMemoryAllocateInfo mem_alloc = {};
-   mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-   mem_alloc.pNext = NULL;
-   mem_alloc.allocationSize = mem_reqs.size;
-   bool result =
-      vkdf_memory_type_from_properties(ctx,
-                                       mem_reqs.memoryTypeBits,
-                                       mem_props,
-                                       &mem_alloc.memoryTypeIndex);
-   assert(result);
-   VK_CHECK(vkAllocateMemory(ctx->device, &mem_alloc, NULL, mem));
-   VK_CHECK(vkBindImageMemory(ctx->device, image, *mem, 0));
+   vkdf_memory_alloc(ctx, &mem_reqs, mem_props,
+                     VKDF_MEMORY_RESOURCE_OPTIMAL, dedicated, alloc);
+   VK_CHECK(vkBindImageMemory(ctx->device, image, alloc->mem, alloc->offset));
 }
 
 static VkImageView
@@ -136,7 +141,12 @@ vkdf_create_image(VkdfContext *ctx,
                               usage_flags,
                               false);
 
-   bind_image_memory(ctx, image.image, mem_props, &image.mem);
+   const VkImageUsageFlags rt_usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+   bind_image_memory(ctx, image.image, mem_props,
+                     (usage_flags & rt_usage) != 0, &image.alloc);
+   image.mem = image.alloc.mem;
 
    image.view = create_image_view(ctx,
                                   VK_IMAGE_VIEW_TYPE_2D,
@@ -156,7 +166,8 @@ vkdf_destroy_image(VkdfContext *ctx, VkdfImage *image)
 {
    vkDestroyImageView(ctx->device, image->view, NULL);
    vkDestroyImage(ctx->device, image->image, NULL);
-   vkFreeMemory(ctx->device, image->mem, NULL);
+   vkdf_memory_free(ctx, &image->alloc);
+   image->mem = 0;
 }
 
 VkImageSubresourceRange
@@ -265,6 +276,9 @@ vkdf_image_set_layout(VkCommandBuffer cmd_buf,
    if (old_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
       src_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+   if (old_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+      src_access_mask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
    if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
       src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
@@ -505,6 +519,98 @@ get_format_feature_flags_from_usage(VkImageUsageFlags usage)
    return flags;
 }
 
+/**
+ * Describes the pixel data for a single layer of an image to upload. The
+ * source can have a row pitch larger than the packed row size and it can
+ * be 24bpp RGB data that we need to expand to 32bpp RGBA on the fly if the
+ * device doesn't support the RGB format.
+ */
+struct _PixelSource {
+   const uint8_t *pixels;
+   uint32_t pitch;
+   uint32_t bpp;
+};
+
+#ifdef VKDF_IMAGE_SSSE3
+/**
+ * SSSE3 version of expand_rgb_to_rgba(). Returns the number of pixels
+ * expanded, the caller takes care of the rest.
+ */
+__attribute__((target("ssse3")))
+static uint32_t
+expand_rgb_to_rgba_ssse3(uint8_t *dst, const uint8_t *src, uint32_t num_pixels)
+{
+   const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                         6, 7, 8, -1, 9, 10, 11, -1);
+   const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+   /* Each iteration loads 16 bytes but only consumes 12 (4 pixels), so stop
+    * early enough that we never read past the end of the source row.
+    */
+   uint32_t i = 0;
+   for (; i + 6 <= num_pixels; i += 4) {
+      __m128i rgb = _mm_loadu_si128((const __m128i *) (src + 3 * i));
+      __m128i rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+      _mm_storeu_si128((__m128i *) (dst + 4 * i), rgba);
+   }
+
+   return i;
+}
+#endif
+
+/**
+ * Expands packed 8-bit RGB pixels to RGBA with alpha set to 0xff. Byte
+ * order is preserved, so the swizzle computed for the RGB source is still
+ * valid for the result.
+ */
+static void
+expand_rgb_to_rgba(uint8_t *dst, const uint8_t *src, uint32_t num_pixels)
+{
+   uint32_t i = 0;
+
+#ifdef VKDF_IMAGE_SSSE3
+   static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+   if (has_ssse3)
+      i = expand_rgb_to_rgba_ssse3(dst, src, num_pixels);
+#endif
+
+   for (; i < num_pixels; i++) {
+      dst[4 * i + 0] = src[3 * i + 0];
+      dst[4 * i + 1] = src[3 * i + 1];
+      dst[4 * i + 2] = src[3 * i + 2];
+      dst[4 * i + 3] = 0xff;
+   }
+}
+
+/**
+ * Writes the pixel data for one layer into (mapped) staging memory, packing
+ * rows and expanding RGB to RGBA as needed. This is the only copy of the
+ * pixel data we do on the CPU side.
+ */
+static void
+write_pixels_to_staging(uint8_t *dst,
+                        uint32_t dst_bpp,
+                        const struct _PixelSource *src,
+                        uint32_t width,
+                        uint32_t height)
+{
+   const uint32_t dst_pitch = width * dst_bpp / 8;
+
+   if (src->bpp == dst_bpp) {
+      if (src->pitch == dst_pitch) {
+         memcpy(dst, src->pixels, (size_t) dst_pitch * height);
+      } else {
+         for (uint32_t y = 0; y < height; y++)
+            memcpy(dst + y * dst_pitch, src->pixels + y * src->pitch, dst_pitch);
+      }
+      return;
+   }
+
+   assert(src->bpp == 24 && dst_bpp == 32);
+   for (uint32_t y = 0; y < height; y++)
+      expand_rgb_to_rgba(dst + y * dst_pitch, src->pixels + y * src->pitch, width);
+}
+
 static void
 create_image_from_data(VkdfContext *ctx,
                        VkCommandPool pool,
@@ -518,7 +624,7 @@ create_image_from_data(VkdfContext *ctx,
                        const VkComponentSwizzle *swz,
                        VkImageUsageFlags usage,
                        bool gen_mipmaps,
-                       const void **pixel_data)
+                       const struct _PixelSource *pixel_data)
 {
    assert(!is_cube || num_layers == 6);
 
@@ -578,7 +684,9 @@ create_image_from_data(VkdfContext *ctx,
    bind_image_memory(ctx,
                      image->image,
                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                     &image->mem);
+                     false,
+                     &image->alloc);
+   image->mem = image->alloc.mem;
 
    image->view = create_image_view(ctx,
                                    is_cube ? VK_IMAGE_VIEW_TYPE_CUBE :
@@ -590,21 +698,55 @@ create_image_from_data(VkdfContext *ctx,
                                    num_levels,
                                    swz[0], swz[1], swz[2], swz[3]);
 
+   // Upload pixel data for all layers to a host-visible staging buffer,
+   // writing directly into the mapped memory
+   const VkDeviceSize layer_bytes = mip_levels[0].bytes;
    VkdfBuffer buf =
       vkdf_create_buffer(ctx,
                          0,
-                         mip_levels[0].bytes,
+                         layer_bytes * num_layers,
                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
+   uint8_t *data;
+   vkdf_memory_map(ctx, buf.mem, 0, VK_WHOLE_SIZE, (void **)&data);
    for (uint32_t i = 0; i < num_layers; i++) {
-      // Upload pixel data to a host-visible staging buffer
-      uint8_t *data;
-      vkdf_memory_map(ctx, buf.mem, 0, VK_WHOLE_SIZE, (void **)&data);
-      memcpy(data, pixel_data[i], mip_levels[0].bytes);
-      vkdf_memory_unmap(ctx, buf.mem, buf.mem_props, 0, VK_WHOLE_SIZE);
+      write_pixels_to_staging(data + i * layer_bytes, bpp,
+                              &pixel_data[i], width, height);
+   }
+   vkdf_memory_unmap(ctx, buf.mem, buf.mem_props, 0, VK_WHOLE_SIZE);
+
+   // Copy data from staging buffer to mip level 0 of each layer and
+   // generate mipmaps in a single command buffer
+   VkCommandBuffer cmd_buf;
+   vkdf_create_command_buffer(ctx, pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &cmd_buf);
+
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   VkImageSubresourceRange mip_0_all_layers =
+      vkdf_create_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT,
+                                          0, 1, 0, num_layers);
+
+   VkImageMemoryBarrier barrier_layout_mip_0 =
+      vkdf_create_image_barrier(0,
+                                VK_ACCESS_TRANSFER_WRITE_BIT,
+                                VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                image->image,
+                                mip_0_all_layers);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0,
+                        0, NULL,
+                        0, NULL,
+                        1, &barrier_layout_mip_0);
 
-      // Copy data from staging buffer to mip level 0
+   for (uint32_t i = 0; i < num_layers; i++) {
       VkBufferImageCopy region = {};
       region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
       region.imageSubresource.mipLevel = 0;
@@ -613,43 +755,17 @@ create_image_from_data(VkdfContext *ctx,
       region.imageExtent.width = width;
       region.imageExtent.height = height;
       region.imageExtent.depth = 1;
-      region.bufferOffset = 0;
-
-
-      VkImageSubresourceRange mip_0 =
-         vkdf_create_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT,
-                                             0, 1, i, 1);
-
-      VkImageMemoryBarrier barrier_layout_mip_0 =
-         vkdf_create_image_barrier(0,
-                                   VK_ACCESS_TRANSFER_WRITE_BIT,
-                                   VK_IMAGE_LAYOUT_UNDEFINED,
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                   image->image,
-                                   mip_0);
-
-      VkCommandBuffer cmd_buf;
-      vkdf_create_command_buffer(ctx, pool,
-                                 VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                                 1, &cmd_buf);
-
-      vkdf_command_buffer_begin(cmd_buf,
-                                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-      vkCmdPipelineBarrier(cmd_buf,
-                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                           VK_PIPELINE_STAGE_TRANSFER_BIT,
-                           0,
-                           0, NULL,
-                           0, NULL,
-                           1, &barrier_layout_mip_0);
+      region.bufferOffset = i * layer_bytes;
 
       vkCmdCopyBufferToImage(cmd_buf, buf.buf, image->image,
                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                              1, &region);
 
-
       if (!gen_mipmaps) {
+         VkImageSubresourceRange mip_0 =
+            vkdf_create_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT,
+                                                0, 1, i, 1);
+
          vkdf_image_set_layout(cmd_buf, image->image, mip_0,
                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
@@ -658,12 +774,11 @@ create_image_from_data(VkdfContext *ctx,
       } else {
          gen_mipmaps_linear_blit(image->image, i, num_levels, mip_levels, cmd_buf);
       }
-
-      vkdf_command_buffer_end(cmd_buf);
-      vkdf_command_buffer_execute_sync(ctx, cmd_buf, 0);
-      vkFreeCommandBuffers(ctx->device, pool, 1, &cmd_buf);
    }
 
+   vkdf_command_buffer_end(cmd_buf);
+   vkdf_command_buffer_execute_sync(ctx, cmd_buf, 0);
+   vkFreeCommandBuffers(ctx->device, pool, 1, &cmd_buf);
 
    vkdf_destroy_buffer(ctx, &buf);
    g_free(mip_levels);
@@ -833,15 +948,6 @@ compute_image_parameters_from_surface(SDL_Surface *surf,
    }
 }
 
-static SDL_Surface *
-convert_rgb_surface_to_rgba(SDL_Surface *rgb)
-{
-   SDL_PixelFormat *format = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA32);
-   SDL_Surface *rgba = SDL_ConvertSurface(rgb, format, 0);
-   SDL_FreeFormat(format);
-   return rgba;
-}
-
 static bool
 needs_rgba_conversion(VkdfContext *ctx, VkFormat format, bool gen_mipmaps)
 {
@@ -862,6 +968,19 @@ needs_rgba_conversion(VkdfContext *ctx, VkFormat format, bool gen_mipmaps)
    return false;
 }
 
+/**
+ * Selects the RGBA format we upload RGB data to when the device can't
+ * use the RGB format. The component swizzle computed for the RGB source
+ * is kept, since expand_rgb_to_rgba() preserves byte order.
+ */
+static inline void
+expand_rgb_format(VkFormat *format, uint32_t *bpp, bool is_srgb)
+{
+   assert(*bpp == 24);
+   *bpp = 32;
+   *format = guess_format_from_bpp(*bpp, is_srgb);
+}
+
 bool
 vkdf_load_image_from_file(VkdfContext *ctx,
                           VkCommandPool pool,
@@ -886,18 +1005,20 @@ vkdf_load_image_from_file(VkdfContext *ctx,
    VkComponentSwizzle swz[4];
    compute_image_parameters_from_surface(surf, &format, &bpp, &is_srgb, swz);
 
-   // Convert RGB to RGBA if needed
-   if (needs_rgba_conversion(ctx, format, gen_mipmaps)) {
-      surf = convert_rgb_surface_to_rgba(surf);
-      compute_image_parameters_from_surface(surf, &format, &bpp, &is_srgb, swz);
-   }
+   struct _PixelSource src;
+   src.pixels = (const uint8_t *) surf->pixels;
+   src.pitch = surf->pitch;
+   src.bpp = bpp;
+
+   // Expand RGB to RGBA while uploading if needed
+   if (needs_rgba_conversion(ctx, format, gen_mipmaps))
+      expand_rgb_format(&format, &bpp, is_srgb);
 
    // Create and initialize image
    create_image_from_data(ctx, pool,
                           image, surf->w, surf->h, 1, false,
                           format, bpp, swz,
-                          usage, gen_mipmaps,
-                          (const void **) &surf->pixels);
+                          usage, gen_mipmaps, &src);
 
    if (out_surf)
       *out_surf = surf;
@@ -925,12 +1046,17 @@ vkdf_create_image_from_data(VkdfContext *ctx,
    VkComponentSwizzle swz[4];
    guess_swizzle_from_format(format, swz);
 
+   struct _PixelSource src;
+   src.pixels = (const uint8_t *) pixel_data;
+   src.pitch = width * bpp / 8;
+   src.bpp = bpp;
+
    create_image_from_data(ctx, pool,
                           image, width, height, 1, false,
                           format, bpp, swz,
                           usage,
                           gen_mipmaps,
-                          &pixel_data);
+                          &src);
 }
 
 bool
@@ -961,27 +1087,25 @@ vkdf_load_cube_image_from_files(VkdfContext *ctx,
    VkComponentSwizzle swz[4];
    compute_image_parameters_from_surface(surf, &format, &bpp, &is_srgb, swz);
 
-   // Convert RGB to RGBA if needed
-   if (needs_rgba_conversion(ctx, format, false)) {
-      for (uint32_t i = 0; i < 6; i++)
-         surfs[i] = convert_rgb_surface_to_rgba(surfs[i]);
-      surf = surfs[0];
-      compute_image_parameters_from_surface(surf, &format, &bpp, &is_srgb, swz);
+   struct _PixelSource src[6];
+   for (uint32_t i = 0; i < 6; i++) {
+      src[i].pixels = (const uint8_t *) surfs[i]->pixels;
+      src[i].pitch = surfs[i]->pitch;
+      src[i].bpp = bpp;
    }
 
+   // Expand RGB to RGBA while uploading if needed
+   if (needs_rgba_conversion(ctx, format, false))
+      expand_rgb_format(&format, &bpp, is_srgb);
+
    // Create and initialize image
-   const void *pixels[6] = {
-      surfs[0]->pixels,
-      surfs[1]->pixels,
-      surfs[2]->pixels,
-      surfs[3]->pixels,
-      surfs[4]->pixels,
-      surfs[5]->pixels,
-   };
    create_image_from_data(ctx, pool,
                           image, surf->w, surf->h, 6, true,
                           format, bpp, swz,
-                          usage, false, pixels);
+                          usage, false, src);
+
+   for (uint32_t i = 0; i < 6; i++)
+      SDL_FreeSurface(surfs[i]);
 
    return true;
 }
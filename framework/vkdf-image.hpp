@@ -3,12 +3,14 @@
 
 #include "vkdf-deps.hpp"
 #include "vkdf-init.hpp"
+#include "vkdf-memory.hpp"
 
 typedef struct {
    VkImage image;
    VkFormat format;
    VkDeviceMemory mem;
    VkImageView view;
+   VkdfMemoryAllocation alloc;
 } VkdfImage;
 
 VkdfImage
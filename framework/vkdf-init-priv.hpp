@@ -4,4 +4,17 @@
 void
 _init_swap_chain(VkdfContext *ctx);
 
+// Headless swap chain, see vkdf-headless.cpp
+void
+_init_headless_swap_chain(VkdfContext *ctx);
+
+void
+_destroy_headless_swap_chain(VkdfContext *ctx);
+
+void
+_headless_acquire_next_image(VkdfContext *ctx);
+
+void
+_headless_present_image(VkdfContext *ctx);
+
 #endif
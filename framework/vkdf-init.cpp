@@ -1,6 +1,9 @@
 #include "vkdf-init.hpp"
 #include "vkdf-init-priv.hpp"
 #include "vkdf-semaphore.hpp"
+#include "vkdf-memory.hpp"
+#include "vkdf-pipeline.hpp"
+#include "vkdf-shader.hpp"
 
 // SDL BEGIN
 #include <SDL2/SDL_syswm.h>
@@ -55,9 +58,13 @@ get_required_extensions(VkdfContext *ctx, bool enable_validation)
 {
    ctx->inst_extension_count = enable_validation ? 1 : 0;
 
-   uint32_t platform_extension_count;
-   const char **platform_extensions =
-      vkdf_platform_get_required_extensions(&platform_extension_count);
+   // Headless contexts don't present, so they don't need surface extensions
+   uint32_t platform_extension_count = 0;
+   const char **platform_extensions = NULL;
+   if (!ctx->headless) {
+      platform_extensions =
+         vkdf_platform_get_required_extensions(&platform_extension_count);
+   }
 
    ctx->inst_extension_count += platform_extension_count;
 
@@ -196,8 +203,8 @@ init_queues(VkdfContext *ctx)
    if (ctx->queue_count == 0)
       vkdf_fatal("Selected Vulkan device does not expose any queues");
 
-   bool *can_present = g_new(bool, ctx->queue_count);
-   for (uint32_t i = 0; i < ctx->queue_count; i++) {
+   bool *can_present = g_new0(bool, ctx->queue_count);
+   for (uint32_t i = 0; !ctx->headless && i < ctx->queue_count; i++) {
       // GLFW does not call vkGetPhysicalDeviceSurfaceSupportKHR and it should.
       // See: https://github.com/glfw/glfw/issues/828
       // can_present[i] =
@@ -224,6 +231,10 @@ init_queues(VkdfContext *ctx)
    if (gfx_queue_index == -1)
       vkdf_fatal("Selected device does not provide a graphics queue");
 
+   // Headless "presentation" happens on the graphics queue
+   if (ctx->headless)
+      pst_queue_index = gfx_queue_index;
+
    if (ctx->pst_queue_index == -1) {
       for (uint32_t i = 0; i < ctx->queue_count; i++) {
          if (can_present[i]) {
@@ -259,6 +270,7 @@ check_extension_supported(VkdfContext *ctx, const char *ext)
 struct _extension_spec {
    const char *name;
    bool required;
+   bool needs_window;                  // Not enabled for headless contexts
 };
 
 static void
@@ -272,8 +284,8 @@ choose_device_extensions(VkdfContext *ctx,
     *       'device_extensions' union.
     */
    static struct _extension_spec extensions[] = {
-      { "VK_KHR_swapchain",            true},
-      { "VK_KHR_maintenance1",         false},
+      { "VK_KHR_swapchain",            true,  true},
+      { "VK_KHR_maintenance1",         false, false},
    };
 
    const uint32_t num_extensions = sizeof(extensions) / sizeof(extensions[0]);
@@ -292,6 +304,9 @@ choose_device_extensions(VkdfContext *ctx,
 
    for (uint32_t i = 0; i < num_extensions; i++) {
       const char *ext = extensions[i].name;
+      if (ctx->headless && extensions[i].needs_window)
+         continue;
+
       if (!check_extension_supported(ctx, ext)) {
          if (extensions[i].required)
             vkdf_fatal("Required extension '%s' not available.\n", ext);
@@ -319,6 +334,17 @@ choose_device_features(VkdfContext *ctx)
     * lighting pass, to prevent the light volumes from being Z-clipped.
     */
    ctx->device_features.depthClamp = ctx->phy_device_features.depthClamp;
+
+   /* Indirect drawing
+    *
+    * Scene geometry arenas can pack all the draws of a tile into a single
+    * indirect draw call. This requires both features, otherwise the draws
+    * are issued one by one from the CPU.
+    */
+   ctx->device_features.multiDrawIndirect =
+      ctx->phy_device_features.multiDrawIndirect;
+   ctx->device_features.drawIndirectFirstInstance =
+      ctx->phy_device_features.drawIndirectFirstInstance;
 }
 
 static void
@@ -692,29 +718,86 @@ set_fps_target_from_env(VkdfContext *ctx)
    ctx->fps_target_from_env = true;
 }
 
-void
-vkdf_init(VkdfContext *ctx,
-          uint32_t width,
-          uint32_t height,
-          bool fullscreen,
-          bool resizable,
-          bool enable_validation)
+static void
+set_geometry_memory_mode(VkdfContext *ctx)
+{
+   ctx->host_visible_geometry =
+      ctx->phy_device_props.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+
+   char *env_str = getenv("VKDF_HOST_VISIBLE_GEOMETRY");
+   if (!env_str)
+      return;
+
+   if (!strcmp(env_str, "1") || !strcmp(env_str, "true")) {
+      ctx->host_visible_geometry = true;
+   } else if (!strcmp(env_str, "0") || !strcmp(env_str, "false")) {
+      ctx->host_visible_geometry = false;
+   } else {
+      vkdf_error("Ignoring unknown VKDF_HOST_VISIBLE_GEOMETRY value '%s'.",
+                 env_str);
+   }
+}
+
+static void
+init_context(VkdfContext *ctx,
+             uint32_t width,
+             uint32_t height,
+             bool headless,
+             bool fullscreen,
+             bool resizable,
+             bool enable_validation)
 {
    if (getenv("VKDF_HOME") == NULL)
       vkdf_fatal("VKDF_HOME environment variable is not set.");
 
    memset(ctx, 0, sizeof(VkdfContext));
+   ctx->headless = headless;
+   ctx->platform.headless = headless;
 
    vkdf_platform_init(&ctx->platform);
 
    init_instance(ctx, enable_validation);
    init_physical_device(ctx);
-   init_window_surface(ctx, width, height, fullscreen, resizable);
+   if (!headless) {
+      init_window_surface(ctx, width, height, fullscreen, resizable);
+   } else {
+      ctx->width = width;
+      ctx->height = height;
+   }
    init_queues(ctx);
    init_logical_device(ctx);
-   _init_swap_chain(ctx);
+   vkdf_memory_allocator_init(ctx);
+   vkdf_pipeline_cache_init(ctx);
+   vkdf_shader_cache_init(ctx);
+   if (!headless)
+      _init_swap_chain(ctx);
+   else
+      _init_headless_swap_chain(ctx);
 
    set_fps_target_from_env(ctx);
+   set_geometry_memory_mode(ctx);
+}
+
+void
+vkdf_init(VkdfContext *ctx,
+          uint32_t width,
+          uint32_t height,
+          bool fullscreen,
+          bool resizable,
+          bool enable_validation)
+{
+   init_context(ctx, width, height, false,
+                fullscreen, resizable, enable_validation);
+}
+
+void
+vkdf_init_headless(VkdfContext *ctx,
+                   uint32_t width,
+                   uint32_t height,
+                   bool enable_validation)
+{
+   assert(width > 0 && height > 0);
+   init_context(ctx, width, height, true, false, false, enable_validation);
 }
 
 static void
@@ -760,13 +843,20 @@ destroy_physical_device_extension_list(VkdfContext *ctx)
 void
 vkdf_cleanup(VkdfContext *ctx)
 {
-   destroy_swap_chain(ctx);
+   if (!ctx->headless)
+      destroy_swap_chain(ctx);
+   else
+      _destroy_headless_swap_chain(ctx);
+   vkdf_memory_allocator_destroy(ctx);
+   vkdf_shader_cache_destroy(ctx);
+   vkdf_pipeline_cache_destroy(ctx);
    destroy_device(ctx);
    destroy_physical_device_list(ctx);
    destroy_queue_list(ctx);
    destroy_instance_extension_list(ctx);
    destroy_physical_device_extension_list(ctx);
-   vkDestroySurfaceKHR(ctx->inst, ctx->platform.surface, NULL);
+   if (!ctx->headless)
+      vkDestroySurfaceKHR(ctx->inst, ctx->platform.surface, NULL);
    vkdf_platform_finish(&ctx->platform);
    destroy_instance(ctx);
 }
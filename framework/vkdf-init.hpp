@@ -11,6 +11,9 @@ typedef struct {
 } VkdfSwapChainImage;
 
 struct _VkdfContext;
+struct _VkdfMemoryAllocator;
+struct _VkdfProfiler;
+struct _VkdfHeadlessOutput;
 
 typedef void (*VkdfRebuildSwapChainCB)(struct _VkdfContext *ctx,
                                        void *user_data);
@@ -51,6 +54,17 @@ struct _VkdfContext {
    } device_extensions;
    VkPhysicalDeviceFeatures device_features;        // Enabled features
 
+   // Device memory sub-allocator (see vkdf-memory.hpp)
+   struct _VkdfMemoryAllocator *mem_allocator;
+
+   // Pipeline cache used by default for all pipelines, persisted to disk
+   // across runs (see vkdf-pipeline.hpp)
+   VkPipelineCache pipeline_cache;
+   char *pipeline_cache_path;
+
+   // Shader modules shared across the application (see vkdf-shader.hpp)
+   GHashTable *shader_cache;
+
    // Window and surface
    VkdfPlatform platform;
    VkSurfaceCapabilitiesKHR surface_caps;
@@ -66,6 +80,11 @@ struct _VkdfContext {
    VkSemaphore *draw_sem;
    uint32_t swap_chain_index;
 
+   // Headless mode (see vkdf_init_headless()): no window, surface or swap
+   // chain, the swap chain images are offscreen images (see vkdf-headless.hpp)
+   bool headless;
+   struct _VkdfHeadlessOutput *headless_output;
+
    // Swap chain rebuild callbacks
    VkdfRebuildSwapChainCB before_rebuild_swap_chain_cb;
    VkdfRebuildSwapChainCB after_rebuild_swap_chain_cb;
@@ -75,6 +94,18 @@ struct _VkdfContext {
    float fps_target;
    double frame_time_budget;
    bool fps_target_from_env;
+
+   // If TRUE, vertex and index buffers live in host-visible memory and are
+   // filled directly instead of going through a staging upload to
+   // device-local memory. Defaults to TRUE for integrated GPUs.
+   bool host_visible_geometry;
+
+   // Frame profiler, NULL unless the application attaches one
+   // (see vkdf-profiler.hpp)
+   struct _VkdfProfiler *profiler;
+
+   // Set by vkdf_event_loop_quit() to leave the event loop
+   bool quit;
 };
 
 typedef struct _VkdfContext VkdfContext;
@@ -87,6 +118,32 @@ vkdf_init(VkdfContext *ctx,
           bool resizable,
           bool enable_validation);
 
+/**
+ * Like vkdf_init(), but without a window. Rendering goes to offscreen
+ * images that take the place of the swap chain images, so applications
+ * work unmodified as long as they don't need input and leave swap chain
+ * images in vkdf_get_present_layout() rather than
+ * VK_IMAGE_LAYOUT_PRESENT_SRC_KHR. This doesn't require
+ * a display or any surface extensions, so it also runs on software
+ * implementations such as lavapipe.
+ */
+void
+vkdf_init_headless(VkdfContext *ctx,
+                   uint32_t width,
+                   uint32_t height,
+                   bool enable_validation);
+
+/**
+ * Layout swap chain images must be in when they are presented. Headless
+ * contexts have no presentation engine and read images back instead.
+ */
+inline VkImageLayout
+vkdf_get_present_layout(VkdfContext *ctx)
+{
+   return ctx->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+                          VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
 inline void
 vkdf_set_framerate_target(VkdfContext *ctx, float target)
 {
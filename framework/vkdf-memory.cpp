@@ -1,4 +1,29 @@
 #include "vkdf-memory.hpp"
+#include "vkdf-util.hpp"
+
+#include <pthread.h>
+
+struct _VkdfMemoryRange {
+   VkDeviceSize offset;
+   VkDeviceSize size;
+};
+
+struct _VkdfMemoryBlock {
+   VkDeviceMemory mem;
+   VkDeviceSize size;
+   VkDeviceSize used;
+   uint32_t num_allocs;
+   uint32_t mem_type;
+   VkdfMemoryResourceType type;
+   GList *free_ranges;   // Sorted by offset, adjacent ranges are merged
+};
+
+struct _VkdfMemoryAllocator {
+   pthread_mutex_t mutex;
+   VkDeviceSize block_size[VK_MAX_MEMORY_TYPES];
+   GList *blocks[VK_MAX_MEMORY_TYPES][VKDF_MEMORY_RESOURCE_COUNT];
+   VkdfMemoryStats stats;
+};
 
 bool
 vkdf_memory_type_from_properties(VkdfContext *ctx,
@@ -19,3 +44,371 @@ vkdf_memory_type_from_properties(VkdfContext *ctx,
 
    return false;
 }
+
+void
+vkdf_memory_allocator_init(VkdfContext *ctx)
+{
+   struct _VkdfMemoryAllocator *a = g_new0(struct _VkdfMemoryAllocator, 1);
+
+   pthread_mutex_init(&a->mutex, NULL);
+
+   // Don't let a single block take a large portion of a small heap
+   const VkPhysicalDeviceMemoryProperties *props = &ctx->phy_device_mem_props;
+   for (uint32_t i = 0; i < props->memoryTypeCount; i++) {
+      uint32_t heap_idx = props->memoryTypes[i].heapIndex;
+      VkDeviceSize heap_size = props->memoryHeaps[heap_idx].size;
+      a->block_size[i] = MIN2(VKDF_MEMORY_BLOCK_SIZE, heap_size / 8);
+   }
+
+   ctx->mem_allocator = a;
+}
+
+static void
+free_block(VkdfContext *ctx, struct _VkdfMemoryBlock *block)
+{
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+
+   vkFreeMemory(ctx->device, block->mem, NULL);
+   g_list_free_full(block->free_ranges, g_free);
+
+   a->stats.block_count--;
+   a->stats.block_bytes -= block->size;
+   a->stats.device_allocation_count--;
+
+   g_free(block);
+}
+
+void
+vkdf_memory_allocator_destroy(VkdfContext *ctx)
+{
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+   if (!a)
+      return;
+
+#if ENABLE_DEBUG
+   vkdf_memory_print_stats(ctx);
+#endif
+
+   if (a->stats.suballocation_count > 0 || a->stats.dedicated_count > 0) {
+      vkdf_info("memory: %u sub-allocations and %u dedicated allocations "
+                "were not freed\n",
+                a->stats.suballocation_count, a->stats.dedicated_count);
+   }
+
+   for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+      for (uint32_t j = 0; j < VKDF_MEMORY_RESOURCE_COUNT; j++) {
+         GList *iter = a->blocks[i][j];
+         while (iter) {
+            free_block(ctx, (struct _VkdfMemoryBlock *) iter->data);
+            iter = g_list_next(iter);
+         }
+         g_list_free(a->blocks[i][j]);
+      }
+   }
+
+   pthread_mutex_destroy(&a->mutex);
+   g_free(a);
+   ctx->mem_allocator = NULL;
+}
+
+static bool
+allocate_device_memory(VkdfContext *ctx,
+                       VkDeviceSize size,
+                       uint32_t mem_type,
+                       VkDeviceMemory *mem)
+{
+   VkMemoryAllocateInfo alloc_info;
+   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+   alloc_info.pNext = NULL;
+   alloc_info.allocationSize = size;
+   alloc_info.memoryTypeIndex = mem_type;
+
+   if (vkAllocateMemory(ctx->device, &alloc_info, NULL, mem) != VK_SUCCESS)
+      return false;
+
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+   a->stats.device_allocation_count++;
+   a->stats.peak_device_allocation_count =
+      MAX2(a->stats.peak_device_allocation_count,
+           a->stats.device_allocation_count);
+
+   return true;
+}
+
+static struct _VkdfMemoryBlock *
+new_block(VkdfContext *ctx, uint32_t mem_type, VkdfMemoryResourceType type)
+{
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+
+   VkDeviceMemory mem;
+   if (!allocate_device_memory(ctx, a->block_size[mem_type], mem_type, &mem))
+      return NULL;
+
+   struct _VkdfMemoryBlock *block = g_new0(struct _VkdfMemoryBlock, 1);
+   block->mem = mem;
+   block->size = a->block_size[mem_type];
+   block->mem_type = mem_type;
+   block->type = type;
+
+   struct _VkdfMemoryRange *range = g_new(struct _VkdfMemoryRange, 1);
+   range->offset = 0;
+   range->size = block->size;
+   block->free_ranges = g_list_prepend(NULL, range);
+
+   a->blocks[mem_type][type] = g_list_append(a->blocks[mem_type][type], block);
+   a->stats.block_count++;
+   a->stats.block_bytes += block->size;
+
+   return block;
+}
+
+/**
+ * First-fit sub-allocation from the free ranges of a block. Alignment
+ * padding in front of the allocation is kept as a free range.
+ */
+static bool
+alloc_from_block(struct _VkdfMemoryBlock *block,
+                 VkDeviceSize size,
+                 VkDeviceSize alignment,
+                 VkDeviceSize *offset)
+{
+   if (block->size - block->used < size)
+      return false;
+
+   GList *iter = block->free_ranges;
+   while (iter) {
+      struct _VkdfMemoryRange *r = (struct _VkdfMemoryRange *) iter->data;
+      VkDeviceSize aligned = ALIGN(r->offset, alignment);
+      VkDeviceSize range_end = r->offset + r->size;
+      VkDeviceSize alloc_end = aligned + size;
+
+      if (alloc_end > range_end) {
+         iter = g_list_next(iter);
+         continue;
+      }
+
+      if (aligned > r->offset) {
+         r->size = aligned - r->offset;
+         if (range_end > alloc_end) {
+            struct _VkdfMemoryRange *tail = g_new(struct _VkdfMemoryRange, 1);
+            tail->offset = alloc_end;
+            tail->size = range_end - alloc_end;
+            block->free_ranges =
+               g_list_insert_before(block->free_ranges, iter->next, tail);
+         }
+      } else if (range_end > alloc_end) {
+         r->offset = alloc_end;
+         r->size = range_end - alloc_end;
+      } else {
+         g_free(r);
+         block->free_ranges = g_list_delete_link(block->free_ranges, iter);
+      }
+
+      block->used += size;
+      block->num_allocs++;
+      *offset = aligned;
+      return true;
+   }
+
+   return false;
+}
+
+static void
+free_to_block(struct _VkdfMemoryBlock *block,
+              VkDeviceSize offset,
+              VkDeviceSize size)
+{
+   // Find the first free range after the one we are releasing
+   GList *next = block->free_ranges;
+   while (next && ((struct _VkdfMemoryRange *) next->data)->offset < offset)
+      next = g_list_next(next);
+
+   GList *prev = next ? g_list_previous(next) : g_list_last(block->free_ranges);
+
+   struct _VkdfMemoryRange *p =
+      prev ? (struct _VkdfMemoryRange *) prev->data : NULL;
+   struct _VkdfMemoryRange *n =
+      next ? (struct _VkdfMemoryRange *) next->data : NULL;
+
+   bool merge_prev = p && p->offset + p->size == offset;
+   bool merge_next = n && offset + size == n->offset;
+
+   if (merge_prev && merge_next) {
+      p->size += size + n->size;
+      g_free(n);
+      block->free_ranges = g_list_delete_link(block->free_ranges, next);
+   } else if (merge_prev) {
+      p->size += size;
+   } else if (merge_next) {
+      n->offset = offset;
+      n->size += size;
+   } else {
+      struct _VkdfMemoryRange *r = g_new(struct _VkdfMemoryRange, 1);
+      r->offset = offset;
+      r->size = size;
+      block->free_ranges = g_list_insert_before(block->free_ranges, next, r);
+   }
+
+   assert(block->used >= size && block->num_allocs > 0);
+   block->used -= size;
+   block->num_allocs--;
+}
+
+static void
+alloc_dedicated(VkdfContext *ctx,
+                const VkMemoryRequirements *reqs,
+                uint32_t mem_type,
+                VkdfMemoryAllocation *alloc)
+{
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+
+   if (!allocate_device_memory(ctx, reqs->size, mem_type, &alloc->mem))
+      vkdf_fatal("memory: failed to allocate %lu bytes of device memory",
+                 (unsigned long) reqs->size);
+
+   alloc->offset = 0;
+   alloc->size = reqs->size;
+   alloc->block = NULL;
+
+   a->stats.dedicated_count++;
+   a->stats.dedicated_bytes += reqs->size;
+}
+
+/**
+ * Allocates device memory for a resource with the given requirements.
+ *
+ * Host-visible memory always gets a dedicated allocation, since
+ * applications map the VkDeviceMemory of their buffers directly at offset 0.
+ * Resources that are large compared to the block size, or that the caller
+ * flags as dedicated (such as render targets), get one too. Everything else
+ * is sub-allocated from a shared block of the same memory type and resource
+ * type. The resource must be bound at alloc->offset.
+ */
+void
+vkdf_memory_alloc(VkdfContext *ctx,
+                  const VkMemoryRequirements *reqs,
+                  uint32_t mem_props,
+                  VkdfMemoryResourceType type,
+                  bool dedicated,
+                  VkdfMemoryAllocation *alloc)
+{
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+   assert(a);
+
+   uint32_t mem_type;
+   bool result =
+      vkdf_memory_type_from_properties(ctx, reqs->memoryTypeBits,
+                                       mem_props, &mem_type);
+   assert(result);
+
+   pthread_mutex_lock(&a->mutex);
+
+   if (dedicated ||
+       (mem_props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ||
+       reqs->size > a->block_size[mem_type] / 2) {
+      alloc_dedicated(ctx, reqs, mem_type, alloc);
+      pthread_mutex_unlock(&a->mutex);
+      return;
+   }
+
+   struct _VkdfMemoryBlock *block = NULL;
+   VkDeviceSize offset;
+
+   GList *iter = a->blocks[mem_type][type];
+   while (iter) {
+      struct _VkdfMemoryBlock *b = (struct _VkdfMemoryBlock *) iter->data;
+      if (alloc_from_block(b, reqs->size, reqs->alignment, &offset)) {
+         block = b;
+         break;
+      }
+      iter = g_list_next(iter);
+   }
+
+   if (!block) {
+      block = new_block(ctx, mem_type, type);
+      if (!block) {
+         // Out of memory for a full block, try to fit just this resource
+         alloc_dedicated(ctx, reqs, mem_type, alloc);
+         pthread_mutex_unlock(&a->mutex);
+         return;
+      }
+
+      result = alloc_from_block(block, reqs->size, reqs->alignment, &offset);
+      assert(result);
+   }
+
+   alloc->mem = block->mem;
+   alloc->offset = offset;
+   alloc->size = reqs->size;
+   alloc->block = block;
+
+   a->stats.suballocation_count++;
+   a->stats.suballocated_bytes += reqs->size;
+
+   pthread_mutex_unlock(&a->mutex);
+}
+
+void
+vkdf_memory_free(VkdfContext *ctx, VkdfMemoryAllocation *alloc)
+{
+   if (!alloc->mem)
+      return;
+
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+   assert(a);
+
+   pthread_mutex_lock(&a->mutex);
+
+   struct _VkdfMemoryBlock *block = alloc->block;
+   if (!block) {
+      vkFreeMemory(ctx->device, alloc->mem, NULL);
+      a->stats.dedicated_count--;
+      a->stats.dedicated_bytes -= alloc->size;
+      a->stats.device_allocation_count--;
+   } else {
+      free_to_block(block, alloc->offset, alloc->size);
+      a->stats.suballocation_count--;
+      a->stats.suballocated_bytes -= alloc->size;
+
+      // Release empty blocks, but keep the last one around to avoid
+      // thrashing when resources are created and destroyed repeatedly
+      GList **blocks = &a->blocks[block->mem_type][block->type];
+      if (block->num_allocs == 0 && g_list_length(*blocks) > 1) {
+         *blocks = g_list_remove(*blocks, block);
+         free_block(ctx, block);
+      }
+   }
+
+   pthread_mutex_unlock(&a->mutex);
+
+   memset(alloc, 0, sizeof(VkdfMemoryAllocation));
+}
+
+void
+vkdf_memory_get_stats(VkdfContext *ctx, VkdfMemoryStats *stats)
+{
+   struct _VkdfMemoryAllocator *a = ctx->mem_allocator;
+   assert(a);
+
+   pthread_mutex_lock(&a->mutex);
+   *stats = a->stats;
+   pthread_mutex_unlock(&a->mutex);
+}
+
+void
+vkdf_memory_print_stats(VkdfContext *ctx)
+{
+   VkdfMemoryStats stats;
+   vkdf_memory_get_stats(ctx, &stats);
+
+   const double MB = 1024.0 * 1024.0;
+   vkdf_info("memory: blocks: %u (%.2f MB, %.2f MB used by %u allocations)\n",
+             stats.block_count, stats.block_bytes / MB,
+             stats.suballocated_bytes / MB, stats.suballocation_count);
+   vkdf_info("memory: dedicated: %u (%.2f MB)\n",
+             stats.dedicated_count, stats.dedicated_bytes / MB);
+   vkdf_info("memory: device allocations: %u (peak: %u, limit: %u)\n",
+             stats.device_allocation_count,
+             stats.peak_device_allocation_count,
+             ctx->phy_device_props.limits.maxMemoryAllocationCount);
+}
@@ -4,11 +4,69 @@
 #include "vkdf-deps.hpp"
 #include "vkdf-init.hpp"
 
+/* Default size of the device memory blocks we sub-allocate from. Resources
+ * larger than half of this get a dedicated allocation instead.
+ */
+#define VKDF_MEMORY_BLOCK_SIZE (64ull * 1024ull * 1024ull)
+
+struct _VkdfMemoryBlock;
+
+/* Linear resources (buffers) and optimal tiling resources (images) are
+ * sub-allocated from separate blocks so we never have to care about
+ * bufferImageGranularity.
+ */
+typedef enum {
+   VKDF_MEMORY_RESOURCE_LINEAR = 0,
+   VKDF_MEMORY_RESOURCE_OPTIMAL,
+   VKDF_MEMORY_RESOURCE_COUNT
+} VkdfMemoryResourceType;
+
+typedef struct {
+   VkDeviceMemory mem;
+   VkDeviceSize offset;
+   VkDeviceSize size;
+   struct _VkdfMemoryBlock *block;     // NULL for dedicated allocations
+} VkdfMemoryAllocation;
+
+typedef struct {
+   uint32_t block_count;               // Live blocks
+   VkDeviceSize block_bytes;           // Bytes reserved by live blocks
+   uint32_t suballocation_count;       // Live allocations inside blocks
+   VkDeviceSize suballocated_bytes;    // Bytes used inside blocks
+   uint32_t dedicated_count;           // Live dedicated allocations
+   VkDeviceSize dedicated_bytes;       // Bytes used by dedicated allocations
+   uint32_t device_allocation_count;   // Live vkAllocateMemory allocations
+   uint32_t peak_device_allocation_count;
+} VkdfMemoryStats;
+
 bool vkdf_memory_type_from_properties(VkdfContext *ctx,
                                       uint32_t type_bits,
                                       VkFlags requirements_mask,
                                       uint32_t *type_index);
 
+void
+vkdf_memory_allocator_init(VkdfContext *ctx);
+
+void
+vkdf_memory_allocator_destroy(VkdfContext *ctx);
+
+void
+vkdf_memory_alloc(VkdfContext *ctx,
+                  const VkMemoryRequirements *reqs,
+                  uint32_t mem_props,
+                  VkdfMemoryResourceType type,
+                  bool dedicated,
+                  VkdfMemoryAllocation *alloc);
+
+void
+vkdf_memory_free(VkdfContext *ctx, VkdfMemoryAllocation *alloc);
+
+void
+vkdf_memory_get_stats(VkdfContext *ctx, VkdfMemoryStats *stats);
+
+void
+vkdf_memory_print_stats(VkdfContext *ctx);
+
 inline void
 vkdf_memory_map(VkdfContext *ctx,
                 VkDeviceMemory mem,
@@ -0,0 +1,259 @@
+#include "vkdf-mesh-lod.hpp"
+
+#include <algorithm>
+
+/* Max. number of grid cells along the longest axis of the mesh */
+#define MAX_GRID_RESOLUTION 1024
+
+/* Symmetric 4x4 error quadric */
+typedef struct {
+   float a00, a01, a02, a11, a12, a22;
+   float b0, b1, b2;
+   float c;
+} Quadric;
+
+static inline void
+quadric_add_plane(Quadric *q, const glm::vec3 &n, float d, float w)
+{
+   q->a00 += w * n.x * n.x;
+   q->a01 += w * n.x * n.y;
+   q->a02 += w * n.x * n.z;
+   q->a11 += w * n.y * n.y;
+   q->a12 += w * n.y * n.z;
+   q->a22 += w * n.z * n.z;
+   q->b0 += w * n.x * d;
+   q->b1 += w * n.y * d;
+   q->b2 += w * n.z * d;
+   q->c += w * d * d;
+}
+
+static inline void
+quadric_add(Quadric *q, const Quadric *o)
+{
+   q->a00 += o->a00; q->a01 += o->a01; q->a02 += o->a02;
+   q->a11 += o->a11; q->a12 += o->a12; q->a22 += o->a22;
+   q->b0 += o->b0; q->b1 += o->b1; q->b2 += o->b2;
+   q->c += o->c;
+}
+
+static inline float
+quadric_error(const Quadric *q, const glm::vec3 &p)
+{
+   float rx = q->a00 * p.x + q->a01 * p.y + q->a02 * p.z;
+   float ry = q->a01 * p.x + q->a11 * p.y + q->a12 * p.z;
+   float rz = q->a02 * p.x + q->a12 * p.y + q->a22 * p.z;
+
+   float e = rx * p.x + ry * p.y + rz * p.z +
+             2.0f * (q->b0 * p.x + q->b1 * p.y + q->b2 * p.z) +
+             q->c;
+
+   return fabsf(e);
+}
+
+static void
+compute_vertex_quadrics(VkdfMesh *mesh, std::vector<Quadric> &quadrics)
+{
+   quadrics.assign(mesh->vertices.size(), Quadric());
+
+   for (uint32_t i = 0; i < mesh->indices.size(); i += 3) {
+      const uint32_t *tri = &mesh->indices[i];
+      const glm::vec3 &p0 = mesh->vertices[tri[0]];
+      const glm::vec3 &p1 = mesh->vertices[tri[1]];
+      const glm::vec3 &p2 = mesh->vertices[tri[2]];
+
+      glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(n);
+      if (area <= 0.0f)
+         continue;
+
+      n /= area;
+      float d = -glm::dot(n, p0);
+
+      for (uint32_t k = 0; k < 3; k++)
+         quadric_add_plane(&quadrics[tri[k]], n, d, area);
+   }
+}
+
+typedef struct {
+   uint64_t cell;
+   uint32_t vertex;
+} CellEntry;
+
+static bool
+cell_entry_cmp(const CellEntry &a, const CellEntry &b)
+{
+   return a.cell < b.cell;
+}
+
+/**
+ * Clusters vertices into cells of the given size, then collapses each
+ * cell into its best representative and writes the surviving triangles
+ * to 'out'. Returns the number of triangles produced.
+ */
+static uint32_t
+simplify_with_grid(VkdfMesh *mesh,
+                   const std::vector<Quadric> &quadrics,
+                   const std::vector<uint32_t> &referenced,
+                   const glm::vec3 &origin,
+                   float cell_size,
+                   std::vector<CellEntry> &cells,
+                   std::vector<uint32_t> &rep,
+                   std::vector<uint32_t> &out)
+{
+   const float inv_cell_size = 1.0f / cell_size;
+
+   cells.resize(referenced.size());
+   for (uint32_t i = 0; i < referenced.size(); i++) {
+      uint32_t v = referenced[i];
+      glm::vec3 g = (mesh->vertices[v] - origin) * inv_cell_size;
+      uint64_t x = (uint64_t) MAX2(g.x, 0.0f);
+      uint64_t y = (uint64_t) MAX2(g.y, 0.0f);
+      uint64_t z = (uint64_t) MAX2(g.z, 0.0f);
+      cells[i].cell = (x << 42) | (y << 21) | z;
+      cells[i].vertex = v;
+   }
+
+   std::sort(cells.begin(), cells.end(), cell_entry_cmp);
+
+   // Pick the vertex that minimizes the cell's quadric error
+   for (uint32_t start = 0; start < cells.size(); ) {
+      uint32_t end = start + 1;
+      while (end < cells.size() && cells[end].cell == cells[start].cell)
+         end++;
+
+      Quadric q;
+      memset(&q, 0, sizeof(q));
+      for (uint32_t i = start; i < end; i++)
+         quadric_add(&q, &quadrics[cells[i].vertex]);
+
+      uint32_t best = cells[start].vertex;
+      float best_error = quadric_error(&q, mesh->vertices[best]);
+      for (uint32_t i = start + 1; i < end; i++) {
+         uint32_t v = cells[i].vertex;
+         float error = quadric_error(&q, mesh->vertices[v]);
+         if (error < best_error) {
+            best_error = error;
+            best = v;
+         }
+      }
+
+      for (uint32_t i = start; i < end; i++)
+         rep[cells[i].vertex] = best;
+
+      start = end;
+   }
+
+   out.clear();
+   for (uint32_t i = 0; i < mesh->indices.size(); i += 3) {
+      uint32_t a = rep[mesh->indices[i + 0]];
+      uint32_t b = rep[mesh->indices[i + 1]];
+      uint32_t c = rep[mesh->indices[i + 2]];
+      if (a == b || b == c || a == c)
+         continue;
+      out.push_back(a);
+      out.push_back(b);
+      out.push_back(c);
+   }
+
+   return out.size() / 3;
+}
+
+void
+vkdf_mesh_clear_lods(VkdfMesh *mesh)
+{
+   assert(mesh->index_buf.buf == 0);
+
+   mesh->lod_indices.clear();
+   std::vector<uint32_t>(mesh->lod_indices).swap(mesh->lod_indices);
+   mesh->num_lods = 0;
+}
+
+uint32_t
+vkdf_mesh_generate_lods(VkdfMesh *mesh, uint32_t num_lods, float reduction)
+{
+   assert(num_lods >= 1 && num_lods <= VKDF_MESH_MAX_LODS);
+   assert(reduction > 0.0f && reduction < 1.0f);
+
+   vkdf_mesh_clear_lods(mesh);
+
+   if (mesh->primitive != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST ||
+       mesh->indices.size() < 3 || num_lods == 1) {
+      return vkdf_mesh_get_num_lods(mesh);
+   }
+
+   const uint32_t base_tri_count = mesh->indices.size() / 3;
+
+   // Only vertices used by the base level take part in clustering
+   std::vector<uint32_t> referenced;
+   std::vector<bool> is_referenced(mesh->vertices.size(), false);
+   glm::vec3 min = mesh->vertices[mesh->indices[0]];
+   glm::vec3 max = min;
+   for (uint32_t i = 0; i < mesh->indices.size(); i++) {
+      uint32_t v = mesh->indices[i];
+      if (is_referenced[v])
+         continue;
+      is_referenced[v] = true;
+      referenced.push_back(v);
+      min = glm::min(min, mesh->vertices[v]);
+      max = glm::max(max, mesh->vertices[v]);
+   }
+
+   glm::vec3 extent = max - min;
+   float max_extent = MAX2(extent.x, MAX2(extent.y, extent.z));
+   if (max_extent <= 0.0f)
+      return vkdf_mesh_get_num_lods(mesh);
+
+   std::vector<Quadric> quadrics;
+   compute_vertex_quadrics(mesh, quadrics);
+
+   std::vector<CellEntry> cells;
+   std::vector<uint32_t> rep(mesh->vertices.size());
+   std::vector<uint32_t> lod, best_lod;
+
+   mesh->lods[0].first_index = 0;
+   mesh->lods[0].index_count = mesh->indices.size();
+   mesh->lods[0].error = 0.0f;
+   mesh->num_lods = 1;
+
+   uint32_t prev_tri_count = base_tri_count;
+   uint32_t max_res = MAX_GRID_RESOLUTION;
+   for (uint32_t l = 1; l < num_lods; l++) {
+      uint32_t target = (uint32_t) (prev_tri_count * reduction);
+      if (target == 0)
+         break;
+
+      // Binary search the finest grid that meets the target triangle count
+      uint32_t lo = 1, hi = max_res;
+      uint32_t best_res = 0, best_count = 0;
+      while (lo <= hi) {
+         uint32_t res = (lo + hi) / 2;
+         uint32_t count =
+            simplify_with_grid(mesh, quadrics, referenced, min,
+                               max_extent / res, cells, rep, lod);
+         if (count <= target) {
+            best_res = res;
+            best_count = count;
+            best_lod.swap(lod);
+            lo = res + 1;
+         } else {
+            hi = res - 1;
+         }
+      }
+
+      if (best_res == 0 || best_count == 0)
+         break;
+
+      mesh->lods[l].first_index =
+         mesh->indices.size() + mesh->lod_indices.size();
+      mesh->lods[l].index_count = best_lod.size();
+      mesh->lods[l].error = (max_extent / best_res) * sqrtf(3.0f);
+      mesh->lod_indices.insert(mesh->lod_indices.end(),
+                               best_lod.begin(), best_lod.end());
+      mesh->num_lods++;
+
+      prev_tri_count = best_count;
+      max_res = best_res;
+   }
+
+   return vkdf_mesh_get_num_lods(mesh);
+}
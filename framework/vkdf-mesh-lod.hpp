@@ -0,0 +1,34 @@
+#ifndef __VKDF_MESH_LOD_H__
+#define __VKDF_MESH_LOD_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-mesh.hpp"
+
+/**
+ * Generates simplified levels of detail for an indexed triangle list mesh.
+ *
+ * 'num_lods' is the total number of levels including the base mesh (at most
+ * VKDF_MESH_MAX_LODS) and each level targets 'reduction' times the triangle
+ * count of the previous one. Fewer levels may be produced if the mesh can't
+ * be simplified any further.
+ *
+ * Simplification is done by vertex clustering on a uniform grid, picking
+ * for each cell the vertex that minimizes the cell's quadric error, so
+ * levels only reference vertices of the base mesh and can share its vertex
+ * buffer. Must be called before the mesh index buffer is filled. Calling
+ * vkdf_mesh_optimize() afterwards also optimizes the generated levels.
+ *
+ * Returns the number of levels available (including the base level).
+ */
+uint32_t
+vkdf_mesh_generate_lods(VkdfMesh *mesh,
+                        uint32_t num_lods,
+                        float reduction = 0.5f);
+
+/**
+ * Drops all levels of detail from the mesh except the base level.
+ */
+void
+vkdf_mesh_clear_lods(VkdfMesh *mesh);
+
+#endif
@@ -0,0 +1,406 @@
+#include "vkdf-mesh-optimize.hpp"
+#include "vkdf-util.hpp"
+
+#include <algorithm>
+
+/* Tuning for Forsyth's vertex cache optimization algorithm */
+#define FORSYTH_CACHE_SIZE           32
+#define FORSYTH_CACHE_DECAY_POWER    1.5f
+#define FORSYTH_LAST_TRI_SCORE       0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE  2.0f
+#define FORSYTH_VALENCE_BOOST_POWER  0.5f
+
+#define NO_VERTEX (~0u)
+
+static inline bool
+is_optimizable(VkdfMesh *mesh)
+{
+   return mesh->primitive == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST &&
+          mesh->indices.size() >= 3 &&
+          mesh->indices.size() % 3 == 0;
+}
+
+/**
+ * Simulates a FIFO cache using timestamps: a vertex is in the cache if
+ * less than 'cache_size' misses happened since it was last loaded.
+ */
+static uint32_t
+count_cache_misses(const std::vector<uint32_t> &indices,
+                   uint32_t vertex_count,
+                   uint32_t cache_size)
+{
+   std::vector<uint32_t> stamp(vertex_count, 0);
+   uint32_t misses = 0;
+   for (uint32_t i = 0; i < indices.size(); i++) {
+      uint32_t v = indices[i];
+      assert(v < vertex_count);
+      if (stamp[v] == 0 || misses - stamp[v] >= cache_size)
+         stamp[v] = ++misses;
+   }
+   return misses;
+}
+
+void
+vkdf_mesh_analyze_vertex_cache(VkdfMesh *mesh,
+                               uint32_t cache_size,
+                               float *acmr,
+                               float *atvr)
+{
+   assert(is_optimizable(mesh));
+
+   uint32_t vertex_count = mesh->vertices.size();
+   uint32_t misses =
+      count_cache_misses(mesh->indices, vertex_count, cache_size);
+
+   if (acmr)
+      *acmr = misses / (float) (mesh->indices.size() / 3);
+   if (atvr)
+      *atvr = misses / (float) vertex_count;
+}
+
+static inline float
+forsyth_vertex_score(int32_t cache_pos, uint32_t active_tris)
+{
+   // Vertices not used by any pending triangle don't contribute
+   if (active_tris == 0)
+      return -1.0f;
+
+   float score = 0.0f;
+   if (cache_pos >= 0) {
+      if (cache_pos < 3) {
+         // Used by the last triangle: fixed score so we don't favor
+         // continuing strips in any particular direction
+         score = FORSYTH_LAST_TRI_SCORE;
+      } else {
+         const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+         score = 1.0f - (cache_pos - 3) * scaler;
+         score = powf(score, FORSYTH_CACHE_DECAY_POWER);
+      }
+   }
+
+   // Favor vertices with few pending triangles so we get rid of them early
+   score += FORSYTH_VALENCE_BOOST_SCALE *
+            powf((float) active_tris, -FORSYTH_VALENCE_BOOST_POWER);
+
+   return score;
+}
+
+static void
+optimize_vertex_cache(std::vector<uint32_t> &indices, uint32_t vertex_count)
+{
+   const uint32_t tri_count = indices.size() / 3;
+
+   // Pending triangles for each vertex
+   std::vector<uint32_t> active(vertex_count, 0);
+   for (uint32_t i = 0; i < indices.size(); i++)
+      active[indices[i]]++;
+
+   std::vector<uint32_t> adj_offset(vertex_count + 1, 0);
+   for (uint32_t v = 0; v < vertex_count; v++)
+      adj_offset[v + 1] = adj_offset[v] + active[v];
+
+   std::vector<uint32_t> adj(indices.size());
+   std::vector<uint32_t> adj_fill(adj_offset.begin(), adj_offset.end() - 1);
+   for (uint32_t t = 0; t < tri_count; t++) {
+      for (uint32_t k = 0; k < 3; k++) {
+         uint32_t v = indices[3 * t + k];
+         adj[adj_fill[v]++] = t;
+      }
+   }
+
+   std::vector<int32_t> cache_pos(vertex_count, -1);
+   std::vector<float> vertex_score(vertex_count);
+   for (uint32_t v = 0; v < vertex_count; v++)
+      vertex_score[v] = forsyth_vertex_score(-1, active[v]);
+
+   std::vector<float> tri_score(tri_count);
+   std::vector<bool> emitted(tri_count, false);
+   int32_t best_tri = -1;
+   float best_score = -1.0f;
+   for (uint32_t t = 0; t < tri_count; t++) {
+      tri_score[t] = vertex_score[indices[3 * t + 0]] +
+                     vertex_score[indices[3 * t + 1]] +
+                     vertex_score[indices[3 * t + 2]];
+      if (tri_score[t] > best_score) {
+         best_score = tri_score[t];
+         best_tri = t;
+      }
+   }
+
+   uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+   uint32_t new_cache[FORSYTH_CACHE_SIZE + 3];
+   uint32_t cache_len = 0;
+
+   std::vector<uint32_t> out;
+   out.reserve(indices.size());
+
+   uint32_t cursor = 0;
+   for (uint32_t n = 0; n < tri_count; n++) {
+      // If none of the triangles using cached vertices are pending we have
+      // to restart somewhere else. Any pending triangle will do, since none
+      // of them benefits from the cache contents.
+      if (best_tri < 0) {
+         while (emitted[cursor])
+            cursor++;
+         best_tri = cursor;
+      }
+
+      const uint32_t t = best_tri;
+      const uint32_t *tri = &indices[3 * t];
+      emitted[t] = true;
+      out.push_back(tri[0]);
+      out.push_back(tri[1]);
+      out.push_back(tri[2]);
+
+      // Remove the triangle from its vertices' pending lists
+      for (uint32_t k = 0; k < 3; k++) {
+         uint32_t v = tri[k];
+         uint32_t *list = &adj[adj_offset[v]];
+         for (uint32_t j = 0; j < active[v]; j++) {
+            if (list[j] == t) {
+               list[j] = list[active[v] - 1];
+               break;
+            }
+         }
+         active[v]--;
+      }
+
+      // Move the triangle's vertices to the front of the LRU cache
+      uint32_t new_len = 0;
+      for (uint32_t k = 0; k < 3; k++)
+         new_cache[new_len++] = tri[k];
+      for (uint32_t i = 0; i < cache_len; i++) {
+         uint32_t v = cache[i];
+         if (v != tri[0] && v != tri[1] && v != tri[2])
+            new_cache[new_len++] = v;
+      }
+
+      // Update scores of all vertices that changed cache position,
+      // including the ones that were just evicted
+      for (uint32_t i = 0; i < new_len; i++) {
+         uint32_t v = new_cache[i];
+         cache_pos[v] = i < FORSYTH_CACHE_SIZE ? (int32_t) i : -1;
+         vertex_score[v] = forsyth_vertex_score(cache_pos[v], active[v]);
+      }
+
+      // Update affected triangle scores and pick the next best triangle
+      best_tri = -1;
+      best_score = -1.0f;
+      for (uint32_t i = 0; i < new_len; i++) {
+         uint32_t v = new_cache[i];
+         const uint32_t *list = &adj[adj_offset[v]];
+         for (uint32_t j = 0; j < active[v]; j++) {
+            uint32_t at = list[j];
+            tri_score[at] = vertex_score[indices[3 * at + 0]] +
+                            vertex_score[indices[3 * at + 1]] +
+                            vertex_score[indices[3 * at + 2]];
+            if (tri_score[at] > best_score) {
+               best_score = tri_score[at];
+               best_tri = at;
+            }
+         }
+      }
+
+      cache_len = MIN2(new_len, FORSYTH_CACHE_SIZE);
+      memcpy(cache, new_cache, cache_len * sizeof(uint32_t));
+   }
+
+   indices.swap(out);
+}
+
+typedef struct {
+   uint32_t start;
+   uint32_t count;
+   float sort_key;
+} TriangleCluster;
+
+static bool
+cluster_sort_cmp(const TriangleCluster &a, const TriangleCluster &b)
+{
+   return a.sort_key > b.sort_key;
+}
+
+/**
+ * Splits the (cache optimized) triangle list at the points where the vertex
+ * cache is restarted, so reordering clusters doesn't hurt cache efficiency
+ * much, and sorts the clusters so that the ones at the outside of the mesh
+ * facing away from its center go first. These are the most likely to
+ * occlude the rest of the mesh.
+ */
+static uint32_t
+optimize_overdraw(VkdfMesh *mesh)
+{
+   std::vector<uint32_t> &indices = mesh->indices;
+   const uint32_t tri_count = indices.size() / 3;
+   const uint32_t vertex_count = mesh->vertices.size();
+   const uint32_t cache_size = VKDF_MESH_OPTIMIZE_ANALYSIS_CACHE_SIZE;
+
+   std::vector<TriangleCluster> clusters;
+   std::vector<uint32_t> stamp(vertex_count, 0);
+   uint32_t misses = 0;
+   for (uint32_t t = 0; t < tri_count; t++) {
+      uint32_t tri_misses = 0;
+      for (uint32_t k = 0; k < 3; k++) {
+         uint32_t v = indices[3 * t + k];
+         if (stamp[v] == 0 || misses - stamp[v] >= cache_size) {
+            stamp[v] = ++misses;
+            tri_misses++;
+         }
+      }
+
+      if (t == 0 || tri_misses == 3) {
+         TriangleCluster c = { t, 0, 0.0f };
+         clusters.push_back(c);
+      }
+      clusters.back().count++;
+   }
+
+   if (clusters.size() <= 1)
+      return clusters.size();
+
+   // Area weighted centroid and normal for each cluster and for the mesh
+   std::vector<glm::vec3> cluster_centroid(clusters.size());
+   std::vector<glm::vec3> cluster_normal(clusters.size());
+   glm::vec3 mesh_centroid = glm::vec3(0.0f);
+   float mesh_area = 0.0f;
+
+   for (uint32_t c = 0; c < clusters.size(); c++) {
+      glm::vec3 centroid = glm::vec3(0.0f);
+      glm::vec3 normal = glm::vec3(0.0f);
+      float area = 0.0f;
+
+      for (uint32_t t = clusters[c].start;
+           t < clusters[c].start + clusters[c].count; t++) {
+         const glm::vec3 &p0 = mesh->vertices[indices[3 * t + 0]];
+         const glm::vec3 &p1 = mesh->vertices[indices[3 * t + 1]];
+         const glm::vec3 &p2 = mesh->vertices[indices[3 * t + 2]];
+
+         glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+         float tri_area = glm::length(n);
+
+         centroid += (p0 + p1 + p2) * (tri_area / 3.0f);
+         normal += n;
+         area += tri_area;
+      }
+
+      mesh_centroid += centroid;
+      mesh_area += area;
+
+      cluster_centroid[c] = area > 0.0f ? centroid / area : centroid;
+      cluster_normal[c] = normal;
+   }
+
+   if (mesh_area > 0.0f)
+      mesh_centroid /= mesh_area;
+
+   for (uint32_t c = 0; c < clusters.size(); c++) {
+      float len = glm::length(cluster_normal[c]);
+      if (len > 0.0f) {
+         clusters[c].sort_key =
+            glm::dot(cluster_centroid[c] - mesh_centroid,
+                     cluster_normal[c] / len);
+      }
+   }
+
+   std::stable_sort(clusters.begin(), clusters.end(), cluster_sort_cmp);
+
+   std::vector<uint32_t> out;
+   out.reserve(indices.size());
+   for (uint32_t c = 0; c < clusters.size(); c++) {
+      out.insert(out.end(),
+                 indices.begin() + 3 * clusters[c].start,
+                 indices.begin() + 3 * (clusters[c].start + clusters[c].count));
+   }
+   indices.swap(out);
+
+   return clusters.size();
+}
+
+template <typename T>
+static void
+remap_attribute(std::vector<T> &data,
+                const std::vector<uint32_t> &remap,
+                uint32_t new_count)
+{
+   if (data.size() == 0)
+      return;
+
+   assert(data.size() == remap.size());
+
+   std::vector<T> out(new_count);
+   for (uint32_t v = 0; v < remap.size(); v++) {
+      if (remap[v] != NO_VERTEX)
+         out[remap[v]] = data[v];
+   }
+   data.swap(out);
+}
+
+/**
+ * Renumbers vertices in order of first use so vertex fetches walk the
+ * vertex buffer linearly.
+ */
+static void
+optimize_vertex_fetch(VkdfMesh *mesh)
+{
+   std::vector<uint32_t> remap(mesh->vertices.size(), NO_VERTEX);
+   uint32_t new_count = 0;
+
+   for (uint32_t i = 0; i < mesh->indices.size(); i++) {
+      uint32_t v = mesh->indices[i];
+      if (remap[v] == NO_VERTEX)
+         remap[v] = new_count++;
+      mesh->indices[i] = remap[v];
+   }
+
+   // LODs only reference vertices used by the base level
+   for (uint32_t i = 0; i < mesh->lod_indices.size(); i++) {
+      assert(remap[mesh->lod_indices[i]] != NO_VERTEX);
+      mesh->lod_indices[i] = remap[mesh->lod_indices[i]];
+   }
+
+   remap_attribute(mesh->vertices, remap, new_count);
+   remap_attribute(mesh->normals, remap, new_count);
+   remap_attribute(mesh->tangents, remap, new_count);
+   remap_attribute(mesh->bitangents, remap, new_count);
+   remap_attribute(mesh->uvs, remap, new_count);
+}
+
+bool
+vkdf_mesh_optimize(VkdfMesh *mesh, VkdfMeshOptimizeStats *stats)
+{
+   assert(mesh->vertex_buf.buf == 0 && mesh->index_buf.buf == 0);
+
+   if (!is_optimizable(mesh))
+      return false;
+
+   VkdfMeshOptimizeStats s;
+   s.vertex_count_before = mesh->vertices.size();
+   s.triangle_count = mesh->indices.size() / 3;
+   vkdf_mesh_analyze_vertex_cache(mesh,
+                                  VKDF_MESH_OPTIMIZE_ANALYSIS_CACHE_SIZE,
+                                  &s.acmr_before, &s.atvr_before);
+
+   optimize_vertex_cache(mesh->indices, mesh->vertices.size());
+   s.cluster_count = optimize_overdraw(mesh);
+
+   // Levels of detail are only optimized for the vertex cache
+   for (uint32_t l = 1; l < mesh->num_lods; l++) {
+      std::vector<uint32_t>::iterator first = mesh->lod_indices.begin() +
+         (mesh->lods[l].first_index - mesh->indices.size());
+      std::vector<uint32_t> lod(first, first + mesh->lods[l].index_count);
+      optimize_vertex_cache(lod, mesh->vertices.size());
+      std::copy(lod.begin(), lod.end(), first);
+   }
+
+   optimize_vertex_fetch(mesh);
+
+   s.vertex_count_after = mesh->vertices.size();
+   vkdf_mesh_analyze_vertex_cache(mesh,
+                                  VKDF_MESH_OPTIMIZE_ANALYSIS_CACHE_SIZE,
+                                  &s.acmr_after, &s.atvr_after);
+
+   if (stats)
+      *stats = s;
+
+   return true;
+}
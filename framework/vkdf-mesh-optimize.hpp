@@ -0,0 +1,57 @@
+#ifndef __VKDF_MESH_OPTIMIZE_H__
+#define __VKDF_MESH_OPTIMIZE_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-mesh.hpp"
+
+/* Post-transform cache size used to evaluate ACMR / ATVR (FIFO) */
+#define VKDF_MESH_OPTIMIZE_ANALYSIS_CACHE_SIZE 16
+
+typedef struct {
+   /* Average cache miss ratio: transformed vertices per triangle */
+   float acmr_before;
+   float acmr_after;
+
+   /* Average transformed to vertex ratio: 1.0 is optimal */
+   float atvr_before;
+   float atvr_after;
+
+   uint32_t vertex_count_before;
+   uint32_t vertex_count_after;
+   uint32_t triangle_count;
+
+   /* Number of triangle clusters reordered to reduce overdraw */
+   uint32_t cluster_count;
+} VkdfMeshOptimizeStats;
+
+/**
+ * Simulates a FIFO post-transform vertex cache of the given size over the
+ * mesh indices and returns the ACMR and ATVR. Only valid for indexed
+ * triangle lists.
+ */
+void
+vkdf_mesh_analyze_vertex_cache(VkdfMesh *mesh,
+                               uint32_t cache_size,
+                               float *acmr,
+                               float *atvr);
+
+/**
+ * Reorders an indexed triangle list mesh for GPU efficiency:
+ *
+ * 1. Triangles are reordered for post-transform vertex cache locality
+ *    (Forsyth's linear-speed algorithm).
+ * 2. Runs of triangles that start at a cache restart are treated as
+ *    clusters and sorted front-to-back from the outside of the mesh in, so
+ *    triangles likely to occlude others are drawn first.
+ * 3. Vertices are renumbered in order of first use and all vertex
+ *    attributes are reordered to match, improving vertex fetch locality.
+ *    Vertices not referenced by any triangle are dropped.
+ *
+ * Must be called before the mesh vertex and index buffers are filled.
+ * Meshes that are not indexed triangle lists are left untouched and false
+ * is returned.
+ */
+bool
+vkdf_mesh_optimize(VkdfMesh *mesh, VkdfMeshOptimizeStats *stats = NULL);
+
+#endif
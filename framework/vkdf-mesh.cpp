@@ -14,6 +14,7 @@ vkdf_mesh_new(VkPrimitiveTopology primitive)
    mesh->uvs = std::vector<glm::vec2>();
 
    mesh->indices = std::vector<uint32_t>();
+   mesh->lod_indices = std::vector<uint32_t>();
 
    mesh->material_idx = -1;
 
@@ -219,37 +220,52 @@ vkdf_mesh_free(VkdfContext *ctx, VkdfMesh *mesh)
    mesh->indices.clear();
    std::vector<uint32_t>(mesh->indices).swap(mesh->indices);
 
-   if (mesh->vertex_buf.buf) {
-      vkDestroyBuffer(ctx->device, mesh->vertex_buf.buf, NULL);
-      vkFreeMemory(ctx->device, mesh->vertex_buf.mem, NULL);
-   }
+   mesh->lod_indices.clear();
+   std::vector<uint32_t>(mesh->lod_indices).swap(mesh->lod_indices);
 
-   if (mesh->index_buf.buf) {
-      vkDestroyBuffer(ctx->device, mesh->index_buf.buf, NULL);
-      vkFreeMemory(ctx->device, mesh->index_buf.mem, NULL);
-   }
+   if (mesh->vertex_buf.buf)
+      vkdf_destroy_buffer(ctx, &mesh->vertex_buf);
+
+   if (mesh->index_buf.buf)
+      vkdf_destroy_buffer(ctx, &mesh->index_buf);
 
    g_free(mesh);
 }
 
+static uint32_t
+get_vertex_attrib_mask(VkdfMesh *mesh)
+{
+   uint32_t mask = 0;
+   if (mesh->vertices.size() > 0)
+      mask |= 1 << VKDF_VERTEX_ATTRIB_POSITION;
+   if (mesh->normals.size() > 0)
+      mask |= 1 << VKDF_VERTEX_ATTRIB_NORMAL;
+   if (mesh->tangents.size() > 0)
+      mask |= 1 << VKDF_VERTEX_ATTRIB_TANGENT;
+   if (mesh->bitangents.size() > 0)
+      mask |= 1 << VKDF_VERTEX_ATTRIB_BITANGENT;
+   if (mesh->uvs.size() > 0)
+      mask |= 1 << VKDF_VERTEX_ATTRIB_UV;
+   if (mesh->material_idx != -1)
+      mask |= 1 << VKDF_VERTEX_ATTRIB_MATERIAL;
+   return mask;
+}
+
+void
+vkdf_mesh_get_vertex_layout(VkdfMesh *mesh, VkdfVertexLayout *layout)
+{
+   assert(mesh->vertices.size() > 0);
+   vkdf_vertex_format_get_layout(&mesh->vertex_format,
+                                 get_vertex_attrib_mask(mesh),
+                                 layout);
+}
+
 static inline uint32_t
 get_vertex_data_stride(VkdfMesh *mesh)
 {
-   uint32_t has_vertices = MIN2(mesh->vertices.size(), 1);
-   uint32_t has_normals = MIN2(mesh->normals.size(), 1);
-   uint32_t has_tangents = MIN2(mesh->tangents.size(), 1) * has_normals;
-   uint32_t has_bitangents = MIN2(mesh->bitangents.size(), 1) * has_normals;
-   uint32_t has_uv = MIN2(mesh->uvs.size(), 1);
-   uint32_t has_material = mesh->material_idx == -1 ? 0 : 1;
-
-   assert(has_vertices);
-
-   return has_vertices   * sizeof(glm::vec3) +
-          has_normals    * sizeof(glm::vec3) +
-          has_tangents   * sizeof(glm::vec3) +
-          has_bitangents * sizeof(glm::vec3) +
-          has_uv         * sizeof(glm::vec2) +
-          has_material   * sizeof(int32_t);
+   VkdfVertexLayout layout;
+   vkdf_mesh_get_vertex_layout(mesh, &layout);
+   return layout.stride;
 }
 
 uint32_t
@@ -266,7 +282,6 @@ get_vertex_data_size(VkdfMesh *mesh)
    uint32_t tangent_count = mesh->tangents.size() * MIN2(normal_count, 1);
    uint32_t bitangent_count = mesh->bitangents.size() * MIN2(normal_count, 1);
    uint32_t uv_count = mesh->uvs.size();
-   uint32_t material_count = (mesh->material_idx == -1 ? 0 : 1) * vertex_count;
 
    assert(vertex_count > 0 &&
           (vertex_count == normal_count || normal_count == 0) &&
@@ -275,12 +290,7 @@ get_vertex_data_size(VkdfMesh *mesh)
           (tangent_count == bitangent_count) &&
           (vertex_count == uv_count || uv_count == 0));
 
-   return vertex_count    * sizeof(glm::vec3) + // pos
-          normal_count    * sizeof(glm::vec3) + // normal
-          tangent_count   * sizeof(glm::vec3) + // tangent
-          bitangent_count * sizeof(glm::vec3) + // bitangent
-          uv_count        * sizeof(glm::vec2) + // uv
-          material_count  * sizeof(int32_t);    // material
+   return (VkDeviceSize) vertex_count * get_vertex_data_stride(mesh);
 }
 
 VkDeviceSize
@@ -289,80 +299,74 @@ vkdf_mesh_get_vertex_data_size(VkdfMesh *mesh)
    return get_vertex_data_size(mesh);
 }
 
+void
+vkdf_mesh_get_vertex_streams(VkdfMesh *mesh,
+                             bool include_tangents,
+                             VkdfVertexStreams *streams)
+{
+   bool has_normals = mesh->normals.size() > 0;
+   bool has_tangents =
+      include_tangents && has_normals && mesh->tangents.size() > 0;
+
+   streams->positions = &mesh->vertices[0];
+   streams->normals = has_normals ? &mesh->normals[0] : NULL;
+   streams->tangents = has_tangents ? &mesh->tangents[0] : NULL;
+   streams->bitangents = has_tangents ? &mesh->bitangents[0] : NULL;
+   streams->uvs = mesh->uvs.size() > 0 ? &mesh->uvs[0] : NULL;
+   streams->material_idx = mesh->material_idx;
+}
+
+void
+vkdf_mesh_write_vertex_data(VkdfMesh *mesh, uint8_t *map)
+{
+   // Interleaved per-vertex attributes (position, normal, tangent,
+   // bitangent, uv, material), encoded as per the mesh vertex format
+   VkdfVertexStreams streams;
+   vkdf_mesh_get_vertex_streams(mesh, true, &streams);
+   vkdf_vertex_format_pack(&mesh->vertex_format, &streams,
+                           mesh->vertices.size(), map);
+}
+
 /**
  * Allocates a device buffer and populates it with vertex data from the
  * mesh in interleaved fashion.
+ *
+ * If 'staging' is not NULL the upload is only recorded there and the
+ * buffer contents are not available until it is flushed. Otherwise the
+ * data is uploaded before returning.
  */
 void
-vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx, VkdfMesh *mesh)
+vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx,
+                             VkdfMesh *mesh,
+                             VkdfStaging *staging)
 {
-   // Interleaved per-vertex attributes (position, normal, uv, material)
    if (mesh->vertex_buf.buf != 0)
       return;
 
    VkDeviceSize vertex_data_size = get_vertex_data_size(mesh);
 
-   mesh->vertex_buf =
-      vkdf_create_buffer(ctx,
-                         0,
-                         vertex_data_size,
-                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VkdfStaging *st = staging;
+   if (!st && !ctx->host_visible_geometry)
+      st = vkdf_staging_new(ctx, vertex_data_size);
 
-   bool has_normals = mesh->normals.size() > 0;
-   bool has_tangents = has_normals && mesh->tangents.size() > 0;
-   bool has_bitangents = has_normals && mesh->bitangents.size() > 0;
-   bool has_uv = mesh->uvs.size() > 0;
-   bool has_material = mesh->material_idx != -1;
+   uint8_t *map =
+      vkdf_staging_create_geometry_buffer(ctx, st,
+                                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                          vertex_data_size,
+                                          &mesh->vertex_buf);
 
-   uint8_t *map;
-   vkdf_memory_map(ctx, mesh->vertex_buf.mem,
-                   0, vertex_data_size, (void **) &map);
+   vkdf_mesh_write_vertex_data(mesh, map);
 
-   for (uint32_t i = 0; i < mesh->vertices.size(); i++) {
-      uint32_t elem_size = sizeof(mesh->vertices[0]);
-      memcpy(map, &mesh->vertices[i], elem_size);
-      map += elem_size;
-
-      if (has_normals) {
-         elem_size = sizeof(mesh->normals[0]);
-         memcpy(map, &mesh->normals[i], elem_size);
-         map += elem_size;
-
-         if (has_tangents) {
-            assert(has_bitangents);
-
-            elem_size = sizeof(mesh->tangents[0]);
-            memcpy(map, &mesh->tangents[i], elem_size);
-            map += elem_size;
-
-            elem_size = sizeof(mesh->bitangents[0]);
-            memcpy(map, &mesh->bitangents[i], elem_size);
-            map += elem_size;
-         }
-      }
-
-      if (has_uv) {
-         elem_size = sizeof(mesh->uvs[0]);
-         memcpy(map, &mesh->uvs[i], elem_size);
-         map += elem_size;
-      }
-
-      if (has_material) {
-         elem_size = sizeof(mesh->material_idx);
-         memcpy(map, &mesh->material_idx, elem_size);
-         map += elem_size;
-      }
-   }
+   vkdf_staging_finish_geometry_buffer(ctx, &mesh->vertex_buf);
 
-   vkdf_memory_unmap(ctx, mesh->vertex_buf.mem, mesh->vertex_buf.mem_props,
-                     0, vertex_data_size);
+   if (st && st != staging)
+      vkdf_staging_free(st);
 }
 
 static inline VkDeviceSize
 get_index_data_size(VkdfMesh *mesh)
 {
-   return mesh->indices.size() * sizeof(uint32_t);
+   return (mesh->indices.size() + mesh->lod_indices.size()) * sizeof(uint32_t);
 }
 
 VkDeviceSize
@@ -371,11 +375,27 @@ vkdf_mesh_get_index_data_size(VkdfMesh *mesh)
    return get_index_data_size(mesh);
 }
 
+void
+vkdf_mesh_write_index_data(VkdfMesh *mesh, uint8_t *map)
+{
+   VkDeviceSize base_size = mesh->indices.size() * sizeof(uint32_t);
+   memcpy(map, &mesh->indices[0], base_size);
+
+   // LOD indices go right after the base level
+   if (mesh->lod_indices.size() > 0) {
+      memcpy(map + base_size, &mesh->lod_indices[0],
+             mesh->lod_indices.size() * sizeof(uint32_t));
+   }
+}
+
 /**
- * Allocates a device buffer and populates it with index data from the mesh
+ * Allocates a device buffer and populates it with index data from the mesh.
+ * See vkdf_mesh_fill_vertex_buffer() for the meaning of 'staging'.
  */
 void
-vkdf_mesh_fill_index_buffer(VkdfContext *ctx, VkdfMesh *mesh)
+vkdf_mesh_fill_index_buffer(VkdfContext *ctx,
+                            VkdfMesh *mesh,
+                            VkdfStaging *staging)
 {
    if (mesh->index_buf.buf != 0)
       return;
@@ -384,21 +404,22 @@ vkdf_mesh_fill_index_buffer(VkdfContext *ctx, VkdfMesh *mesh)
    if (index_data_size == 0)
       return;
 
-   mesh->index_buf =
-      vkdf_create_buffer(ctx,
-                         0,
-                         index_data_size,
-                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VkdfStaging *st = staging;
+   if (!st && !ctx->host_visible_geometry)
+      st = vkdf_staging_new(ctx, index_data_size);
+
+   uint8_t *map =
+      vkdf_staging_create_geometry_buffer(ctx, st,
+                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                          index_data_size,
+                                          &mesh->index_buf);
 
-   uint8_t *map;
-   vkdf_memory_map(ctx, mesh->index_buf.mem,
-                   0, index_data_size, (void **) &map);
+   vkdf_mesh_write_index_data(mesh, map);
 
-   memcpy(map, &mesh->indices[0], index_data_size);
+   vkdf_staging_finish_geometry_buffer(ctx, &mesh->index_buf);
 
-   vkdf_memory_unmap(ctx, mesh->index_buf.mem, mesh->index_buf.mem_props,
-                     0, index_data_size);
+   if (st && st != staging)
+      vkdf_staging_free(st);
 }
 
 void
@@ -460,3 +481,29 @@ vkdf_mesh_draw(VkdfMesh *mesh,
                        first_instance);              // first instance
    }
 }
+
+void
+vkdf_mesh_draw_lod(VkdfMesh *mesh,
+                   VkCommandBuffer cmd_buf,
+                   uint32_t lod,
+                   uint32_t instance_count,
+                   uint32_t first_instance)
+{
+   lod = MIN2(lod, vkdf_mesh_get_num_lods(mesh) - 1);
+   if (lod == 0 || mesh->index_buf.buf == 0) {
+      vkdf_mesh_draw(mesh, cmd_buf, instance_count, first_instance);
+      return;
+   }
+
+   vkCmdBindIndexBuffer(cmd_buf,
+                        mesh->index_buf.buf,         // Buffer
+                        0,                           // Offset
+                        VK_INDEX_TYPE_UINT32);       // Index type
+
+   vkCmdDrawIndexed(cmd_buf,
+                    mesh->lods[lod].index_count,     // index count
+                    instance_count,                  // instance count
+                    mesh->lods[lod].first_index,     // first index
+                    0,                               // first vertex
+                    first_instance);                 // first instance
+}
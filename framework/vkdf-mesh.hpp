@@ -3,8 +3,23 @@
 
 #include "vkdf-deps.hpp"
 #include "vkdf-init.hpp"
+#include "vkdf-util.hpp"
 #include "vkdf-box.hpp"
 #include "vkdf-buffer.hpp"
+#include "vkdf-staging.hpp"
+#include "vkdf-vertex-format.hpp"
+
+#define VKDF_MESH_MAX_LODS 4
+
+/**
+ * A simplified level of detail of a mesh. LODs share the mesh vertex buffer
+ * and live after the base level indices in the mesh index buffer.
+ */
+typedef struct {
+   uint32_t first_index;
+   uint32_t index_count;
+   float error;            /* Max. geometric error (model-space units) */
+} VkdfMeshLod;
 
 typedef struct {
    bool active;
@@ -16,8 +31,16 @@ typedef struct {
    std::vector<glm::vec2> uvs;
    std::vector<uint32_t> indices;
 
+   /* Levels of detail 1..num_lods-1 (level 0 is 'indices') */
+   std::vector<uint32_t> lod_indices;
+   VkdfMeshLod lods[VKDF_MESH_MAX_LODS];
+   uint32_t num_lods;
+
    int32_t material_idx;
-   
+
+   /* Encoding of the vertex buffer data (zero-initialized: full precision) */
+   VkdfVertexFormat vertex_format;
+
    VkdfBuffer vertex_buf;
    VkdfBuffer index_buf;
 
@@ -71,20 +94,61 @@ vkdf_mesh_get_primitive(VkdfMesh *mesh)
    return mesh->primitive;
 }
 
+/**
+ * Selects the encoding used for the mesh vertex buffer. Must be called
+ * before the vertex buffer is filled. Pipelines rendering the mesh should
+ * take their vertex input state from vkdf_mesh_get_vertex_layout().
+ */
+inline void
+vkdf_mesh_set_vertex_format(VkdfMesh *mesh, const VkdfVertexFormat *fmt)
+{
+   assert(mesh->vertex_buf.buf == 0);
+   mesh->vertex_format = *fmt;
+}
+
+void
+vkdf_mesh_get_vertex_layout(VkdfMesh *mesh, VkdfVertexLayout *layout);
+
 VkDeviceSize
 vkdf_mesh_get_vertex_data_size(VkdfMesh *mesh);
 
 uint32_t
 vkdf_mesh_get_vertex_data_stride(VkdfMesh *mesh);
 
+/**
+ * Sets up packer input streams pointing at the mesh vertex data.
+ */
+void
+vkdf_mesh_get_vertex_streams(VkdfMesh *mesh,
+                             bool include_tangents,
+                             VkdfVertexStreams *streams);
+
+/**
+ * Writes vkdf_mesh_get_vertex_data_size() bytes of interleaved vertex data,
+ * encoded as per the mesh vertex format, to 'map'.
+ */
+void
+vkdf_mesh_write_vertex_data(VkdfMesh *mesh, uint8_t *map);
+
 void
-vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx, VkdfMesh *mesh);
+vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx,
+                             VkdfMesh *mesh,
+                             VkdfStaging *staging = NULL);
 
 VkDeviceSize
 vkdf_mesh_get_index_data_size(VkdfMesh *mesh);
 
+/**
+ * Writes vkdf_mesh_get_index_data_size() bytes of index data (base level
+ * followed by LODs) to 'map'.
+ */
+void
+vkdf_mesh_write_index_data(VkdfMesh *mesh, uint8_t *map);
+
 void
-vkdf_mesh_fill_index_buffer(VkdfContext *ctx, VkdfMesh *mesh);
+vkdf_mesh_fill_index_buffer(VkdfContext *ctx,
+                            VkdfMesh *mesh,
+                            VkdfStaging *staging = NULL);
 
 void
 vkdf_mesh_compute_box(VkdfMesh *mesh);
@@ -110,5 +174,22 @@ vkdf_mesh_draw(VkdfMesh *mesh,
                uint32_t instance_count,
                uint32_t first_instance);
 
+inline uint32_t
+vkdf_mesh_get_num_lods(VkdfMesh *mesh)
+{
+   return MAX2(mesh->num_lods, 1);
+}
+
+/**
+ * Like vkdf_mesh_draw() but draws the requested level of detail, or the
+ * coarsest available if the mesh doesn't have that many.
+ */
+void
+vkdf_mesh_draw_lod(VkdfMesh *mesh,
+                   VkCommandBuffer cmd_buf,
+                   uint32_t lod,
+                   uint32_t instance_count,
+                   uint32_t first_instance);
+
 #endif
 
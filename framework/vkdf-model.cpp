@@ -1,5 +1,7 @@
 #include "vkdf-model.hpp"
 #include "vkdf-memory.hpp"
+#include "vkdf-mesh-optimize.hpp"
+#include "vkdf-mesh-lod.hpp"
 
 VkdfModel *
 vkdf_model_new()
@@ -156,8 +158,12 @@ process_node(VkdfModel *model,
       process_node(model, scene, node->mChildren[i], load_uvs, load_tangents);
 }
 
+/**
+ * Texture paths in model files are relative to the model, so we prefix them
+ * with its directory to load models from anywhere.
+ */
 static char *
-fixup_path_str(const char *str)
+fixup_path_str(const char *file, const char *str)
 {
    char *new_str = g_strdup(str);
    char *iter = new_str;
@@ -167,7 +173,15 @@ fixup_path_str(const char *str)
       iter++;
    }
 
-   return new_str;
+   if (g_path_is_absolute(new_str))
+      return new_str;
+
+   char *dir = g_path_get_dirname(file);
+   char *path = g_build_filename(dir, new_str, NULL);
+   g_free(dir);
+   g_free(new_str);
+
+   return path;
 }
 
 static void
@@ -213,7 +227,7 @@ process_material(aiMaterial *material,
                    file, count);
       }
       aiGetMaterialTexture(material, aiTextureType_DIFFUSE, 0, &path);
-      tex_material->diffuse_path = fixup_path_str(path.C_Str());
+      tex_material->diffuse_path = fixup_path_str(file, path.C_Str());
    }
    solid_material->diffuse_tex_count = count;
 
@@ -230,7 +244,7 @@ process_material(aiMaterial *material,
                    file, count);
       }
       aiGetMaterialTexture(material, aiTextureType_SPECULAR, 0, &path);
-      tex_material->specular_path = fixup_path_str(path.C_Str());
+      tex_material->specular_path = fixup_path_str(file, path.C_Str());
    }
    solid_material->specular_tex_count = count;
 
@@ -253,7 +267,7 @@ process_material(aiMaterial *material,
                    file, count);
       }
       aiGetMaterialTexture(material, aiTextureType_NORMALS, 0, &path);
-      tex_material->normal_path = fixup_path_str(path.C_Str());
+      tex_material->normal_path = fixup_path_str(file, path.C_Str());
    }
    solid_material->normal_tex_count = count;
 
@@ -264,7 +278,7 @@ process_material(aiMaterial *material,
                    file, count);
       }
       aiGetMaterialTexture(material, aiTextureType_OPACITY, 0, &path);
-      tex_material->opacity_path = fixup_path_str(path.C_Str());
+      tex_material->opacity_path = fixup_path_str(file, path.C_Str());
    }
    solid_material->opacity_tex_count = count;
 
@@ -324,7 +338,10 @@ create_model_from_scene(const aiScene *scene,
 }
 
 VkdfModel *
-vkdf_model_load(const char *file, bool load_uvs, bool load_tangents)
+vkdf_model_load(const char *file,
+                bool load_uvs,
+                bool load_tangents,
+                bool optimize)
 
 {
    uint32_t flags = aiProcess_CalcTangentSpace |
@@ -346,11 +363,59 @@ vkdf_model_load(const char *file, bool load_uvs, bool load_tangents)
 
    aiReleaseImport(scene);
 
+   if (optimize)
+      vkdf_model_optimize(model);
+
    vkdf_model_compute_box(model);
 
    return model;
 }
 
+void
+vkdf_model_optimize(VkdfModel *model)
+{
+   uint32_t num_optimized = 0;
+   double misses_before = 0.0, misses_after = 0.0;
+   uint32_t vertices_before = 0, vertices_after = 0, triangles = 0;
+
+   for (uint32_t i = 0; i < model->meshes.size(); i++) {
+      VkdfMeshOptimizeStats stats;
+      if (!vkdf_mesh_optimize(model->meshes[i], &stats))
+         continue;
+
+#if ENABLE_DEBUG
+      vkdf_info("model: mesh %u: %u tris, %u clusters, "
+                "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+                i, stats.triangle_count, stats.cluster_count,
+                stats.acmr_before, stats.acmr_after,
+                stats.atvr_before, stats.atvr_after);
+#endif
+
+      num_optimized++;
+      triangles += stats.triangle_count;
+      misses_before += stats.acmr_before * stats.triangle_count;
+      misses_after += stats.acmr_after * stats.triangle_count;
+      vertices_before += stats.vertex_count_before;
+      vertices_after += stats.vertex_count_after;
+   }
+
+   if (num_optimized == 0)
+      return;
+
+   vkdf_info("model: optimized %u meshes (%u tris): "
+             "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+             num_optimized, triangles,
+             misses_before / triangles, misses_after / triangles,
+             misses_before / vertices_before, misses_after / vertices_after);
+}
+
+void
+vkdf_model_generate_lods(VkdfModel *model, uint32_t num_lods, float reduction)
+{
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      vkdf_mesh_generate_lods(model->meshes[i], num_lods, reduction);
+}
+
 void
 vkdf_model_free(VkdfContext *ctx, VkdfModel *model,
                 bool free_material_resources)
@@ -386,21 +451,19 @@ vkdf_model_free(VkdfContext *ctx, VkdfModel *model,
    model->tex_materials.clear();
    std::vector<VkdfTexMaterial>(model->tex_materials).swap(model->tex_materials);
 
-   if (model->vertex_buf.buf) {
-      vkDestroyBuffer(ctx->device, model->vertex_buf.buf, NULL);
-      vkFreeMemory(ctx->device, model->vertex_buf.mem, NULL);
-   }
+   if (model->vertex_buf.buf)
+      vkdf_destroy_buffer(ctx, &model->vertex_buf);
 
-   if (model->index_buf.buf) {
-      vkDestroyBuffer(ctx->device, model->index_buf.buf, NULL);
-      vkFreeMemory(ctx->device, model->index_buf.mem, NULL);
-   }
+   if (model->index_buf.buf)
+      vkdf_destroy_buffer(ctx, &model->index_buf);
 
    g_free(model);
 }
 
 static void
-model_fill_vertex_buffer(VkdfContext *ctx, VkdfModel *model)
+model_fill_vertex_buffer(VkdfContext *ctx,
+                         VkdfModel *model,
+                         VkdfStaging *st)
 {
    assert(model->meshes.size() > 0);
 
@@ -413,58 +476,36 @@ model_fill_vertex_buffer(VkdfContext *ctx, VkdfModel *model)
 
    assert(vertex_data_size > 0);
 
-   model->vertex_buf =
-      vkdf_create_buffer(ctx,
-                         0,
-                         vertex_data_size,
-                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-   uint8_t *map;
-   vkdf_memory_map(ctx, model->vertex_buf.mem,
-                   0, vertex_data_size, (void **) &map);
+   uint8_t *map =
+      vkdf_staging_create_geometry_buffer(ctx, st,
+                                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                          vertex_data_size,
+                                          &model->vertex_buf);
 
-   // Interleaved per-vertex attributes (position, normal, uv, material)
+   // Interleaved per-vertex attributes (position, normal, uv, material),
+   // encoded as per each mesh's vertex format
    VkDeviceSize byte_offset = 0;
    for (uint32_t m = 0; m < model->meshes.size(); m++) {
       VkdfMesh *mesh = model->meshes[m];
-      bool has_normals = mesh->normals.size() > 0;
-      bool has_uv = mesh->uvs.size() > 0;
-      bool has_material = mesh->material_idx != -1;
 
       model->vertex_buf_offsets.push_back(byte_offset);
 
-      for (uint32_t i = 0; i < mesh->vertices.size(); i++) {
-         uint32_t elem_size = sizeof(mesh->vertices[0]);
-         memcpy(map + byte_offset, &mesh->vertices[i], elem_size);
-         byte_offset += elem_size;
-
-         if (has_normals) {
-            elem_size = sizeof(mesh->normals[0]);
-            memcpy(map + byte_offset, &mesh->normals[i], elem_size);
-            byte_offset += elem_size;
-         }
-
-         if (has_uv) {
-            elem_size = sizeof(mesh->uvs[0]);
-            memcpy(map + byte_offset, &mesh->uvs[i], elem_size);
-            byte_offset += elem_size;
-         }
-
-         if (has_material) {
-            elem_size = sizeof(mesh->material_idx);
-            memcpy(map + byte_offset, &mesh->material_idx, elem_size);
-            byte_offset += elem_size;
-         }
-      }
+      VkdfVertexStreams streams;
+      vkdf_mesh_get_vertex_streams(mesh, false, &streams);
+      uint32_t stride = vkdf_vertex_format_pack(&mesh->vertex_format,
+                                                &streams,
+                                                mesh->vertices.size(),
+                                                map + byte_offset);
+      byte_offset += (VkDeviceSize) stride * mesh->vertices.size();
    }
 
-   vkdf_memory_unmap(ctx, model->vertex_buf.mem,
-                     model->vertex_buf.mem_props, 0, vertex_data_size);
+   vkdf_staging_finish_geometry_buffer(ctx, &model->vertex_buf);
 }
 
 static void
-model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
+model_fill_index_buffer(VkdfContext *ctx,
+                        VkdfModel *model,
+                        VkdfStaging *st)
 {
    assert(model->meshes.size() > 0);
 
@@ -477,16 +518,11 @@ model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
 
    assert(index_data_size > 0);
 
-   model->index_buf =
-      vkdf_create_buffer(ctx,
-                         0,
-                         index_data_size,
-                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-   uint8_t *map;
-   vkdf_memory_map(ctx, model->index_buf.mem,
-                   0, index_data_size, (void **) &map);
+   uint8_t *map =
+      vkdf_staging_create_geometry_buffer(ctx, st,
+                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                          index_data_size,
+                                          &model->index_buf);
 
    VkDeviceSize byte_offset = 0;
    for (uint32_t m = 0; m < model->meshes.size(); m++) {
@@ -495,12 +531,11 @@ model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
 
       model->index_buf_offsets.push_back(byte_offset);
 
-      memcpy(map + byte_offset, &mesh->indices[0], mesh_index_data_size);
+      vkdf_mesh_write_index_data(mesh, map + byte_offset);
       byte_offset += mesh_index_data_size;
    }
 
-   vkdf_memory_unmap(ctx, model->index_buf.mem, model->index_buf.mem_props,
-                     0, index_data_size);
+   vkdf_staging_finish_geometry_buffer(ctx, &model->index_buf);
 }
 
 /**
@@ -510,21 +545,34 @@ model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
  * there is a single vertex/index buffer owned by the model
  * (model->vertex/index_buf)itself that packs vertex and index data for all
  * meshes.
+ *
+ * Uploads for all meshes are batched in a single transfer submission. If
+ * 'staging' is not NULL the uploads are only recorded there, so they can be
+ * batched with other models, and the buffers are not ready until it is
+ * flushed.
  */
 void
 vkdf_model_fill_vertex_buffers(VkdfContext *ctx,
                                VkdfModel *model,
-                               bool per_mesh)
+                               bool per_mesh,
+                               VkdfStaging *staging)
 {
+   VkdfStaging *st = staging;
+   if (!st && !ctx->host_visible_geometry)
+      st = vkdf_staging_new(ctx);
+
    if (per_mesh) {
       for (uint32_t i = 0; i < model->meshes.size(); i++) {
-         vkdf_mesh_fill_vertex_buffer(ctx, model->meshes[i]);
-         vkdf_mesh_fill_index_buffer(ctx, model->meshes[i]);
+         vkdf_mesh_fill_vertex_buffer(ctx, model->meshes[i], st);
+         vkdf_mesh_fill_index_buffer(ctx, model->meshes[i], st);
       }
    } else {
-      model_fill_vertex_buffer(ctx, model);
-      model_fill_index_buffer(ctx, model);
+      model_fill_vertex_buffer(ctx, model, st);
+      model_fill_index_buffer(ctx, model, st);
    }
+
+   if (st && st != staging)
+      vkdf_staging_free(st);
 }
 
 void
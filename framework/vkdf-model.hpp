@@ -66,7 +66,8 @@ typedef struct {
 VkdfModel *
 vkdf_model_load(const char *file,
                 bool load_uvs = true,
-                bool load_tangents = true);
+                bool load_tangents = true,
+                bool optimize = false);
 
 VkdfModel *
 vkdf_model_new();
@@ -111,10 +112,37 @@ vkdf_model_add_texture_material(VkdfModel *model,
    model->tex_materials.push_back(*tex_material);
 }
 
+/**
+ * Selects the vertex encoding for all meshes in the model. Must be called
+ * before the vertex buffers are filled.
+ */
+inline void
+vkdf_model_set_vertex_format(VkdfModel *model, const VkdfVertexFormat *fmt)
+{
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      vkdf_mesh_set_vertex_format(model->meshes[i], fmt);
+}
+
 void
 vkdf_model_fill_vertex_buffers(VkdfContext *ctx,
                                VkdfModel *model,
-                               bool per_mesh);
+                               bool per_mesh,
+                               VkdfStaging *staging = NULL);
+
+/**
+ * Runs vkdf_mesh_optimize() on all meshes in the model and logs the vertex
+ * cache efficiency gains (per-mesh details only in debug builds).
+ */
+void
+vkdf_model_optimize(VkdfModel *model);
+
+/**
+ * Runs vkdf_mesh_generate_lods() on all meshes in the model.
+ */
+void
+vkdf_model_generate_lods(VkdfModel *model,
+                         uint32_t num_lods,
+                         float reduction = 0.5f);
 
 void
 vkdf_model_compute_box(VkdfModel *model);
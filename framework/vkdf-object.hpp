@@ -39,6 +39,12 @@ typedef struct {
    bool receives_shadows;
    bool casts_shadows;
 
+   // Rendered by the scene's software occlusion rasterizer
+   bool is_occluder;
+
+   // Level of detail selected by the scene (only for dynamic objects)
+   uint32_t lod;
+
    union {
       uint32_t u32[4];
       int32_t  i32[4];
@@ -163,6 +169,23 @@ vkdf_object_receives_shadows(VkdfObject *obj)
    return obj->receives_shadows;
 }
 
+/**
+ * Occluders are rasterized on the CPU to cull geometry behind them (see
+ * vkdf_scene_enable_sw_occlusion_culling()). Good occluders are large
+ * objects with simple geometry, such as walls and floors.
+ */
+inline void
+vkdf_object_set_occluder(VkdfObject *obj, bool occluder)
+{
+   obj->is_occluder = occluder;
+}
+
+inline bool
+vkdf_object_is_occluder(VkdfObject *obj)
+{
+   return obj->is_occluder;
+}
+
 inline void
 vkdf_object_set_dirty(VkdfObject *obj, bool dirty)
 {
@@ -1,5 +1,169 @@
 #include "vkdf-pipeline.hpp"
 
+#define PIPELINE_CACHE_MAGIC   0x564b4443    // 'VKDC'
+#define PIPELINE_CACHE_VERSION 1
+
+/* Header of the pipeline cache file. The driver validates its own data too,
+ * but checking the device and driver ourselves lets us discard stale caches
+ * (such as after a driver update) without relying on that.
+ */
+struct PipelineCacheHeader {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t vendor_id;
+   uint32_t device_id;
+   uint32_t driver_version;
+   uint8_t uuid[VK_UUID_SIZE];
+   uint64_t data_size;
+};
+
+static void
+fill_pipeline_cache_header(VkdfContext *ctx,
+                           struct PipelineCacheHeader *header,
+                           uint64_t data_size)
+{
+   memset(header, 0, sizeof(struct PipelineCacheHeader));
+   header->magic = PIPELINE_CACHE_MAGIC;
+   header->version = PIPELINE_CACHE_VERSION;
+   header->vendor_id = ctx->phy_device_props.vendorID;
+   header->device_id = ctx->phy_device_props.deviceID;
+   header->driver_version = ctx->phy_device_props.driverVersion;
+   memcpy(header->uuid, ctx->phy_device_props.pipelineCacheUUID, VK_UUID_SIZE);
+   header->data_size = data_size;
+}
+
+static char *
+get_pipeline_cache_path(VkdfContext *ctx)
+{
+   const char *env_str = getenv("VKDF_PIPELINE_CACHE");
+   if (env_str && (!strcmp(env_str, "0") || !strcmp(env_str, "false")))
+      return NULL;
+
+   const char *dir = getenv("VKDF_PIPELINE_CACHE_DIR");
+   char *cache_dir = dir ? g_strdup(dir) :
+      g_build_filename(g_get_user_cache_dir(), "vkdf", NULL);
+
+   if (g_mkdir_with_parents(cache_dir, 0755) != 0) {
+      vkdf_error("pipeline-cache: can't create directory '%s'.", cache_dir);
+      g_free(cache_dir);
+      return NULL;
+   }
+
+   // One file per device so multi-GPU systems don't evict each other's cache
+   char uuid[2 * VK_UUID_SIZE + 1];
+   for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+      snprintf(&uuid[2 * i], 3, "%02x",
+               ctx->phy_device_props.pipelineCacheUUID[i]);
+   }
+
+   char *name = g_strdup_printf("pipeline-cache-%04x-%04x-%s.bin",
+                                ctx->phy_device_props.vendorID,
+                                ctx->phy_device_props.deviceID,
+                                uuid);
+   char *path = g_build_filename(cache_dir, name, NULL);
+   g_free(name);
+   g_free(cache_dir);
+
+   return path;
+}
+
+/**
+ * Returns the cache data in the file at 'path' if it was created for the
+ * same device and driver, or NULL otherwise.
+ */
+static uint8_t *
+load_pipeline_cache_data(VkdfContext *ctx, const char *path, size_t *size)
+{
+   gchar *contents;
+   gsize length;
+   if (!g_file_get_contents(path, &contents, &length, NULL))
+      return NULL;
+
+   struct PipelineCacheHeader expected, header;
+   if (length >= sizeof(header)) {
+      memcpy(&header, contents, sizeof(header));
+      fill_pipeline_cache_header(ctx, &expected, length - sizeof(header));
+      if (memcmp(&header, &expected, sizeof(header)) == 0) {
+         *size = header.data_size;
+         uint8_t *data = g_new(uint8_t, *size);
+         memcpy(data, contents + sizeof(header), *size);
+         g_free(contents);
+         return data;
+      }
+   }
+
+   vkdf_info("pipeline-cache: discarding stale cache '%s'.\n", path);
+   g_free(contents);
+   return NULL;
+}
+
+void
+vkdf_pipeline_cache_init(VkdfContext *ctx)
+{
+   ctx->pipeline_cache_path = get_pipeline_cache_path(ctx);
+
+   size_t size = 0;
+   uint8_t *data = NULL;
+   if (ctx->pipeline_cache_path)
+      data = load_pipeline_cache_data(ctx, ctx->pipeline_cache_path, &size);
+
+   VkPipelineCacheCreateInfo info;
+   info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+   info.pNext = NULL;
+   info.flags = 0;
+   info.initialDataSize = size;
+   info.pInitialData = data;
+
+   VK_CHECK(vkCreatePipelineCache(ctx->device, &info, NULL,
+                                  &ctx->pipeline_cache));
+
+   if (data) {
+      vkdf_info("pipeline-cache: loaded %.2f KB from '%s'.\n",
+                size / 1024.0f, ctx->pipeline_cache_path);
+   }
+
+   g_free(data);
+}
+
+void
+vkdf_pipeline_cache_save(VkdfContext *ctx)
+{
+   if (!ctx->pipeline_cache_path)
+      return;
+
+   size_t size;
+   VK_CHECK(vkGetPipelineCacheData(ctx->device, ctx->pipeline_cache,
+                                   &size, NULL));
+
+   uint8_t *contents = g_new(uint8_t, sizeof(struct PipelineCacheHeader) + size);
+   VK_CHECK(vkGetPipelineCacheData(ctx->device, ctx->pipeline_cache, &size,
+                                   contents + sizeof(struct PipelineCacheHeader)));
+
+   struct PipelineCacheHeader header;
+   fill_pipeline_cache_header(ctx, &header, size);
+   memcpy(contents, &header, sizeof(header));
+
+   // Written to a temporary file and renamed, so concurrent runs never
+   // see a partial cache
+   if (!g_file_set_contents(ctx->pipeline_cache_path, (const gchar *) contents,
+                            sizeof(header) + size, NULL)) {
+      vkdf_error("pipeline-cache: can't write '%s'.",
+                 ctx->pipeline_cache_path);
+   }
+
+   g_free(contents);
+}
+
+void
+vkdf_pipeline_cache_destroy(VkdfContext *ctx)
+{
+   vkdf_pipeline_cache_save(ctx);
+   vkDestroyPipelineCache(ctx->device, ctx->pipeline_cache, NULL);
+   ctx->pipeline_cache = VK_NULL_HANDLE;
+   g_free(ctx->pipeline_cache_path);
+   ctx->pipeline_cache_path = NULL;
+}
+
 VkPipeline
 vkdf_create_gfx_pipeline(VkdfContext *ctx,
                          VkPipelineCache *pipeline_cache,
@@ -164,7 +328,8 @@ vkdf_create_gfx_pipeline(VkdfContext *ctx,
    pipeline_info.subpass = 0;
 
    VK_CHECK(vkCreateGraphicsPipelines(ctx->device,
-                                      pipeline_cache ? *pipeline_cache : NULL,
+                                      pipeline_cache ? *pipeline_cache :
+                                         ctx->pipeline_cache,
                                       1,
                                       &pipeline_info,
                                       NULL,
@@ -213,3 +378,33 @@ vkdf_create_gfx_pipeline(VkdfContext *ctx,
                                    &vs_info,
                                    fs_module ? &fs_info : NULL);
 }
+
+VkPipeline
+vkdf_create_compute_pipeline(VkdfContext *ctx,
+                             VkPipelineCache *pipeline_cache,
+                             VkPipelineLayout pipeline_layout,
+                             VkShaderModule cs_module,
+                             const VkSpecializationInfo *si)
+{
+   VkComputePipelineCreateInfo pipeline_info;
+   pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+   pipeline_info.pNext = NULL;
+   pipeline_info.flags = 0;
+   pipeline_info.layout = pipeline_layout;
+   pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+   pipeline_info.basePipelineIndex = 0;
+   vkdf_pipeline_fill_shader_stage_info(&pipeline_info.stage,
+                                        VK_SHADER_STAGE_COMPUTE_BIT,
+                                        cs_module, si);
+
+   VkPipeline pipeline;
+   VK_CHECK(vkCreateComputePipelines(ctx->device,
+                                     pipeline_cache ? *pipeline_cache :
+                                         ctx->pipeline_cache,
+                                     1,
+                                     &pipeline_info,
+                                     NULL,
+                                     &pipeline));
+
+   return pipeline;
+}
@@ -4,6 +4,26 @@
 #include "vkdf-deps.hpp"
 #include "vkdf-init.hpp"
 
+/**
+ * Creates the context's pipeline cache, loading its contents from the
+ * previous run on the same device and driver if available. Pipelines
+ * created with a NULL cache use it. The cache is stored in the user's cache
+ * directory (or VKDF_PIPELINE_CACHE_DIR), and setting VKDF_PIPELINE_CACHE=0
+ * disables persistence.
+ */
+void
+vkdf_pipeline_cache_init(VkdfContext *ctx);
+
+/**
+ * Writes the contents of the context's pipeline cache to disk. This is done
+ * automatically on vkdf_cleanup().
+ */
+void
+vkdf_pipeline_cache_save(VkdfContext *ctx);
+
+void
+vkdf_pipeline_cache_destroy(VkdfContext *ctx);
+
 VkPipeline
 vkdf_create_gfx_pipeline(VkdfContext *ctx,
                          VkPipelineCache *cache,
@@ -38,6 +58,13 @@ vkdf_create_gfx_pipeline(VkdfContext *ctx,
                          const VkPipelineShaderStageCreateInfo *vs_info,
                          const VkPipelineShaderStageCreateInfo *fs_info);
 
+VkPipeline
+vkdf_create_compute_pipeline(VkdfContext *ctx,
+                             VkPipelineCache *cache,
+                             VkPipelineLayout pipeline_layout,
+                             VkShaderModule cs_module,
+                             const VkSpecializationInfo *si = NULL);
+
 static inline void
 vkdf_pipeline_fill_shader_stage_info(VkPipelineShaderStageCreateInfo *info,
                                      VkShaderStageFlagBits stage,
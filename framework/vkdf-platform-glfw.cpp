@@ -14,14 +14,22 @@ static const uint32_t glfw_key_map[] = {
    GLFW_KEY_L,
 };
 
+// GLFW needs a display to initialize, so headless platforms don't
+static bool glfw_initialized = false;
+
 static void
 platform_init(VkdfPlatform *platform)
 {
+   if (platform->headless)
+      return;
+
    if (!glfwInit())
       vkdf_fatal("Failed to initialize GLFW platforms");
 
    if (!glfwVulkanSupported())
       vkdf_fatal("GLFW Vulkan support unavailable");
+
+   glfw_initialized = true;
 }
 
 void
@@ -86,13 +94,19 @@ vkdf_platform_get_required_extensions(uint32_t *count)
 void
 vkdf_platform_finish(VkdfPlatform *platform)
 {
+   if (platform->headless)
+      return;
+
    glfwDestroyWindow(platform->window);
    glfwTerminate();
+   glfw_initialized = false;
 }
 
 double
 vkdf_platform_get_time()
 {
+   if (!glfw_initialized)
+      return g_get_monotonic_time() / 1000000.0;
    return glfwGetTime();
 }
 
@@ -113,6 +127,9 @@ vkdf_platform_get_framebuffer_size(VkdfPlatform *platform,
 bool
 vkdf_platform_should_quit(VkdfPlatform *platform)
 {
+   if (platform->headless)
+      return false;
+
    return glfwGetKey(platform->window, GLFW_KEY_ESCAPE) == GLFW_PRESS ||
           glfwWindowShouldClose(platform->window);
 }
@@ -120,12 +137,16 @@ vkdf_platform_should_quit(VkdfPlatform *platform)
 void
 vkdf_platform_poll_events(VkdfPlatform *platform)
 {
-   glfwPollEvents();
+   if (!platform->headless)
+      glfwPollEvents();
 }
 
 bool
 vkdf_platform_key_is_pressed(VkdfPlatform *platform, VkdfKey key)
 {
+   if (platform->headless)
+      return false;
+
    return glfwGetKey(platform->window, glfw_key_map[key]) == GLFW_PRESS;
 }
 
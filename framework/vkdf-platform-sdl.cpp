@@ -19,6 +19,13 @@ static const uint32_t sdl_key_map[] = {
 static void
 platform_init(VkdfPlatform *platform)
 {
+   // Headless platforms only need the timer
+   if (platform->headless) {
+      if (SDL_Init(SDL_INIT_TIMER) < 0)
+         vkdf_fatal("Failed to initialize SDL2 platform SDL_Error:%s", SDL_GetError());
+      return;
+   }
+
    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0)
       vkdf_fatal("Failed to initialize SDL2 platform SDL_Error:%s", SDL_GetError());
 
@@ -130,8 +137,10 @@ vkdf_platform_finish(VkdfPlatform *platform)
 {
    if (platform->sdl.joy.joy)
       SDL_JoystickClose(platform->sdl.joy.joy);
-   SDL_DestroyRenderer(platform->sdl.renderer);
-   SDL_DestroyWindow(platform->window);
+   if (!platform->headless) {
+      SDL_DestroyRenderer(platform->sdl.renderer);
+      SDL_DestroyWindow(platform->window);
+   }
    SDL_Quit();
 }
 
@@ -158,6 +167,9 @@ vkdf_platform_get_framebuffer_size(VkdfPlatform *platform,
 bool
 vkdf_platform_should_quit(VkdfPlatform *platform)
 {
+   if (platform->headless)
+      return false;
+
    const uint8_t *keys = SDL_GetKeyboardState(NULL);
    return keys[SDL_SCANCODE_ESCAPE] != 0;
 }
@@ -165,12 +177,16 @@ vkdf_platform_should_quit(VkdfPlatform *platform)
 void
 vkdf_platform_poll_events(VkdfPlatform *platform)
 {
-   SDL_PumpEvents();
+   if (!platform->headless)
+      SDL_PumpEvents();
 }
 
 bool
 vkdf_platform_key_is_pressed(VkdfPlatform *platform, VkdfKey key)
 {
+   if (platform->headless)
+      return false;
+
    const uint8_t *keys = SDL_GetKeyboardState(NULL);
    return keys[sdl_key_map[key]] != 0;
 }
@@ -10,6 +10,9 @@ typedef GLFWwindow *VkdfWindow;
 #endif
 
 typedef struct {
+   // Headless platforms have no window: there are no events to poll and
+   // input queries report nothing
+   bool headless;
    VkdfWindow window;
    VkSurfaceKHR surface;
 #ifdef VKDF_PLATFORM_SDL
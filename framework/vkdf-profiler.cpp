@@ -0,0 +1,609 @@
+#include "vkdf-profiler.hpp"
+#include "vkdf-cmd-buffer.hpp"
+#include "vkdf-util.hpp"
+
+/* Threads get a small index the first time they record a zone, which is
+ * what we use to group zones by thread in traces.
+ */
+static volatile gint _num_threads = 0;
+static __thread int32_t _thread_idx = -1;
+
+static __thread struct {
+   uint32_t depth;
+   const char *name[VKDF_PROFILER_MAX_DEPTH];
+   double start[VKDF_PROFILER_MAX_DEPTH];
+} _stack;
+
+static inline double
+get_time(VkdfProfiler *p)
+{
+   return g_get_monotonic_time() / 1000000.0 - p->base_time;
+}
+
+static inline uint32_t
+get_thread_idx()
+{
+   if (_thread_idx < 0)
+      _thread_idx = g_atomic_int_add(&_num_threads, 1);
+   return _thread_idx;
+}
+
+/* Must be called with the profiler mutex held */
+static int32_t
+find_zone(VkdfProfiler *p, const char *name, bool gpu, bool create)
+{
+   for (uint32_t i = 0; i < p->num_zones; i++) {
+      if (p->zones[i].gpu == gpu &&
+          (p->zones[i].name == name || !strcmp(p->zones[i].name, name)))
+         return i;
+   }
+
+   if (!create || p->num_zones == VKDF_PROFILER_MAX_ZONES)
+      return -1;
+
+   p->zones[p->num_zones].name = name;
+   p->zones[p->num_zones].gpu = gpu;
+   return p->num_zones++;
+}
+
+static void
+init_gpu_frames(VkdfProfiler *p)
+{
+   VkdfContext *ctx = p->ctx;
+
+   const uint32_t valid_bits =
+      ctx->queues[ctx->gfx_queue_index].timestampValidBits;
+   const float period = ctx->phy_device_props.limits.timestampPeriod;
+   if (valid_bits == 0 || period <= 0.0f) {
+      vkdf_info("profiler: GPU timestamps not supported.\n");
+      return;
+   }
+
+   p->gpu.supported = true;
+   p->gpu.mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+   p->gpu.period = period / 1000000000.0;
+   p->gpu.open_zone = -1;
+
+   p->gpu.cmd_pool = vkdf_create_gfx_command_pool(ctx, 0);
+
+   const uint32_t num_queries = 2 * VKDF_PROFILER_MAX_GPU_ZONES;
+   for (uint32_t i = 0; i < VKDF_PROFILER_GPU_FRAMES; i++) {
+      VkdfProfilerGpuFrame *gf = &p->gpu.frames[i];
+
+      VkQueryPoolCreateInfo info;
+      info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      info.pNext = NULL;
+      info.flags = 0;
+      info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      info.queryCount = num_queries;
+      info.pipelineStatistics = 0;
+      VK_CHECK(vkCreateQueryPool(ctx->device, &info, NULL, &gf->pool));
+
+      // Timestamp writes only depend on the query index, so we record them
+      // once. The first one of each frame also resets the frame's queries.
+      vkdf_create_command_buffer(ctx, p->gpu.cmd_pool,
+                                 VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                 num_queries, gf->cmd_bufs);
+
+      for (uint32_t q = 0; q < num_queries; q++) {
+         VkCommandBuffer cmd_buf = gf->cmd_bufs[q];
+         vkdf_command_buffer_begin(cmd_buf,
+                                   VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+         if (q == 0)
+            vkCmdResetQueryPool(cmd_buf, gf->pool, 0, num_queries);
+
+         // A top-of-pipe start timestamp would be written as soon as the
+         // zone's submission starts, before its semaphore waits and while
+         // the work submitted before it may still be running. Make the
+         // start wait for both, so zones only measure their own work.
+         if ((q % 2) == 0) {
+            vkCmdPipelineBarrier(cmd_buf,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 0,
+                                 0, NULL,
+                                 0, NULL,
+                                 0, NULL);
+         }
+
+         vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             gf->pool, q);
+         vkdf_command_buffer_end(cmd_buf);
+      }
+   }
+}
+
+VkdfProfiler *
+vkdf_profiler_new(VkdfContext *ctx, uint32_t num_frames)
+{
+   VkdfProfiler *p = g_new0(VkdfProfiler, 1);
+
+   p->ctx = ctx;
+   pthread_mutex_init(&p->mutex, NULL);
+   p->base_time = g_get_monotonic_time() / 1000000.0;
+
+   // GPU results are written to the frame that produced them, so it has to
+   // still be in the ring when we collect them
+   p->num_frames = MAX2(num_frames, VKDF_PROFILER_GPU_FRAMES);
+   p->frames = g_new0(VkdfProfilerFrame, p->num_frames);
+
+   init_gpu_frames(p);
+
+   return p;
+}
+
+void
+vkdf_profiler_free(VkdfProfiler *p)
+{
+   if (p->ctx->profiler == p)
+      p->ctx->profiler = NULL;
+
+   if (p->gpu.supported) {
+      for (uint32_t i = 0; i < VKDF_PROFILER_GPU_FRAMES; i++)
+         vkDestroyQueryPool(p->ctx->device, p->gpu.frames[i].pool, NULL);
+      vkDestroyCommandPool(p->ctx->device, p->gpu.cmd_pool, NULL);
+   }
+
+   pthread_mutex_destroy(&p->mutex);
+   g_free(p->frames);
+   g_free(p);
+}
+
+static inline VkdfProfilerFrame *
+get_frame(VkdfProfiler *p, uint64_t frame)
+{
+   VkdfProfilerFrame *f = &p->frames[frame % p->num_frames];
+   return f->frame == frame ? f : NULL;
+}
+
+/**
+ * Reads back the GPU timestamps of a frame that was submitted
+ * VKDF_PROFILER_GPU_FRAMES frames ago. If the GPU isn't done with it yet
+ * (which can only happen if the application keeps that many frames in
+ * flight) its GPU zones are dropped.
+ */
+static void
+collect_gpu_frame(VkdfProfiler *p, VkdfProfilerGpuFrame *gf)
+{
+   gf->pending = false;
+
+   VkdfProfilerFrame *f = get_frame(p, gf->frame);
+   if (!f || gf->num_zones == 0)
+      return;
+
+   uint64_t data[2 * VKDF_PROFILER_MAX_GPU_ZONES];
+   VkResult res = vkGetQueryPoolResults(p->ctx->device, gf->pool,
+                                        0, 2 * gf->num_zones,
+                                        sizeof(data), data, sizeof(uint64_t),
+                                        VK_QUERY_RESULT_64_BIT);
+   if (res != VK_SUCCESS)
+      return;
+
+   for (uint32_t i = 0; i < gf->num_zones; i++) {
+      uint64_t start = (data[2 * i] - data[0]) & p->gpu.mask;
+      uint64_t end = (data[2 * i + 1] - data[0]) & p->gpu.mask;
+
+      VkdfProfilerEvent *ev = &f->gpu_events[i];
+      ev->zone = gf->zones[i];
+      ev->thread = 0;
+      ev->depth = 0;
+      ev->start = gf->anchor + start * p->gpu.period;
+      ev->end = gf->anchor + end * p->gpu.period;
+   }
+   f->num_gpu_events = gf->num_zones;
+   f->gpu_valid = true;
+}
+
+void
+vkdf_profiler_frame_begin(VkdfProfiler *p)
+{
+   pthread_mutex_lock(&p->mutex);
+
+   VkdfProfilerFrame *f = &p->frames[p->frame % p->num_frames];
+   f->frame = p->frame;
+   f->start = get_time(p);
+   f->end = f->start;
+   f->num_cpu_events = 0;
+   f->num_gpu_events = 0;
+   f->gpu_valid = false;
+   f->dropped_events = 0;
+   p->in_frame = true;
+
+   pthread_mutex_unlock(&p->mutex);
+
+   if (p->gpu.supported) {
+      VkdfProfilerGpuFrame *gf =
+         &p->gpu.frames[p->frame % VKDF_PROFILER_GPU_FRAMES];
+      if (gf->pending)
+         collect_gpu_frame(p, gf);
+      gf->frame = p->frame;
+      gf->num_zones = 0;
+      p->gpu.open_zone = -1;
+   }
+}
+
+void
+vkdf_profiler_frame_end(VkdfProfiler *p)
+{
+   pthread_mutex_lock(&p->mutex);
+
+   assert(p->in_frame);
+   VkdfProfilerFrame *f = &p->frames[p->frame % p->num_frames];
+   f->end = get_time(p);
+   p->in_frame = false;
+   p->frame++;
+
+   pthread_mutex_unlock(&p->mutex);
+}
+
+void
+vkdf_profiler_cpu_zone_begin(VkdfProfiler *p, const char *name)
+{
+   if (!p)
+      return;
+
+   // Zones nested too deep are not recorded, but we still track them so
+   // that begin/end calls stay paired
+   uint32_t depth = _stack.depth++;
+   if (depth >= VKDF_PROFILER_MAX_DEPTH)
+      return;
+
+   _stack.name[depth] = name;
+   _stack.start[depth] = get_time(p);
+}
+
+void
+vkdf_profiler_cpu_zone_end(VkdfProfiler *p)
+{
+   if (!p)
+      return;
+
+   assert(_stack.depth > 0);
+   uint32_t depth = --_stack.depth;
+   if (depth >= VKDF_PROFILER_MAX_DEPTH)
+      return;
+
+   double end = get_time(p);
+   uint32_t thread = get_thread_idx();
+
+   pthread_mutex_lock(&p->mutex);
+
+   // Zones that end outside of a frame are not recorded
+   if (p->in_frame) {
+      VkdfProfilerFrame *f = &p->frames[p->frame % p->num_frames];
+      int32_t zone = find_zone(p, _stack.name[depth], false, true);
+      if (zone < 0 || f->num_cpu_events == VKDF_PROFILER_MAX_CPU_EVENTS) {
+         f->dropped_events++;
+      } else {
+         VkdfProfilerEvent *ev = &f->cpu_events[f->num_cpu_events++];
+         ev->zone = zone;
+         ev->thread = thread;
+         ev->depth = depth;
+         ev->start = _stack.start[depth];
+         ev->end = end;
+      }
+   }
+
+   pthread_mutex_unlock(&p->mutex);
+}
+
+VkCommandBuffer
+vkdf_profiler_gpu_zone_begin(VkdfProfiler *p, const char *name)
+{
+   if (!p || !p->gpu.supported || !p->in_frame)
+      return VK_NULL_HANDLE;
+
+   assert(p->gpu.open_zone < 0);
+
+   VkdfProfilerGpuFrame *gf =
+      &p->gpu.frames[p->frame % VKDF_PROFILER_GPU_FRAMES];
+   if (gf->num_zones == VKDF_PROFILER_MAX_GPU_ZONES)
+      return VK_NULL_HANDLE;
+
+   pthread_mutex_lock(&p->mutex);
+   int32_t zone = find_zone(p, name, true, true);
+   pthread_mutex_unlock(&p->mutex);
+   if (zone < 0)
+      return VK_NULL_HANDLE;
+
+   uint32_t idx = gf->num_zones++;
+   gf->zones[idx] = zone;
+   if (idx == 0)
+      gf->anchor = get_time(p);
+   gf->pending = true;
+
+   p->gpu.open_zone = idx;
+   return gf->cmd_bufs[2 * idx];
+}
+
+VkCommandBuffer
+vkdf_profiler_gpu_zone_end(VkdfProfiler *p)
+{
+   if (!p || !p->gpu.supported || p->gpu.open_zone < 0)
+      return VK_NULL_HANDLE;
+
+   VkdfProfilerGpuFrame *gf =
+      &p->gpu.frames[p->frame % VKDF_PROFILER_GPU_FRAMES];
+
+   uint32_t idx = p->gpu.open_zone;
+   p->gpu.open_zone = -1;
+   return gf->cmd_bufs[2 * idx + 1];
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+   double da = *(const double *) a;
+   double db = *(const double *) b;
+   return (da > db) - (da < db);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static inline double
+percentile(const double *values, uint32_t count, double pct)
+{
+   uint32_t rank = (uint32_t) ceil(pct / 100.0 * count);
+   return values[CLAMP(rank, 1u, count) - 1];
+}
+
+#define SUMMARY_CPU_FRAME -1
+#define SUMMARY_GPU_FRAME -2
+
+/**
+ * Computes the summary for 'zone' (or the SUMMARY_* totals for complete
+ * frames) over the completed frames in the ring. Must be called with the
+ * mutex held.
+ */
+static bool
+compute_summary(VkdfProfiler *p, int32_t zone, VkdfProfilerSummary *summary)
+{
+   memset(summary, 0, sizeof(VkdfProfilerSummary));
+
+   const uint64_t last = p->frame;
+   const uint64_t first = last > p->num_frames ? last - p->num_frames : 0;
+   const bool gpu = zone == SUMMARY_GPU_FRAME ||
+                    (zone >= 0 && p->zones[zone].gpu);
+
+   double *values = g_new(double, p->num_frames);
+   uint32_t count = 0;
+   for (uint64_t n = first; n < last; n++) {
+      VkdfProfilerFrame *f = get_frame(p, n);
+      if (!f)
+         continue;
+
+      if (zone == SUMMARY_CPU_FRAME) {
+         values[count++] = f->end - f->start;
+         continue;
+      }
+
+      uint32_t num_events = gpu ? f->num_gpu_events : f->num_cpu_events;
+      VkdfProfilerEvent *events = gpu ? f->gpu_events : f->cpu_events;
+      if (gpu && !f->gpu_valid)
+         continue;
+
+      // The GPU frame spans from the start of its first zone to the end of
+      // its last one, including any idle time between zones
+      if (zone == SUMMARY_GPU_FRAME) {
+         if (num_events == 0)
+            continue;
+
+         double start = events[0].start;
+         double end = events[0].end;
+         for (uint32_t i = 1; i < num_events; i++) {
+            start = MIN2(start, events[i].start);
+            end = MAX2(end, events[i].end);
+         }
+         values[count++] = end - start;
+         continue;
+      }
+
+      bool found = false;
+      double total = 0.0;
+      for (uint32_t i = 0; i < num_events; i++) {
+         if (events[i].zone == (uint32_t) zone) {
+            total += events[i].end - events[i].start;
+            found = true;
+         }
+      }
+      if (found)
+         values[count++] = total;
+   }
+
+   if (count > 0) {
+      qsort(values, count, sizeof(double), compare_double);
+
+      double sum = 0.0;
+      for (uint32_t i = 0; i < count; i++)
+         sum += values[i];
+
+      summary->count = count;
+      summary->avg = sum / count;
+      summary->min = values[0];
+      summary->max = values[count - 1];
+      summary->p50 = percentile(values, count, 50.0);
+      summary->p95 = percentile(values, count, 95.0);
+      summary->p99 = percentile(values, count, 99.0);
+   }
+
+   g_free(values);
+   return count > 0;
+}
+
+static bool
+get_zone_summary(VkdfProfiler *p,
+                 const char *name,
+                 bool gpu,
+                 VkdfProfilerSummary *summary)
+{
+   pthread_mutex_lock(&p->mutex);
+
+   bool result;
+   int32_t zone = find_zone(p, name, gpu, false);
+   if (zone < 0) {
+      memset(summary, 0, sizeof(VkdfProfilerSummary));
+      result = false;
+   } else {
+      result = compute_summary(p, zone, summary);
+   }
+
+   pthread_mutex_unlock(&p->mutex);
+   return result;
+}
+
+bool
+vkdf_profiler_get_cpu_summary(VkdfProfiler *p,
+                              const char *name,
+                              VkdfProfilerSummary *summary)
+{
+   return get_zone_summary(p, name, false, summary);
+}
+
+bool
+vkdf_profiler_get_gpu_summary(VkdfProfiler *p,
+                              const char *name,
+                              VkdfProfilerSummary *summary)
+{
+   return get_zone_summary(p, name, true, summary);
+}
+
+bool
+vkdf_profiler_get_frame_summary(VkdfProfiler *p, VkdfProfilerSummary *summary)
+{
+   pthread_mutex_lock(&p->mutex);
+   bool result = compute_summary(p, SUMMARY_CPU_FRAME, summary);
+   pthread_mutex_unlock(&p->mutex);
+   return result;
+}
+
+bool
+vkdf_profiler_get_gpu_frame_summary(VkdfProfiler *p,
+                                    VkdfProfilerSummary *summary)
+{
+   pthread_mutex_lock(&p->mutex);
+   bool result = compute_summary(p, SUMMARY_GPU_FRAME, summary);
+   pthread_mutex_unlock(&p->mutex);
+   return result;
+}
+
+static void
+log_summary(const char *kind, const char *name, VkdfProfilerSummary *s)
+{
+   vkdf_info("profiler: %s %s: avg %.3f ms, min %.3f ms, max %.3f ms, "
+             "p50 %.3f ms, p95 %.3f ms, p99 %.3f ms (%u frames).\n",
+             kind, name, s->avg * 1000.0, s->min * 1000.0, s->max * 1000.0,
+             s->p50 * 1000.0, s->p95 * 1000.0, s->p99 * 1000.0, s->count);
+}
+
+void
+vkdf_profiler_log_summary(VkdfProfiler *p)
+{
+   pthread_mutex_lock(&p->mutex);
+
+   VkdfProfilerSummary summary;
+   if (compute_summary(p, SUMMARY_CPU_FRAME, &summary))
+      log_summary("frame", "total", &summary);
+   if (compute_summary(p, SUMMARY_GPU_FRAME, &summary))
+      log_summary("gpu", "total", &summary);
+
+   for (uint32_t i = 0; i < p->num_zones; i++) {
+      if (compute_summary(p, i, &summary)) {
+         log_summary(p->zones[i].gpu ? "gpu" : "cpu",
+                     p->zones[i].name, &summary);
+      }
+   }
+
+   pthread_mutex_unlock(&p->mutex);
+}
+
+static void
+append_json_string(GString *str, const char *s)
+{
+   g_string_append_c(str, '"');
+   for (; *s; s++) {
+      if (*s == '"' || *s == '\\')
+         g_string_append_c(str, '\\');
+      if ((unsigned char) *s < 0x20)
+         g_string_append_printf(str, "\\u%04x", (unsigned char) *s);
+      else
+         g_string_append_c(str, *s);
+   }
+   g_string_append_c(str, '"');
+}
+
+static void
+append_trace_event(GString *str,
+                   const char *name,
+                   const char *cat,
+                   uint32_t pid,
+                   uint32_t tid,
+                   double start,
+                   double end)
+{
+   g_string_append(str, ",\n{\"name\":");
+   append_json_string(str, name);
+   g_string_append_printf(str,
+                          ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+                          "\"ts\":%.3f,\"dur\":%.3f}",
+                          cat, pid, tid, start * 1000000.0,
+                          (end - start) * 1000000.0);
+}
+
+bool
+vkdf_profiler_write_chrome_trace(VkdfProfiler *p, const char *path)
+{
+   GString *str = g_string_new("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+   // Process names, so CPU and GPU tracks are easy to tell apart
+   g_string_append(str,
+                   "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+                   "\"args\":{\"name\":\"CPU\"}},\n"
+                   "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"args\":{\"name\":\"GPU\"}}");
+
+   pthread_mutex_lock(&p->mutex);
+
+   const uint64_t last = p->frame;
+   const uint64_t first = last > p->num_frames ? last - p->num_frames : 0;
+   for (uint64_t n = first; n < last; n++) {
+      VkdfProfilerFrame *f = get_frame(p, n);
+      if (!f)
+         continue;
+
+      char frame_name[32];
+      snprintf(frame_name, sizeof(frame_name), "frame %llu",
+               (unsigned long long) f->frame);
+      append_trace_event(str, frame_name, "frame", 0, 0, f->start, f->end);
+
+      for (uint32_t i = 0; i < f->num_cpu_events; i++) {
+         VkdfProfilerEvent *ev = &f->cpu_events[i];
+         append_trace_event(str, p->zones[ev->zone].name, "cpu",
+                            0, ev->thread + 1, ev->start, ev->end);
+      }
+
+      if (!f->gpu_valid)
+         continue;
+
+      for (uint32_t i = 0; i < f->num_gpu_events; i++) {
+         VkdfProfilerEvent *ev = &f->gpu_events[i];
+         append_trace_event(str, p->zones[ev->zone].name, "gpu",
+                            1, 0, ev->start, ev->end);
+      }
+   }
+
+   pthread_mutex_unlock(&p->mutex);
+
+   g_string_append(str, "\n]}\n");
+
+   GError *error = NULL;
+   bool result = g_file_set_contents(path, str->str, str->len, &error);
+   if (!result) {
+      vkdf_error("profiler: failed to write trace to '%s': %s.",
+                 path, error->message);
+      g_error_free(error);
+   } else {
+      vkdf_info("profiler: wrote trace to '%s'.\n", path);
+   }
+
+   g_string_free(str, TRUE);
+   return result;
+}
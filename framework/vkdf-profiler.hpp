@@ -0,0 +1,216 @@
+#ifndef __VKDF_PROFILER_H__
+#define __VKDF_PROFILER_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-init.hpp"
+
+#include <pthread.h>
+
+/**
+ * Frame profiler with CPU and GPU zones.
+ *
+ * CPU zones are named, nestable time ranges recorded from any thread.
+ * GPU zones are measured with timestamp queries written by small command
+ * buffers that the caller submits right before and after the work being
+ * measured (see vkdf_submit_batch_wrap_last()).
+ *
+ * Each frame (delimited by vkdf_profiler_frame_begin/end(), which the
+ * event loop calls when a profiler is attached to the context) produces a
+ * record in a ring of the last 'num_frames' frames, from which percentile
+ * summaries and Chrome trace files (chrome://tracing, Perfetto) are built.
+ * GPU results become available a few frames later, once the GPU is done.
+ *
+ * Zone names are stored by pointer, so they must outlive the profiler
+ * (string literals are the expected use).
+ */
+#define VKDF_PROFILER_MAX_ZONES        64   // Distinct zone names
+#define VKDF_PROFILER_MAX_CPU_EVENTS   256  // CPU zones recorded per frame
+#define VKDF_PROFILER_MAX_GPU_ZONES    16   // GPU zones recorded per frame
+#define VKDF_PROFILER_MAX_DEPTH        16   // Nested CPU zones per thread
+#define VKDF_PROFILER_GPU_FRAMES       4    // Frames of GPU queries in flight
+
+typedef struct {
+   const char *name;
+   bool gpu;
+} VkdfProfilerZone;
+
+typedef struct {
+   uint32_t zone;                      // Index into VkdfProfiler::zones
+   uint32_t thread;                    // Profiler thread index (CPU only)
+   uint32_t depth;                     // Nesting level (CPU only)
+   double start;                       // Seconds since profiler creation
+   double end;
+} VkdfProfilerEvent;
+
+typedef struct {
+   uint64_t frame;
+   double start;
+   double end;
+   uint32_t num_cpu_events;
+   VkdfProfilerEvent cpu_events[VKDF_PROFILER_MAX_CPU_EVENTS];
+   uint32_t num_gpu_events;
+   VkdfProfilerEvent gpu_events[VKDF_PROFILER_MAX_GPU_ZONES];
+   bool gpu_valid;                     // GPU results have been collected
+   uint32_t dropped_events;            // Events that didn't fit the record
+} VkdfProfilerFrame;
+
+typedef struct {
+   VkQueryPool pool;
+   VkCommandBuffer cmd_bufs[2 * VKDF_PROFILER_MAX_GPU_ZONES];
+   uint32_t num_zones;
+   uint32_t zones[VKDF_PROFILER_MAX_GPU_ZONES];
+   uint64_t frame;                     // Frame that wrote the queries
+   double anchor;                      // CPU time of the first GPU zone
+   bool pending;                       // Results not collected yet
+} VkdfProfilerGpuFrame;
+
+typedef struct {
+   uint32_t count;                     // Frames with samples
+   double avg;                         // Seconds
+   double min;
+   double max;
+   double p50;
+   double p95;
+   double p99;
+} VkdfProfilerSummary;
+
+typedef struct _VkdfProfiler {
+   VkdfContext *ctx;
+   pthread_mutex_t mutex;
+
+   double base_time;                   // Monotonic time at creation
+
+   uint32_t num_zones;
+   VkdfProfilerZone zones[VKDF_PROFILER_MAX_ZONES];
+
+   uint64_t frame;                     // Current frame number
+   bool in_frame;
+   uint32_t num_frames;
+   VkdfProfilerFrame *frames;          // Ring, indexed by frame % num_frames
+
+   struct {
+      bool supported;
+      uint64_t mask;                   // Valid timestamp bits
+      double period;                   // Seconds per timestamp tick
+      VkCommandPool cmd_pool;
+      VkdfProfilerGpuFrame frames[VKDF_PROFILER_GPU_FRAMES];
+      int32_t open_zone;               // Zone index in the frame, -1 if none
+   } gpu;
+} VkdfProfiler;
+
+VkdfProfiler *
+vkdf_profiler_new(VkdfContext *ctx, uint32_t num_frames);
+
+void
+vkdf_profiler_free(VkdfProfiler *p);
+
+/**
+ * Attaches the profiler to the context, so the event loop delimits frames
+ * and the scene records its CPU and GPU zones. Pass NULL to detach it.
+ */
+inline void
+vkdf_set_profiler(VkdfContext *ctx, VkdfProfiler *p)
+{
+   ctx->profiler = p;
+}
+
+void
+vkdf_profiler_frame_begin(VkdfProfiler *p);
+
+void
+vkdf_profiler_frame_end(VkdfProfiler *p);
+
+/**
+ * Opens a CPU zone on the calling thread, closed by the next
+ * vkdf_profiler_cpu_zone_end() on the same thread. Both do nothing if 'p'
+ * is NULL, so callers can pass ctx->profiler unconditionally.
+ */
+void
+vkdf_profiler_cpu_zone_begin(VkdfProfiler *p, const char *name);
+
+void
+vkdf_profiler_cpu_zone_end(VkdfProfiler *p);
+
+/**
+ * Closes a CPU zone when it goes out of scope, see VKDF_PROFILE_ZONE().
+ */
+struct VkdfProfilerScope {
+   VkdfProfiler *p;
+
+   VkdfProfilerScope(VkdfProfiler *_p, const char *name) : p(_p)
+   {
+      vkdf_profiler_cpu_zone_begin(p, name);
+   }
+
+   ~VkdfProfilerScope()
+   {
+      vkdf_profiler_cpu_zone_end(p);
+   }
+};
+
+#define _VKDF_PROFILE_CONCAT(a, b) a##b
+#define _VKDF_PROFILE_SCOPE_NAME(line) _VKDF_PROFILE_CONCAT(_vkdf_profile_, line)
+#define VKDF_PROFILE_ZONE(p, name) \
+   VkdfProfilerScope _VKDF_PROFILE_SCOPE_NAME(__LINE__)(p, name)
+
+/**
+ * Returns a command buffer that writes the start timestamp of a GPU zone.
+ * vkdf_profiler_gpu_zone_end() returns the one that writes its end. Zones
+ * can't be nested, and both must be submitted (in order) during the current
+ * frame. The start waits for the semaphores of its submission and for the
+ * work submitted before it, so profiled jobs don't overlap on the GPU. They return VK_NULL_HANDLE if 'p' is NULL, timestamps aren't
+ * supported or the frame ran out of GPU zones.
+ *
+ * Only call these from the thread submitting the frame.
+ */
+VkCommandBuffer
+vkdf_profiler_gpu_zone_begin(VkdfProfiler *p, const char *name);
+
+VkCommandBuffer
+vkdf_profiler_gpu_zone_end(VkdfProfiler *p);
+
+/**
+ * Computes duration statistics for a zone over the frames in the ring.
+ * Durations of all the instances of the zone in a frame (for example, from
+ * different threads) are added up. Returns false if there are no samples.
+ */
+bool
+vkdf_profiler_get_cpu_summary(VkdfProfiler *p,
+                              const char *name,
+                              VkdfProfilerSummary *summary);
+
+bool
+vkdf_profiler_get_gpu_summary(VkdfProfiler *p,
+                              const char *name,
+                              VkdfProfilerSummary *summary);
+
+/**
+ * Statistics for the CPU time of complete frames.
+ */
+bool
+vkdf_profiler_get_frame_summary(VkdfProfiler *p, VkdfProfilerSummary *summary);
+
+/**
+ * Statistics for the GPU time of complete frames, from the start of the
+ * first GPU zone of each frame to the end of its last one.
+ */
+bool
+vkdf_profiler_get_gpu_frame_summary(VkdfProfiler *p,
+                                    VkdfProfilerSummary *summary);
+
+/**
+ * Logs the frame summary and the summary of every zone.
+ */
+void
+vkdf_profiler_log_summary(VkdfProfiler *p);
+
+/**
+ * Writes the frames in the ring to 'path' in Chrome trace event format.
+ * CPU zones go in one track per thread and GPU zones in a separate track,
+ * aligned to the CPU time at which the frame's first GPU zone was
+ * submitted, so GPU start times are approximate.
+ */
+bool
+vkdf_profiler_write_chrome_trace(VkdfProfiler *p, const char *path);
+
+#endif
@@ -8,7 +8,9 @@
 #include "vkdf-framebuffer.hpp"
 #include "vkdf-pipeline.hpp"
 #include "vkdf-descriptor.hpp"
+#include "vkdf-draw-sort.hpp"
 #include "vkdf-barrier.hpp"
+#include "vkdf-profiler.hpp"
 #include "vkdf-ssao.hpp"
 #include "vkdf-shader.hpp"
 #include "vkdf-semaphore.hpp"
@@ -39,6 +41,20 @@
 #define BRIGHTNESS_VS_SHADER_PATH JOIN(VKDF_DATA_DIR, "spirv/brightness.vert.spv")
 #define BRIGHTNESS_FS_SHADER_PATH JOIN(VKDF_DATA_DIR, "spirv/brightness.frag.spv")
 
+#define GPU_CULL_CS_SHADER_PATH JOIN(VKDF_DATA_DIR, "spirv/gpu-cull.comp.spv")
+
+#define HIZ_REDUCE_CS_SHADER_PATH JOIN(VKDF_DATA_DIR, "spirv/hiz-reduce.comp.spv")
+
+/* Size of the pixel blocks reduced into each texel of the base level of the
+ * hierarchical depth buffer used for occlusion culling.
+ */
+#define OCCLUSION_HIZ_BLOCK 8
+
+/* Width of the depth buffer occluders are rasterized into on the CPU. The
+ * height follows the aspect ratio of the scene render targets.
+ */
+#define SW_OCCLUSION_WIDTH 256
+
 /**
  * Input texture bindings for deferred SSAO base pass
  */
@@ -65,6 +81,12 @@ struct FreeCmdBufInfo {
 static void inline
 new_inactive_cmd_buf(VkdfScene *s, uint32_t thread_id, VkCommandBuffer cmd_buf);
 
+static void
+retire_inactive_resources(VkdfScene *s, VkdfSceneFrame *f);
+
+static void
+wait_for_frame(VkdfScene *s, VkdfSceneFrame *f);
+
 static void
 remove_light_volume_object_from_scene(VkdfScene *s, VkdfSceneLight *slight);
 
@@ -344,7 +366,7 @@ vkdf_scene_new(VkdfContext *ctx,
                glm::vec3 scene_size,
                glm::vec3 tile_size,
                uint32_t num_tile_levels,
-               uint32_t cache_size,
+               VkDeviceSize cache_budget,
                uint32_t num_threads)
 {
    VkdfScene *s = g_new0(VkdfScene, 1);
@@ -422,16 +444,18 @@ vkdf_scene_new(VkdfContext *ctx,
    if (num_threads > 1)
       s->thread.pool = vkdf_thread_pool_new(num_threads);
 
-   s->cache = (struct _cache *) malloc(sizeof(struct _cache) * num_threads);
+   // Each thread caches the tiles it processes, so split the budget
+   s->cache = g_new0(struct _cache, num_threads);
    for (uint32_t thread_idx = 0; thread_idx < num_threads; thread_idx++) {
-      s->cache[thread_idx].max_size = cache_size;
-      s->cache[thread_idx].size = 0;
-      s->cache[thread_idx].cached = NULL;
+      s->cache[thread_idx].budget =
+         cache_budget > 0 ? MAX2(cache_budget / num_threads, 1) : 0;
    }
 
    s->cmd_buf.pool = g_new(VkCommandPool, num_threads);
    s->cmd_buf.active = g_new(GList *, num_threads);
    s->cmd_buf.free = g_new(GList *, num_threads);
+   s->cmd_buf.recycled = g_new0(GList *, num_threads);
+   s->cmd_buf.num_recycled = g_new0(uint32_t, num_threads);
    for (uint32_t thread_idx = 0; thread_idx < num_threads; thread_idx++) {
       s->cmd_buf.pool[thread_idx] =
          vkdf_create_gfx_command_pool(s->ctx,
@@ -454,6 +478,13 @@ vkdf_scene_new(VkdfContext *ctx,
             s->num_tiles.total - 1;
    }
 
+   s->thread.dynamic_data = g_new0(struct DynamicThreadData, num_threads);
+   for (uint32_t thread_idx = 0; thread_idx < num_threads; thread_idx++) {
+      s->thread.dynamic_data[thread_idx].s = s;
+      s->thread.dynamic_data[thread_idx].sets =
+         g_hash_table_new(g_str_hash, g_str_equal);
+   }
+
    s->sync.update_resources_sem = vkdf_create_semaphore(s->ctx);
    s->sync.depth_draw_sem = vkdf_create_semaphore(s->ctx);
    s->sync.depth_draw_static_sem = vkdf_create_semaphore(s->ctx);
@@ -462,7 +493,17 @@ vkdf_scene_new(VkdfContext *ctx,
    s->sync.ssao_sem = vkdf_create_semaphore(s->ctx);
    s->sync.gbuffer_merge_sem = vkdf_create_semaphore(s->ctx);
    s->sync.postprocess_sem = vkdf_create_semaphore(s->ctx);
-   s->sync.present_fence = vkdf_create_fence(s->ctx);
+   s->sync.frame_sem = vkdf_create_semaphore(s->ctx);
+   for (uint32_t i = 0; i < SCENE_FRAMES_IN_FLIGHT; i++) {
+      s->sync.frame[i].fence = vkdf_create_fence(s->ctx);
+      s->sync.frame[i].cmd_bufs = g_new0(GList *, num_threads);
+      s->sync.frame[i].pools = g_new0(VkdfSceneFramePool, num_threads);
+      for (uint32_t j = 0; j < num_threads; j++) {
+         s->sync.frame[i].pools[j].pool =
+            vkdf_create_gfx_command_pool(s->ctx,
+                                         VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+      }
+   }
 
    s->ubo.static_pool =
       vkdf_create_descriptor_pool(s->ctx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8);
@@ -510,6 +551,7 @@ free_scene_set(VkdfSceneSetInfo *info, bool full_destroy)
       g_list_free_full(info->objs, (GDestroyNotify) vkdf_object_free);
    else
       g_list_free(info->objs);
+   g_free(info->batches);
    g_free(info);
 }
 
@@ -681,8 +723,8 @@ destroy_ssao_resources(VkdfScene *s)
                                 s->ssao.base.pipeline.textures_set_layout, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->ssao.base.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->ssao.base.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->ssao.base.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->ssao.base.pipeline.shader.fs);
 
    /* Samples buffer */
    vkdf_destroy_buffer(s->ctx, &s->ssao.samples_buf.buf);
@@ -709,10 +751,8 @@ destroy_ssao_resources(VkdfScene *s)
                                    s->ssao.blur.pipeline.ssao_tex_set_layout,
                                    NULL);
 
-      vkDestroyShaderModule(s->ctx->device,
-                            s->ssao.blur.pipeline.shader.vs, NULL);
-      vkDestroyShaderModule(s->ctx->device,
-                            s->ssao.blur.pipeline.shader.fs, NULL);
+      vkdf_shader_cache_release(s->ctx, s->ssao.blur.pipeline.shader.vs);
+      vkdf_shader_cache_release(s->ctx, s->ssao.blur.pipeline.shader.fs);
 
       vkDestroySampler(s->ctx->device, s->ssao.blur.input_sampler, NULL);
 
@@ -744,8 +784,8 @@ destroy_ssr_resources(VkdfScene *s)
                                 s->ssr.base.pipeline.tex_set_layout, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->ssr.base.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->ssr.base.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->ssr.base.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->ssr.base.pipeline.shader.fs);
 
    /* Render target */
    vkDestroyRenderPass(s->ctx->device, s->ssr.base.rp.renderpass, NULL);
@@ -766,8 +806,8 @@ destroy_ssr_resources(VkdfScene *s)
                                 s->ssr.blur.pipeline.tex_set_layout, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->ssr.blur.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->ssr.blur.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->ssr.blur.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->ssr.blur.pipeline.shader.fs);
 
    /* Render target */
    vkDestroyRenderPass(s->ctx->device, s->ssr.blur.rp.renderpass, NULL);
@@ -788,8 +828,8 @@ destroy_ssr_resources(VkdfScene *s)
                                 s->ssr.blend.pipeline.tex_set_layout, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->ssr.blend.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->ssr.blend.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->ssr.blend.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->ssr.blend.pipeline.shader.fs);
 
    /* Render target
     *
@@ -819,8 +859,8 @@ destroy_hdr_resources(VkdfScene *s)
    vkDestroySampler(s->ctx->device, s->hdr.input_sampler, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->hdr.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->hdr.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->hdr.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->hdr.pipeline.shader.fs);
 
 
    /* Render target */
@@ -854,8 +894,8 @@ destroy_brightness_filter_resources(VkdfScene *s)
    vkDestroySampler(s->ctx->device, s->brightness.input_sampler, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->brightness.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->brightness.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->brightness.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->brightness.pipeline.shader.fs);
 
 
    /* Render target */
@@ -882,8 +922,8 @@ destroy_fxaa_resources(VkdfScene *s)
    vkDestroySampler(s->ctx->device, s->fxaa.input_sampler, NULL);
 
    /* Shaders */
-   vkDestroyShaderModule(s->ctx->device, s->fxaa.pipeline.shader.vs, NULL);
-   vkDestroyShaderModule(s->ctx->device, s->fxaa.pipeline.shader.fs, NULL);
+   vkdf_shader_cache_release(s->ctx, s->fxaa.pipeline.shader.vs);
+   vkdf_shader_cache_release(s->ctx, s->fxaa.pipeline.shader.fs);
 
 
    /* Render target */
@@ -892,19 +932,87 @@ destroy_fxaa_resources(VkdfScene *s)
    vkdf_destroy_image(s->ctx, &s->fxaa.output);
 }
 
+static void
+destroy_gpu_culling_resources(VkdfScene *s)
+{
+   VkDevice device = s->ctx->device;
+
+   vkDestroyPipeline(device, s->gpu_cull.pipeline, NULL);
+   vkDestroyPipelineLayout(device, s->gpu_cull.layout, NULL);
+   vkdf_shader_cache_release(s->ctx, s->gpu_cull.cs);
+   vkFreeDescriptorSets(device, s->gpu_cull.pool, 1, &s->gpu_cull.set);
+   vkDestroyDescriptorSetLayout(device, s->gpu_cull.set_layout, NULL);
+   vkDestroyDescriptorPool(device, s->gpu_cull.pool, NULL);
+
+   vkdf_destroy_buffer(s->ctx, &s->gpu_cull.obj_buf);
+   vkdf_destroy_buffer(s->ctx, &s->gpu_cull.range_buf);
+   vkdf_destroy_buffer(s->ctx, &s->gpu_cull.visible_buf);
+   vkdf_destroy_buffer(s->ctx, &s->gpu_cull.bounds_buf);
+
+   s->gpu_cull.ranges.clear();
+   std::vector<VkdfSceneCullRange>(s->gpu_cull.ranges).swap(s->gpu_cull.ranges);
+   s->gpu_cull.visible.clear();
+   std::vector<uint32_t>(s->gpu_cull.visible).swap(s->gpu_cull.visible);
+}
+
+static void
+destroy_occlusion_culling_resources(VkdfScene *s)
+{
+   VkDevice device = s->ctx->device;
+
+   if (s->occlusion.pending) {
+      VK_CHECK(vkWaitForFences(device, 1, &s->occlusion.fence,
+                               true, UINT64_MAX));
+   }
+
+   vkDestroyPipeline(device, s->occlusion.pipeline, NULL);
+   vkDestroyPipelineLayout(device, s->occlusion.layout, NULL);
+   vkdf_shader_cache_release(s->ctx, s->occlusion.cs);
+
+   vkFreeDescriptorSets(device, s->sampler.pool, 1, &s->occlusion.sampler_set);
+   vkDestroyDescriptorSetLayout(device, s->occlusion.sampler_set_layout, NULL);
+   vkFreeDescriptorSets(device, s->occlusion.pool, 1, &s->occlusion.buf_set);
+   vkDestroyDescriptorSetLayout(device, s->occlusion.buf_set_layout, NULL);
+   vkDestroyDescriptorPool(device, s->occlusion.pool, NULL);
+   vkDestroySampler(device, s->occlusion.sampler, NULL);
+
+   vkDestroySemaphore(device, s->occlusion.sem, NULL);
+   vkDestroyFence(device, s->occlusion.fence, NULL);
+
+   vkdf_memory_unmap(s->ctx, s->occlusion.buf.mem, s->occlusion.buf.mem_props,
+                     0, VK_WHOLE_SIZE);
+   vkdf_destroy_buffer(s->ctx, &s->occlusion.buf);
+
+   vkdf_hiz_free(s->occlusion.hiz);
+}
+
 void
-vkdf_scene_free(VkdfScene *s)
+vkdf_scene_get_tile_cache_stats(VkdfScene *s, VkdfSceneTileCacheStats *stats)
 {
-   while (s->sync.present_fence_active) {
-      VkResult status;
-      do {
-         status = vkWaitForFences(s->ctx->device,
-                                  1, &s->sync.present_fence,
-                                  true, 1000ull);
-      } while (status == VK_NOT_READY || status == VK_TIMEOUT);
-      vkResetFences(s->ctx->device, 1, &s->sync.present_fence);
-      s->sync.present_fence_active = false;
+   memset(stats, 0, sizeof(VkdfSceneTileCacheStats));
+   for (uint32_t i = 0; i < s->thread.num_threads; i++) {
+      stats->size += s->cache[i].size;
+      stats->mem_size += s->cache[i].mem_size;
+      stats->budget += s->cache[i].budget;
+      stats->hits += s->cache[i].hits;
+      stats->misses += s->cache[i].misses;
+      stats->evictions += s->cache[i].evictions;
    }
+}
+
+void
+vkdf_scene_get_stats(VkdfScene *s, VkdfSceneStats *stats)
+{
+   *stats = s->stats.last;
+}
+
+void
+vkdf_scene_free(VkdfScene *s)
+{
+   // Wait for all frames in flight and release anything they retired
+   retire_inactive_resources(s, &s->sync.frame[s->sync.frame_idx]);
+   for (uint32_t i = 0; i < SCENE_FRAMES_IN_FLIGHT; i++)
+      wait_for_frame(s, &s->sync.frame[i]);
 
    if (s->thread.pool) {
       vkdf_thread_pool_wait(s->thread.pool);
@@ -942,6 +1050,10 @@ vkdf_scene_free(VkdfScene *s)
       g_list_free(s->thread.tile_data[i].visible);
    g_free(s->thread.tile_data);
 
+   for (uint32_t i = 0; i < s->thread.num_threads; i++)
+      g_hash_table_destroy(s->thread.dynamic_data[i].sets);
+   g_free(s->thread.dynamic_data);
+
    g_list_free_full(s->set_ids, g_free);
    s->set_ids = NULL;
 
@@ -957,6 +1069,26 @@ vkdf_scene_free(VkdfScene *s)
       free_tile(&s->tiles[i]);
    g_free(s->tiles);
 
+   if (s->gpu_cull.enabled)
+      destroy_gpu_culling_resources(s);
+
+   if (s->occlusion.enabled)
+      destroy_occlusion_culling_resources(s);
+
+   if (s->sw_occlusion.raster)
+      vkdf_sw_occlusion_free(s->sw_occlusion.raster);
+   g_list_free(s->sw_occlusion.occluders);
+
+   if (s->geometry.arena)
+      vkdf_geometry_arena_free(s->geometry.arena);
+   if (s->geometry.released_models)
+      g_hash_table_destroy(s->geometry.released_models);
+   if (s->geometry.indirect_buf.buf)
+      vkdf_destroy_buffer(s->ctx, &s->geometry.indirect_buf);
+   s->geometry.draws.clear();
+   std::vector<VkDrawIndexedIndirectCommand>(s->geometry.draws).swap(
+      s->geometry.draws);
+
    free_dynamic_objects(s);
    g_free(s->dynamic.ubo.obj.host_buf);
    g_free(s->dynamic.ubo.shadow_map.host_buf);
@@ -969,20 +1101,38 @@ vkdf_scene_free(VkdfScene *s)
    vkDestroySemaphore(s->ctx->device, s->sync.gbuffer_merge_sem, NULL);
    vkDestroySemaphore(s->ctx->device, s->sync.ssao_sem, NULL);
    vkDestroySemaphore(s->ctx->device, s->sync.postprocess_sem, NULL);
-   vkDestroyFence(s->ctx->device, s->sync.present_fence, NULL);
+   vkDestroySemaphore(s->ctx->device, s->sync.frame_sem, NULL);
+   for (uint32_t i = 0; i < SCENE_FRAMES_IN_FLIGHT; i++) {
+      vkDestroyFence(s->ctx->device, s->sync.frame[i].fence, NULL);
+      g_free(s->sync.frame[i].cmd_bufs);
+      for (uint32_t j = 0; j < s->thread.num_threads; j++) {
+         VkdfSceneFramePool *fp = &s->sync.frame[i].pools[j];
+         vkDestroyCommandPool(s->ctx->device, fp->pool, NULL);
+         g_free(fp->cmd_bufs[VK_COMMAND_BUFFER_LEVEL_PRIMARY]);
+         g_free(fp->cmd_bufs[VK_COMMAND_BUFFER_LEVEL_SECONDARY]);
+      }
+      g_free(s->sync.frame[i].pools);
+   }
 
    for (uint32_t i = 0; i < s->thread.num_threads; i++) {
-      g_list_free(s->cache[i].cached);
       g_list_free(s->cmd_buf.active[i]);
       g_list_free(s->cmd_buf.free[i]);
-      g_list_free(s->cache[i].cached);
+      g_list_free(s->cmd_buf.recycled[i]);
       vkDestroyCommandPool(s->ctx->device, s->cmd_buf.pool[i], NULL);
    }
    g_free(s->cache);
    g_free(s->cmd_buf.active);
    g_free(s->cmd_buf.free);
+   g_free(s->cmd_buf.recycled);
+   g_free(s->cmd_buf.num_recycled);
    g_free(s->cmd_buf.pool);
    g_free(s->cmd_buf.present);
+   s->cmd_buf.tiles.clear();
+   std::vector<VkdfSceneTile *>(s->cmd_buf.tiles).swap(s->cmd_buf.tiles);
+   s->cmd_buf.packets.clear();
+   std::vector<VkdfDrawPacket>(s->cmd_buf.packets).swap(s->cmd_buf.packets);
+   s->cmd_buf.sorted.clear();
+   std::vector<VkdfSceneTile *>(s->cmd_buf.sorted).swap(s->cmd_buf.sorted);
    g_free(s->tile_size);
 
    if (s->shadows.renderpass)
@@ -1004,7 +1154,7 @@ vkdf_scene_free(VkdfScene *s)
    }
 
    if (s->shadows.shaders.vs)
-     vkDestroyShaderModule(s->ctx->device, s->shadows.shaders.vs, NULL);
+     vkdf_shader_cache_release(s->ctx, s->shadows.shaders.vs);
 
    if (s->ssao.enabled)
       destroy_ssao_resources(s);
@@ -1169,6 +1319,9 @@ add_static_object(VkdfScene *s, const char *set_id, VkdfObject *obj)
 static void
 add_dynamic_object(VkdfScene *s, const char *set_id, VkdfObject *obj)
 {
+   assert(!s->geometry.released_models ||
+          !g_hash_table_contains(s->geometry.released_models, obj->model));
+
    // FIXME: for dynamic objects a hashtable might not be the best choice...
    VkdfSceneSetInfo *info =
       (VkdfSceneSetInfo *) g_hash_table_lookup(s->dynamic.sets, set_id);
@@ -1199,6 +1352,9 @@ vkdf_scene_add_object(VkdfScene *s, const char *set_id, VkdfObject *obj)
    else
       add_dynamic_object(s, set_id, obj);
 
+   if (vkdf_object_is_occluder(obj))
+      s->sw_occlusion.occluders = g_list_prepend(s->sw_occlusion.occluders, obj);
+
    s->obj_count++;
 }
 
@@ -1225,6 +1381,9 @@ vkdf_scene_remove_object(VkdfScene *s, const char *set_id, VkdfObject *obj)
    assert(info->count > 0);
    assert(node->data == obj);
 
+   if (vkdf_object_is_occluder(obj))
+      s->sw_occlusion.occluders = g_list_remove(s->sw_occlusion.occluders, obj);
+
    vkdf_object_free(obj);
    info->objs = g_list_remove_link(info->objs, node);
    g_list_free(node);
@@ -1701,32 +1860,48 @@ vkdf_scene_remove_light(VkdfScene *s, VkdfLight *light)
    vkdf_info("debug: scene: warning: attempted to remove non-existent light\n");
 }
 
-static int
-compare_distance(const void *a, const void *b,  void *data)
+/**
+ * Returns an array with the active tiles sorted front-to-back, so static
+ * geometry gets the most out of early depth testing. The array is owned by
+ * the scene and is only valid until the next call.
+ */
+static VkdfSceneTile **
+sort_active_tiles_by_distance(VkdfScene *s, uint32_t *count)
 {
-   VkdfSceneTile *t1 = (VkdfSceneTile *) a;
-   VkdfSceneTile *t2 = (VkdfSceneTile *) b;
-   glm::vec3 *cam_pos = (glm::vec3 *) data;
+   *count = 0;
+   for (uint32_t i = 0; i < s->thread.num_threads; i++)
+      *count += g_list_length(s->cmd_buf.active[i]);
 
-   float d1 = vkdf_vec3_module(t1->box.center - *cam_pos, 1, 1, 1);
-   float d2 = vkdf_vec3_module(t2->box.center - *cam_pos, 1, 1, 1);
-   return d1 < d2 ? -1 : d1 > d2 ? 1 : 0;
-}
+   if (*count == 0)
+      return NULL;
 
-static inline GList *
-sort_active_tiles_by_distance(VkdfScene *s)
-{
-   GList *list = NULL;
+   std::vector<VkdfSceneTile *> &tiles = s->cmd_buf.tiles;
+   std::vector<VkdfDrawPacket> &packets = s->cmd_buf.packets;
+   std::vector<VkdfSceneTile *> &sorted = s->cmd_buf.sorted;
+   tiles.resize(*count);
+   packets.resize(2 * (*count));
+   sorted.resize(*count);
+
+   glm::vec3 cam_pos = vkdf_camera_get_position(s->camera);
+   uint32_t idx = 0;
    for (uint32_t i = 0; i < s->thread.num_threads; i++) {
       GList *iter = s->cmd_buf.active[i];
       while (iter) {
-         list = g_list_prepend(list, iter->data);
+         VkdfSceneTile *t = (VkdfSceneTile *) iter->data;
+         float dist = vkdf_vec3_module(t->box.center - cam_pos, 1, 1, 1);
+         packets[idx].key = vkdf_draw_key(0, 0, 0, dist);
+         packets[idx].index = idx;
+         tiles[idx++] = t;
          iter = g_list_next(iter);
       }
    }
 
-   glm::vec3 cam_pos = vkdf_camera_get_position(s->camera);
-   return g_list_sort_with_data(list, compare_distance, &cam_pos);
+   vkdf_draw_sort(packets.data(), *count, &packets[*count]);
+
+   for (uint32_t i = 0; i < *count; i++)
+      sorted[i] = tiles[packets[i].index];
+
+   return sorted.data();
 }
 
 static void
@@ -1773,26 +1948,21 @@ build_primary_cmd_buf(VkdfScene *s)
       cmd_buf[1] = *dpp_primary;
    }
 
-   GList *active = sort_active_tiles_by_distance(s);
-
-   uint32_t cmd_buf_count = g_list_length(active);
+   uint32_t cmd_buf_count;
+   VkdfSceneTile **active = sort_active_tiles_by_distance(s, &cmd_buf_count);
 
    VkCommandBuffer *secondaries = NULL;
    if (cmd_buf_count > 0) {
       uint32_t multiplier = s->rp.do_depth_prepass ? 2 : 1;
       secondaries =
          g_new(VkCommandBuffer,  multiplier * cmd_buf_count);
-      uint32_t idx = 0;
-      GList *iter = active;
-      while (iter) {
-         VkdfSceneTile *t = (VkdfSceneTile *) iter->data;
+      for (uint32_t idx = 0; idx < cmd_buf_count; idx++) {
+         VkdfSceneTile *t = active[idx];
          assert(t->cmd_buf != 0);
          assert(!s->rp.do_depth_prepass || t->depth_cmd_buf != 0);
          secondaries[idx] = t->cmd_buf;
          if (s->rp.do_depth_prepass)
             secondaries[cmd_buf_count + idx] = t->depth_cmd_buf;
-         idx++;
-         iter = g_list_next(iter);
       }
    }
 
@@ -1831,33 +2001,31 @@ build_primary_cmd_buf(VkdfScene *s)
    }
 
    g_free(secondaries);
-   g_list_free(active);
-}
-
-static bool
-check_fences(VkdfScene *s)
-{
-   bool new_signaled = false;
-   if (s->sync.present_fence_active &&
-       vkGetFenceStatus(s->ctx->device, s->sync.present_fence) == VK_SUCCESS) {
-      vkResetFences(s->ctx->device, 1, &s->sync.present_fence);
-      s->sync.present_fence_active = false;
-      new_signaled = true;
-   }
-
-   return new_signaled;
 }
 
 static void
-free_inactive_command_buffers(VkdfScene *s)
+free_inactive_command_buffers(VkdfScene *s, GList **lists)
 {
    for (uint32_t i = 0; i < s->thread.num_threads; i++) {
-      GList *iter = s->cmd_buf.free[i];
+      GList *iter = lists[i];
       while (iter) {
          struct FreeCmdBufInfo *info = (struct FreeCmdBufInfo *) iter->data;
          assert(info->num_commands > 0);
-         vkFreeCommandBuffers(s->ctx->device, s->cmd_buf.pool[i],
-                              info->num_commands, info->cmd_buf);
+
+         // Tile secondaries are recycled for new tiles (up to a limit) so we
+         // don't have to allocate them again, anything else is freed
+         for (uint32_t j = 0; j < info->num_commands; j++) {
+            if (info->tile &&
+                s->cmd_buf.num_recycled[i] < SCENE_MAX_RECYCLED_SECONDARIES) {
+               vkResetCommandBuffer(info->cmd_buf[j], 0);
+               s->cmd_buf.recycled[i] =
+                  g_list_prepend(s->cmd_buf.recycled[i], info->cmd_buf[j]);
+               s->cmd_buf.num_recycled[i]++;
+            } else {
+               vkFreeCommandBuffers(s->ctx->device, s->cmd_buf.pool[i],
+                                    1, &info->cmd_buf[j]);
+            }
+         }
 
          // If this was a tile secondary, mark the tile as not having a command
          if (info->tile &&
@@ -1868,7 +2036,7 @@ free_inactive_command_buffers(VkdfScene *s)
 
          GList *link = iter;
          iter = g_list_next(iter);
-         s->cmd_buf.free[i] = g_list_delete_link(s->cmd_buf.free[i], link);
+         lists[i] = g_list_delete_link(lists[i], link);
 
          g_free(info);
       }
@@ -1876,51 +2044,119 @@ free_inactive_command_buffers(VkdfScene *s)
 }
 
 static void
-free_inactive_images(VkdfScene *s)
+free_inactive_images(VkdfScene *s, GList **list)
 {
-   GList *head = s->inactive.images;
+   GList *head = *list;
    while (head) {
       VkdfImage *image = (VkdfImage *) head->data;
       vkdf_destroy_image(s->ctx, image);
       head = g_list_delete_link(head, head);
    }
 
-   s->inactive.images = NULL;
+   *list = NULL;
 }
 
 static void
-free_inactive_framebuffers(VkdfScene *s)
+free_inactive_framebuffers(VkdfScene *s, GList **list)
 {
-   GList *head = s->inactive.framebuffers;
+   GList *head = *list;
    while (head) {
       VkFramebuffer framebuffer = (VkFramebuffer) head->data;
       vkDestroyFramebuffer(s->ctx->device, framebuffer, NULL);
       head = g_list_delete_link(head, head);
    }
 
-   s->inactive.framebuffers = NULL;
+   *list = NULL;
 }
 
 static void
-free_inactive_samplers(VkdfScene *s)
+free_inactive_samplers(VkdfScene *s, GList **list)
 {
-   GList *head = s->inactive.samplers;
+   GList *head = *list;
    while (head) {
       VkSampler sampler = (VkSampler) head->data;
       vkDestroySampler(s->ctx->device, sampler, NULL);
       head = g_list_delete_link(head, head);
    }
 
+   *list = NULL;
+}
+
+/**
+ * Hands resources retired since the previous frame was submitted over to
+ * frame 'f', so they are released when the GPU is done with it.
+ */
+static void
+retire_inactive_resources(VkdfScene *s, VkdfSceneFrame *f)
+{
+   for (uint32_t i = 0; i < s->thread.num_threads; i++) {
+      f->cmd_bufs[i] = g_list_concat(f->cmd_bufs[i], s->cmd_buf.free[i]);
+      s->cmd_buf.free[i] = NULL;
+   }
+
+   f->images = g_list_concat(f->images, s->inactive.images);
+   f->framebuffers = g_list_concat(f->framebuffers, s->inactive.framebuffers);
+   f->samplers = g_list_concat(f->samplers, s->inactive.samplers);
+   s->inactive.images = NULL;
+   s->inactive.framebuffers = NULL;
    s->inactive.samplers = NULL;
 }
 
+/**
+ * Waits until the GPU is done with frame 'f' (if it was submitted) and
+ * releases the resources that were retired with it.
+ */
 static void
-free_inactive_resources(VkdfScene *s)
+wait_for_frame(VkdfScene *s, VkdfSceneFrame *f)
+{
+   if (f->fence_active) {
+      VK_CHECK(vkWaitForFences(s->ctx->device, 1, &f->fence,
+                               true, UINT64_MAX));
+      vkResetFences(s->ctx->device, 1, &f->fence);
+      f->fence_active = false;
+   }
+
+   for (uint32_t i = 0; i < s->thread.num_threads; i++) {
+      VkdfSceneFramePool *fp = &f->pools[i];
+      if (fp->used[VK_COMMAND_BUFFER_LEVEL_PRIMARY] > 0 ||
+          fp->used[VK_COMMAND_BUFFER_LEVEL_SECONDARY] > 0) {
+         VK_CHECK(vkResetCommandPool(s->ctx->device, fp->pool, 0));
+         fp->used[VK_COMMAND_BUFFER_LEVEL_PRIMARY] = 0;
+         fp->used[VK_COMMAND_BUFFER_LEVEL_SECONDARY] = 0;
+      }
+   }
+
+   free_inactive_command_buffers(s, f->cmd_bufs);
+   free_inactive_images(s, &f->images);
+   free_inactive_framebuffers(s, &f->framebuffers);
+   free_inactive_samplers(s, &f->samplers);
+}
+
+/**
+ * Returns a command buffer for the frame being prepared, recycling one from
+ * a previous use of the frame's pool if possible. The command buffer is
+ * valid until the frame is waited on again, so it must only be used for
+ * commands that are recorded every frame. 'thread_id' selects the pool, so
+ * it must be the thread calling this.
+ */
+static VkCommandBuffer
+get_frame_cmd_buf(VkdfScene *s,
+                  uint32_t thread_id,
+                  VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY)
 {
-   free_inactive_command_buffers(s);
-   free_inactive_images(s);
-   free_inactive_framebuffers(s);
-   free_inactive_samplers(s);
+   VkdfSceneFrame *f = &s->sync.frame[s->sync.frame_idx];
+   VkdfSceneFramePool *fp = &f->pools[thread_id];
+
+   if (fp->used[level] == fp->num_cmd_bufs[level]) {
+      uint32_t n = fp->num_cmd_bufs[level];
+      fp->cmd_bufs[level] =
+         g_renew(VkCommandBuffer, fp->cmd_bufs[level], n + 1);
+      vkdf_create_command_buffer(s->ctx, fp->pool, level,
+                                 1, &fp->cmd_bufs[level][n]);
+      fp->num_cmd_bufs[level]++;
+   }
+
+   return fp->cmd_bufs[level][fp->used[level]++];
 }
 
 static inline void
@@ -1930,8 +2166,20 @@ add_to_cache(struct TileThreadData *data, VkdfSceneTile *t)
    uint32_t job_id = data->id;
    assert(job_id < s->thread.num_threads);
 
-   s->cache[job_id].cached = g_list_prepend(s->cache[job_id].cached, t);
-   s->cache[job_id].size++;
+   struct _cache *cache = &s->cache[job_id];
+   assert(!t->cached);
+
+   t->cache_prev = NULL;
+   t->cache_next = cache->head;
+   if (cache->head)
+      cache->head->cache_prev = t;
+   else
+      cache->tail = t;
+   cache->head = t;
+
+   t->cached = true;
+   cache->size++;
+   cache->mem_size += t->cmd_buf_size;
 }
 
 static inline void
@@ -1941,9 +2189,79 @@ remove_from_cache(struct TileThreadData *data, VkdfSceneTile *t)
    uint32_t job_id = data->id;
    assert(job_id < s->thread.num_threads);
 
-   assert(s->cache[job_id].size > 0);
-   s->cache[job_id].cached = g_list_remove(s->cache[job_id].cached, t);
-   s->cache[job_id].size--;
+   struct _cache *cache = &s->cache[job_id];
+   assert(t->cached && cache->size > 0);
+
+   if (t->cache_prev)
+      t->cache_prev->cache_next = t->cache_next;
+   else
+      cache->head = t->cache_next;
+
+   if (t->cache_next)
+      t->cache_next->cache_prev = t->cache_prev;
+   else
+      cache->tail = t->cache_prev;
+
+   t->cache_prev = NULL;
+   t->cache_next = NULL;
+   t->cached = false;
+   cache->size--;
+   cache->mem_size -= t->cmd_buf_size;
+}
+
+/**
+ * Number of draw calls recorded by draw_geometry_range() for 'count' draws.
+ */
+static inline uint32_t
+count_geometry_range_draws(VkdfScene *s, uint32_t count)
+{
+   if (s->geometry.use_indirect && s->geometry.use_multi_draw)
+      return count > 0 ? 1 : 0;
+   return count;
+}
+
+/**
+ * Number of draw calls vkdf_scene_draw_batches() records for a set.
+ */
+static uint32_t
+count_set_draws(VkdfScene *s, VkdfSceneSetInfo *info)
+{
+   if (!info || info->count == 0)
+      return 0;
+
+   if (info->draws.valid)
+      return count_geometry_range_draws(s, info->draws.count);
+
+   // Sets without batches are usually drawn one object at a time
+   return info->num_batches > 0 ? info->num_batches : info->count;
+}
+
+static uint32_t
+count_sets_draws(VkdfScene *s, GHashTable *sets)
+{
+   uint32_t num_draws = 0;
+
+   char *id;
+   VkdfSceneSetInfo *info;
+   GHashTableIter iter;
+   g_hash_table_iter_init(&iter, sets);
+   while (g_hash_table_iter_next(&iter, (void **)&id, (void **)&info))
+      num_draws += count_set_draws(s, info);
+
+   return num_draws;
+}
+
+/**
+ * Estimates the memory used by a tile's command buffers from the number of
+ * draws recorded for its sets (see SCENE_CMD_BUF_BASE_SIZE).
+ */
+static VkDeviceSize
+estimate_tile_cmd_buf_size(VkdfScene *s, VkdfSceneTile *t)
+{
+   VkDeviceSize size =
+      SCENE_CMD_BUF_BASE_SIZE + t->num_draws * SCENE_CMD_BUF_DRAW_SIZE;
+
+   return s->rp.do_depth_prepass ? 2 * size : size;
 }
 
 static void
@@ -1968,6 +2286,63 @@ record_viewport_and_scissor_commands(VkCommandBuffer cmd_buf,
    vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
 }
 
+/**
+ * Schedules the tile's command buffers for release once the GPU is done
+ * with them, so the tile can be recorded again.
+ */
+static void
+discard_tile_cmd_bufs(VkdfScene *s, uint32_t job_id, VkdfSceneTile *t)
+{
+   if (t->cmd_buf == 0)
+      return;
+
+   struct FreeCmdBufInfo *info = g_new(struct FreeCmdBufInfo, 1);
+   info->cmd_buf[0] = t->cmd_buf;
+   if (s->rp.do_depth_prepass) {
+      info->num_commands = 2;
+      info->cmd_buf[1] = t->depth_cmd_buf;
+   } else {
+      info->num_commands = 1;
+   }
+   info->tile = t;
+   s->cmd_buf.free[job_id] = g_list_prepend(s->cmd_buf.free[job_id], info);
+
+   t->cmd_buf = 0;
+   t->depth_cmd_buf = 0;
+}
+
+uint32_t
+vkdf_scene_select_lod(VkdfScene *s, const VkdfBox *box, uint32_t cur_lod)
+{
+   if (s->lod.num_lods <= 1)
+      return 0;
+
+   // Distance from the camera to the closest point in the box
+   glm::vec3 cam_pos = vkdf_camera_get_position(s->camera);
+   glm::vec3 d = glm::abs(cam_pos - box->center) -
+                 glm::vec3(box->w, box->h, box->d);
+   float dist = glm::length(glm::max(d, glm::vec3(0.0f)));
+
+   // Only switch to a coarser level when we are past its distance by the
+   // hysteresis margin and only go back when we are below it by the same
+   // margin, so tiles close to a threshold don't flip between levels.
+   const float h = s->lod.hysteresis;
+   uint32_t lod_out = 0;
+   uint32_t lod_in = 0;
+   for (uint32_t i = 0; i < s->lod.num_lods - 1; i++) {
+      if (dist > s->lod.distances[i] * (1.0f + h))
+         lod_out = i + 1;
+      if (dist > s->lod.distances[i] * (1.0f - h))
+         lod_in = i + 1;
+   }
+
+   if (lod_out > cur_lod)
+      return lod_out;
+   if (lod_in < cur_lod)
+      return lod_in;
+   return cur_lod;
+}
+
 static void
 new_active_tile(struct TileThreadData *data, VkdfSceneTile *t)
 {
@@ -1977,33 +2352,40 @@ new_active_tile(struct TileThreadData *data, VkdfSceneTile *t)
 
    assert(t->obj_count > 0);
 
-   /* If we don't free secondaries we only need to record them once and we can
-    * reuse them whenever we need them again.
+   /* If the tile is still in the cache we can reuse its command buffers,
+    * unless they were recorded for a different level of detail.
     */
-   if (!SCENE_FREE_SECONDARIES) {
-      if (t->cmd_buf != 0) {
-         s->cmd_buf.active[job_id] = g_list_prepend(s->cmd_buf.active[job_id], t);
+   if (t->cached) {
+      remove_from_cache(data, t);
+      if (t->cmd_buf_lod == t->lod) {
+         s->cache[job_id].hits++;
+         s->cmd_buf.active[job_id] =
+            g_list_prepend(s->cmd_buf.active[job_id], t);
          return;
       }
-   } else {
-      /* Otherwise, we may still find it in the cache */
-      if (s->cache[job_id].size > 0) {
-         GList *found = g_list_find(s->cache[job_id].cached, t);
-         if (found) {
-            remove_from_cache(data, t);
-            s->cmd_buf.active[job_id] =
-               g_list_prepend(s->cmd_buf.active[job_id], t);
-            return;
-         }
-      }
    }
+   discard_tile_cmd_bufs(s, job_id, t);
+   s->cache[job_id].misses++;
 
-   /* If we get here, it means we need to create and record a new one */
+   /* If we get here, it means we need to record a new one, preferably
+    * reusing secondaries released by other tiles.
+    */
    VkCommandBuffer cmd_buf[2];
-   vkdf_create_command_buffer(s->ctx,
-                              s->cmd_buf.pool[job_id],
-                              VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-                              s->rp.do_depth_prepass ? 2 : 1, cmd_buf);
+   uint32_t num_cmd_bufs = s->rp.do_depth_prepass ? 2 : 1;
+   for (uint32_t i = 0; i < num_cmd_bufs; i++) {
+      GList *link = s->cmd_buf.recycled[job_id];
+      if (link) {
+         cmd_buf[i] = (VkCommandBuffer) link->data;
+         s->cmd_buf.recycled[job_id] =
+            g_list_delete_link(s->cmd_buf.recycled[job_id], link);
+         s->cmd_buf.num_recycled[job_id]--;
+      } else {
+         vkdf_create_command_buffer(s->ctx,
+                                    s->cmd_buf.pool[job_id],
+                                    VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                                    1, &cmd_buf[i]);
+      }
+   }
 
    VkCommandBufferUsageFlags flags =
       VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT |
@@ -2024,7 +2406,7 @@ new_active_tile(struct TileThreadData *data, VkdfSceneTile *t)
    record_viewport_and_scissor_commands(cmd_buf[0], s->rt.width, s->rt.height);
 
    s->callbacks.record_commands(s->ctx, cmd_buf[0], t->sets, false, false,
-                                s->callbacks.data);
+                                t->lod, s->callbacks.data);
 
    vkdf_command_buffer_end(cmd_buf[0]);
 
@@ -2041,13 +2423,19 @@ new_active_tile(struct TileThreadData *data, VkdfSceneTile *t)
                                            s->rt.width, s->rt.height);
 
       s->callbacks.record_commands(s->ctx, cmd_buf[1],
-                                   t->sets, false, true, s->callbacks.data);
+                                   t->sets, false, true, t->lod,
+                                   s->callbacks.data);
 
       vkdf_command_buffer_end(cmd_buf[1]);
 
       t->depth_cmd_buf = cmd_buf[1];
    }
 
+   t->cmd_buf_lod = t->lod;
+   t->num_draws = count_sets_draws(s, t->sets);
+   t->cmd_buf_size = estimate_tile_cmd_buf_size(s, t);
+   data->num_recorded += num_cmd_bufs;
+
    s->cmd_buf.active[job_id] = g_list_prepend(s->cmd_buf.active[job_id], t);
 
    t->dirty = false;
@@ -2063,66 +2451,50 @@ new_inactive_tile(struct TileThreadData *data, VkdfSceneTile *t)
    s->cmd_buf.active[job_id] =
       g_list_remove(s->cmd_buf.active[job_id], t);
 
-   /* If we're not freeing secondary command buffers, then we are done */
-   if (!SCENE_FREE_SECONDARIES)
+   if (t->cmd_buf == 0)
       return;
 
-   /* Otherwise, put it in the cache if we have one */
-   VkdfSceneTile *expired;
-   if (s->cache[job_id].max_size <= 0) {
-      expired = t;
-   } else {
-      if (s->cache[job_id].size >= s->cache[job_id].max_size) {
-         GList *last = g_list_last(s->cache[job_id].cached);
-         expired = (VkdfSceneTile *) last->data;
-         remove_from_cache(data, expired);
-      } else {
-         expired = NULL;
-      }
+   /* Keep the tile's command buffers around in case it becomes visible
+    * again, then evict the least recently used tiles until we are back in
+    * budget. Evicted command buffers may still be used by the GPU, so they
+    * are released with the frame.
+    */
+   struct _cache *cache = &s->cache[job_id];
+   add_to_cache(data, t);
 
-      add_to_cache(data, t);
+   while (cache->budget > 0 && cache->mem_size > cache->budget) {
+      VkdfSceneTile *expired = cache->tail;
+      remove_from_cache(data, expired);
+      discard_tile_cmd_bufs(s, job_id, expired);
+      cache->evictions++;
    }
+}
 
-   if (!expired)
-      return;
-
-   /* If we got here, we have a command buffer to free, but we can't do it yet,
-    * since it may still be used by the GPU. Put it in a to-free list and
-    * free it when it is safe.
-    */
-   struct FreeCmdBufInfo *info = g_new(struct FreeCmdBufInfo, 1);
-   info->cmd_buf[0] = expired->cmd_buf;
-   if (s->rp.do_depth_prepass) {
-      info->num_commands = 2;
-      info->cmd_buf[1] = expired->depth_cmd_buf;
-   } else {
-      info->num_commands = 1;
-   }
-   info->tile = expired;
-   s->cmd_buf.free[job_id] = g_list_prepend(s->cmd_buf.free[job_id], info);
+/**
+ * Records a buffer update in the resource update command buffer of the
+ * frame. Updates are limited to 64KB (see vkCmdUpdateBuffer).
+ */
+static inline void
+record_buffer_update(VkdfScene *s,
+                     VkBuffer buf,
+                     VkDeviceSize offset,
+                     VkDeviceSize size,
+                     const void *data)
+{
+   vkCmdUpdateBuffer(s->cmd_buf.update_resources, buf, offset, size, data);
+   s->stage.update.stats.resource_update_bytes += size;
 }
 
 static void
 start_recording_resource_updates(VkdfScene *s)
 {
-   // If the previous frame didn't have any resource updates, we have the
-   // resouce update command buffer available for this frame, otherwise
-   // we need to create a new one.
-   VkCommandBuffer cmd_buf;
-   if (s->cmd_buf.update_resources && !s->cmd_buf.have_resource_updates) {
-      cmd_buf = s->cmd_buf.update_resources;
-   } else {
-      if (s->cmd_buf.update_resources)
-         new_inactive_cmd_buf(s, 0, s->cmd_buf.update_resources);
-
-      vkdf_create_command_buffer(s->ctx,
-                                 s->cmd_buf.pool[0],
-                                 VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                                 1, &cmd_buf);
-
-      vkdf_command_buffer_begin(cmd_buf,
-                                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-   }
+   // The command buffer comes from the frame's pool, so it is recycled
+   // when the frame is done whether we end up submitting it or not. We
+   // can't carry an unused one over to the next frame because it would be
+   // reset with the pool of this frame.
+   VkCommandBuffer cmd_buf = get_frame_cmd_buf(s, 0);
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
    s->cmd_buf.update_resources = cmd_buf;
 }
@@ -2268,11 +2640,71 @@ subtile_is_visible(VkdfSceneTile *t, const VkdfPlane *fp)
    return vkdf_box_is_in_frustum(&t->box, NULL, fp);
 }
 
+/**
+ * Occlusion data to test tiles against while looking for visible tiles.
+ */
+struct TileOccluders {
+   VkdfHiZ *hiz[2];
+   uint32_t count;
+};
+
+static inline bool
+tile_is_occluded(VkdfSceneTile *t, const struct TileOccluders *occ)
+{
+   for (uint32_t i = 0; i < occ->count; i++) {
+      if (vkdf_hiz_is_box_occluded(occ->hiz[i], &t->box))
+         return true;
+   }
+   return false;
+}
+
+/**
+ * Adds a tile that is in the view, replacing it with its unoccluded
+ * subtiles if some of them are occluded.
+ */
+static GList *
+add_unoccluded_tile(VkdfSceneTile *t,
+                    const struct TileOccluders *occ,
+                    GList *visible)
+{
+   if (occ->count == 0)
+      return g_list_prepend(visible, t);
+
+   if (tile_is_occluded(t, occ))
+      return visible;
+
+   if (!t->subtiles)
+      return g_list_prepend(visible, t);
+
+   // Only take individual subtiles if some of them are occluded
+   bool any_subtile_occluded = false;
+   for (uint32_t i = 0; !any_subtile_occluded && i < 8; i++) {
+      VkdfSceneTile *st = &t->subtiles[i];
+      any_subtile_occluded = st->obj_count > 0 && tile_is_occluded(st, occ);
+   }
+
+   if (!any_subtile_occluded)
+      return g_list_prepend(visible, t);
+
+   for (uint32_t i = 0; i < 8; i++) {
+      if (t->subtiles[i].obj_count > 0)
+         visible = add_unoccluded_tile(&t->subtiles[i], occ, visible);
+   }
+
+   return visible;
+}
+
 static GList *
 find_visible_subtiles(VkdfSceneTile *t,
                       const VkdfPlane *fplanes,
+                      const struct TileOccluders *occ,
                       GList *visible)
 {
+   // Tiles hidden behind the occluders are not visible, whatever the
+   // visibility of their subtiles
+   if (occ->count > 0 && tile_is_occluded(t, occ))
+      return visible;
+
    // If the tile can't be subdivided, then take the entire tile as visible
    if (!t->subtiles)
       return g_list_prepend(visible, t);
@@ -2292,37 +2724,44 @@ find_visible_subtiles(VkdfSceneTile *t,
    }
 
    // If all subtiles are visible, then the parent tile is fully visible,
-   // just add the parent tile
+   // just add the parent tile (or its unoccluded subtiles)
    if (all_subtiles_visible)
-      return g_list_prepend(visible, t);
+      return add_unoccluded_tile(t, occ, visible);
 
    // Otherwise, add only the visible subtiles
    for (uint32_t j = 0; j < 8; j++) {
       if (subtile_visibility[j] == INSIDE) {
-         visible = g_list_prepend(visible, &t->subtiles[j]);
+         visible = add_unoccluded_tile(&t->subtiles[j], occ, visible);
       } else if (subtile_visibility[j] == INTERSECT) {
-         visible = find_visible_subtiles(&t->subtiles[j], fplanes, visible);
+         visible = find_visible_subtiles(&t->subtiles[j], fplanes, occ,
+                                         visible);
       }
    }
 
    return visible;
 }
 
+/**
+ * Finds the tiles in the view. With occluders, tiles are tested against
+ * them as they are found, so occluded tiles are never added and partially
+ * occluded tiles are replaced with their unoccluded subtiles.
+ */
 static GList *
 find_visible_tiles(VkdfScene *s,
                    uint32_t first_tile_idx,
                    uint32_t last_tile_idx,
                    const VkdfBox *visible_box,
-                   const VkdfPlane *fplanes)
+                   const VkdfPlane *fplanes,
+                   const struct TileOccluders *occ)
 {
    GList *visible = NULL;
    for (uint32_t i = first_tile_idx; i <= last_tile_idx; i++) {
       VkdfSceneTile *t = &s->tiles[i];
       uint32_t visibility = tile_is_visible(t, visible_box, fplanes);
       if (visibility == INSIDE) {
-         visible = g_list_prepend(visible, t);
+         visible = add_unoccluded_tile(t, occ, visible);
       } else if (visibility == INTERSECT) {
-         visible = find_visible_subtiles(t, fplanes, visible);
+         visible = find_visible_subtiles(t, fplanes, occ, visible);
       }
    }
    return visible;
@@ -2344,7 +2783,8 @@ create_static_object_ubo(VkdfScene *s)
    s->ubo.obj.buf =
       vkdf_create_buffer(s->ctx, 0,
                          s->ubo.obj.size,
-                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
    uint8_t *mem;
@@ -2429,6 +2869,7 @@ create_dynamic_object_ubo(VkdfScene *s)
       vkdf_create_buffer(s->ctx, 0,
                          s->dynamic.ubo.obj.size,
                          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
@@ -2659,20 +3100,865 @@ create_dynamic_material_ubo(VkdfScene *s)
 }
 
 /**
- * - Builds object lists for non-leaf (sub)tiles (making sure object
- *   order is correct)
- * - Computes (sub)tile starting indices
- * - Creates static UBO data for scene objects (model matrix, materials, etc)
+ * Builds the arena draws for a static set: one draw per active mesh for
+ * each level of detail, plus one for its shadow casters. With GPU culling
+ * the set also gets a cull range and its own slots in the culled object
+ * buffer.
  */
 static void
-prepare_scene_objects(VkdfScene *s)
+build_set_draws(VkdfScene *s, VkdfSceneSetInfo *info)
 {
-   s->set_ids = g_list_reverse(s->set_ids);
-   s->models = g_list_reverse(s->models);
+   info->draws.cull_range = -1;
+   if (info->count == 0)
+      return;
 
-   for (uint32_t i = 0; i < s->num_tiles.total; i++) {
-      VkdfSceneTile *t = &s->tiles[i];
-      ensure_set_infos(t, s->set_ids);
+   // All objects in a set share the same model
+   VkdfModel *model = ((VkdfObject *) info->objs->data)->model;
+
+   uint32_t pool;
+   if (!vkdf_geometry_arena_get_model_pool(s->geometry.arena, model, &pool))
+      return;
+
+   uint32_t num_lods = 1;
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      num_lods = MAX2(num_lods, vkdf_mesh_get_num_lods(model->meshes[i]));
+
+   std::vector<VkDrawIndexedIndirectCommand> &draws = s->geometry.draws;
+   uint32_t count = 0;
+   for (uint32_t lod = 0; lod < num_lods; lod++) {
+      info->draws.first[lod] = draws.size();
+      count = 0;
+      for (uint32_t i = 0; i < model->meshes.size(); i++) {
+         VkdfMesh *mesh = model->meshes[i];
+         if (mesh->active == false)
+            continue;
+
+         VkDrawIndexedIndirectCommand draw;
+         vkdf_geometry_range_get_draw(
+            vkdf_geometry_arena_lookup(s->geometry.arena, mesh),
+            lod, info->count, info->start_index, &draw);
+         draws.push_back(draw);
+         count++;
+      }
+   }
+
+   if (info->shadow_caster_count > 0) {
+      info->draws.shadow_first = draws.size();
+      for (uint32_t i = 0; i < model->meshes.size(); i++) {
+         VkdfMesh *mesh = model->meshes[i];
+         if (mesh->active == false)
+            continue;
+
+         VkDrawIndexedIndirectCommand draw;
+         vkdf_geometry_range_get_draw(
+            vkdf_geometry_arena_lookup(s->geometry.arena, mesh),
+            0, info->shadow_caster_count, info->shadow_caster_start_index,
+            &draw);
+         draws.push_back(draw);
+      }
+   }
+
+   info->draws.valid = count > 0;
+   info->draws.pool = pool;
+   info->draws.num_lods = num_lods;
+   info->draws.count = count;
+
+   // With GPU culling each set draws its visible objects from its own
+   // slots in the culled object buffer. Sets that would take the buffer
+   // past the storage buffer range limit keep drawing all their objects.
+   const VkDeviceSize max_slots =
+      s->ctx->phy_device_props.limits.maxStorageBufferRange /
+      s->ubo.obj.inst_size;
+   if (s->gpu_cull.enabled && info->draws.valid &&
+       s->gpu_cull.num_slots + info->count <= max_slots) {
+      VkdfSceneCullRange range;
+      memset(&range, 0, sizeof(range));
+      range.obj_first = info->start_index;
+      range.obj_count = info->count;
+      range.slot_first = s->gpu_cull.num_slots;
+      range.draw_first = info->draws.first[0];
+      range.draw_count = num_lods * count;
+      info->draws.cull_range = s->gpu_cull.ranges.size();
+      s->gpu_cull.ranges.push_back(range);
+      s->gpu_cull.num_slots += info->count;
+
+      for (uint32_t i = 0; i < range.draw_count; i++)
+         draws[range.draw_first + i].firstInstance = range.slot_first;
+   }
+}
+
+static void
+build_tile_draws(VkdfScene *s, VkdfSceneTile *t)
+{
+   GHashTableIter iter;
+   VkdfSceneSetInfo *info;
+   g_hash_table_iter_init(&iter, t->sets);
+   while (g_hash_table_iter_next(&iter, NULL, (void **) &info))
+      build_set_draws(s, info);
+
+   if (!t->subtiles)
+      return;
+
+   for (uint32_t i = 0; i < 8; i++)
+      build_tile_draws(s, &t->subtiles[i]);
+}
+
+static void
+upload_static_object_bounds(VkdfScene *s, VkdfStaging *st)
+{
+   VkDeviceSize size = s->static_obj_count * 2 * sizeof(glm::vec4);
+   s->gpu_cull.bounds_buf =
+      vkdf_create_buffer(s->ctx, 0, size,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   glm::vec4 *bounds = (glm::vec4 *)
+      vkdf_staging_upload_to_buffer(st, &s->gpu_cull.bounds_buf, 0, size);
+
+   // Same object order as the static object UBO
+   GList *set_id_iter = s->set_ids;
+   while (set_id_iter) {
+      const char *set_id = (const char *) set_id_iter->data;
+      for (uint32_t i = 0; i < s->num_tiles.total; i++) {
+         VkdfSceneTile *t = &s->tiles[i];
+         if (t->obj_count == 0)
+             continue;
+
+         VkdfSceneSetInfo *info =
+            (VkdfSceneSetInfo *) g_hash_table_lookup(t->sets, set_id);
+         if (!info || info->count == 0)
+            continue;
+
+         uint32_t idx = info->start_index;
+         GList *iter = info->objs;
+         while (iter) {
+            VkdfObject *obj = (VkdfObject *) iter->data;
+            VkdfBox *box = vkdf_object_get_box(obj);
+            bounds[2 * idx] = glm::vec4(box->center, 1.0f);
+            bounds[2 * idx + 1] = glm::vec4(box->w, box->h, box->d, 0.0f);
+            idx++;
+            iter = g_list_next(iter);
+         }
+      }
+      set_id_iter = g_list_next(set_id_iter);
+   }
+}
+
+struct _gpu_cull_pcb {
+   glm::vec4 planes[6];
+   uint32_t obj_vec4_count;
+};
+
+/**
+ * Creates the buffers and the compute pipeline for GPU culling. The culled
+ * object buffer starts with a copy of the static object UBO so sets that
+ * aren't culled can still use their original object indices.
+ */
+static void
+prepare_gpu_culling(VkdfScene *s, VkdfStaging *st)
+{
+   VkdfContext *ctx = s->ctx;
+
+   // Culled object data
+   s->gpu_cull.obj_size = s->gpu_cull.num_slots * s->ubo.obj.inst_size;
+   s->gpu_cull.obj_buf =
+      vkdf_create_buffer(ctx, 0, s->gpu_cull.obj_size,
+                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   uint8_t *obj_data;
+   vkdf_memory_map(ctx, s->ubo.obj.buf.mem, 0, VK_WHOLE_SIZE,
+                   (void **) &obj_data);
+   memcpy(vkdf_staging_upload_to_buffer(st, &s->gpu_cull.obj_buf,
+                                        0, s->ubo.obj.size),
+          obj_data, s->ubo.obj.size);
+   vkdf_memory_unmap(ctx, s->ubo.obj.buf.mem, s->ubo.obj.buf.mem_props,
+                     0, VK_WHOLE_SIZE);
+
+   // Cull ranges and object bounds
+   VkDeviceSize ranges_size =
+      s->gpu_cull.ranges.size() * sizeof(VkdfSceneCullRange);
+   s->gpu_cull.range_buf =
+      vkdf_create_buffer(ctx, 0, ranges_size,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+   memcpy(vkdf_staging_upload_to_buffer(st, &s->gpu_cull.range_buf,
+                                        0, ranges_size),
+          &s->gpu_cull.ranges[0], ranges_size);
+
+   s->gpu_cull.visible_buf =
+      vkdf_create_buffer(ctx, 0,
+                         s->gpu_cull.ranges.size() * sizeof(uint32_t),
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   upload_static_object_bounds(s, st);
+
+   // Descriptor set: ranges, bounds, source objects, culled objects, draws
+   // and the indices of the ranges to cull
+   s->gpu_cull.pool =
+      vkdf_create_descriptor_pool(ctx, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8);
+   s->gpu_cull.set_layout =
+      vkdf_create_ssbo_descriptor_set_layout(ctx, 0, 6,
+                                             VK_SHADER_STAGE_COMPUTE_BIT,
+                                             false);
+   s->gpu_cull.set =
+      vkdf_descriptor_set_create(ctx, s->gpu_cull.pool, s->gpu_cull.set_layout);
+
+   VkBuffer buffers[6] = {
+      s->gpu_cull.range_buf.buf,
+      s->gpu_cull.bounds_buf.buf,
+      s->ubo.obj.buf.buf,
+      s->gpu_cull.obj_buf.buf,
+      s->geometry.indirect_buf.buf,
+      s->gpu_cull.visible_buf.buf,
+   };
+   for (uint32_t i = 0; i < 6; i++) {
+      VkDeviceSize offset = 0;
+      VkDeviceSize range = VK_WHOLE_SIZE;
+      vkdf_descriptor_set_buffer_update(ctx, s->gpu_cull.set, buffers[i],
+                                        i, 1, &offset, &range, false, false);
+   }
+
+   // Pipeline
+   VkPushConstantRange pcb_range;
+   pcb_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+   pcb_range.offset = 0;
+   pcb_range.size = sizeof(struct _gpu_cull_pcb);
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = &pcb_range;
+   pipeline_layout_info.setLayoutCount = 1;
+   pipeline_layout_info.pSetLayouts = &s->gpu_cull.set_layout;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &s->gpu_cull.layout));
+
+   s->gpu_cull.cs = vkdf_shader_cache_acquire(ctx, GPU_CULL_CS_SHADER_PATH);
+   s->gpu_cull.pipeline =
+      vkdf_create_compute_pipeline(ctx, NULL, s->gpu_cull.layout,
+                                   s->gpu_cull.cs);
+}
+
+/**
+ * Collects the cull ranges of the sets in the tiles found visible on the
+ * CPU for the current frame.
+ */
+static void
+collect_visible_cull_ranges(VkdfScene *s)
+{
+   std::vector<uint32_t> &visible = s->gpu_cull.visible;
+   visible.clear();
+
+   for (uint32_t i = 0; i < s->thread.num_threads; i++) {
+      GList *iter = s->cmd_buf.active[i];
+      while (iter) {
+         VkdfSceneTile *t = (VkdfSceneTile *) iter->data;
+         GHashTableIter set_iter;
+         VkdfSceneSetInfo *info;
+         g_hash_table_iter_init(&set_iter, t->sets);
+         while (g_hash_table_iter_next(&set_iter, NULL, (void **) &info)) {
+            if (info->count > 0 && info->draws.cull_range >= 0)
+               visible.push_back(info->draws.cull_range);
+         }
+         iter = g_list_next(iter);
+      }
+   }
+}
+
+/**
+ * Records the culling of the visible cull ranges for the current camera.
+ */
+static void
+record_gpu_culling_pass(VkdfScene *s, VkCommandBuffer cmd_buf)
+{
+   const uint32_t num_ranges = s->gpu_cull.visible.size();
+
+   // Don't overwrite the culling inputs and results until previous frames
+   // are done with them
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        0, NULL,
+                        0, NULL);
+
+   // vkCmdUpdateBuffer() takes up to 64KB per call
+   const uint32_t max_update = 65536 / sizeof(uint32_t);
+   for (uint32_t i = 0; i < num_ranges; i += max_update) {
+      uint32_t count = MIN2(max_update, num_ranges - i);
+      vkCmdUpdateBuffer(cmd_buf, s->gpu_cull.visible_buf.buf,
+                        i * sizeof(uint32_t), count * sizeof(uint32_t),
+                        &s->gpu_cull.visible[i]);
+   }
+
+   VkMemoryBarrier update_barrier;
+   update_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+   update_barrier.pNext = NULL;
+   update_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   update_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        1, &update_barrier,
+                        0, NULL,
+                        0, NULL);
+
+   struct _gpu_cull_pcb pcb;
+   const VkdfPlane *planes = vkdf_camera_get_frustum_planes(s->camera);
+   for (uint32_t i = 0; i < 6; i++) {
+      pcb.planes[i] =
+         glm::vec4(planes[i].a, planes[i].b, planes[i].c, planes[i].d);
+   }
+   pcb.obj_vec4_count = s->ubo.obj.inst_size / sizeof(glm::vec4);
+
+   vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     s->gpu_cull.pipeline);
+
+   vkCmdBindDescriptorSets(cmd_buf,
+                           VK_PIPELINE_BIND_POINT_COMPUTE,
+                           s->gpu_cull.layout,
+                           0,                        // First decriptor set
+                           1,                        // Descriptor set count
+                           &s->gpu_cull.set,         // Descriptor sets
+                           0,                        // Dynamic offset count
+                           NULL);                    // Dynamic offsets
+
+   vkCmdPushConstants(cmd_buf,
+                      s->gpu_cull.layout,
+                      VK_SHADER_STAGE_COMPUTE_BIT,
+                      0, sizeof(pcb), &pcb);
+
+   // One work group per visible set
+   vkCmdDispatch(cmd_buf, num_ranges, 1, 1);
+
+   VkMemoryBarrier barrier;
+   barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+   barrier.pNext = NULL;
+   barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                           VK_ACCESS_UNIFORM_READ_BIT |
+                           VK_ACCESS_SHADER_READ_BIT;
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0,
+                        1, &barrier,
+                        0, NULL,
+                        0, NULL);
+}
+
+/**
+ * Records the GPU culling pass for the current camera into the resource
+ * update command buffer. Only the sets in the visible tiles are culled, the
+ * draws of the rest keep stale instance counts until their tiles become
+ * visible again and they are culled for the view of that frame.
+ */
+static void
+record_gpu_culling(VkdfScene *s)
+{
+   collect_visible_cull_ranges(s);
+   if (s->gpu_cull.visible.size() == 0)
+      return;
+
+   record_gpu_culling_pass(s, s->cmd_buf.update_resources);
+   s->cmd_buf.have_resource_updates = true;
+}
+
+/**
+ * Same frustum test as the culling shader.
+ */
+static bool
+box_passes_gpu_cull(const VkdfBox *box, const VkdfPlane *planes)
+{
+   for (uint32_t i = 0; i < 6; i++) {
+      glm::vec3 n = glm::vec3(planes[i].a, planes[i].b, planes[i].c);
+      float r = glm::dot(glm::abs(n), glm::vec3(box->w, box->h, box->d));
+      if (glm::dot(n, box->center) + planes[i].d + r < 0.0f)
+         return false;
+   }
+   return true;
+}
+
+uint32_t
+vkdf_scene_check_gpu_culling(VkdfScene *s)
+{
+   if (!s->gpu_cull.enabled)
+      return 0;
+
+   VkdfContext *ctx = s->ctx;
+   vkDeviceWaitIdle(ctx->device);
+
+   collect_visible_cull_ranges(s);
+   if (s->gpu_cull.visible.size() == 0)
+      return 0;
+
+   // Cull the visible tiles for the current camera and read back the
+   // resulting draws
+   const VkDeviceSize size =
+      s->geometry.draws.size() * sizeof(VkDrawIndexedIndirectCommand);
+   VkdfBuffer readback =
+      vkdf_create_buffer(ctx, 0, size,
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   VkCommandBuffer cmd_buf;
+   vkdf_create_command_buffer(ctx, s->cmd_buf.pool[0],
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &cmd_buf);
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   record_gpu_culling_pass(s, cmd_buf);
+
+   VkMemoryBarrier barrier;
+   barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+   barrier.pNext = NULL;
+   barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0,
+                        1, &barrier,
+                        0, NULL,
+                        0, NULL);
+
+   VkBufferCopy region;
+   region.srcOffset = 0;
+   region.dstOffset = 0;
+   region.size = size;
+   vkCmdCopyBuffer(cmd_buf, s->geometry.indirect_buf.buf, readback.buf,
+                   1, &region);
+
+   barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_HOST_BIT,
+                        0,
+                        1, &barrier,
+                        0, NULL,
+                        0, NULL);
+
+   vkdf_command_buffer_end(cmd_buf);
+   vkdf_command_buffer_execute_sync(ctx, cmd_buf, 0);
+   vkFreeCommandBuffers(ctx->device, s->cmd_buf.pool[0], 1, &cmd_buf);
+
+   VkDrawIndexedIndirectCommand *draws;
+   vkdf_memory_map(ctx, readback.mem, 0, VK_WHOLE_SIZE, (void **) &draws);
+
+   // Compare the instance counts of the draws of every visible set with
+   // the objects of the set that pass the same test on the CPU
+   const VkdfPlane *planes = vkdf_camera_get_frustum_planes(s->camera);
+   uint32_t mismatches = 0;
+   for (uint32_t i = 0; i < s->thread.num_threads; i++) {
+      GList *iter = s->cmd_buf.active[i];
+      while (iter) {
+         VkdfSceneTile *t = (VkdfSceneTile *) iter->data;
+         GHashTableIter set_iter;
+         VkdfSceneSetInfo *info;
+         g_hash_table_iter_init(&set_iter, t->sets);
+         while (g_hash_table_iter_next(&set_iter, NULL, (void **) &info)) {
+            if (info->count == 0 || info->draws.cull_range < 0)
+               continue;
+
+            uint32_t expected = 0;
+            GList *obj_iter = info->objs;
+            while (obj_iter) {
+               VkdfObject *obj = (VkdfObject *) obj_iter->data;
+               if (box_passes_gpu_cull(vkdf_object_get_box(obj), planes))
+                  expected++;
+               obj_iter = g_list_next(obj_iter);
+            }
+
+            const VkdfSceneCullRange *range =
+               &s->gpu_cull.ranges[info->draws.cull_range];
+            for (uint32_t d = 0; d < range->draw_count; d++) {
+               uint32_t count = draws[range->draw_first + d].instanceCount;
+               if (count != expected) {
+                  vkdf_info("scene: GPU culling: tile %u.%u has %u visible "
+                            "objects, the GPU drew %u.\n",
+                            t->level, t->index, expected, count);
+                  mismatches++;
+                  break;
+               }
+            }
+         }
+         iter = g_list_next(iter);
+      }
+   }
+
+   vkdf_memory_unmap(ctx, readback.mem, readback.mem_props, 0, VK_WHOLE_SIZE);
+   vkdf_destroy_buffer(ctx, &readback);
+
+   return mismatches;
+}
+
+static void
+collect_arena_models(VkdfSceneTile *t, GHashTable *drawn, GHashTable *keep)
+{
+   GHashTableIter iter;
+   VkdfSceneSetInfo *info;
+   g_hash_table_iter_init(&iter, t->sets);
+   while (g_hash_table_iter_next(&iter, NULL, (void **) &info)) {
+      if (info->count == 0)
+         continue;
+
+      VkdfModel *model = ((VkdfObject *) info->objs->data)->model;
+      g_hash_table_add(info->draws.valid ? drawn : keep, model);
+   }
+
+   if (!t->subtiles)
+      return;
+
+   for (uint32_t i = 0; i < 8; i++)
+      collect_arena_models(&t->subtiles[i], drawn, keep);
+}
+
+static VkDeviceSize
+release_geometry_buffer(VkdfContext *ctx, VkdfBuffer *buf)
+{
+   if (buf->buf == 0)
+      return 0;
+
+   VkDeviceSize size = buf->mem_reqs.size;
+   vkdf_destroy_buffer(ctx, buf);
+   buf->buf = 0;
+   return size;
+}
+
+/**
+ * Destroys the per-mesh and per-model buffers of the models that are only
+ * drawn from the geometry arena, so their geometry is not kept twice in
+ * video memory. Models used by dynamic sets or by static sets without
+ * arena draws keep their buffers.
+ */
+static void
+release_static_geometry_buffers(VkdfScene *s)
+{
+   GHashTable *drawn = g_hash_table_new(g_direct_hash, g_direct_equal);
+   GHashTable *keep = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+   for (uint32_t i = 0; i < s->num_tiles.total; i++)
+      collect_arena_models(&s->tiles[i], drawn, keep);
+
+   GHashTableIter iter;
+   VkdfSceneSetInfo *info;
+   g_hash_table_iter_init(&iter, s->dynamic.sets);
+   while (g_hash_table_iter_next(&iter, NULL, (void **) &info)) {
+      if (info->objs)
+         g_hash_table_add(keep, ((VkdfObject *) info->objs->data)->model);
+   }
+
+   s->geometry.released_models =
+      g_hash_table_new(g_direct_hash, g_direct_equal);
+
+   VkDeviceSize released_size = 0;
+   VkdfModel *model;
+   g_hash_table_iter_init(&iter, drawn);
+   while (g_hash_table_iter_next(&iter, (void **) &model, NULL)) {
+      if (g_hash_table_contains(keep, model))
+         continue;
+
+      for (uint32_t i = 0; i < model->meshes.size(); i++) {
+         VkdfMesh *mesh = model->meshes[i];
+         released_size += release_geometry_buffer(s->ctx, &mesh->vertex_buf);
+         released_size += release_geometry_buffer(s->ctx, &mesh->index_buf);
+      }
+      released_size += release_geometry_buffer(s->ctx, &model->vertex_buf);
+      released_size += release_geometry_buffer(s->ctx, &model->index_buf);
+
+      g_hash_table_add(s->geometry.released_models, model);
+   }
+
+   g_hash_table_destroy(drawn);
+   g_hash_table_destroy(keep);
+
+   vkdf_info("scene: released %u models (%.1f MB) drawn from the arena.\n",
+             g_hash_table_size(s->geometry.released_models),
+             released_size / (1024.0 * 1024.0));
+}
+
+/**
+ * Packs all scene models into the geometry arena and builds the draws for
+ * the static sets in every tile at every level of the hierarchy.
+ */
+static void
+prepare_scene_geometry(VkdfScene *s)
+{
+   VkdfContext *ctx = s->ctx;
+
+   if (s->gpu_cull.enabled &&
+       (!ctx->device_features.drawIndirectFirstInstance ||
+        s->static_obj_count == 0)) {
+      vkdf_info("scene: GPU culling not available.\n");
+      s->gpu_cull.enabled = false;
+   }
+   s->gpu_cull.num_slots = s->static_obj_count;
+
+   VkdfStaging *st = NULL;
+   if (!ctx->host_visible_geometry || s->gpu_cull.enabled)
+      st = vkdf_staging_new(ctx);
+
+   s->geometry.arena = vkdf_geometry_arena_new(ctx);
+   GList *iter = s->models;
+   while (iter) {
+      vkdf_geometry_arena_add_model(s->geometry.arena,
+                                    (VkdfModel *) iter->data);
+      iter = g_list_next(iter);
+   }
+   vkdf_geometry_arena_build(s->geometry.arena, st);
+
+   for (uint32_t i = 0; i < s->num_tiles.total; i++)
+      build_tile_draws(s, &s->tiles[i]);
+
+   const uint32_t num_draws = s->geometry.draws.size();
+   s->geometry.use_indirect =
+      num_draws > 0 && ctx->device_features.drawIndirectFirstInstance;
+   s->geometry.use_multi_draw = ctx->device_features.multiDrawIndirect;
+
+   if (s->gpu_cull.ranges.size() == 0)
+      s->gpu_cull.enabled = false;
+
+   if (s->geometry.use_indirect) {
+      VkDeviceSize size = num_draws * sizeof(VkDrawIndexedIndirectCommand);
+      if (s->gpu_cull.enabled) {
+         // The culling pass updates instance counts in place
+         s->geometry.indirect_buf =
+            vkdf_create_buffer(ctx, 0, size,
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+         memcpy(vkdf_staging_upload_to_buffer(st, &s->geometry.indirect_buf,
+                                              0, size),
+                &s->geometry.draws[0], size);
+      } else {
+         uint8_t *map =
+            vkdf_staging_create_geometry_buffer(ctx, st,
+                                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                size,
+                                                &s->geometry.indirect_buf);
+         memcpy(map, &s->geometry.draws[0], size);
+         vkdf_staging_finish_geometry_buffer(ctx, &s->geometry.indirect_buf);
+      }
+   }
+
+   if (s->gpu_cull.enabled)
+      prepare_gpu_culling(s, st);
+
+   if (st)
+      vkdf_staging_free(st);
+
+   if (s->geometry.release_static_buffers)
+      release_static_geometry_buffers(s);
+
+   vkdf_info("scene: %u arena draws (%s%s).\n", num_draws,
+             s->geometry.use_indirect ? "indirect" : "direct",
+             s->gpu_cull.enabled ? ", GPU culled" : "");
+}
+
+static void
+draw_geometry_range(VkdfScene *s,
+                    VkCommandBuffer cmd_buf,
+                    uint32_t first,
+                    uint32_t count)
+{
+   const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+   if (s->geometry.use_indirect && s->geometry.use_multi_draw) {
+      vkCmdDrawIndexedIndirect(cmd_buf,
+                               s->geometry.indirect_buf.buf,
+                               first * stride,      // Offset
+                               count,               // Draw count
+                               stride);             // Stride
+      return;
+   }
+
+   if (s->geometry.use_indirect) {
+      for (uint32_t i = first; i < first + count; i++) {
+         vkCmdDrawIndexedIndirect(cmd_buf,
+                                  s->geometry.indirect_buf.buf,
+                                  i * stride,       // Offset
+                                  1,                // Draw count
+                                  stride);          // Stride
+      }
+      return;
+   }
+
+   for (uint32_t i = first; i < first + count; i++) {
+      const VkDrawIndexedIndirectCommand *draw = &s->geometry.draws[i];
+      vkCmdDrawIndexed(cmd_buf,
+                       draw->indexCount,
+                       draw->instanceCount,
+                       draw->firstIndex,
+                       draw->vertexOffset,
+                       draw->firstInstance);
+   }
+}
+
+void
+vkdf_scene_draw_set(VkdfScene *s,
+                    VkCommandBuffer cmd_buf,
+                    VkdfSceneSetInfo *set_info,
+                    uint32_t lod)
+{
+   assert(set_info->draws.valid);
+
+   lod = MIN2(lod, set_info->draws.num_lods - 1);
+   vkdf_geometry_arena_bind(s->geometry.arena, cmd_buf, set_info->draws.pool);
+   draw_geometry_range(s, cmd_buf,
+                       set_info->draws.first[lod], set_info->draws.count);
+}
+
+void
+vkdf_scene_draw_batches(VkdfScene *s,
+                        VkCommandBuffer cmd_buf,
+                        VkdfSceneSetInfo *set_info,
+                        uint32_t lod)
+{
+   if (set_info->draws.valid) {
+      vkdf_scene_draw_set(s, cmd_buf, set_info, lod);
+      return;
+   }
+
+   VkdfMesh *bound_mesh = NULL;
+   for (uint32_t i = 0; i < set_info->num_batches; i++) {
+      const VkdfSceneDrawBatch *batch = &set_info->batches[i];
+
+      if (batch->mesh != bound_mesh) {
+         const VkDeviceSize offsets[1] = { 0 };
+         vkCmdBindVertexBuffers(cmd_buf,
+                                0,                               // Start Binding
+                                1,                               // Binding Count
+                                &batch->mesh->vertex_buf.buf,    // Buffers
+                                offsets);                        // Offsets
+         bound_mesh = batch->mesh;
+      }
+
+      vkdf_mesh_draw_lod(batch->mesh, cmd_buf, MAX2(batch->lod, lod),
+                         batch->instance_count, batch->first_instance);
+   }
+}
+
+/**
+ * Builds the set's draw batches: one instanced draw per active mesh for each
+ * run of consecutive objects with the same level of detail. Objects in a
+ * set are stored in instance order, so each run is a contiguous range of
+ * instances starting at the set's start index.
+ */
+static void
+build_set_batches(VkdfSceneSetInfo *info)
+{
+   g_free(info->batches);
+   info->batches = NULL;
+   info->num_batches = 0;
+
+   if (info->count == 0)
+      return;
+
+   // All objects in a set share the same model
+   VkdfModel *model = ((VkdfObject *) info->objs->data)->model;
+
+   uint32_t num_runs = 0;
+   uint32_t run_lod = 0;
+   GList *iter = info->objs;
+   while (iter) {
+      VkdfObject *obj = (VkdfObject *) iter->data;
+      if (iter == info->objs || obj->lod != run_lod) {
+         run_lod = obj->lod;
+         num_runs++;
+      }
+      iter = g_list_next(iter);
+   }
+
+   info->batches = g_new(VkdfSceneDrawBatch, num_runs * model->meshes.size());
+
+   uint32_t run_first = info->start_index;
+   uint32_t run_count = 0;
+   iter = info->objs;
+   while (iter) {
+      VkdfObject *obj = (VkdfObject *) iter->data;
+      run_lod = obj->lod;
+      run_count++;
+
+      GList *next = g_list_next(iter);
+      if (!next || ((VkdfObject *) next->data)->lod != run_lod) {
+         for (uint32_t i = 0; i < model->meshes.size(); i++) {
+            VkdfMesh *mesh = model->meshes[i];
+            if (mesh->active == false)
+               continue;
+
+            VkdfSceneDrawBatch *batch = &info->batches[info->num_batches++];
+            batch->mesh = mesh;
+            batch->lod = run_lod;
+            batch->first_instance = run_first;
+            batch->instance_count = run_count;
+         }
+         run_first += run_count;
+         run_count = 0;
+      }
+
+      iter = next;
+   }
+}
+
+static void
+build_tile_batches(VkdfSceneTile *t)
+{
+   GHashTableIter iter;
+   VkdfSceneSetInfo *info;
+   g_hash_table_iter_init(&iter, t->sets);
+   while (g_hash_table_iter_next(&iter, NULL, (void **) &info))
+      build_set_batches(info);
+
+   if (!t->subtiles)
+      return;
+
+   for (uint32_t i = 0; i < 8; i++)
+      build_tile_batches(&t->subtiles[i]);
+}
+
+/**
+ * - Builds object lists for non-leaf (sub)tiles (making sure object
+ *   order is correct)
+ * - Computes (sub)tile starting indices
+ * - Creates static UBO data for scene objects (model matrix, materials, etc)
+ */
+static void
+prepare_scene_objects(VkdfScene *s)
+{
+   s->set_ids = g_list_reverse(s->set_ids);
+   s->models = g_list_reverse(s->models);
+
+   for (uint32_t i = 0; i < s->num_tiles.total; i++) {
+      VkdfSceneTile *t = &s->tiles[i];
+      ensure_set_infos(t, s->set_ids);
 
       GList *iter = s->set_ids;
       while (iter) {
@@ -2701,12 +3987,18 @@ prepare_scene_objects(VkdfScene *s)
       iter = g_list_next(iter);
    }
 
+   for (uint32_t i = 0; i < s->num_tiles.total; i++)
+      build_tile_batches(&s->tiles[i]);
+
    create_static_object_ubo(s);
    create_static_material_ubo(s);
 
    create_dynamic_object_ubo(s);
    create_dynamic_material_ubo(s);
 
+   if (s->geometry.enabled)
+      prepare_scene_geometry(s);
+
    s->static_objs_dirty = false;
 }
 
@@ -2805,15 +4097,26 @@ hash_shadow_map_pipeline_spec(uint32_t vertex_data_stride,
    return primitive << 24 | vertex_data_stride;
 }
 
+struct ShadowMapPipelineJob {
+   VkdfScene *s;
+   uint32_t vertex_data_stride;
+   VkPrimitiveTopology primitive;
+   VkPipeline pipeline;
+};
+
+/**
+ * Creates the shadow map pipeline for a vertex data stride and primitive
+ * topology. This can run on a worker thread: it only reads scene state that
+ * has been setup before the job was dispatched and the pipeline cache is
+ * internally synchronized.
+ */
 static void
-create_shadow_map_pipeline_for_mesh(VkdfScene *s, VkdfMesh *mesh)
+thread_create_shadow_map_pipeline(uint32_t thread_id, void *arg)
 {
-   uint32_t vertex_data_stride = vkdf_mesh_get_vertex_data_stride(mesh);
-   VkPrimitiveTopology primitive = vkdf_mesh_get_primitive(mesh);
-   void *hash = GINT_TO_POINTER(
-      hash_shadow_map_pipeline_spec(vertex_data_stride, primitive));
-   if (g_hash_table_lookup(s->shadows.pipeline.pipelines, hash) != NULL)
-      return;
+   struct ShadowMapPipelineJob *job = (struct ShadowMapPipelineJob *) arg;
+   VkdfScene *s = job->s;
+   uint32_t vertex_data_stride = job->vertex_data_stride;
+   VkPrimitiveTopology primitive = job->primitive;
 
    VkPipelineInputAssemblyStateCreateInfo ia;
    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -2923,10 +4226,6 @@ create_shadow_map_pipeline_for_mesh(VkdfScene *s, VkdfMesh *mesh)
    vi.vertexAttributeDescriptionCount = 1;
    vi.pVertexAttributeDescriptions = vi_attribs;
 
-   if (!s->shadows.shaders.vs) {
-      s->shadows.shaders.vs =
-         vkdf_create_shader_module(s->ctx, SHADOW_MAP_SHADER_PATH);
-   }
    VkPipelineShaderStageCreateInfo shader_stages[1];
    vkdf_pipeline_fill_shader_stage_info(&shader_stages[0],
                                         VK_SHADER_STAGE_VERTEX_BIT,
@@ -2953,15 +4252,68 @@ create_shadow_map_pipeline_for_mesh(VkdfScene *s, VkdfMesh *mesh)
    pipeline_info.renderPass = s->shadows.renderpass;
    pipeline_info.subpass = 0;
 
-   VkPipeline pipeline;
    VK_CHECK(vkCreateGraphicsPipelines(s->ctx->device,
-                                      NULL,
+                                      s->ctx->pipeline_cache,
                                       1,
                                       &pipeline_info,
                                       NULL,
-                                      &pipeline));
+                                      &job->pipeline));
+}
+
+static void
+create_shadow_map_pipeline_for_mesh(VkdfScene *s, VkdfMesh *mesh)
+{
+   uint32_t vertex_data_stride = vkdf_mesh_get_vertex_data_stride(mesh);
+   VkPrimitiveTopology primitive = vkdf_mesh_get_primitive(mesh);
+   void *hash = GINT_TO_POINTER(
+      hash_shadow_map_pipeline_spec(vertex_data_stride, primitive));
+   if (g_hash_table_contains(s->shadows.pipeline.pipelines, hash))
+      return;
+
+   // Reserve the spec so other meshes with the same spec don't queue
+   // another job. The pipeline is filled in when the job is collected.
+   g_hash_table_insert(s->shadows.pipeline.pipelines, hash, NULL);
+
+   struct ShadowMapPipelineJob *job = g_new0(struct ShadowMapPipelineJob, 1);
+   job->s = s;
+   job->vertex_data_stride = vertex_data_stride;
+   job->primitive = primitive;
+   s->shadows.pending_jobs = g_list_prepend(s->shadows.pending_jobs, job);
+
+   if (s->thread.pool) {
+      vkdf_thread_pool_add_job(s->thread.pool,
+                               thread_create_shadow_map_pipeline, job);
+   } else {
+      thread_create_shadow_map_pipeline(0, job);
+   }
+}
+
+/**
+ * Waits for the shadow map pipeline jobs dispatched by
+ * create_shadow_map_pipelines() and makes their pipelines available for
+ * command buffer recording.
+ */
+static void
+finish_shadow_map_pipelines(VkdfScene *s)
+{
+   if (!s->shadows.pending_jobs)
+      return;
+
+   if (s->thread.pool)
+      vkdf_thread_pool_wait(s->thread.pool);
+
+   GList *iter = s->shadows.pending_jobs;
+   while (iter) {
+      struct ShadowMapPipelineJob *job = (struct ShadowMapPipelineJob *) iter->data;
+      void *hash = GINT_TO_POINTER(
+         hash_shadow_map_pipeline_spec(job->vertex_data_stride, job->primitive));
+      g_hash_table_insert(s->shadows.pipeline.pipelines, hash,
+                          (gpointer) job->pipeline);
+      iter = g_list_next(iter);
+   }
 
-   g_hash_table_insert(s->shadows.pipeline.pipelines, hash, (gpointer) pipeline);
+   g_list_free_full(s->shadows.pending_jobs, g_free);
+   s->shadows.pending_jobs = NULL;
 }
 
 /**
@@ -3035,6 +4387,13 @@ create_shadow_map_pipelines(VkdfScene *s)
    // Different meshes may require slightly different pipelines to be rendered
    // to the shadow map to account for varying vertex data strides in the
    // meshes's vertex buffers and different primitive topologies.
+   //
+   // Pipelines are compiled on the thread pool while we continue preparing
+   // the scene, vkdf_scene_prepare() collects them before returning, since
+   // they are not needed until we record the first frame.
+   s->shadows.shaders.vs =
+      vkdf_shader_cache_acquire(s->ctx, SHADOW_MAP_SHADER_PATH);
+
    s->shadows.pipeline.pipelines =
       g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
 
@@ -3099,8 +4458,11 @@ compute_visible_tiles_for_light(VkdfScene *s, VkdfSceneLight *sl)
 
    // Find the list of tiles visible to this light
    // FIXME: thread this?
+   struct TileOccluders no_occluders;
+   no_occluders.count = 0;
    sl->shadow.visible = find_visible_tiles(s, 0, s->num_tiles.total - 1,
-                                           frustum_box, frustum_planes);
+                                           frustum_box, frustum_planes,
+                                           &no_occluders);
 
 #if 0
    // Trim the list of visible tiles further by testing the tiles that
@@ -3206,6 +4568,9 @@ record_shadow_map_commands(VkdfScene *s,
                       VK_SHADER_STAGE_VERTEX_BIT,
                       0, sizeof(_shadow_map_pcb), &sl->shadow.viewproj[0][0]);
 
+   VkdfSceneStats *stats = &s->stage.update.stats;
+   stats->shadow_maps_updated++;
+
    VkPipeline current_pipeline = 0;
 
    // Render static objects
@@ -3233,8 +4598,33 @@ record_shadow_map_commands(VkdfScene *s,
             VkdfSceneSetInfo *set_info =
                (VkdfSceneSetInfo *) g_hash_table_lookup(tile->sets, set_id);
 
-            // If there are shadow caster objects of this type...
-            if (set_info->shadow_caster_count > 0) {
+            // If the set is in the geometry arena we can draw all its
+            // meshes with a single pipeline and buffer binding
+            if (set_info->shadow_caster_count > 0 && set_info->draws.valid) {
+               const VkdfGeometryPool *pool =
+                  &s->geometry.arena->pools[set_info->draws.pool];
+               void *hash = GINT_TO_POINTER(
+                  hash_shadow_map_pipeline_spec(pool->stride, pool->primitive));
+               VkPipeline pipeline = (VkPipeline)
+                  g_hash_table_lookup(s->shadows.pipeline.pipelines, hash);
+               assert(pipeline);
+
+               if (pipeline != current_pipeline) {
+                  vkCmdBindPipeline(s->cmd_buf.update_resources,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    pipeline);
+                  current_pipeline = pipeline;
+               }
+
+               vkdf_geometry_arena_bind(s->geometry.arena,
+                                        s->cmd_buf.update_resources,
+                                        set_info->draws.pool);
+               draw_geometry_range(s, s->cmd_buf.update_resources,
+                                   set_info->draws.shadow_first,
+                                   set_info->draws.count);
+               stats->shadow_draw_calls +=
+                  count_geometry_range_draws(s, set_info->draws.count);
+            } else if (set_info->shadow_caster_count > 0) {
                // Grab the model (it is shared across all objects in the same type)
                VkdfObject *obj = (VkdfObject *) set_info->objs->data;
                VkdfModel *model = obj->model;
@@ -3281,6 +4671,7 @@ record_shadow_map_commands(VkdfScene *s,
                                  s->cmd_buf.update_resources,
                                  set_info->shadow_caster_count,
                                  set_info->shadow_caster_start_index);
+                  stats->shadow_draw_calls++;
                }
             }
             set_iter = g_list_next(set_iter);
@@ -3349,6 +4740,7 @@ record_shadow_map_commands(VkdfScene *s,
                         s->cmd_buf.update_resources,
                         set_info->shadow_caster_count,
                         set_info->shadow_caster_start_index);
+         stats->shadow_draw_calls++;
       }
    }
 
@@ -3428,10 +4820,10 @@ record_dirty_light_resource_updates(VkdfScene *s)
       /* Base light data */
       if (scene_light_is_dirty(sl) || s->light_indices_dirty) {
          assert(light_inst_size < 64 * 1024);
-         vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                           s->ubo.light.buf.buf,
-                           i * light_inst_size, light_inst_size,
-                           sl->light);
+         record_buffer_update(s,
+                              s->ubo.light.buf.buf,
+                              i * light_inst_size, light_inst_size,
+                              sl->light);
       }
 
       /* Eye-space light data */
@@ -3460,10 +4852,10 @@ record_dirty_light_resource_updates(VkdfScene *s)
             s->ubo.light.eye_space_data_offset + i * light_eye_space_size;
 
          assert(light_eye_space_size < 64 * 1024);
-         vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                           s->ubo.light.buf.buf,
-                           offset, light_eye_space_size,
-                           &data);
+         record_buffer_update(s,
+                              s->ubo.light.buf.buf,
+                              offset, light_eye_space_size,
+                              &data);
       }
 
       /* Clip planes */
@@ -3473,10 +4865,10 @@ record_dirty_light_resource_updates(VkdfScene *s)
             s->ubo.light.clip_planes_data_offset + i * light_clip_planes_size;
 
          assert(light_eye_space_size < 64 * 1024);
-         vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                           s->ubo.light.buf.buf,
-                           offset, light_clip_planes_size,
-                           &sl->clip);
+         record_buffer_update(s,
+                              s->ubo.light.buf.buf,
+                              offset, light_clip_planes_size,
+                              &sl->clip);
       }
    }
 
@@ -3509,11 +4901,11 @@ record_dirty_shadow_map_resource_updates(VkdfScene *s)
              &sl->shadow.spec.pcf_kernel_size, sizeof(uint32_t));
 
       assert(shadow_map_inst_size < 64 * 1024);
-      vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                        s->ubo.light.buf.buf,
-                        base_offset + i * shadow_map_inst_size,
-                        shadow_map_inst_size,
-                        &data);
+      record_buffer_update(s,
+                           s->ubo.light.buf.buf,
+                           base_offset + i * shadow_map_inst_size,
+                           shadow_map_inst_size,
+                           &data);
    }
 
    s->cmd_buf.have_resource_updates = true;
@@ -3652,9 +5044,9 @@ record_dynamic_shadow_map_resource_updates(VkdfScene *s,
    if (offset > 0) {
       assert(offset < 64 * 1024);
       uint8_t *mem = (uint8_t *) s->dynamic.ubo.shadow_map.host_buf;
-      vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                        s->dynamic.ubo.shadow_map.buf.buf,
-                        0, offset, mem);
+      record_buffer_update(s,
+                           s->dynamic.ubo.shadow_map.buf.buf,
+                           0, offset, mem);
    }
 }
 
@@ -4396,7 +5788,7 @@ prepare_ssao_rendering(VkdfScene *s)
                                    &s->ssao.base.pipeline.layout));
 
    s->ssao.base.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, SSAO_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSAO_VS_SHADER_PATH);
 
    VkPipelineShaderStageCreateInfo vs_info;
    vkdf_pipeline_fill_shader_stage_info(&vs_info,
@@ -4404,7 +5796,7 @@ prepare_ssao_rendering(VkdfScene *s)
                                         s->ssao.base.pipeline.shader.vs);
 
    s->ssao.base.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, SSAO_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSAO_FS_SHADER_PATH);
 
    VkPipelineShaderStageCreateInfo fs_info;
    VkSpecializationMapEntry entry = { 0, 0, sizeof(uint32_t) };
@@ -4543,7 +5935,7 @@ prepare_ssao_rendering(VkdfScene *s)
                                       &s->ssao.blur.pipeline.layout));
 
       s->ssao.blur.pipeline.shader.vs =
-         vkdf_create_shader_module(s->ctx, SSAO_BLUR_VS_SHADER_PATH);
+         vkdf_shader_cache_acquire(s->ctx, SSAO_BLUR_VS_SHADER_PATH);
 
       VkPipelineShaderStageCreateInfo vs_info;
       vkdf_pipeline_fill_shader_stage_info(&vs_info,
@@ -4552,7 +5944,7 @@ prepare_ssao_rendering(VkdfScene *s)
                                            NULL);
 
       s->ssao.blur.pipeline.shader.fs =
-         vkdf_create_shader_module(s->ctx, SSAO_BLUR_FS_SHADER_PATH);
+         vkdf_shader_cache_acquire(s->ctx, SSAO_BLUR_FS_SHADER_PATH);
 
       VkPipelineShaderStageCreateInfo fs_info;
       VkSpecializationMapEntry entry = { 0, 0, sizeof(uint32_t) };
@@ -4814,10 +6206,10 @@ prepare_tone_mapping(VkdfScene *s,
                                    &s->hdr.pipeline.layout));
 
    s->hdr.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, TONE_MAP_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, TONE_MAP_VS_SHADER_PATH);
 
    s->hdr.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, TONE_MAP_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, TONE_MAP_FS_SHADER_PATH);
 
    s->hdr.pipeline.pipeline =
       vkdf_create_gfx_pipeline(s->ctx,
@@ -4988,10 +6380,10 @@ prepare_fxaa(VkdfScene *s, VkCommandBuffer cmd_buf, const VkdfImage *input)
                                    &s->fxaa.pipeline.layout));
 
    s->fxaa.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, FXAA_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, FXAA_VS_SHADER_PATH);
 
    s->fxaa.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, FXAA_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, FXAA_FS_SHADER_PATH);
 
    s->fxaa.pipeline.pipeline =
       vkdf_create_gfx_pipeline(s->ctx,
@@ -5395,7 +6787,7 @@ create_ssr_blend_pipeline(VkdfScene *s)
    pipeline_info.subpass = 0;
 
    VK_CHECK(vkCreateGraphicsPipelines(s->ctx->device,
-                                      NULL,
+                                      s->ctx->pipeline_cache,
                                       1,
                                       &pipeline_info,
                                       NULL,
@@ -5594,7 +6986,7 @@ prepare_ssr(VkdfScene *s, VkCommandBuffer cmd_buf, const VkdfImage *input)
    VK_CHECK(vkCreatePipelineLayout(s->ctx->device, &base_info, NULL,
                                    &s->ssr.base.pipeline.layout));
    s->ssr.base.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, SSR_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSR_VS_SHADER_PATH);
 
    VkPipelineShaderStageCreateInfo vs_info;
    vkdf_pipeline_fill_shader_stage_info(&vs_info,
@@ -5602,7 +6994,7 @@ prepare_ssr(VkdfScene *s, VkCommandBuffer cmd_buf, const VkdfImage *input)
                                         s->ssr.base.pipeline.shader.vs);
 
    s->ssr.base.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, SSR_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSR_FS_SHADER_PATH);
 
    VkSpecializationInfo fs_spec_info;
    ssr_prepare_specialization_constants(s, &fs_spec_info);
@@ -5718,10 +7110,10 @@ prepare_ssr(VkdfScene *s, VkCommandBuffer cmd_buf, const VkdfImage *input)
                                    &s->ssr.blur.pipeline.layout));
 
    s->ssr.blur.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, SSR_BLUR_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSR_BLUR_VS_SHADER_PATH);
 
    s->ssr.blur.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, SSR_BLUR_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSR_BLUR_FS_SHADER_PATH);
 
    s->ssr.blur.pipeline.pipeline =
       vkdf_create_gfx_pipeline(s->ctx,
@@ -5827,10 +7219,10 @@ prepare_ssr(VkdfScene *s, VkCommandBuffer cmd_buf, const VkdfImage *input)
                                    &s->ssr.blend.pipeline.layout));
 
    s->ssr.blend.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, SSR_BLEND_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSR_BLEND_VS_SHADER_PATH);
 
    s->ssr.blend.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, SSR_BLEND_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, SSR_BLEND_FS_SHADER_PATH);
 
    s->ssr.blend.pipeline.pipeline = create_ssr_blend_pipeline(s);
 
@@ -5971,10 +7363,10 @@ prepare_brightness_filter(VkdfScene *s,
                                    &s->brightness.pipeline.layout));
 
    s->brightness.pipeline.shader.vs =
-      vkdf_create_shader_module(s->ctx, BRIGHTNESS_VS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, BRIGHTNESS_VS_SHADER_PATH);
 
    s->brightness.pipeline.shader.fs =
-      vkdf_create_shader_module(s->ctx, BRIGHTNESS_FS_SHADER_PATH);
+      vkdf_shader_cache_acquire(s->ctx, BRIGHTNESS_FS_SHADER_PATH);
 
    s->brightness.pipeline.pipeline =
       vkdf_create_gfx_pipeline(s->ctx,
@@ -6142,15 +7534,10 @@ prepare_scene_gbuffer_merge_command_buffer(VkdfScene *s)
 {
    assert(!s->cmd_buf.gbuffer_merge);
 
-   VkCommandBuffer cmd_buf;
-
-   vkdf_create_command_buffer(s->ctx,
-                              s->cmd_buf.pool[0],
-                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                              1, &cmd_buf);
+   VkCommandBuffer cmd_buf = get_frame_cmd_buf(s, 0);
 
    vkdf_command_buffer_begin(cmd_buf,
-                             VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
    uint32_t num_clear_values;
    VkClearValue *clear_values;
@@ -6162,25 +7549,326 @@ prepare_scene_gbuffer_merge_command_buffer(VkdfScene *s)
       clear_values = NULL;
    }
 
-   VkRenderPassBeginInfo rp_begin =
-      vkdf_renderpass_begin_new(s->rp.gbuffer_merge.renderpass,
-                                s->rp.gbuffer_merge.framebuffer,
-                                0, 0, s->rt.width, s->rt.height,
-                                num_clear_values, clear_values);
+   VkRenderPassBeginInfo rp_begin =
+      vkdf_renderpass_begin_new(s->rp.gbuffer_merge.renderpass,
+                                s->rp.gbuffer_merge.framebuffer,
+                                0, 0, s->rt.width, s->rt.height,
+                                num_clear_values, clear_values);
+
+   vkCmdBeginRenderPass(cmd_buf,
+                        &rp_begin,
+                        VK_SUBPASS_CONTENTS_INLINE);
+
+   record_viewport_and_scissor_commands(cmd_buf, s->rt.width, s->rt.height);
+
+   s->callbacks.gbuffer_merge(s->ctx, cmd_buf, s->callbacks.data);
+
+   vkCmdEndRenderPass(cmd_buf);
+
+   vkdf_command_buffer_end(cmd_buf);
+
+   s->cmd_buf.gbuffer_merge = cmd_buf;
+}
+
+struct _hiz_reduce_pcb {
+   glm::uvec2 src_size;
+   glm::uvec2 dst_size;
+   uint32_t block;
+};
+
+static void
+record_occlusion_cmd_buf(VkdfScene *s)
+{
+   VkCommandBuffer cmd_buf;
+   vkdf_create_command_buffer(s->ctx,
+                              s->cmd_buf.pool[0],
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &cmd_buf);
+
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+
+   VkImageSubresourceRange subresource_range =
+      vkdf_create_image_subresource_range(VK_IMAGE_ASPECT_DEPTH_BIT,
+                                          0, 1, 0, 1);
+
+   vkdf_image_set_layout(cmd_buf,
+                         s->rt.depth.image,
+                         subresource_range,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+   vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                     s->occlusion.pipeline);
+
+   VkDescriptorSet sets[] = {
+      s->occlusion.sampler_set,
+      s->occlusion.buf_set,
+   };
+
+   vkCmdBindDescriptorSets(cmd_buf,
+                           VK_PIPELINE_BIND_POINT_COMPUTE,
+                           s->occlusion.layout,
+                           0,                        // First decriptor set
+                           2,                        // Descriptor set count
+                           sets,                     // Descriptor sets
+                           0,                        // Dynamic offset count
+                           NULL);                    // Dynamic offsets
+
+   struct _hiz_reduce_pcb pcb;
+   pcb.src_size = glm::uvec2(s->rt.width, s->rt.height);
+   pcb.dst_size = s->occlusion.size;
+   pcb.block = OCCLUSION_HIZ_BLOCK;
+
+   vkCmdPushConstants(cmd_buf,
+                      s->occlusion.layout,
+                      VK_SHADER_STAGE_COMPUTE_BIT,
+                      0, sizeof(pcb), &pcb);
+
+   vkCmdDispatch(cmd_buf,
+                 (s->occlusion.size.x + 7) / 8,
+                 (s->occlusion.size.y + 7) / 8,
+                 1);
+
+   // Make the result available to the host and return the depth buffer to
+   // the layout expected by the render passes
+   VkMemoryBarrier barrier;
+   barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+   barrier.pNext = NULL;
+   barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_HOST_BIT,
+                        0,
+                        1, &barrier,
+                        0, NULL,
+                        0, NULL);
+
+   vkdf_image_set_layout(cmd_buf,
+                         s->rt.depth.image,
+                         subresource_range,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+
+   vkdf_command_buffer_end(cmd_buf);
+
+   s->occlusion.cmd_buf = cmd_buf;
+}
+
+static void
+prepare_occlusion_culling(VkdfScene *s)
+{
+   if (!s->occlusion.enabled)
+      return;
+
+   if (!s->rp.do_depth_prepass) {
+      vkdf_info("scene: occlusion culling requires the depth-prepass.\n");
+      s->occlusion.enabled = false;
+      return;
+   }
+
+   VkdfContext *ctx = s->ctx;
+
+   s->occlusion.hiz = vkdf_hiz_new(s->rt.width, s->rt.height,
+                                   OCCLUSION_HIZ_BLOCK);
+   s->occlusion.size = glm::uvec2(vkdf_hiz_get_base_width(s->occlusion.hiz),
+                                  vkdf_hiz_get_base_height(s->occlusion.hiz));
+
+   // Readback buffer for the reduced depth, mapped for the lifetime of the
+   // scene
+   s->occlusion.buf =
+      vkdf_create_buffer(ctx, 0,
+                         s->occlusion.size.x * s->occlusion.size.y *
+                            sizeof(float),
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+   vkdf_memory_map(ctx, s->occlusion.buf.mem, 0, VK_WHOLE_SIZE,
+                   (void **) &s->occlusion.map);
+
+   // Descriptor sets: depth buffer and readback buffer
+   s->occlusion.sampler =
+      vkdf_create_sampler(ctx,
+                          VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                          VK_FILTER_NEAREST,
+                          VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                          0.0f);
+
+   s->occlusion.sampler_set_layout =
+      vkdf_create_sampler_descriptor_set_layout(ctx, 0, 1,
+                                                VK_SHADER_STAGE_COMPUTE_BIT);
+   s->occlusion.sampler_set =
+      vkdf_descriptor_set_create(ctx, s->sampler.pool,
+                                 s->occlusion.sampler_set_layout);
+   vkdf_descriptor_set_sampler_update(ctx,
+                                      s->occlusion.sampler_set,
+                                      s->occlusion.sampler,
+                                      s->rt.depth.view,
+                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      0, 1);
+
+   s->occlusion.pool =
+      vkdf_create_descriptor_pool(ctx, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1);
+   s->occlusion.buf_set_layout =
+      vkdf_create_ssbo_descriptor_set_layout(ctx, 0, 1,
+                                             VK_SHADER_STAGE_COMPUTE_BIT,
+                                             false);
+   s->occlusion.buf_set =
+      vkdf_descriptor_set_create(ctx, s->occlusion.pool,
+                                 s->occlusion.buf_set_layout);
+
+   VkDeviceSize offset = 0;
+   VkDeviceSize range = VK_WHOLE_SIZE;
+   vkdf_descriptor_set_buffer_update(ctx, s->occlusion.buf_set,
+                                     s->occlusion.buf.buf,
+                                     0, 1, &offset, &range, false, false);
+
+   // Pipeline
+   VkPushConstantRange pcb_range;
+   pcb_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+   pcb_range.offset = 0;
+   pcb_range.size = sizeof(struct _hiz_reduce_pcb);
+
+   VkDescriptorSetLayout set_layouts[] = {
+      s->occlusion.sampler_set_layout,
+      s->occlusion.buf_set_layout,
+   };
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = &pcb_range;
+   pipeline_layout_info.setLayoutCount = 2;
+   pipeline_layout_info.pSetLayouts = set_layouts;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &s->occlusion.layout));
+
+   s->occlusion.cs = vkdf_shader_cache_acquire(ctx, HIZ_REDUCE_CS_SHADER_PATH);
+   s->occlusion.pipeline =
+      vkdf_create_compute_pipeline(ctx, NULL, s->occlusion.layout,
+                                   s->occlusion.cs);
+
+   // Synchronization
+   s->occlusion.sem = vkdf_create_semaphore(ctx);
+   s->occlusion.fence = vkdf_create_fence(ctx);
+   s->occlusion.pending = false;
+   s->occlusion.dirty = false;
+
+   record_occlusion_cmd_buf(s);
+}
+
+/**
+ * Reduces the depth-prepass output for the current frame into the readback
+ * buffer (see capture_draw_state() for when we request this). Updates
+ * 'wait_sem' so the next rendering job waits for the reduction.
+ */
+static void
+submit_occlusion_update(VkdfScene *s,
+                        VkdfSubmitBatch *batch,
+                        VkSemaphore **wait_sem)
+{
+   VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+   vkdf_submit_batch_add(batch,
+                         s->occlusion.cmd_buf,
+                         &wait_stage,
+                         1, *wait_sem,
+                         1, &s->occlusion.sem);
+
+   // The fence covers everything in the batch, which is only work that
+   // the occlusion update depends on anyway
+   vkdf_submit_batch_flush(s->ctx, batch, s->occlusion.fence);
+   *wait_sem = &s->occlusion.sem;
+}
+
+/**
+ * Rebuilds the hierarchical depth buffer if a readback has completed. If
+ * it was rendered from a different view than the previous one, tile
+ * visibility needs to be re-evaluated even if the camera didn't change
+ * since, since the previous evaluation used stale occlusion data.
+ */
+static void
+update_occlusion_data(VkdfScene *s)
+{
+   if (!s->occlusion.pending ||
+       vkGetFenceStatus(s->ctx->device, s->occlusion.fence) != VK_SUCCESS) {
+      return;
+   }
+
+   vkResetFences(s->ctx->device, 1, &s->occlusion.fence);
+   s->occlusion.pending = false;
+
+   VkdfHiZ *hiz = s->occlusion.hiz;
+   if (!hiz->valid || hiz->view_proj != s->occlusion.pending_view_proj)
+      s->occlusion.dirty = true;
 
-   vkCmdBeginRenderPass(cmd_buf,
-                        &rp_begin,
-                        VK_SUBPASS_CONTENTS_INLINE);
+   vkdf_hiz_update(hiz, s->occlusion.map, s->occlusion.pending_view_proj);
+}
 
-   record_viewport_and_scissor_commands(cmd_buf, s->rt.width, s->rt.height);
+static void
+prepare_sw_occlusion_culling(VkdfScene *s)
+{
+   if (!s->sw_occlusion.enabled)
+      return;
 
-   s->callbacks.gbuffer_merge(s->ctx, cmd_buf, s->callbacks.data);
+   const uint32_t height =
+      MAX2(SW_OCCLUSION_WIDTH * s->rt.height / s->rt.width, 1);
+   s->sw_occlusion.raster = vkdf_sw_occlusion_new(SW_OCCLUSION_WIDTH, height);
+}
 
-   vkCmdEndRenderPass(cmd_buf);
+/**
+ * Rasterizes the occluders in the camera view if the camera or any of the
+ * dynamic occluders changed.
+ */
+static void
+update_sw_occlusion_data(VkdfScene *s)
+{
+   bool needs_update =
+      vkdf_camera_is_dirty(s->camera) || s->dynamic_objs_dirty;
 
-   vkdf_command_buffer_end(cmd_buf);
+   GList *iter = s->sw_occlusion.occluders;
+   while (!needs_update && iter) {
+      VkdfObject *obj = (VkdfObject *) iter->data;
+      needs_update = vkdf_object_is_dynamic(obj) && vkdf_object_is_dirty(obj);
+      iter = g_list_next(iter);
+   }
 
-   s->cmd_buf.gbuffer_merge = cmd_buf;
+   if (!needs_update)
+      return;
+
+   const VkdfBox *cam_box = vkdf_camera_get_frustum_box(s->camera);
+   const VkdfPlane *cam_planes = vkdf_camera_get_frustum_planes(s->camera);
+   const glm::mat4 view_proj =
+      (*vkdf_camera_get_projection_ptr(s->camera)) *
+      vkdf_camera_get_view_matrix(s->camera);
+
+   VkdfSwOcclusion *raster = s->sw_occlusion.raster;
+   vkdf_sw_occlusion_begin(raster, view_proj);
+
+   // Always use the full detail geometry, since simplified levels of
+   // detail may cover pixels the actual geometry doesn't
+   iter = s->sw_occlusion.occluders;
+   while (iter) {
+      VkdfObject *obj = (VkdfObject *) iter->data;
+      if (vkdf_box_is_in_frustum(vkdf_object_get_box(obj),
+                                 cam_box, cam_planes) != OUTSIDE) {
+         vkdf_sw_occlusion_draw_object(raster, obj, 0);
+      }
+      iter = g_list_next(iter);
+   }
+
+   vkdf_sw_occlusion_end(raster);
+   s->sw_occlusion.dirty = true;
 }
 
 /**
@@ -6193,6 +7881,9 @@ vkdf_scene_prepare(VkdfScene *s)
    prepare_scene_objects(s);
    prepare_scene_lights(s);
    prepare_scene_render_passes(s);
+   prepare_occlusion_culling(s);
+   prepare_sw_occlusion_culling(s);
+   finish_shadow_map_pipelines(s);
 }
 
 static void
@@ -6210,11 +7901,177 @@ record_dynamic_objects_command_buffer(VkdfScene *s,
    const bool is_depth_prepass =
       rp_begin->renderPass == s->rp.dpp_dynamic_geom.renderpass;
    s->callbacks.record_commands(s->ctx, cmd_buf, s->dynamic.visible,
-                                true, is_depth_prepass, s->callbacks.data);
+                                true, is_depth_prepass, 0, s->callbacks.data);
+
+   vkCmdEndRenderPass(cmd_buf);
+
+   vkdf_command_buffer_end(cmd_buf);
+}
+
+static void
+thread_record_dynamic_objects(uint32_t thread_id, void *arg)
+{
+   struct DynamicThreadData *data = (struct DynamicThreadData *) arg;
+   VkdfScene *s = data->s;
+   VKDF_PROFILE_ZONE(s->ctx->profiler, "scene-dynamic-job");
+
+   VkCommandBufferUsageFlags flags =
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+      VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+   VkCommandBufferInheritanceInfo inheritance_info;
+   inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+   inheritance_info.pNext = NULL;
+   inheritance_info.renderPass = s->rp.dynamic_geom.renderpass;
+   inheritance_info.subpass = 0;
+   inheritance_info.framebuffer = s->rp.dynamic_geom.framebuffer;
+   inheritance_info.occlusionQueryEnable = 0;
+   inheritance_info.queryFlags = 0;
+   inheritance_info.pipelineStatistics = 0;
+
+   uint32_t num_cmd_bufs = s->rp.do_depth_prepass ? 2 : 1;
+   for (uint32_t i = 0; i < num_cmd_bufs; i++) {
+      const bool is_depth_prepass = i == 1;
+      if (is_depth_prepass) {
+         inheritance_info.renderPass = s->rp.dpp_dynamic_geom.renderpass;
+         inheritance_info.framebuffer = s->rp.dpp_dynamic_geom.framebuffer;
+      }
+
+      VkCommandBuffer cmd_buf =
+         get_frame_cmd_buf(s, thread_id, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+      vkdf_command_buffer_begin_secondary(cmd_buf, flags, &inheritance_info);
+
+      record_viewport_and_scissor_commands(cmd_buf, s->rt.width, s->rt.height);
+
+      s->callbacks.record_commands(s->ctx, cmd_buf, data->sets,
+                                   true, is_depth_prepass, 0,
+                                   s->callbacks.data);
+
+      vkdf_command_buffer_end(cmd_buf);
+
+      data->cmd_buf[i] = cmd_buf;
+   }
+}
+
+/**
+ * Records a primary that executes the dynamic object secondaries recorded
+ * by the first 'num_jobs' threads ('index' selects the color or the
+ * depth-prepass ones).
+ */
+static VkCommandBuffer
+record_dynamic_objects_primary(VkdfScene *s,
+                               VkRenderPassBeginInfo *rp_begin,
+                               uint32_t num_jobs,
+                               uint32_t index)
+{
+   VkCommandBuffer *secondaries = g_new(VkCommandBuffer, num_jobs);
+   for (uint32_t i = 0; i < num_jobs; i++)
+      secondaries[i] = s->thread.dynamic_data[i].cmd_buf[index];
+
+   VkCommandBuffer cmd_buf = get_frame_cmd_buf(s, 0);
+
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   vkCmdBeginRenderPass(cmd_buf, rp_begin,
+                        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+   vkCmdExecuteCommands(cmd_buf, num_jobs, secondaries);
 
    vkCmdEndRenderPass(cmd_buf);
 
    vkdf_command_buffer_end(cmd_buf);
+
+   g_free(secondaries);
+
+   return cmd_buf;
+}
+
+/**
+ * Records the dynamic object command buffers for the frame. With a thread
+ * pool, the visible sets are split across threads (balancing the number of
+ * objects each one records) and each thread records its share into its own
+ * secondaries, which are then executed from a single primary. Otherwise,
+ * or if there is only one set to record, we record the primary directly.
+ */
+static void
+record_dynamic_objects_command_buffers(VkdfScene *s)
+{
+   const uint32_t max_jobs = s->thread.pool ? s->thread.num_threads : 1;
+
+   for (uint32_t i = 0; i < max_jobs; i++) {
+      g_hash_table_remove_all(s->thread.dynamic_data[i].sets);
+      s->thread.dynamic_data[i].obj_count = 0;
+   }
+
+   // Assign each set to the job with the fewest objects so far. Empty jobs
+   // are picked first, so the jobs in use are always the first 'num_jobs'.
+   uint32_t num_jobs = 0;
+   char *id;
+   VkdfSceneSetInfo *info;
+   GHashTableIter iter;
+   g_hash_table_iter_init(&iter, s->dynamic.visible);
+   while (g_hash_table_iter_next(&iter, (void **)&id, (void **)&info)) {
+      if (!info || info->count == 0)
+         continue;
+
+      uint32_t job = 0;
+      for (uint32_t i = 1; i < max_jobs; i++) {
+         if (s->thread.dynamic_data[i].obj_count <
+             s->thread.dynamic_data[job].obj_count)
+            job = i;
+      }
+
+      g_hash_table_insert(s->thread.dynamic_data[job].sets, id, info);
+      s->thread.dynamic_data[job].obj_count += info->count;
+      num_jobs = MAX2(num_jobs, job + 1);
+   }
+
+   VkRenderPassBeginInfo rp_begin =
+      vkdf_renderpass_begin_new(s->rp.dynamic_geom.renderpass,
+                                s->rp.dynamic_geom.framebuffer,
+                                0, 0, s->rt.width, s->rt.height,
+                                0, NULL);
+
+   VkRenderPassBeginInfo dpp_rp_begin;
+   if (s->rp.do_depth_prepass) {
+      dpp_rp_begin =
+         vkdf_renderpass_begin_new(s->rp.dpp_dynamic_geom.renderpass,
+                                   s->rp.dpp_dynamic_geom.framebuffer,
+                                   0, 0, s->rt.width, s->rt.height,
+                                   0, NULL);
+   }
+
+   if (num_jobs <= 1) {
+      s->cmd_buf.dynamic = get_frame_cmd_buf(s, 0);
+      record_dynamic_objects_command_buffer(s, s->cmd_buf.dynamic, &rp_begin);
+
+      if (s->rp.do_depth_prepass) {
+         s->cmd_buf.dpp_dynamic = get_frame_cmd_buf(s, 0);
+         record_dynamic_objects_command_buffer(s, s->cmd_buf.dpp_dynamic,
+                                               &dpp_rp_begin);
+      }
+      return;
+   }
+
+   for (uint32_t i = 0; i < num_jobs; i++) {
+      vkdf_thread_pool_add_job(s->thread.pool,
+                               thread_record_dynamic_objects,
+                               &s->thread.dynamic_data[i]);
+   }
+   vkdf_thread_pool_wait(s->thread.pool);
+
+   s->stage.update.stats.secondaries_recorded +=
+      num_jobs * (s->rp.do_depth_prepass ? 2 : 1);
+
+   s->cmd_buf.dynamic =
+      record_dynamic_objects_primary(s, &rp_begin, num_jobs, 0);
+
+   if (s->rp.do_depth_prepass) {
+      s->cmd_buf.dpp_dynamic =
+         record_dynamic_objects_primary(s, &dpp_rp_begin, num_jobs, 1);
+   }
 }
 
 static inline bool
@@ -6224,12 +8081,43 @@ is_light_volume_set(const char *id)
           strcmp(id, VKDF_SCENE_LIGHT_VOL_SPOT_ID) == 0;
 }
 
+/**
+ * Whether the box is hidden according to any of the enabled occlusion
+ * culling methods.
+ */
+static inline bool
+is_box_occluded(VkdfScene *s, const VkdfBox *box)
+{
+   if (s->occlusion.enabled &&
+       vkdf_hiz_is_box_occluded(s->occlusion.hiz, box))
+      return true;
+
+   if (s->sw_occlusion.enabled &&
+       vkdf_sw_occlusion_is_box_occluded(s->sw_occlusion.raster, box))
+      return true;
+
+   return false;
+}
+
+static gint
+compare_object_lod(gconstpointer a, gconstpointer b)
+{
+   const VkdfObject *obj_a = (const VkdfObject *) a;
+   const VkdfObject *obj_b = (const VkdfObject *) b;
+   return (gint) obj_a->lod - (gint) obj_b->lod;
+}
+
 static void
 update_dirty_objects(VkdfScene *s)
 {
-   // Only need to do anything if we have dynamic objects
-   if (s->obj_count == s->static_obj_count)
+   // Only need to do anything if we have dynamic objects. Command buffers
+   // recorded for previous frames are recycled with their frame, so make
+   // sure we don't keep them around.
+   if (s->obj_count == s->static_obj_count) {
+      s->cmd_buf.dynamic = 0;
+      s->cmd_buf.dpp_dynamic = 0;
       return;
+   }
 
    const VkdfBox *cam_box = vkdf_camera_get_frustum_box(s->camera);
    const VkdfPlane *cam_planes = vkdf_camera_get_frustum_planes(s->camera);
@@ -6262,6 +8150,7 @@ update_dirty_objects(VkdfScene *s)
          g_hash_table_replace(s->dynamic.visible, g_strdup(id), vis_info);
       } else if (vis_info->objs) {
          g_list_free(vis_info->objs);
+         g_free(vis_info->batches);
          memset(vis_info, 0, sizeof(VkdfSceneSetInfo));
       }
 
@@ -6303,8 +8192,11 @@ update_dirty_objects(VkdfScene *s)
          // (or maybe more procisely, it has not moved) and the
          // camera is not dirty and the object was visible in the previous
          // frame.
+         // Light volumes are never occlusion culled, since they can
+         // contain the geometry they light
          VkdfBox *obj_box = vkdf_object_get_box(obj);
-         if (vkdf_box_is_in_frustum(obj_box, cam_box, cam_planes) != OUTSIDE) {
+         if (vkdf_box_is_in_frustum(obj_box, cam_box, cam_planes) != OUTSIDE &&
+             (is_light_volume || !is_box_occluded(s, obj_box))) {
             // Add the object to the corresponding visible list (we track
             // light volumes for shadow casting lights separately) and update
             // visibility counters
@@ -6315,6 +8207,8 @@ update_dirty_objects(VkdfScene *s)
                visible = g_list_prepend(visible, obj);
             }
 
+            obj->lod = vkdf_scene_select_lod(s, obj_box, obj->lod);
+
             vis_info->count++;
             if (vkdf_object_casts_shadows(obj)) {
                vis_info->shadow_caster_count++;
@@ -6328,9 +8222,13 @@ update_dirty_objects(VkdfScene *s)
 
       /* Merge all light volumes for lights with shadows enabled at the
        * begining of the list so applications can use instancing to render
-       * the lights with and without shadows.
+       * the lights with and without shadows. Objects are sorted by level of
+       * detail within each group so they can be instanced together.
        */
+      visible_slv = g_list_sort(visible_slv, compare_object_lod);
+      visible = g_list_sort(visible, compare_object_lod);
       vis_info->objs = g_list_concat(visible_slv, visible);
+      build_set_batches(vis_info);
 
       /* Now that we have our objects properly sorted, proceed to update
        * the UBO
@@ -6388,10 +8286,10 @@ update_dirty_objects(VkdfScene *s)
          const VkDeviceSize update_size = num_materials * material_size;
 
          assert(update_size < 64 * 1024);
-         vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                           s->dynamic.ubo.material.buf.buf,
-                           update_offset, update_size,
-                           &model->materials[0]);
+         record_buffer_update(s,
+                              s->dynamic.ubo.material.buf.buf,
+                              update_offset, update_size,
+                              &model->materials[0]);
 
          model->materials_dirty = false;
       }
@@ -6419,46 +8317,16 @@ update_dirty_objects(VkdfScene *s)
        * buffers that are not being accessed by commands in execution.
        */
       assert(obj_offset < 64 * 1024);
-      vkCmdUpdateBuffer(s->cmd_buf.update_resources,
-                        s->dynamic.ubo.obj.buf.buf,
-                        0, obj_offset,
-                        s->dynamic.ubo.obj.host_buf);
+      record_buffer_update(s,
+                           s->dynamic.ubo.obj.buf.buf,
+                           0, obj_offset,
+                           s->dynamic.ubo.obj.host_buf);
    }
 
-   // Record dynamic object rendering command buffer
-   if (s->cmd_buf.dynamic)
-      new_inactive_cmd_buf(s, 0, s->cmd_buf.dynamic);
-   if (s->cmd_buf.dpp_dynamic)
-      new_inactive_cmd_buf(s, 0, s->cmd_buf.dpp_dynamic);
-
+   // Record dynamic object rendering command buffer. The ones from the
+   // previous frame are recycled with that frame's command pool.
    if (s->dynamic.visible_obj_count > 0) {
-      VkCommandBuffer cmd_buf[2];
-      vkdf_create_command_buffer(s->ctx,
-                                 s->cmd_buf.pool[0],
-                                 VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                                 s->rp.do_depth_prepass ? 2 : 1, cmd_buf);
-
-      VkRenderPassBeginInfo rp_begin =
-         vkdf_renderpass_begin_new(s->rp.dynamic_geom.renderpass,
-                                   s->rp.dynamic_geom.framebuffer,
-                                   0, 0, s->rt.width, s->rt.height,
-                                   0, NULL);
-
-      record_dynamic_objects_command_buffer(s, cmd_buf[0], &rp_begin);
-
-      s->cmd_buf.dynamic = cmd_buf[0];
-
-      if (s->rp.do_depth_prepass) {
-         rp_begin =
-            vkdf_renderpass_begin_new(s->rp.dpp_dynamic_geom.renderpass,
-                                      s->rp.dpp_dynamic_geom.framebuffer,
-                                      0, 0, s->rt.width, s->rt.height,
-                                      0, NULL);
-
-         record_dynamic_objects_command_buffer(s, cmd_buf[1], &rp_begin);
-
-         s->cmd_buf.dpp_dynamic = cmd_buf[1];
-      }
+      record_dynamic_objects_command_buffers(s);
    } else {
       s->cmd_buf.dynamic = 0;
       s->cmd_buf.dpp_dynamic = 0;
@@ -6471,6 +8339,7 @@ thread_update_cmd_bufs(uint32_t thread_id, void *arg)
    struct TileThreadData *data = (struct TileThreadData *) arg;
 
    VkdfScene *s = data->s;
+   VKDF_PROFILE_ZONE(s->ctx->profiler, "scene-tile-job");
 
    const VkdfBox *visible_box = data->visible_box;
    const VkdfPlane *fplanes = data->fplanes;
@@ -6478,10 +8347,17 @@ thread_update_cmd_bufs(uint32_t thread_id, void *arg)
    uint32_t first_idx = data->first_idx;
    uint32_t last_idx = data->last_idx;
 
-   // Find visible tiles
+   // Find visible tiles that are not hidden behind the occlusion data
+   struct TileOccluders occ;
+   occ.count = 0;
+   if (s->occlusion.enabled)
+      occ.hiz[occ.count++] = s->occlusion.hiz;
+   if (s->sw_occlusion.enabled)
+      occ.hiz[occ.count++] = s->sw_occlusion.raster->hiz;
+
    GList *prev_visible = data->visible;
    GList *cur_visible =
-      find_visible_tiles(s, first_idx, last_idx, visible_box, fplanes);
+      find_visible_tiles(s, first_idx, last_idx, visible_box, fplanes, &occ);
 
    // Identify new invisible tiles
    data->cmd_buf_changes = false;
@@ -6495,13 +8371,24 @@ thread_update_cmd_bufs(uint32_t thread_id, void *arg)
       iter = g_list_next(iter);
    }
 
-   // Identify new visible tiles
+   // Identify new visible tiles and tiles that switched level of detail
    iter = cur_visible;
    while (iter) {
       VkdfSceneTile *t = (VkdfSceneTile *) iter->data;
-      if (t->obj_count > 0 && !g_list_find(prev_visible, t)) {
-         new_active_tile(data, t);
-         data->cmd_buf_changes = true;
+      if (t->obj_count > 0) {
+         uint32_t lod = vkdf_scene_select_lod(s, &t->box, t->lod);
+         if (!g_list_find(prev_visible, t)) {
+            t->lod = lod;
+            new_active_tile(data, t);
+            data->cmd_buf_changes = true;
+         } else if (lod != t->lod) {
+            t->lod = lod;
+            s->cmd_buf.active[data->id] =
+               g_list_remove(s->cmd_buf.active[data->id], t);
+            discard_tile_cmd_bufs(s, data->id, t);
+            new_active_tile(data, t);
+            data->cmd_buf_changes = true;
+         }
       }
       iter = g_list_next(iter);
    }
@@ -6549,6 +8436,108 @@ update_cmd_bufs(VkdfScene *s)
    return cmd_buf_changes;
 }
 
+/**
+ * Starts counting the work for a new frame in the update stage.
+ */
+static void
+start_frame_stats(VkdfScene *s)
+{
+   VkdfSceneStats *stats = &s->stage.update.stats;
+   memset(stats, 0, sizeof(VkdfSceneStats));
+   stats->frame = ++s->stats.frame;
+
+   for (uint32_t i = 0; i < s->thread.num_threads; i++)
+      s->thread.tile_data[i].num_recorded = 0;
+}
+
+/**
+ * Adds up the work for the visible tiles and dynamic objects of the frame.
+ * Other counters are updated as the work is done.
+ */
+static void
+finish_frame_stats(VkdfScene *s)
+{
+   VkdfSceneStats *stats = &s->stage.update.stats;
+   const uint32_t num_passes = s->rp.do_depth_prepass ? 2 : 1;
+
+   uint32_t tile_recorded = 0;
+   for (uint32_t i = 0; i < s->thread.num_threads; i++) {
+      GList *iter = s->cmd_buf.active[i];
+      while (iter) {
+         VkdfSceneTile *t = (VkdfSceneTile *) iter->data;
+         stats->visible_tiles++;
+         stats->visible_static_objs += t->obj_count;
+         stats->draw_calls += t->num_draws * num_passes;
+         iter = g_list_next(iter);
+      }
+      tile_recorded += s->thread.tile_data[i].num_recorded;
+   }
+   // Tiles that became visible or changed level of detail were recorded
+   // this frame, the rest are reused
+   stats->secondaries_recorded += tile_recorded;
+   stats->secondaries_reused =
+      stats->visible_tiles * num_passes - tile_recorded;
+
+   if (s->cmd_buf.dynamic) {
+      stats->visible_dynamic_objs = s->dynamic.visible_obj_count;
+      stats->draw_calls +=
+         count_sets_draws(s, s->dynamic.visible) * num_passes;
+   }
+
+   stats->draw_calls += stats->shadow_draw_calls;
+}
+
+/**
+ * Captures everything the render stage needs to submit the frame we just
+ * prepared and moves on to the next frame in flight. After this, the update
+ * stage can start working on the next frame without interfering with the
+ * submission of this one.
+ */
+static void
+capture_draw_state(VkdfScene *s)
+{
+   VkdfSceneDrawState *ds = &s->stage.update;
+
+   ds->frame_idx = s->sync.frame_idx;
+   ds->have_resource_updates = s->cmd_buf.have_resource_updates;
+   ds->update_resources = s->cmd_buf.update_resources;
+   ds->dpp_primary = s->cmd_buf.dpp_primary[s->cmd_buf.cur_idx];
+   ds->dpp_dynamic = s->cmd_buf.dpp_dynamic;
+   ds->primary = s->cmd_buf.primary[s->cmd_buf.cur_idx];
+   ds->dynamic = s->cmd_buf.dynamic;
+   ds->ssao = s->ssao.enabled ? s->ssao.cmd_buf : 0;
+   ds->gbuffer_merge = s->cmd_buf.gbuffer_merge;
+   ds->postprocess = s->cmd_buf.postprocess;
+
+   // Request a new occlusion data readback for this view, unless the
+   // previous one hasn't been consumed yet
+   ds->occlusion_update = false;
+   if (s->occlusion.enabled && s->rp.do_depth_prepass &&
+       !s->occlusion.pending) {
+      ds->occlusion_update = true;
+      s->occlusion.pending = true;
+      s->occlusion.pending_view_proj =
+         (*vkdf_camera_get_projection_ptr(s->camera)) *
+         vkdf_camera_get_view_matrix(s->camera);
+   }
+
+   // Anything retired while preparing this frame may still be used by the
+   // previous frames in flight, so release it with this one
+   retire_inactive_resources(s, &s->sync.frame[s->sync.frame_idx]);
+   s->sync.frame_idx = (s->sync.frame_idx + 1) % SCENE_FRAMES_IN_FLIGHT;
+}
+
+/**
+ * Hands the state captured by the last update over to the render stage.
+ * Must be called while neither stage is running.
+ */
+static inline void
+sync_draw_state(VkdfScene *s)
+{
+   s->stats.last = s->stage.render.stats;
+   s->stage.render = s->stage.update;
+}
+
 static void
 scene_update(VkdfScene *s)
 {
@@ -6558,10 +8547,24 @@ scene_update(VkdfScene *s)
    if (s->callbacks.update_state)
       s->callbacks.update_state(s->callbacks.data);
 
-   // Check if any fences have been signaled and if so free any disposable
-   // command buffers that were pending execution on signaled fences
-   if (check_fences(s))
-      free_inactive_resources(s);
+   start_frame_stats(s);
+
+   // We are about to reuse the resources of the frame that was submitted
+   // SCENE_FRAMES_IN_FLIGHT frames ago, so wait for the GPU to be done with
+   // it. This also releases the resources that were retired with it.
+   vkdf_profiler_cpu_zone_begin(s->ctx->profiler, "scene-wait-frame");
+   wait_for_frame(s, &s->sync.frame[s->sync.frame_idx]);
+   vkdf_profiler_cpu_zone_end(s->ctx->profiler);
+
+   // Pick up new occlusion data if the GPU is done producing it
+   if (s->occlusion.enabled)
+      update_occlusion_data(s);
+
+   // Rasterize the occluders for the current view
+   if (s->sw_occlusion.enabled) {
+      VKDF_PROFILE_ZONE(s->ctx->profiler, "scene-sw-occlusion");
+      update_sw_occlusion_data(s);
+   }
 
    // Start recording command buffer with resource updates for this frame
    start_recording_resource_updates(s);
@@ -6572,11 +8575,14 @@ scene_update(VkdfScene *s)
    // Process scene element changes (this may also record resource updates)
    // We want to update dirty lights first so we can know if any dirty objects
    // are visible to them (since that means their shadow maps are dirty).
+   vkdf_profiler_cpu_zone_begin(s->ctx->profiler, "scene-dirty-lights");
    update_dirty_lights(s);
+   vkdf_profiler_cpu_zone_end(s->ctx->profiler);
+
+   vkdf_profiler_cpu_zone_begin(s->ctx->profiler, "scene-dirty-objects");
    update_dirty_objects(s);
+   vkdf_profiler_cpu_zone_end(s->ctx->profiler);
 
-   // At this point we are done recording resource updates
-   stop_recording_resource_updates(s);
 
    // Record the gbuffer merge command if needed. We have to do this after
    // updating dirty lights and objects so that applications have access
@@ -6585,30 +8591,59 @@ scene_update(VkdfScene *s)
       /* FIXME: we don't need to re-record the command buffer if the list
        * of visible light volumes hasn't changed
        */
-      if (s->cmd_buf.gbuffer_merge) {
-         new_inactive_cmd_buf(s, 0, s->cmd_buf.gbuffer_merge);
-         s->cmd_buf.gbuffer_merge = 0;
-      }
+      s->cmd_buf.gbuffer_merge = 0;
       prepare_scene_gbuffer_merge_command_buffer(s);
    }
 
    // If the camera didn't change, then our active tiles remain the same and
-   // we don't need to re-record secondaries for them
-   if (vkdf_camera_is_dirty(s->camera)) {
+   // we don't need to re-record secondaries for them, unless we have new
+   // occlusion data for a different view
+   if (vkdf_camera_is_dirty(s->camera) || s->occlusion.dirty ||
+       s->sw_occlusion.dirty) {
+      VKDF_PROFILE_ZONE(s->ctx->profiler, "scene-tiles");
+
       bool cmd_buf_changes = update_cmd_bufs(s);
 
       if (!s->cmd_buf.primary[s->cmd_buf.cur_idx] || cmd_buf_changes) {
          build_primary_cmd_buf(s);
       }
 
+      // Cull the static objects in the new visible tiles on the GPU
+      if (s->gpu_cull.enabled)
+         record_gpu_culling(s);
+
       vkdf_camera_reset_dirty_state(s->camera);
+      s->occlusion.dirty = false;
+      s->sw_occlusion.dirty = false;
    }
 
+   // At this point we are done recording resource updates
+   stop_recording_resource_updates(s);
+
    // Clean dynamic dirty flags
    s->dynamic_objs_dirty = false;
    s->lights_dirty = false;
    s->shadow_maps_dirty = false;
    s->light_indices_dirty = false;
+
+   finish_frame_stats(s);
+   capture_draw_state(s);
+}
+
+/**
+ * Wraps the last job added to the batch with GPU timestamps if we have a
+ * profiler.
+ */
+static inline void
+profile_last_job(VkdfScene *s, VkdfSubmitBatch *batch, const char *name)
+{
+   VkdfProfiler *p = s->ctx->profiler;
+   if (!p)
+      return;
+
+   VkCommandBuffer begin = vkdf_profiler_gpu_zone_begin(p, name);
+   VkCommandBuffer end = vkdf_profiler_gpu_zone_end(p);
+   vkdf_submit_batch_wrap_last(batch, begin, end);
 }
 
 static void
@@ -6618,111 +8653,108 @@ scene_draw(VkdfScene *s)
    uint32_t wait_sem_count;
    VkSemaphore *wait_sem;
 
-   /* ========== Submit resource updates for the current frame ========== */
+   // Jobs are accumulated in a batch and sent to the queue with a single
+   // vkQueueSubmit (two if we also request an occlusion data readback).
+   VkdfSubmitBatch batch;
+   vkdf_submit_batch_reset(&batch);
+
+   // Only use state captured by the update stage, which may be preparing
+   // the next frame already (see capture_draw_state())
+   const VkdfSceneDrawState *ds = &s->stage.render;
+   VkdfSceneFrame *frame = &s->sync.frame[ds->frame_idx];
+
+   // The previous frame may still be executing on the GPU. Instead of
+   // stalling the CPU until it is done, the first job of this frame waits
+   // for its copy to the swapchain to complete, since that is the last
+   // job reading the render targets and resources we are about to update.
+   if (s->sync.frame_sem_pending) {
+      wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      wait_sem_count = 1;
+      wait_sem = &s->sync.frame_sem;
+   } else {
+      wait_stage = 0;
+      wait_sem_count = 0;
+      wait_sem = NULL;
+   }
 
-   // Since we always have to wait for the rendering to the render target
-   // to finish before we submit the presentation job, we are certain that by
-   // the time we get here, rendering to the render target for the previous
-   // frame is completed and presentation for the previous frame might still
-   // be ongoing. This means that we can safely submit command buffers that
-   // do not render to the render target, such us any resource update.
+   /* ========== Submit resource updates for the current frame ========== */
 
    // If we have resource update commands, execute them first
    // (this includes shadow map updates)
-   if (s->cmd_buf.have_resource_updates) {
-      VkPipelineStageFlags resources_wait_stage = 0;
-      vkdf_command_buffer_execute(s->ctx,
-                                  s->cmd_buf.update_resources,
-                                  &resources_wait_stage,
-                                  0, NULL,
-                                  1, &s->sync.update_resources_sem);
+   if (ds->have_resource_updates) {
+      vkdf_submit_batch_add(&batch,
+                            ds->update_resources,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, &s->sync.update_resources_sem);
+      profile_last_job(s, &batch, "resource-updates");
 
       wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
       wait_sem_count = 1;
       wait_sem = &s->sync.update_resources_sem;
-   } else {
-      wait_stage = 0;
-      wait_sem_count = 0;
-      wait_sem = NULL;
    }
 
    // Execute rendering command for the depth-prepass
    if (s->rp.do_depth_prepass) {
-      if (!s->cmd_buf.dpp_dynamic) {
-         vkdf_command_buffer_execute(s->ctx,
-                                     s->cmd_buf.dpp_primary[s->cmd_buf.cur_idx],
-                                     &wait_stage,
-                                     wait_sem_count, wait_sem,
-                                     1, &s->sync.depth_draw_sem);
-      } else {
-         vkdf_command_buffer_execute(s->ctx,
-                                     s->cmd_buf.dpp_primary[s->cmd_buf.cur_idx],
-                                     &wait_stage,
-                                     wait_sem_count, wait_sem,
-                                     1, &s->sync.depth_draw_static_sem);
-
-         wait_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-         wait_sem_count = 1;
-         wait_sem = &s->sync.depth_draw_static_sem;
+      VkSemaphore *static_sem = ds->dpp_dynamic ?
+         &s->sync.depth_draw_static_sem : &s->sync.depth_draw_sem;
 
-         vkdf_command_buffer_execute(s->ctx,
-                                     s->cmd_buf.dpp_dynamic,
-                                     &wait_stage,
-                                     wait_sem_count, wait_sem,
-                                     1, &s->sync.depth_draw_sem);
-      }
+      vkdf_submit_batch_add(&batch,
+                            ds->dpp_primary,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, static_sem);
+      profile_last_job(s, &batch, "depth-prepass-static");
 
       wait_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
       wait_sem_count = 1;
-      wait_sem = &s->sync.depth_draw_sem;
+      wait_sem = static_sem;
+
+      // Occlusion data only uses the depth of the static geometry, so
+      // dynamic objects never occlude themselves
+      if (ds->occlusion_update)
+         submit_occlusion_update(s, &batch, &wait_sem);
+
+      if (ds->dpp_dynamic) {
+         vkdf_submit_batch_add(&batch,
+                               ds->dpp_dynamic,
+                               &wait_stage,
+                               wait_sem_count, wait_sem,
+                               1, &s->sync.depth_draw_sem);
+         profile_last_job(s, &batch, "depth-prepass-dynamic");
+
+         wait_sem = &s->sync.depth_draw_sem;
+      }
    }
 
    /* ========== Submit rendering jobs for the current frame ========== */
 
-   // If we are still presenting the previous frame (actually, copying the
-   // previous frame to the swapchain) we have to wait for that to finish
-   // before rendering the new one. Otherwise we would probably corrupt the
-   // copy of the previous frame to the swapchain.
-   while (s->sync.present_fence_active) {
-      VkResult status;
-      do {
-         status = vkWaitForFences(s->ctx->device,
-                                  1, &s->sync.present_fence,
-                                  true, 1000ull);
-#if ENABLE_DEBUG && 0
-         if (status == VK_NOT_READY || status == VK_TIMEOUT) {
-            vkdf_info("debug: perf: scene: warning: "
-                      "gpu busy, cpu stall before draw\n");
-         }
-#endif
-      } while (status == VK_NOT_READY || status == VK_TIMEOUT);
-      vkResetFences(s->ctx->device, 1, &s->sync.present_fence);
-      s->sync.present_fence_active = false;
-   }
-
    // Execute rendering commands for static and dynamic geometry
-   if (!s->cmd_buf.dynamic) {
-      vkdf_command_buffer_execute(s->ctx,
-                                  s->cmd_buf.primary[s->cmd_buf.cur_idx],
-                                  &wait_stage,
-                                  wait_sem_count, wait_sem,
-                                  1, &s->sync.draw_sem);
+   if (!ds->dynamic) {
+      vkdf_submit_batch_add(&batch,
+                            ds->primary,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, &s->sync.draw_sem);
+      profile_last_job(s, &batch, "geometry");
    } else {
-      vkdf_command_buffer_execute(s->ctx,
-                                  s->cmd_buf.primary[s->cmd_buf.cur_idx],
-                                  &wait_stage,
-                                  wait_sem_count, wait_sem,
-                                  1, &s->sync.draw_static_sem);
+      vkdf_submit_batch_add(&batch,
+                            ds->primary,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, &s->sync.draw_static_sem);
+      profile_last_job(s, &batch, "static");
 
       wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
       wait_sem_count = 1;
       wait_sem = &s->sync.draw_static_sem;
 
-      vkdf_command_buffer_execute(s->ctx,
-                                  s->cmd_buf.dynamic,
-                                  &wait_stage,
-                                  wait_sem_count, wait_sem,
-                                  1, &s->sync.draw_sem);
+      vkdf_submit_batch_add(&batch,
+                            ds->dynamic,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, &s->sync.draw_sem);
+      profile_last_job(s, &batch, "dynamic");
    }
 
    wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -6731,12 +8763,13 @@ scene_draw(VkdfScene *s)
 
    if (s->rp.do_deferred) {
       // SSAO
-      if (s->ssao.enabled) {
-         vkdf_command_buffer_execute(s->ctx,
-                                     s->ssao.cmd_buf,
-                                     &wait_stage,
-                                     wait_sem_count, wait_sem,
-                                     1, &s->sync.ssao_sem);
+      if (ds->ssao) {
+         vkdf_submit_batch_add(&batch,
+                               ds->ssao,
+                               &wait_stage,
+                               wait_sem_count, wait_sem,
+                               1, &s->sync.ssao_sem);
+         profile_last_job(s, &batch, "ssao");
 
          wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
          wait_sem_count = 1;
@@ -6744,11 +8777,12 @@ scene_draw(VkdfScene *s)
       }
 
       // Deferred merge pass
-      vkdf_command_buffer_execute(s->ctx,
-                                  s->cmd_buf.gbuffer_merge,
-                                  &wait_stage,
-                                  wait_sem_count, wait_sem,
-                                  1, &s->sync.gbuffer_merge_sem);
+      vkdf_submit_batch_add(&batch,
+                            ds->gbuffer_merge,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, &s->sync.gbuffer_merge_sem);
+      profile_last_job(s, &batch, "gbuffer-merge");
 
       wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
       wait_sem_count = 1;
@@ -6756,12 +8790,13 @@ scene_draw(VkdfScene *s)
    }
 
    // Execute post-processing chain command buffer
-   if (s->cmd_buf.postprocess) {
-      vkdf_command_buffer_execute(s->ctx,
-                                  s->cmd_buf.postprocess,
-                                  &wait_stage,
-                                  wait_sem_count, wait_sem,
-                                  1, &s->sync.postprocess_sem);
+   if (ds->postprocess) {
+      vkdf_submit_batch_add(&batch,
+                            ds->postprocess,
+                            &wait_stage,
+                            wait_sem_count, wait_sem,
+                            1, &s->sync.postprocess_sem);
+      profile_last_job(s, &batch, "postprocess");
 
       wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
       wait_sem_count = 1;
@@ -6772,23 +8807,45 @@ scene_draw(VkdfScene *s)
 
    assert(wait_sem_count == 1);
 
-   vkdf_copy_to_swapchain(s->ctx,
-                          s->cmd_buf.present,
-                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                          *wait_sem,
-                          s->sync.present_fence);
+   vkdf_batch_copy_to_swapchain(s->ctx,
+                                &batch,
+                                s->cmd_buf.present,
+                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                *wait_sem,
+                                s->sync.frame_sem);
+
+   s->stage.render.stats.submits = batch.count;
 
-   s->sync.present_fence_active = true;
-   free_inactive_resources(s);
+   vkdf_submit_batch_flush(s->ctx, &batch, frame->fence);
+
+   frame->fence_active = true;
+   s->sync.frame_sem_pending = true;
 }
 
 static inline void
 event_loop_update(VkdfContext *ctx, void *data)
+{
+   VkdfScene *s = (VkdfScene *) data;
+   scene_update(s);
+
+   // Not pipelined, the render stage goes right after us
+   sync_draw_state(s);
+}
+
+static inline void
+event_loop_pipelined_update(VkdfContext *ctx, void *data)
 {
    VkdfScene *s = (VkdfScene *) data;
    scene_update(s);
 }
 
+static inline void
+event_loop_sync(VkdfContext *ctx, void *data)
+{
+   VkdfScene *s = (VkdfScene *) data;
+   sync_draw_state(s);
+}
+
 static inline void
 event_loop_render(VkdfContext *ctx, void *data)
 {
@@ -6799,10 +8856,21 @@ event_loop_render(VkdfContext *ctx, void *data)
 void
 vkdf_scene_event_loop_run(VkdfScene *s)
 {
-  vkdf_event_loop_run(s->ctx,
-                      event_loop_update,
-                      event_loop_render,
-                      s);
+   if (s->stage.pipelined) {
+      vkdf_event_loop_run_pipelined(s->ctx,
+                                    event_loop_pipelined_update,
+                                    event_loop_sync,
+                                    event_loop_render,
+                                    s);
+   } else {
+      vkdf_event_loop_run(s->ctx,
+                          event_loop_update,
+                          event_loop_render,
+                          s);
+   }
+
+   // Publish the stats of the last frame rendered
+   s->stats.last = s->stage.render.stats;
 }
 
 static bool
@@ -12,6 +12,10 @@
 #include "vkdf-buffer.hpp"
 #include "vkdf-camera.hpp"
 #include "vkdf-thread-pool.hpp"
+#include "vkdf-geometry-arena.hpp"
+#include "vkdf-hiz.hpp"
+#include "vkdf-draw-sort.hpp"
+#include "vkdf-sw-occlusion.hpp"
 
 const uint32_t GBUFFER_MAX_SIZE = 8;
 
@@ -47,8 +51,22 @@ const VkFormat GBUFFER_FIXED_FORMATS[GBUFFER_LAST_FIXED_IDX] = {
    VK_FORMAT_R8G8B8A8_UNORM
 };
 
-static const uint32_t SCENE_CMD_BUF_LIST_SIZE = 2;
-static const bool SCENE_FREE_SECONDARIES = false;
+/**
+ * Number of frames the CPU can prepare ahead of the GPU. Each frame in flight
+ * has its own fence and list of retired resources, and the static geometry
+ * primary command buffers are replicated per frame.
+ */
+static const uint32_t SCENE_FRAMES_IN_FLIGHT = 2;
+static const uint32_t SCENE_CMD_BUF_LIST_SIZE = SCENE_FRAMES_IN_FLIGHT;
+static const uint32_t SCENE_MAX_RECYCLED_SECONDARIES = 64;
+
+/**
+ * Vulkan doesn't report how much memory a command buffer uses, so the tile
+ * cache budget is enforced against an estimate: a fixed cost per command
+ * buffer plus a cost per draw recorded for the tile's sets.
+ */
+static const VkDeviceSize SCENE_CMD_BUF_BASE_SIZE = 4 * 1024;
+static const VkDeviceSize SCENE_CMD_BUF_DRAW_SIZE = 256;
 
 typedef struct {
    uint32_t shadow_map_size;
@@ -141,6 +159,14 @@ struct TileThreadData {
    const VkdfPlane *fplanes;
    GList *visible;
    bool cmd_buf_changes;
+   uint32_t num_recorded;              // Tile secondaries recorded
+};
+
+struct DynamicThreadData {
+   VkdfScene *s;
+   GHashTable *sets;                   // Subset of the visible dynamic sets
+   uint32_t obj_count;
+   VkCommandBuffer cmd_buf[2];         // Secondaries [color, depth-prepass]
 };
 
 struct _DirtyShadowMapInfo {
@@ -158,14 +184,56 @@ struct LightThreadData {
    struct _DirtyShadowMapInfo shadow_map_info;
 };
 
+/* An instanced draw of one mesh for a range of consecutive objects in a set
+ * that use the same level of detail. 'first_instance' indexes the object
+ * UBO the set's objects live in (static or dynamic).
+ */
+typedef struct {
+   VkdfMesh *mesh;
+   uint32_t lod;
+   uint32_t first_instance;
+   uint32_t instance_count;
+} VkdfSceneDrawBatch;
+
 typedef struct {
    GList *objs;                        // Set list
    uint32_t start_index;               // The global scene set index of the first object in this set
    uint32_t count;                     // Number of objects in the set
    uint32_t shadow_caster_start_index; // The shadow map scene set index of the first shadow caster object in this set
    uint32_t shadow_caster_count;       // Number of objects in the set that cast shadows
+
+   // Draws for the set in the scene geometry arena (static sets only). The
+   // draws for 'lod' start at index first[lod] of the scene draw list, and
+   // the shadow map draws only include the shadow casters at LOD 0
+   struct {
+      bool valid;                      // Whether the set has arena draws
+      uint32_t pool;                   // Arena pool of the set's model
+      uint32_t num_lods;
+      uint32_t first[VKDF_MESH_MAX_LODS];
+      uint32_t count;                  // Draws per LOD (one per active mesh)
+      uint32_t shadow_first;
+      int32_t cull_range;              // GPU cull range of the set or -1
+   } draws;
+
+   // Instanced draws covering all the objects in the set, one per active
+   // mesh of the set's model and level of detail in use. Built for static
+   // sets on vkdf_scene_prepare() and for visible dynamic sets every frame
+   VkdfSceneDrawBatch *batches;
+   uint32_t num_batches;
 } VkdfSceneSetInfo;
 
+/* A range of static object instances culled together on the GPU, and the
+ * indirect draws that render them. Matches CullRange in gpu-cull.comp.
+ */
+typedef struct {
+   uint32_t obj_first;
+   uint32_t obj_count;
+   uint32_t slot_first;
+   uint32_t draw_first;
+   uint32_t draw_count;
+   uint32_t padding[3];
+} VkdfSceneCullRange;
+
 struct _VkdfSceneTile {
    int32_t parent;
    uint32_t level;                 // Level of the tile
@@ -178,6 +246,13 @@ struct _VkdfSceneTile {
    uint32_t shadow_caster_count;   // Number of objects in the tile that can cast shadows
    VkCommandBuffer cmd_buf;        // Secondary command buffer for this tile
    VkCommandBuffer depth_cmd_buf;  // Secondary command buffer for this tile (depth-prepass)
+   uint32_t lod;                   // Level of detail selected for the tile
+   uint32_t cmd_buf_lod;           // Level of detail recorded in the tile's command buffers
+   VkDeviceSize cmd_buf_size;      // Estimated memory used by the tile's command buffers
+   uint32_t num_draws;             // Draws recorded in the tile's command buffer
+   bool cached;                    // Whether the tile is in its thread's cache
+   VkdfSceneTile *cache_prev;      // Toward the most recently used cached tile
+   VkdfSceneTile *cache_next;      // Toward the least recently used cached tile
    VkdfSceneTile *subtiles;        // Subtiles within this tile
 };
 
@@ -212,7 +287,7 @@ typedef struct {
 
 typedef void (*VkdfSceneUpdateStateCB)(void *);
 typedef bool (*VkdfSceneUpdateResourcesCB)(VkdfContext *, VkCommandBuffer, void *);
-typedef void (*VkdfSceneCommandsCB)(VkdfContext *, VkCommandBuffer, GHashTable *, bool, bool, void *);
+typedef void (*VkdfSceneCommandsCB)(VkdfContext *, VkCommandBuffer, GHashTable *, bool, bool, uint32_t, void *);
 typedef void (*VkdfScenePostprocessCB)(VkdfContext *, VkCommandBuffer, void *);
 typedef void (*VkdfSceneGbufferMergeCommandsCB)(VkdfContext *, VkCommandBuffer, void *);
 
@@ -222,12 +297,105 @@ struct _dim {
    float d;
 };
 
+/**
+ * Tiles that are no longer visible keep their secondary command buffers in
+ * a per-thread LRU cache, so they don't need to be recorded again if they
+ * become visible again soon. Cached tiles are linked through the tile
+ * itself, so lookups and removals are O(1). When the estimated command
+ * memory of the cached tiles exceeds the budget, the least recently used
+ * tiles release their command buffers.
+ */
 struct _cache {
-   GList *cached;
-   uint32_t size;
-   uint32_t max_size;
+   VkdfSceneTile *head;                // Most recently used
+   VkdfSceneTile *tail;                // Least recently used
+   uint32_t size;                      // Number of cached tiles
+   VkDeviceSize mem_size;              // Estimated memory of the cached tiles
+   VkDeviceSize budget;                // 0 means no limit
+   uint64_t hits;                      // Tiles reused from the cache
+   uint64_t misses;                    // Tiles that had to be recorded
+   uint64_t evictions;                 // Tiles evicted to stay in budget
 };
 
+typedef struct {
+   uint32_t size;
+   VkDeviceSize mem_size;
+   VkDeviceSize budget;
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+} VkdfSceneTileCacheStats;
+
+/**
+ * Work done by the scene for a frame. Objects are counted at the
+ * granularity of the CPU culling (visible tiles with objects for static
+ * objects), so GPU culling may discard some of them later. Draw calls
+ * count the geometry draws recorded by the scene and the ones the
+ * application records with vkdf_scene_draw_batches() (postprocessing and
+ * other full-screen passes are not included).
+ */
+typedef struct {
+   uint64_t frame;                     // Frame number, starting at 1
+   uint32_t visible_tiles;
+   uint32_t visible_static_objs;
+   uint32_t visible_dynamic_objs;
+   uint32_t shadow_maps_updated;       // Shadow maps rendered
+   uint32_t secondaries_recorded;      // Secondary command buffers recorded
+   uint32_t secondaries_reused;        // Tile secondaries reused as they were
+   VkDeviceSize resource_update_bytes; // Buffer updates recorded by the scene
+   uint32_t draw_calls;
+   uint32_t shadow_draw_calls;         // Included in 'draw_calls'
+   uint32_t submits;                   // Jobs submitted to the queue
+} VkdfSceneStats;
+
+/**
+ * Everything scene_draw() needs to submit a frame, captured at the end of
+ * the update stage. When updates are pipelined with rendering (see
+ * vkdf_scene_enable_pipelined_update()) the next frame is updated while the
+ * current one is submitted, so the render stage works on its own copy.
+ */
+typedef struct {
+   uint32_t frame_idx;                 // Frame in flight slot
+   bool have_resource_updates;
+   VkCommandBuffer update_resources;
+   VkCommandBuffer dpp_primary;
+   VkCommandBuffer dpp_dynamic;
+   VkCommandBuffer primary;
+   VkCommandBuffer dynamic;
+   VkCommandBuffer ssao;
+   VkCommandBuffer gbuffer_merge;
+   VkCommandBuffer postprocess;
+   bool occlusion_update;              // Submit an occlusion data readback
+   VkdfSceneStats stats;               // Work done for the frame so far
+} VkdfSceneDrawState;
+
+/**
+ * A command pool for command buffers that are recorded for a single frame.
+ * Instead of freeing them individually, the whole pool is reset once the
+ * frame is done and its command buffers are handed out again. Arrays are
+ * indexed by VkCommandBufferLevel.
+ */
+typedef struct {
+   VkCommandPool pool;
+   VkCommandBuffer *cmd_bufs[2];       // Allocated from the pool
+   uint32_t num_cmd_bufs[2];
+   uint32_t used[2];                   // Handed out since the last reset
+} VkdfSceneFramePool;
+
+/**
+ * Per-frame state for frames in flight. Resources retired while preparing a
+ * frame can still be in use by the frames before it, so they are attached
+ * to the frame and released once its fence is signaled.
+ */
+typedef struct {
+   VkFence fence;
+   bool fence_active;
+   VkdfSceneFramePool *pools;          // [one per thread]
+   GList **cmd_bufs;                   // struct FreeCmdBufInfo * [one list per thread]
+   GList *images;
+   GList *framebuffers;
+   GList *samplers;
+} VkdfSceneFrame;
+
 struct _VkdfScene {
    VkdfContext *ctx;
 
@@ -581,18 +749,27 @@ struct _VkdfScene {
     *
     * free      : list of obsolete (inactive) secondary command buffers that
     *             are still pending execution (in a previous frame). These
-    *             commands will be freed when the corresponding fence is
-    *             signaled. [one list per thread]
+    *             commands are handed to the frame being prepared and
+    *             released when its fence is signaled. Tile secondaries are
+    *             moved to the recycled list instead of being freed.
+    *             [one list per thread]
+    *
+    * recycled  : list of reset secondary command buffers ready to be
+    *             recorded again for a new tile. [one list per thread]
     *
     * primary   : The current primary command buffer for the visible tiles.
     *
     * resources : A command buffer recorded every frame to update
-    *             resources used for rendering the current frame.
+    *             resources used for rendering the current frame. Like the
+    *             other per-frame primaries (dynamic objects and gbuffer
+    *             merge) it comes from the frame's command pools.
     */
    struct {
       VkCommandPool *pool;
       GList **active;
       GList **free;
+      GList **recycled;
+      uint32_t *num_recycled;
       uint32_t cur_idx;                                        // Index of the current command (for command buffer lists)
       VkCommandBuffer dpp_primary[SCENE_CMD_BUF_LIST_SIZE];    // Command buffer for depth-prepass static objs
       VkCommandBuffer dpp_dynamic;                             // Command buffer for depth-prepass dynamic objs
@@ -603,6 +780,11 @@ struct _VkdfScene {
       VkCommandBuffer *present;          // Command buffer rt -> swapchin copies
       VkCommandBuffer gbuffer_merge;     // Command buffer for deferred gbuffer merge
       VkCommandBuffer postprocess;       // Command buffer for post-processing passes
+
+      // Scratch storage to sort the active tiles front-to-back
+      std::vector<VkdfSceneTile *> tiles;
+      std::vector<VkdfDrawPacket> packets;
+      std::vector<VkdfSceneTile *> sorted;
    } cmd_buf;
 
    struct {
@@ -620,10 +802,23 @@ struct _VkdfScene {
       VkSemaphore ssao_sem;
       VkSemaphore gbuffer_merge_sem;
       VkSemaphore postprocess_sem;
-      VkFence present_fence;
-      bool present_fence_active;
+      VkSemaphore frame_sem;                      // Signaled by the swapchain copy of each frame
+      bool frame_sem_pending;
+      VkdfSceneFrame frame[SCENE_FRAMES_IN_FLIGHT];
+      uint32_t frame_idx;                         // Frame being prepared
    } sync;
 
+   struct {
+      bool pipelined;                  // Update frame N+1 while rendering N
+      VkdfSceneDrawState update;       // Produced by the update stage
+      VkdfSceneDrawState render;       // Consumed by the render stage
+   } stage;
+
+   struct {
+      uint64_t frame;                  // Frames updated so far
+      VkdfSceneStats last;             // Last frame done by both stages
+   } stats;
+
    struct {
       VkdfSceneUpdateStateCB update_state;            // Updates application state, camera, etc
       VkdfSceneUpdateResourcesCB update_resources;    // Updates rendering resources used by command buffers
@@ -634,11 +829,105 @@ struct _VkdfScene {
       VkdfImage *postprocess_output;                  // Pointer to output image produced by the postprocessing chain
    } callbacks;
 
+   /* Distance-based level of detail selection for static tiles and dynamic
+    * objects. distances[i] is the distance at which LOD i+1 kicks in and
+    * hysteresis is the fraction of that distance the camera needs to move
+    * past it before we switch levels.
+    */
+   struct {
+      uint32_t num_lods;
+      float distances[VKDF_MESH_MAX_LODS - 1];
+      float hysteresis;
+   } lod;
+
+   /* Scene-wide geometry arena with the vertex and index data of all the
+    * scene models, and the indexed draws for all static sets in all tiles.
+    * The draws are uploaded to 'indirect_buf' if the device supports
+    * multi-draw indirect with non-zero first instance, otherwise they are
+    * issued one by one from 'draws'.
+    */
+   struct {
+      bool enabled;
+      VkdfGeometryArena *arena;
+      std::vector<VkDrawIndexedIndirectCommand> draws;
+      bool use_indirect;
+      bool use_multi_draw;
+      VkdfBuffer indirect_buf;
+      bool release_static_buffers;
+      GHashTable *released_models;
+   } geometry;
+
+   /* GPU frustum culling of static object instances. The visible objects
+    * of each set in the arena are compacted into their own slots in
+    * 'obj_buf', after a copy of the static object UBO, and the instance
+    * counts of the set's indirect draws are updated to match. Only the
+    * ranges of the sets in the tiles found visible on the CPU are culled
+    * each frame, their indices are uploaded to 'visible_buf'.
+    */
+   struct {
+      bool enabled;
+      std::vector<VkdfSceneCullRange> ranges;
+      std::vector<uint32_t> visible;   // Ranges to cull this frame
+      uint32_t num_slots;              // Object slots in 'obj_buf'
+      VkdfBuffer range_buf;
+      VkdfBuffer visible_buf;
+      VkdfBuffer bounds_buf;
+      VkdfBuffer obj_buf;
+      VkDeviceSize obj_size;
+      VkDescriptorPool pool;
+      VkDescriptorSetLayout set_layout;
+      VkDescriptorSet set;
+      VkPipelineLayout layout;
+      VkPipeline pipeline;
+      VkShaderModule cs;
+   } gpu_cull;
+
+   /* Occlusion culling against a hierarchical depth buffer built from the
+    * static geometry depth-prepass of a previous frame. The depth buffer is
+    * reduced on the GPU into 'buf' and read back when 'fence' signals, so
+    * it never stalls rendering. Tiles and dynamic objects are tested against
+    * it with the view-projection the depth was rendered with.
+    */
+   struct {
+      bool enabled;
+      VkdfHiZ *hiz;
+      VkdfBuffer buf;
+      float *map;
+      glm::uvec2 size;                 // Size of the reduced depth buffer
+      VkSampler sampler;
+      VkDescriptorPool pool;
+      VkDescriptorSetLayout sampler_set_layout;
+      VkDescriptorSet sampler_set;
+      VkDescriptorSetLayout buf_set_layout;
+      VkDescriptorSet buf_set;
+      VkPipelineLayout layout;
+      VkPipeline pipeline;
+      VkShaderModule cs;
+      VkCommandBuffer cmd_buf;
+      VkSemaphore sem;
+      VkFence fence;
+      bool pending;                    // Waiting for a readback
+      glm::mat4 pending_view_proj;
+      bool dirty;                      // New data since the last tile update
+   } occlusion;
+
+   /* Occlusion culling against occluder objects rasterized on the CPU for
+    * the current camera view. Unlike the above, there is no latency, but
+    * only objects flagged with vkdf_object_set_occluder() hide anything.
+    */
+   struct {
+      bool enabled;
+      VkdfSwOcclusion *raster;
+      GList *occluders;                // VkdfObject *
+      bool dirty;                      // New data since the last tile update
+   } sw_occlusion;
+
    struct {
       VkdfThreadPool *pool;
       uint32_t num_threads;
       uint32_t work_size;
       struct TileThreadData *tile_data;
+      struct DynamicThreadData *dynamic_data;
    } thread;
 
    struct {
@@ -653,6 +942,7 @@ struct _VkdfScene {
       struct {
          VkShaderModule vs;
       } shaders;
+      GList *pending_jobs;             // struct ShadowMapPipelineJob *
    } shadows;
 
    struct {
@@ -728,6 +1018,11 @@ struct _VkdfScene {
    } model;
 };
 
+/**
+ * Creates a scene. 'cache_budget' (in bytes, 0 for no limit) bounds the
+ * estimated memory of the command buffers kept for tiles that are not
+ * visible, so they can be reused when the tiles become visible again.
+ */
 VkdfScene *
 vkdf_scene_new(VkdfContext *ctx,
                uint32_t fb_width,
@@ -737,12 +1032,29 @@ vkdf_scene_new(VkdfContext *ctx,
                glm::vec3 scene_size,
                glm::vec3 tile_size,
                uint32_t num_tile_levels,
-               uint32_t cache_size,
+               VkDeviceSize cache_budget,
                uint32_t num_threads);
 
 void
 vkdf_scene_free(VkdfScene *s);
 
+/**
+ * Returns the state of the tile command buffer caches, added up for all
+ * threads.
+ */
+void
+vkdf_scene_get_tile_cache_stats(VkdfScene *s, VkdfSceneTileCacheStats *stats);
+
+/**
+ * Returns the statistics of the last frame that went through both the
+ * update and the render stages. Applications can call this from their
+ * scene callbacks (which run in the update stage) or after the event loop.
+ * From the callbacks, these are one or two frames (with pipelined updates)
+ * behind the frame being updated, see 'frame'.
+ */
+void
+vkdf_scene_get_stats(VkdfScene *s, VkdfSceneStats *stats);
+
 inline VkdfCamera *
 vkdf_scene_get_camera(VkdfScene *scene)
 {
@@ -760,6 +1072,18 @@ vkdf_scene_set_clear_values(VkdfScene *scene,
                             VkClearValue *color,
                             VkClearValue *depth);
 
+/**
+ * Builds the scene tiles and all the GPU resources needed to render the
+ * scene. Objects added afterwards must be dynamic.
+ *
+ * With the geometry arena enabled, the vertex and index data of every
+ * scene model is copied into the arena, so models that also have their own
+ * per-mesh or per-model buffers (see vkdf_model_fill_vertex_buffers())
+ * keep two copies of their geometry in video memory. Applications that
+ * only draw static sets through vkdf_scene_draw_set() or
+ * vkdf_scene_draw_batches() can drop the second copy with
+ * vkdf_scene_release_static_geometry_buffers().
+ */
 void
 vkdf_scene_prepare(VkdfScene *scene);
 
@@ -799,15 +1123,27 @@ vkdf_scene_get_depth_render_target(VkdfScene *s)
    return &s->rt.depth;
 }
 
+/**
+ * Returns the buffer with the per-instance data of static objects. With GPU
+ * culling enabled this is the culled object buffer, which is a superset of
+ * the static object UBO that can exceed maxUniformBufferRange, so it has to
+ * be bound as a storage buffer. The static and dynamic object buffers can
+ * always be bound as storage buffers, so shaders can use the same layout
+ * for both whether culling is available or not.
+ */
 inline VkdfBuffer *
 vkdf_scene_get_object_ubo(VkdfScene *s)
 {
+   if (s->gpu_cull.obj_buf.buf)
+      return &s->gpu_cull.obj_buf;
    return &s->ubo.obj.buf;
 }
 
 inline VkDeviceSize
 vkdf_scene_get_object_ubo_size(VkdfScene *s)
 {
+   if (s->gpu_cull.obj_buf.buf)
+      return s->gpu_cull.obj_size;
    return s->ubo.obj.size;
 }
 
@@ -1022,6 +1358,11 @@ void
 vkdf_scene_remove_light(VkdfScene *s,
                      VkdfLight *light);
 
+/**
+ * 'cmd_cb' records the given sets into a command buffer. It is called from
+ * the scene's worker threads for static tiles as well as for groups of
+ * visible dynamic sets, so it must be safe to call concurrently.
+ */
 inline void
 vkdf_scene_set_scene_callbacks(VkdfScene *s,
                                VkdfSceneUpdateStateCB us_cb,
@@ -1035,6 +1376,146 @@ vkdf_scene_set_scene_callbacks(VkdfScene *s,
    s->callbacks.data = data;
 }
 
+/**
+ * Enables LOD selection. 'distances' must have 'num_lods - 1' increasing
+ * distances (see VkdfScene::lod). The LOD selected for each tile is passed
+ * to the record_commands callback, while dynamic objects are recorded with
+ * LOD 0 and get their own selection in VkdfObject::lod.
+ */
+inline void
+vkdf_scene_set_lod_distances(VkdfScene *s,
+                             uint32_t num_lods,
+                             const float *distances,
+                             float hysteresis = 0.1f)
+{
+   assert(num_lods >= 1 && num_lods <= VKDF_MESH_MAX_LODS);
+   s->lod.num_lods = num_lods;
+   for (uint32_t i = 0; i < num_lods - 1; i++) {
+      assert(i == 0 || distances[i] > distances[i - 1]);
+      s->lod.distances[i] = distances[i];
+   }
+   s->lod.hysteresis = hysteresis;
+}
+
+uint32_t
+vkdf_scene_select_lod(VkdfScene *s, const VkdfBox *box, uint32_t cur_lod);
+
+/**
+ * Packs the geometry of all the scene models into a shared geometry arena
+ * on vkdf_scene_prepare() and builds indirect draws for the static sets in
+ * every tile, so the record_commands callback can draw a whole set with
+ * vkdf_scene_draw_set() instead of binding and drawing each mesh. The
+ * scene's shadow map passes also render from the arena. Mesh 'active'
+ * flags are only taken into account when the draws are built.
+ */
+inline void
+vkdf_scene_enable_geometry_arena(VkdfScene *s)
+{
+   s->geometry.enabled = true;
+}
+
+/**
+ * Makes vkdf_scene_prepare() destroy the per-mesh and per-model vertex and
+ * index buffers of the models that are only used by static sets that are
+ * fully drawn from the geometry arena, once their geometry has been copied
+ * there. Models with dynamic objects, or with sets that fall back to
+ * per-mesh draws, keep their buffers. Only enable this if the application
+ * does not bind those buffers itself, and do not add dynamic objects using
+ * the released models afterwards.
+ */
+inline void
+vkdf_scene_release_static_geometry_buffers(VkdfScene *s)
+{
+   s->geometry.release_static_buffers = true;
+}
+
+/**
+ * Enables a compute pass that frustum-culls the instances of the static
+ * sets drawn with vkdf_scene_draw_set() in the tiles found visible on the
+ * CPU, whenever the visible tiles change. Implies
+ * vkdf_scene_enable_geometry_arena().
+ *
+ * Culled sets take their instance data from object slots past the end of
+ * the static object UBO, so shaders need to read object data from a storage
+ * buffer with an unsized array (see vkdf_scene_get_object_ubo()). Requires
+ * the drawIndirectFirstInstance feature and is ignored without it.
+ */
+inline void
+vkdf_scene_enable_gpu_culling(VkdfScene *s)
+{
+   s->geometry.enabled = true;
+   s->gpu_cull.enabled = true;
+}
+
+/**
+ * Runs the GPU culling pass for the tiles visible in the last frame and the
+ * current camera, and checks the instance counts it writes against the
+ * objects that pass the same frustum test on the CPU. Returns the number
+ * of sets with a different count. Waits for the device to be idle, so it
+ * is only meant for tests, after vkdf_scene_event_loop_run() returns.
+ */
+uint32_t
+vkdf_scene_check_gpu_culling(VkdfScene *s);
+
+/**
+ * Enables occlusion culling of tiles and dynamic objects against the depth
+ * of the static geometry rendered in the previous frames. Requires the
+ * depth-prepass, and is ignored without it.
+ *
+ * Occlusion data lags at least one frame behind the camera, so objects
+ * that become visible quickly (such as when turning around a corner) may
+ * show up a frame or two late.
+ */
+inline void
+vkdf_scene_enable_occlusion_culling(VkdfScene *s)
+{
+   s->occlusion.enabled = true;
+}
+
+/**
+ * Enables occlusion culling of tiles and dynamic objects against the scene
+ * occluders (see vkdf_object_set_occluder()), which are rasterized on the
+ * CPU into a small depth buffer every time the camera or a dynamic
+ * occluder changes. It can be combined with
+ * vkdf_scene_enable_occlusion_culling().
+ */
+inline void
+vkdf_scene_enable_sw_occlusion_culling(VkdfScene *s)
+{
+   s->sw_occlusion.enabled = true;
+}
+
+inline bool
+vkdf_scene_set_has_draws(VkdfSceneSetInfo *set_info)
+{
+   return set_info->draws.valid;
+}
+
+/**
+ * Binds the arena buffers for the set and draws all its instances at the
+ * requested level of detail. The bound pipeline must take its vertex input
+ * from the set's meshes.
+ */
+void
+vkdf_scene_draw_set(VkdfScene *s,
+                    VkCommandBuffer cmd_buf,
+                    VkdfSceneSetInfo *set_info,
+                    uint32_t lod);
+
+/**
+ * Draws all the objects in the set with as few instanced draws as possible:
+ * from the scene geometry arena if the set has arena draws, or otherwise
+ * from the set's draw batches, binding each mesh's vertex and index
+ * buffers. Batches are drawn at least at level of detail 'lod', so static
+ * tiles can pass their level of detail, and dynamic sets 0 to use the
+ * level of detail selected for each object.
+ */
+void
+vkdf_scene_draw_batches(VkdfScene *s,
+                        VkCommandBuffer cmd_buf,
+                        VkdfSceneSetInfo *set_info,
+                        uint32_t lod);
+
 inline void
 vkdf_scene_enable_postprocessing(VkdfScene *s,
                                  VkdfScenePostprocessCB pp_cb,
@@ -1094,6 +1575,19 @@ vkdf_scene_get_ssao_image(VkdfScene *s)
       return &s->ssao.base.image; /* No blur */
 }
 
+/**
+ * Runs the scene's update and render stages in a pipelined fashion: the
+ * update for frame N+1 (including the update_state, update_resources and
+ * record_commands callbacks) runs on a separate thread while frame N is
+ * submitted, so these callbacks must not touch state that the application
+ * uses from the main thread while rendering.
+ */
+inline void
+vkdf_scene_enable_pipelined_update(VkdfScene *s)
+{
+   s->stage.pipelined = true;
+}
+
 void
 vkdf_scene_event_loop_run(VkdfScene *s);
 
@@ -1,5 +1,16 @@
 #include "vkdf-shader.hpp"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct {
+   char *key;
+   VkShaderModule module;
+   uint32_t refcount;
+} VkdfShaderCacheEntry;
+
 uint32_t *
 vkdf_shader_read_spirv_file(const char *path, VkDeviceSize *size)
 {
@@ -25,12 +36,41 @@ vkdf_shader_read_spirv_file(const char *path, VkDeviceSize *size)
    return (uint32_t *) buf;
 }
 
-VkShaderModule
-vkdf_create_shader_module(VkdfContext *ctx, const char *path)
+const uint32_t *
+vkdf_shader_map_spirv_file(const char *path, VkDeviceSize *size)
 {
-   VkDeviceSize size;
-   uint32_t *spirv = vkdf_shader_read_spirv_file(path, &size);
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      vkdf_fatal("Could not open SPIR-V file at '%s'", path);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size == 0)
+      vkdf_fatal("Failed to read data from SPIR-V file at '%s'", path);
+
+   assert(st.st_size % 4 == 0);
+   *size = st.st_size;
+
+   // The mapping stays valid after closing the file descriptor
+   void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (data == MAP_FAILED)
+      vkdf_fatal("Failed to map SPIR-V file at '%s'", path);
+
+   return (const uint32_t *) data;
+}
 
+void
+vkdf_shader_unmap_spirv_file(const uint32_t *spirv, VkDeviceSize size)
+{
+   munmap((void *) spirv, size);
+}
+
+static VkShaderModule
+create_shader_module_from_spirv(VkdfContext *ctx,
+                                const uint32_t *spirv,
+                                VkDeviceSize size)
+{
    VkShaderModuleCreateInfo mod_info;
    mod_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
    mod_info.pNext = NULL;
@@ -41,8 +81,120 @@ vkdf_create_shader_module(VkdfContext *ctx, const char *path)
    VkShaderModule module;
    VK_CHECK(vkCreateShaderModule(ctx->device, &mod_info, NULL, &module));
 
-   g_free(spirv);
+   return module;
+}
+
+VkShaderModule
+vkdf_create_shader_module(VkdfContext *ctx, const char *path)
+{
+   VkDeviceSize size;
+   const uint32_t *spirv = vkdf_shader_map_spirv_file(path, &size);
+
+   VkShaderModule module = create_shader_module_from_spirv(ctx, spirv, size);
+
+   vkdf_shader_unmap_spirv_file(spirv, size);
 
    return module;
 }
 
+static void
+free_cache_entry(gpointer data)
+{
+   VkdfShaderCacheEntry *entry = (VkdfShaderCacheEntry *) data;
+   g_free(entry->key);
+   g_free(entry);
+}
+
+void
+vkdf_shader_cache_init(VkdfContext *ctx)
+{
+   ctx->shader_cache =
+      g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_cache_entry);
+}
+
+void
+vkdf_shader_cache_destroy(VkdfContext *ctx)
+{
+   if (!ctx->shader_cache)
+      return;
+
+   GHashTableIter iter;
+   gpointer value;
+   g_hash_table_iter_init(&iter, ctx->shader_cache);
+   while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      VkdfShaderCacheEntry *entry = (VkdfShaderCacheEntry *) value;
+      vkdf_info("shader-cache: '%s' still has %u reference(s).\n",
+                entry->key, entry->refcount);
+      vkDestroyShaderModule(ctx->device, entry->module, NULL);
+   }
+
+   g_hash_table_destroy(ctx->shader_cache);
+   ctx->shader_cache = NULL;
+}
+
+/**
+ * 64-bit FNV-1a over the SPIR-V words
+ */
+static uint64_t
+hash_spirv(const uint32_t *spirv, VkDeviceSize size)
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   for (VkDeviceSize i = 0; i < size / 4; i++) {
+      hash ^= spirv[i];
+      hash *= 0x100000001b3ull;
+   }
+   return hash;
+}
+
+VkShaderModule
+vkdf_shader_cache_acquire(VkdfContext *ctx, const char *path)
+{
+   assert(ctx->shader_cache);
+
+   VkDeviceSize size;
+   const uint32_t *spirv = vkdf_shader_map_spirv_file(path, &size);
+
+   char *key = g_strdup_printf("%s:%016" G_GINT64_MODIFIER "x",
+                               path, hash_spirv(spirv, size));
+
+   VkdfShaderCacheEntry *entry = (VkdfShaderCacheEntry *)
+      g_hash_table_lookup(ctx->shader_cache, key);
+   if (entry) {
+      g_free(key);
+   } else {
+      entry = g_new0(VkdfShaderCacheEntry, 1);
+      entry->key = key;
+      entry->module = create_shader_module_from_spirv(ctx, spirv, size);
+      g_hash_table_insert(ctx->shader_cache, entry->key, entry);
+   }
+
+   vkdf_shader_unmap_spirv_file(spirv, size);
+
+   entry->refcount++;
+   return entry->module;
+}
+
+void
+vkdf_shader_cache_release(VkdfContext *ctx, VkShaderModule module)
+{
+   assert(ctx->shader_cache);
+
+   // Applications only have a handful of shaders, so a linear search is fine
+   GHashTableIter iter;
+   gpointer value;
+   g_hash_table_iter_init(&iter, ctx->shader_cache);
+   while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      VkdfShaderCacheEntry *entry = (VkdfShaderCacheEntry *) value;
+      if (entry->module != module)
+         continue;
+
+      assert(entry->refcount > 0);
+      if (--entry->refcount == 0) {
+         vkDestroyShaderModule(ctx->device, entry->module, NULL);
+         g_hash_table_iter_remove(&iter);
+      }
+      return;
+   }
+
+   assert(!"Shader module not in the cache");
+}
@@ -6,6 +6,36 @@
 
 uint32_t *vkdf_shader_read_spirv_file(const char *path, VkDeviceSize *size);
 
+/**
+ * Maps a SPIR-V file into memory (read-only) instead of copying it into a
+ * heap buffer. The mapping must be released with
+ * vkdf_shader_unmap_spirv_file().
+ */
+const uint32_t *vkdf_shader_map_spirv_file(const char *path,
+                                           VkDeviceSize *size);
+
+void vkdf_shader_unmap_spirv_file(const uint32_t *spirv, VkDeviceSize size);
+
 VkShaderModule vkdf_create_shader_module(VkdfContext *ctx, const char *path);
 
+/**
+ * Shader module cache
+ *
+ * Modules are shared by all users that request the same shader, keyed by
+ * the file path and a hash of its contents (so a SPIR-V file rebuilt while
+ * the application runs produces a new module). Modules are refcounted:
+ * every vkdf_shader_cache_acquire() must be paired with a
+ * vkdf_shader_cache_release() instead of vkDestroyShaderModule().
+ *
+ * The cache is not thread-safe, it is meant to be used from the thread
+ * that sets up rendering resources.
+ */
+void vkdf_shader_cache_init(VkdfContext *ctx);
+
+void vkdf_shader_cache_destroy(VkdfContext *ctx);
+
+VkShaderModule vkdf_shader_cache_acquire(VkdfContext *ctx, const char *path);
+
+void vkdf_shader_cache_release(VkdfContext *ctx, VkShaderModule module);
+
 #endif
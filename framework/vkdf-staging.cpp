@@ -0,0 +1,175 @@
+#include "vkdf-staging.hpp"
+#include "vkdf-util.hpp"
+#include "vkdf-memory.hpp"
+#include "vkdf-cmd-buffer.hpp"
+
+static void
+create_staging_buffer(VkdfStaging *st, VkDeviceSize size)
+{
+   st->buf = vkdf_create_buffer(st->ctx, 0, size,
+                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   st->size = size;
+   st->offset = 0;
+   st->map = NULL;
+}
+
+VkdfStaging *
+vkdf_staging_new(VkdfContext *ctx, VkDeviceSize size)
+{
+   VkdfStaging *st = g_new0(VkdfStaging, 1);
+
+   st->ctx = ctx;
+   st->pool =
+      vkdf_create_gfx_command_pool(ctx,
+                                   VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+   vkdf_create_command_buffer(ctx, st->pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &st->cmd_buf);
+
+   create_staging_buffer(st, size);
+
+   return st;
+}
+
+/**
+ * Requests 'size' bytes of staging memory to upload to 'dst' at 'dst_offset'
+ * and records the copy. The caller must write its data to the returned
+ * pointer before the next call to vkdf_staging_flush(), which is also
+ * when the data lands in 'dst'.
+ */
+void *
+vkdf_staging_upload_to_buffer(VkdfStaging *st,
+                              VkdfBuffer *dst,
+                              VkDeviceSize dst_offset,
+                              VkDeviceSize size)
+{
+   assert(size > 0);
+
+   VkDeviceSize offset = ALIGN(st->offset, 16);
+   if (offset + size > st->size) {
+      vkdf_staging_flush(st);
+      offset = 0;
+
+      if (size > st->size) {
+         vkdf_destroy_buffer(st->ctx, &st->buf);
+         create_staging_buffer(st, ALIGN(size, 16));
+      }
+   }
+
+   if (!st->map) {
+      vkdf_memory_map(st->ctx, st->buf.mem, 0, VK_WHOLE_SIZE,
+                      (void **) &st->map);
+   }
+
+   if (!st->recording) {
+      vkdf_command_buffer_begin(st->cmd_buf,
+                                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+      st->recording = true;
+   }
+
+   VkBufferCopy region;
+   region.srcOffset = offset;
+   region.dstOffset = dst_offset;
+   region.size = size;
+   vkCmdCopyBuffer(st->cmd_buf, st->buf.buf, dst->buf, 1, &region);
+
+   st->offset = offset + size;
+   st->num_copies++;
+
+   return st->map + offset;
+}
+
+/**
+ * Submits all pending copies in a single command buffer and waits for them
+ * to complete, after which the staging buffer can be reused.
+ */
+void
+vkdf_staging_flush(VkdfStaging *st)
+{
+   if (!st->recording)
+      return;
+
+   vkdf_memory_unmap(st->ctx, st->buf.mem, st->buf.mem_props,
+                     0, VK_WHOLE_SIZE);
+   st->map = NULL;
+
+   // Make the uploads visible to any kind of buffer read that might follow
+   VkMemoryBarrier barrier;
+   barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+   barrier.pNext = NULL;
+   barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                           VK_ACCESS_INDEX_READ_BIT |
+                           VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                           VK_ACCESS_UNIFORM_READ_BIT |
+                           VK_ACCESS_SHADER_READ_BIT;
+
+   vkCmdPipelineBarrier(st->cmd_buf,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        0,
+                        1, &barrier,
+                        0, NULL,
+                        0, NULL);
+
+   vkdf_command_buffer_end(st->cmd_buf);
+   vkdf_command_buffer_execute_sync(st->ctx, st->cmd_buf, 0);
+   vkResetCommandBuffer(st->cmd_buf, 0);
+
+   st->recording = false;
+   st->offset = 0;
+   st->num_copies = 0;
+}
+
+void
+vkdf_staging_free(VkdfStaging *st)
+{
+   vkdf_staging_flush(st);
+
+   vkdf_destroy_buffer(st->ctx, &st->buf);
+   vkFreeCommandBuffers(st->ctx->device, st->pool, 1, &st->cmd_buf);
+   vkDestroyCommandPool(st->ctx->device, st->pool, NULL);
+
+   g_free(st);
+}
+
+/**
+ * Creates a vertex or index buffer and returns a pointer where its contents
+ * must be written. Unless the context requests host-visible geometry the
+ * buffer is device-local and the data goes through the staging buffer 'st',
+ * so it is only available after the next vkdf_staging_flush().
+ *
+ * vkdf_staging_finish_geometry_buffer() must be called once the data has
+ * been written.
+ */
+uint8_t *
+vkdf_staging_create_geometry_buffer(VkdfContext *ctx,
+                                    VkdfStaging *st,
+                                    VkBufferUsageFlags usage,
+                                    VkDeviceSize size,
+                                    VkdfBuffer *buf)
+{
+   if (ctx->host_visible_geometry) {
+      *buf = vkdf_create_buffer(ctx, 0, size, usage,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+      uint8_t *map;
+      vkdf_memory_map(ctx, buf->mem, 0, size, (void **) &map);
+      return map;
+   }
+
+   assert(st);
+   *buf = vkdf_create_buffer(ctx, 0, size,
+                             usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+   return (uint8_t *) vkdf_staging_upload_to_buffer(st, buf, 0, size);
+}
+
+void
+vkdf_staging_finish_geometry_buffer(VkdfContext *ctx, VkdfBuffer *buf)
+{
+   if (ctx->host_visible_geometry)
+      vkdf_memory_unmap(ctx, buf->mem, buf->mem_props, 0, VK_WHOLE_SIZE);
+}
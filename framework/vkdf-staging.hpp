@@ -0,0 +1,59 @@
+#ifndef __VKDF_STAGING_H__
+#define __VKDF_STAGING_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-init.hpp"
+#include "vkdf-buffer.hpp"
+
+/* Default size of the host-visible staging buffer. Uploads that don't fit
+ * in the remaining space flush the pending batch first, and single uploads
+ * larger than the buffer make it grow.
+ */
+#define VKDF_STAGING_DEFAULT_SIZE (8 * 1024 * 1024)
+
+/**
+ * Batches uploads of buffer data to device-local memory. Clients request
+ * space in the staging buffer for each upload, write their data directly
+ * into it and all the resulting copies are submitted together in a single
+ * command buffer on vkdf_staging_flush().
+ */
+typedef struct {
+   VkdfContext *ctx;
+   VkCommandPool pool;
+   VkCommandBuffer cmd_buf;
+   bool recording;
+
+   VkdfBuffer buf;
+   uint8_t *map;
+   VkDeviceSize size;
+   VkDeviceSize offset;
+
+   uint32_t num_copies;
+} VkdfStaging;
+
+VkdfStaging *
+vkdf_staging_new(VkdfContext *ctx, VkDeviceSize size = VKDF_STAGING_DEFAULT_SIZE);
+
+void *
+vkdf_staging_upload_to_buffer(VkdfStaging *st,
+                              VkdfBuffer *dst,
+                              VkDeviceSize dst_offset,
+                              VkDeviceSize size);
+
+void
+vkdf_staging_flush(VkdfStaging *st);
+
+void
+vkdf_staging_free(VkdfStaging *st);
+
+uint8_t *
+vkdf_staging_create_geometry_buffer(VkdfContext *ctx,
+                                    VkdfStaging *st,
+                                    VkBufferUsageFlags usage,
+                                    VkDeviceSize size,
+                                    VkdfBuffer *buf);
+
+void
+vkdf_staging_finish_geometry_buffer(VkdfContext *ctx, VkdfBuffer *buf);
+
+#endif
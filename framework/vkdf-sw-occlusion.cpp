@@ -0,0 +1,479 @@
+#include "vkdf-sw-occlusion.hpp"
+#include "vkdf-util.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Triangles are drawn alone or in pairs, and clipping adds a vertex
+#define MAX_POLYGON_VERTICES 5
+
+VkdfSwOcclusion *
+vkdf_sw_occlusion_new(uint32_t width, uint32_t height)
+{
+   assert(width > 0 && height > 0);
+
+   VkdfSwOcclusion *occ = g_new0(VkdfSwOcclusion, 1);
+
+   // The inner loop processes rows in groups of 4 pixels
+   occ->width = (width + 3) & ~3u;
+   occ->height = height;
+   occ->depth.resize(occ->width * occ->height, 1.0f);
+
+   // Occluders are rasterized for the view the boxes are tested with
+   occ->hiz = vkdf_hiz_new(occ->width, occ->height, 1);
+   occ->hiz->clamp_to_view = true;
+
+   return occ;
+}
+
+void
+vkdf_sw_occlusion_free(VkdfSwOcclusion *occ)
+{
+   vkdf_hiz_free(occ->hiz);
+   occ->depth.clear();
+   std::vector<float>(occ->depth).swap(occ->depth);
+   occ->vertices.clear();
+   std::vector<VkdfSwOcclusionVertex>(occ->vertices).swap(occ->vertices);
+   occ->indices.clear();
+   std::vector<uint32_t>(occ->indices).swap(occ->indices);
+   occ->edges.clear();
+   std::vector<VkdfSwOcclusionEdge>(occ->edges).swap(occ->edges);
+   occ->pairs.clear();
+   std::vector<int32_t>(occ->pairs).swap(occ->pairs);
+   g_free(occ);
+}
+
+void
+vkdf_sw_occlusion_begin(VkdfSwOcclusion *occ, const glm::mat4 &view_proj)
+{
+   std::fill(occ->depth.begin(), occ->depth.end(), 1.0f);
+   occ->view_proj = view_proj;
+   occ->num_triangles = 0;
+}
+
+/**
+ * Rasterizes a convex polygon in screen-space (x, y in pixels, z in [0, 1])
+ * with up to MAX_POLYGON_VERTICES vertices in either winding.
+ *
+ * Coverage is tested with an edge function E(x, y) = A * x + B * y + C per
+ * edge, all of which are positive inside for polygons with positive area.
+ * To never over-estimate occlusion, pixels are only covered when they are
+ * fully inside the polygon, that is, when every E is positive at the pixel
+ * corner farthest outside its edge, and they take the farthest depth of the
+ * polygon over the pixel. We evaluate everything at pixel centers, so that
+ * means moving the edges in, and the depth back, by half a pixel along each
+ * axis.
+ */
+static void
+rasterize_polygon(VkdfSwOcclusion *occ, glm::vec3 *v, uint32_t n)
+{
+   assert(n >= 3 && n <= MAX_POLYGON_VERTICES);
+
+   // The polygon is planar, so depth is affine in screen-space after the
+   // perspective division. Take its gradients from the largest triangle
+   // in the fan to keep precision with thin slivers.
+   float area = 0.0f;
+   float max_area = 0.0f;
+   uint32_t max_i = 1;
+   for (uint32_t i = 1; i + 1 < n; i++) {
+      float a = (v[i].x - v[0].x) * (v[i + 1].y - v[0].y) -
+                (v[i + 1].x - v[0].x) * (v[i].y - v[0].y);
+      area += a;
+      if (fabsf(a) > fabsf(max_area)) {
+         max_area = a;
+         max_i = i;
+      }
+   }
+
+   if (area == 0.0f || max_area == 0.0f)
+      return;
+
+   const glm::vec3 &t0 = v[0];
+   const glm::vec3 &t1 = v[max_i];
+   const glm::vec3 &t2 = v[max_i + 1];
+   const float dzdx =
+      ((t1.z - t0.z) * (t2.y - t0.y) - (t2.z - t0.z) * (t1.y - t0.y)) / max_area;
+   const float dzdy =
+      ((t2.z - t0.z) * (t1.x - t0.x) - (t1.z - t0.z) * (t2.x - t0.x)) / max_area;
+   const float zc = t0.z - dzdx * t0.x - dzdy * t0.y +
+                    0.5f * (fabsf(dzdx) + fabsf(dzdy));
+
+   // Occluders are double-sided, so just fix the winding
+   if (area < 0.0f) {
+      for (uint32_t i = 0; i < n / 2; i++) {
+         glm::vec3 tmp = v[i];
+         v[i] = v[n - 1 - i];
+         v[n - 1 - i] = tmp;
+      }
+   }
+
+   // Bounding box in pixels, with the start column aligned to 4 pixels
+   float min_x = v[0].x, max_x = v[0].x;
+   float min_y = v[0].y, max_y = v[0].y;
+   for (uint32_t i = 1; i < n; i++) {
+      min_x = MIN2(min_x, v[i].x);
+      max_x = MAX2(max_x, v[i].x);
+      min_y = MIN2(min_y, v[i].y);
+      max_y = MAX2(max_y, v[i].y);
+   }
+   if (max_x < 0.0f || min_x > occ->width ||
+       max_y < 0.0f || min_y > occ->height)
+      return;
+
+   int32_t x0 = (int32_t) MAX2(floorf(min_x), 0.0f) & ~3;
+   int32_t x1 = (int32_t) MIN2(ceilf(max_x), (float) occ->width - 1);
+   int32_t y0 = (int32_t) MAX2(floorf(min_y), 0.0f);
+   int32_t y1 = (int32_t) MIN2(ceilf(max_y), (float) occ->height - 1);
+
+   // Edge functions, from each vertex to the next, moved in by half a pixel
+   float a[MAX_POLYGON_VERTICES];
+   float b[MAX_POLYGON_VERTICES];
+   float c[MAX_POLYGON_VERTICES];
+   for (uint32_t i = 0; i < n; i++) {
+      const glm::vec3 &p0 = v[i];
+      const glm::vec3 &p1 = v[(i + 1) % n];
+      a[i] = p0.y - p1.y;
+      b[i] = p1.x - p0.x;
+      c[i] = -(a[i] * p0.x + b[i] * p0.y) - 0.5f * (fabsf(a[i]) + fabsf(b[i]));
+   }
+
+#ifdef __SSE2__
+   const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 z_step = _mm_set1_ps(4.0f * dzdx);
+   __m128 e_step[MAX_POLYGON_VERTICES];
+   for (uint32_t i = 0; i < n; i++)
+      e_step[i] = _mm_set1_ps(4.0f * a[i]);
+
+   for (int32_t y = y0; y <= y1; y++) {
+      const float py = y + 0.5f;
+      const __m128 px = _mm_add_ps(_mm_set1_ps((float) x0), offsets);
+
+      __m128 e[MAX_POLYGON_VERTICES];
+      for (uint32_t i = 0; i < n; i++) {
+         e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i]), px),
+                           _mm_set1_ps(b[i] * py + c[i]));
+      }
+      __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px),
+                            _mm_set1_ps(dzdy * py + zc));
+
+      float *row = &occ->depth[y * occ->width];
+      for (int32_t x = x0; x <= x1; x += 4) {
+         __m128 mask = _mm_cmpge_ps(e[0], zero);
+         for (uint32_t i = 1; i < n; i++)
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(e[i], zero));
+
+         if (_mm_movemask_ps(mask)) {
+            __m128 depth = _mm_loadu_ps(&row[x]);
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(z, depth));
+            depth = _mm_or_ps(_mm_and_ps(mask, z),
+                              _mm_andnot_ps(mask, depth));
+            _mm_storeu_ps(&row[x], depth);
+         }
+
+         for (uint32_t i = 0; i < n; i++)
+            e[i] = _mm_add_ps(e[i], e_step[i]);
+         z = _mm_add_ps(z, z_step);
+      }
+   }
+#else
+   for (int32_t y = y0; y <= y1; y++) {
+      const float py = y + 0.5f;
+      float *row = &occ->depth[y * occ->width];
+      for (int32_t x = x0; x <= x1; x++) {
+         const float px = x + 0.5f;
+
+         uint32_t i = 0;
+         while (i < n && a[i] * px + b[i] * py + c[i] >= 0.0f)
+            i++;
+         if (i < n)
+            continue;
+
+         const float z = dzdx * px + dzdy * py + zc;
+         if (z < row[x])
+            row[x] = z;
+      }
+   }
+#endif
+}
+
+static inline glm::vec3
+clip_to_screen(VkdfSwOcclusion *occ, const glm::vec4 &clip)
+{
+   return glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * occ->width,
+                    (clip.y / clip.w * 0.5f + 0.5f) * occ->height,
+                    clip.z / clip.w);
+}
+
+/**
+ * Clips a convex polygon in clip-space against the near plane (z >= 0),
+ * which also guarantees w > 0 for the perspective division, and rasterizes
+ * the result. Polygons fully outside any other frustum plane are discarded,
+ * the rest are clipped to the screen by the rasterizer.
+ */
+static void
+draw_clip_polygon(VkdfSwOcclusion *occ, const glm::vec4 *v, uint32_t n)
+{
+   assert(n < MAX_POLYGON_VERTICES);
+
+   uint32_t outside[6] = { 0, 0, 0, 0, 0, 0 };
+   for (uint32_t i = 0; i < n; i++) {
+      outside[0] += v[i].x > v[i].w;
+      outside[1] += v[i].x < -v[i].w;
+      outside[2] += v[i].y > v[i].w;
+      outside[3] += v[i].y < -v[i].w;
+      outside[4] += v[i].z > v[i].w;
+      outside[5] += v[i].z < 0.0f;
+   }
+   for (uint32_t i = 0; i < 6; i++) {
+      if (outside[i] == n)
+         return;
+   }
+
+   occ->num_triangles += n - 2;
+
+   // Clipping a convex polygon against a single plane adds at most one
+   // vertex
+   glm::vec3 s[MAX_POLYGON_VERTICES];
+   uint32_t count = 0;
+   for (uint32_t i = 0; i < n; i++) {
+      const glm::vec4 &p0 = v[i];
+      const glm::vec4 &p1 = v[(i + 1) % n];
+
+      if (p0.z >= 0.0f)
+         s[count++] = clip_to_screen(occ, p0);
+
+      if ((p0.z >= 0.0f) != (p1.z >= 0.0f)) {
+         const float t = p0.z / (p0.z - p1.z);
+         s[count++] = clip_to_screen(occ, p0 + (p1 - p0) * t);
+      }
+   }
+
+   assert(count >= 3 && count <= n + 1);
+
+   rasterize_polygon(occ, s, count);
+}
+
+/**
+ * Checks if the triangle (a0, a1, x) and the triangle on the other side of
+ * its edge (a0, a1), with opposite vertex 'y', are coplanar and form a
+ * convex quad (a0, y, a1, x).
+ */
+static bool
+can_merge_triangles(const glm::vec3 &a0, const glm::vec3 &a1,
+                    const glm::vec3 &x, const glm::vec3 &y)
+{
+   const glm::vec3 n = glm::cross(a1 - a0, x - a0);
+   const glm::vec3 m = glm::cross(a0 - a1, y - a1);
+   const float nn = glm::dot(n, n);
+   const float mm = glm::dot(m, m);
+   if (nn == 0.0f || mm == 0.0f)
+      return false;
+
+   const float d = glm::dot(n, m);
+   if (d * d < 0.9999f * nn * mm)
+      return false;
+
+   // The diagonals must cross
+   if (glm::dot(n, glm::cross(a1 - a0, y - a0)) >= 0.0f)
+      return false;
+
+   const float s0 = glm::dot(n, glm::cross(y - x, a0 - x));
+   const float s1 = glm::dot(n, glm::cross(y - x, a1 - x));
+   return (s0 < 0.0f && s1 > 0.0f) || (s0 > 0.0f && s1 < 0.0f);
+}
+
+static bool
+edge_cmp(const VkdfSwOcclusionEdge &a, const VkdfSwOcclusionEdge &b)
+{
+   return a.key < b.key;
+}
+
+static bool
+vertex_cmp(const VkdfSwOcclusionVertex &a, const VkdfSwOcclusionVertex &b)
+{
+   if (a.pos.x != b.pos.x)
+      return a.pos.x < b.pos.x;
+   if (a.pos.y != b.pos.y)
+      return a.pos.y < b.pos.y;
+   return a.pos.z < b.pos.z;
+}
+
+/**
+ * Builds indices for 'count' consecutive vertices in occ->indices, where
+ * vertices in the same position share the same index.
+ */
+static void
+weld_vertices(VkdfSwOcclusion *occ, const glm::vec3 *vertices, uint32_t count)
+{
+   std::vector<VkdfSwOcclusionVertex> &sorted = occ->vertices;
+   sorted.resize(count);
+   for (uint32_t i = 0; i < count; i++) {
+      sorted[i].pos = vertices[i];
+      sorted[i].index = i;
+   }
+   std::sort(sorted.begin(), sorted.end(), vertex_cmp);
+
+   occ->indices.resize(count);
+   uint32_t first = 0;
+   for (uint32_t i = 0; i < count; i++) {
+      if (vertex_cmp(sorted[first], sorted[i]))
+         first = i;
+      occ->indices[sorted[i].index] = sorted[first].index;
+   }
+}
+
+/**
+ * Pairs up triangles that share an edge and can be drawn together as a
+ * convex quad. On return, occ->pairs has, for each paired triangle, the
+ * shared edge in the other triangle (as 3 * triangle + edge, where edge i
+ * goes from vertex i to the next one), or -1.
+ */
+static void
+pair_triangles(VkdfSwOcclusion *occ,
+               const glm::vec3 *vertices,
+               const uint32_t *indices,
+               uint32_t num_tris)
+{
+   // Sort edges by their (sorted) vertex indices to find the shared ones
+   std::vector<VkdfSwOcclusionEdge> &edges = occ->edges;
+   edges.resize(3 * num_tris);
+   for (uint32_t i = 0; i < 3 * num_tris; i++) {
+      const uint32_t i0 = indices[i];
+      const uint32_t i1 = indices[i - i % 3 + (i + 1) % 3];
+      edges[i].key = ((uint64_t) MIN2(i0, i1) << 32) | MAX2(i0, i1);
+      edges[i].edge = i;
+   }
+   std::sort(edges.begin(), edges.end(), edge_cmp);
+
+   occ->pairs.assign(num_tris, -1);
+
+   uint32_t i = 0;
+   while (i < edges.size()) {
+      uint32_t j = i + 1;
+      while (j < edges.size() && edges[j].key == edges[i].key)
+         j++;
+
+      // Only edges shared by exactly two triangles
+      if (j - i == 2) {
+         const uint32_t ea = edges[i].edge;
+         const uint32_t eb = edges[i + 1].edge;
+         const uint32_t ta = ea / 3;
+         const uint32_t tb = eb / 3;
+         if (ta != tb && occ->pairs[ta] < 0 && occ->pairs[tb] < 0) {
+            const uint32_t a0 = indices[ea];
+            const uint32_t a1 = indices[3 * ta + (ea + 1) % 3];
+            const uint32_t x = indices[3 * ta + (ea + 2) % 3];
+            const uint32_t y = indices[3 * tb + (eb + 2) % 3];
+            if (can_merge_triangles(vertices[a0], vertices[a1],
+                                    vertices[x], vertices[y])) {
+               occ->pairs[ta] = eb;
+               occ->pairs[tb] = ea;
+            }
+         }
+      }
+
+      i = j;
+   }
+}
+
+void
+vkdf_sw_occlusion_draw_triangles(VkdfSwOcclusion *occ,
+                                 const glm::mat4 &model,
+                                 const glm::vec3 *vertices,
+                                 const uint32_t *indices,
+                                 uint32_t count)
+{
+   const glm::mat4 mvp = occ->view_proj * model;
+   const uint32_t num_tris = count / 3;
+   if (num_tris == 0)
+      return;
+
+   if (!indices) {
+      weld_vertices(occ, vertices, 3 * num_tris);
+      indices = &occ->indices[0];
+   }
+
+   // Fully covered pixels along the edge between two triangles are not
+   // fully covered by either of them, so draw coplanar triangles in pairs
+   // when we can to avoid holes along the inner edges of occluders
+   pair_triangles(occ, vertices, indices, num_tris);
+
+   glm::vec4 v[4];
+   for (uint32_t i = 0; i < num_tris; i++) {
+      const int32_t edge = occ->pairs[i];
+      if (edge < 0) {
+         for (uint32_t j = 0; j < 3; j++)
+            v[j] = mvp * glm::vec4(vertices[indices[3 * i + j]], 1.0f);
+         draw_clip_polygon(occ, v, 3);
+         continue;
+      }
+
+      // Draw each pair once, as the quad (a0, y, a1, x) where (a0, a1) is
+      // the shared edge
+      const uint32_t other = edge / 3;
+      if (other < i)
+         continue;
+
+      const uint32_t own_edge = occ->pairs[other];
+      const uint32_t quad[4] = {
+         indices[own_edge],
+         indices[3 * other + (edge + 2) % 3],
+         indices[3 * i + (own_edge + 1) % 3],
+         indices[3 * i + (own_edge + 2) % 3],
+      };
+      for (uint32_t j = 0; j < 4; j++)
+         v[j] = mvp * glm::vec4(vertices[quad[j]], 1.0f);
+      draw_clip_polygon(occ, v, 4);
+   }
+}
+
+void
+vkdf_sw_occlusion_draw_mesh(VkdfSwOcclusion *occ,
+                            VkdfMesh *mesh,
+                            const glm::mat4 &model,
+                            uint32_t lod)
+{
+   if (!mesh->active ||
+       mesh->primitive != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST ||
+       mesh->vertices.size() == 0)
+      return;
+
+   if (mesh->indices.size() == 0) {
+      vkdf_sw_occlusion_draw_triangles(occ, model, &mesh->vertices[0],
+                                       NULL, mesh->vertices.size());
+      return;
+   }
+
+   lod = MIN2(lod, vkdf_mesh_get_num_lods(mesh) - 1);
+   if (lod == 0) {
+      vkdf_sw_occlusion_draw_triangles(occ, model, &mesh->vertices[0],
+                                       &mesh->indices[0],
+                                       mesh->indices.size());
+   } else {
+      const VkdfMeshLod *l = &mesh->lods[lod];
+      vkdf_sw_occlusion_draw_triangles(occ, model, &mesh->vertices[0],
+                                       &mesh->lod_indices[l->first_index -
+                                                          mesh->indices.size()],
+                                       l->index_count);
+   }
+}
+
+void
+vkdf_sw_occlusion_draw_object(VkdfSwOcclusion *occ,
+                              VkdfObject *obj,
+                              uint32_t lod)
+{
+   const glm::mat4 model = vkdf_object_get_model_matrix(obj);
+   for (uint32_t i = 0; i < obj->model->meshes.size(); i++)
+      vkdf_sw_occlusion_draw_mesh(occ, obj->model->meshes[i], model, lod);
+}
+
+void
+vkdf_sw_occlusion_end(VkdfSwOcclusion *occ)
+{
+   vkdf_hiz_update(occ->hiz, &occ->depth[0], occ->view_proj);
+}
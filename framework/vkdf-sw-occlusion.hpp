@@ -0,0 +1,111 @@
+#ifndef __VKDF_SW_OCCLUSION_H__
+#define __VKDF_SW_OCCLUSION_H__
+
+#include "vkdf-deps.hpp"
+#include "vkdf-box.hpp"
+#include "vkdf-hiz.hpp"
+#include "vkdf-mesh.hpp"
+#include "vkdf-object.hpp"
+
+typedef struct {
+   uint64_t key;                       // Sorted vertex indices
+   uint32_t edge;                      // 3 * triangle + edge in triangle
+} VkdfSwOcclusionEdge;
+
+typedef struct {
+   glm::vec3 pos;
+   uint32_t index;
+} VkdfSwOcclusionVertex;
+
+/**
+ * A small software depth rasterizer for occlusion culling on the CPU.
+ *
+ * Occluder triangles are rasterized into a low resolution depth buffer
+ * (depth-only, no attributes) for the current view, which is then turned
+ * into a hierarchical depth buffer to test boxes against. Since it doesn't
+ * depend on the GPU there is no readback latency, at the expense of
+ * only taking into account the geometry designated as occluders.
+ *
+ * Coverage is conservative: pixels are only covered when they are fully
+ * inside a triangle, and they take its farthest depth over the pixel, so
+ * boxes are never reported occluded when some part of them could be seen
+ * past the occluders. Pairs of coplanar triangles that share an edge and
+ * form a convex quad are drawn as a single quad, so the pixels along their
+ * shared edge aren't lost. The inner loop processes 4 pixels at a time
+ * with SSE2 when available.
+ */
+typedef struct {
+   uint32_t width;                     // Multiple of 4
+   uint32_t height;
+   std::vector<float> depth;
+
+   glm::mat4 view_proj;
+   VkdfHiZ *hiz;
+
+   uint32_t num_triangles;             // Rasterized since the last begin
+
+   // Scratch storage to pair up triangles into quads
+   std::vector<VkdfSwOcclusionVertex> vertices;
+   std::vector<uint32_t> indices;
+   std::vector<VkdfSwOcclusionEdge> edges;
+   std::vector<int32_t> pairs;
+} VkdfSwOcclusion;
+
+/**
+ * Creates a rasterizer with a 'width' x 'height' depth buffer. The width
+ * is rounded up to a multiple of 4.
+ */
+VkdfSwOcclusion *
+vkdf_sw_occlusion_new(uint32_t width, uint32_t height);
+
+void
+vkdf_sw_occlusion_free(VkdfSwOcclusion *occ);
+
+/**
+ * Clears the depth buffer to start rasterizing occluders for a new view.
+ */
+void
+vkdf_sw_occlusion_begin(VkdfSwOcclusion *occ, const glm::mat4 &view_proj);
+
+/**
+ * Rasterizes a triangle list. If 'indices' is NULL, 'count' consecutive
+ * vertices are used instead, welding the ones in the same position so
+ * triangles that share them can still be paired into quads.
+ */
+void
+vkdf_sw_occlusion_draw_triangles(VkdfSwOcclusion *occ,
+                                 const glm::mat4 &model,
+                                 const glm::vec3 *vertices,
+                                 const uint32_t *indices,
+                                 uint32_t count);
+
+/**
+ * Rasterizes the mesh at the requested level of detail, or the coarsest
+ * available if it doesn't have that many. Only triangle lists are
+ * supported, other meshes are ignored.
+ */
+void
+vkdf_sw_occlusion_draw_mesh(VkdfSwOcclusion *occ,
+                            VkdfMesh *mesh,
+                            const glm::mat4 &model,
+                            uint32_t lod = 0);
+
+void
+vkdf_sw_occlusion_draw_object(VkdfSwOcclusion *occ,
+                              VkdfObject *obj,
+                              uint32_t lod = 0);
+
+/**
+ * Finishes the current view, building the hierarchical depth buffer used
+ * for box testing.
+ */
+void
+vkdf_sw_occlusion_end(VkdfSwOcclusion *occ);
+
+inline bool
+vkdf_sw_occlusion_is_box_occluded(VkdfSwOcclusion *occ, const VkdfBox *box)
+{
+   return vkdf_hiz_is_box_occluded(occ->hiz, box);
+}
+
+#endif
@@ -0,0 +1,402 @@
+#include "vkdf-vertex-format.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* F16C is not part of the default x86-64 target, so build the half-float
+ * path with a target attribute and select it at run time.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VKDF_VERTEX_FORMAT_F16C 1
+#include <immintrin.h>
+#endif
+
+#define ATTRIB_BIT(a) (1u << (a))
+
+static uint32_t
+get_format_size(VkFormat format)
+{
+   switch (format) {
+   case VK_FORMAT_UNDEFINED:
+      return 0;
+   case VK_FORMAT_R32_UINT:
+   case VK_FORMAT_R16G16_SNORM:
+   case VK_FORMAT_R16G16_SFLOAT:
+      return 4;
+   case VK_FORMAT_R32G32_SFLOAT:
+   case VK_FORMAT_R16G16B16A16_SNORM:
+      return 8;
+   case VK_FORMAT_R32G32B32_SFLOAT:
+      return 12;
+   default:
+      assert(!"Unsupported vertex attribute format");
+      return 0;
+   }
+}
+
+void
+vkdf_vertex_format_get_layout(const VkdfVertexFormat *fmt,
+                              uint32_t attrib_mask,
+                              VkdfVertexLayout *layout)
+{
+   assert(attrib_mask & ATTRIB_BIT(VKDF_VERTEX_ATTRIB_POSITION));
+
+   bool has_normals = attrib_mask & ATTRIB_BIT(VKDF_VERTEX_ATTRIB_NORMAL);
+   bool has_tangents = has_normals &&
+      (attrib_mask & ATTRIB_BIT(VKDF_VERTEX_ATTRIB_TANGENT));
+   bool has_bitangents = has_normals &&
+      (attrib_mask & ATTRIB_BIT(VKDF_VERTEX_ATTRIB_BITANGENT));
+   bool has_uv = attrib_mask & ATTRIB_BIT(VKDF_VERTEX_ATTRIB_UV);
+   bool has_material = !fmt->per_draw_material &&
+      (attrib_mask & ATTRIB_BIT(VKDF_VERTEX_ATTRIB_MATERIAL));
+
+   for (uint32_t i = 0; i < VKDF_VERTEX_ATTRIB_COUNT; i++)
+      layout->format[i] = VK_FORMAT_UNDEFINED;
+
+   // Position is always full precision, since the shadow map and depth
+   // prepass pipelines rely on that
+   layout->format[VKDF_VERTEX_ATTRIB_POSITION] = VK_FORMAT_R32G32B32_SFLOAT;
+
+   if (has_normals) {
+      if (has_tangents && fmt->tangent == VKDF_VERTEX_ENCODING_QTANGENT) {
+         assert(has_bitangents);
+         layout->format[VKDF_VERTEX_ATTRIB_NORMAL] =
+            VK_FORMAT_R16G16B16A16_SNORM;
+      } else {
+         switch (fmt->normal) {
+         case VKDF_VERTEX_ENCODING_FLOAT:
+            layout->format[VKDF_VERTEX_ATTRIB_NORMAL] =
+               VK_FORMAT_R32G32B32_SFLOAT;
+            break;
+         case VKDF_VERTEX_ENCODING_SNORM16:
+            layout->format[VKDF_VERTEX_ATTRIB_NORMAL] =
+               VK_FORMAT_R16G16B16A16_SNORM;
+            break;
+         case VKDF_VERTEX_ENCODING_OCTAHEDRAL:
+            layout->format[VKDF_VERTEX_ATTRIB_NORMAL] =
+               VK_FORMAT_R16G16_SNORM;
+            break;
+         default:
+            assert(!"Invalid normal encoding");
+         }
+
+         if (has_tangents) {
+            assert(has_bitangents);
+            VkFormat tangent_format;
+            switch (fmt->tangent) {
+            case VKDF_VERTEX_ENCODING_FLOAT:
+               tangent_format = VK_FORMAT_R32G32B32_SFLOAT;
+               break;
+            case VKDF_VERTEX_ENCODING_SNORM16:
+               tangent_format = VK_FORMAT_R16G16B16A16_SNORM;
+               break;
+            default:
+               assert(!"Invalid tangent encoding");
+               tangent_format = VK_FORMAT_R32G32B32_SFLOAT;
+            }
+            layout->format[VKDF_VERTEX_ATTRIB_TANGENT] = tangent_format;
+            layout->format[VKDF_VERTEX_ATTRIB_BITANGENT] = tangent_format;
+         }
+      }
+   }
+
+   if (has_uv) {
+      switch (fmt->uv) {
+      case VKDF_VERTEX_ENCODING_FLOAT:
+         layout->format[VKDF_VERTEX_ATTRIB_UV] = VK_FORMAT_R32G32_SFLOAT;
+         break;
+      case VKDF_VERTEX_ENCODING_HALF:
+         layout->format[VKDF_VERTEX_ATTRIB_UV] = VK_FORMAT_R16G16_SFLOAT;
+         break;
+      default:
+         assert(!"Invalid UV encoding");
+      }
+   }
+
+   if (has_material)
+      layout->format[VKDF_VERTEX_ATTRIB_MATERIAL] = VK_FORMAT_R32_UINT;
+
+   uint32_t offset = 0;
+   for (uint32_t i = 0; i < VKDF_VERTEX_ATTRIB_COUNT; i++) {
+      layout->offset[i] = offset;
+      offset += get_format_size(layout->format[i]);
+   }
+   layout->stride = offset;
+}
+
+uint32_t
+vkdf_vertex_layout_get_attribute_descriptions(
+   const VkdfVertexLayout *layout,
+   uint32_t binding,
+   uint32_t first_location,
+   VkVertexInputAttributeDescription *attribs)
+{
+   uint32_t count = 0;
+   for (uint32_t i = 0; i < VKDF_VERTEX_ATTRIB_COUNT; i++) {
+      if (layout->format[i] == VK_FORMAT_UNDEFINED)
+         continue;
+
+      attribs[count].binding = binding;
+      attribs[count].location = first_location + count;
+      attribs[count].format = layout->format[i];
+      attribs[count].offset = layout->offset[i];
+      count++;
+   }
+   return count;
+}
+
+static inline void
+pack_snorm16x4(uint8_t *dst, float x, float y, float z, float w)
+{
+#ifdef __SSE2__
+   __m128 v = _mm_setr_ps(x, y, z, w);
+   v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+   __m128i i = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(32767.0f)));
+   _mm_storel_epi64((__m128i *) dst, _mm_packs_epi32(i, i));
+#else
+   int16_t v[4];
+   const float in[4] = { x, y, z, w };
+   for (uint32_t i = 0; i < 4; i++)
+      v[i] = (int16_t) roundf(CLAMP(in[i], -1.0f, 1.0f) * 32767.0f);
+   memcpy(dst, v, sizeof(v));
+#endif
+}
+
+static inline void
+pack_snorm16x2(uint8_t *dst, float x, float y)
+{
+   int16_t v[2];
+   v[0] = (int16_t) roundf(CLAMP(x, -1.0f, 1.0f) * 32767.0f);
+   v[1] = (int16_t) roundf(CLAMP(y, -1.0f, 1.0f) * 32767.0f);
+   memcpy(dst, v, sizeof(v));
+}
+
+/* Round-to-nearest-even float to half conversion */
+static inline uint16_t
+float_to_half(float f)
+{
+   uint32_t x;
+   memcpy(&x, &f, sizeof(x));
+
+   uint32_t sign = (x >> 16) & 0x8000;
+   uint32_t fexp = (x >> 23) & 0xff;
+   uint32_t mant = x & 0x7fffff;
+
+   if (fexp == 0xff)
+      return sign | 0x7c00 | (mant ? 0x200 : 0);
+
+   int32_t exp = (int32_t) fexp - 127 + 15;
+   if (exp >= 31)
+      return sign | 0x7c00;
+
+   if (exp <= 0) {
+      if (exp < -10)
+         return sign;
+      mant |= 0x800000;
+      uint32_t shift = 14 - exp;
+      uint32_t h = mant >> shift;
+      uint32_t rem = mant & ((1u << shift) - 1);
+      uint32_t half_point = 1u << (shift - 1);
+      if (rem > half_point || (rem == half_point && (h & 1)))
+         h++;
+      return sign | h;
+   }
+
+   uint32_t h = (exp << 10) | (mant >> 13);
+   uint32_t rem = mant & 0x1fff;
+   if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+      h++;
+   return sign | h;
+}
+
+#ifdef VKDF_VERTEX_FORMAT_F16C
+/**
+ * F16C version of pack_half2_stream(). Converts 4 vertices per iteration
+ * and returns the number of vertices packed, the caller takes care of the
+ * rest.
+ */
+__attribute__((target("avx,f16c")))
+static uint32_t
+pack_half2_stream_f16c(uint8_t *dst,
+                       uint32_t stride,
+                       const glm::vec2 *v,
+                       uint32_t count)
+{
+   uint32_t i = 0;
+   for (; i + 4 <= count; i += 4) {
+      __m256 f = _mm256_loadu_ps((const float *) &v[i]);
+      __m128i h = _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT);
+
+      uint32_t packed[4];
+      _mm_storeu_si128((__m128i *) packed, h);
+      for (uint32_t j = 0; j < 4; j++)
+         memcpy(dst + (i + j) * stride, &packed[j], sizeof(uint32_t));
+   }
+
+   return i;
+}
+#endif
+
+/**
+ * Packs 'count' 2-component vectors as half floats into 'dst', 'stride'
+ * bytes apart.
+ */
+static void
+pack_half2_stream(uint8_t *dst,
+                  uint32_t stride,
+                  const glm::vec2 *v,
+                  uint32_t count)
+{
+   uint32_t i = 0;
+
+#ifdef VKDF_VERTEX_FORMAT_F16C
+   static const bool has_f16c =
+      __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+   if (has_f16c)
+      i = pack_half2_stream_f16c(dst, stride, v, count);
+#endif
+
+   for (; i < count; i++) {
+      uint16_t h[2] = { float_to_half(v[i].x), float_to_half(v[i].y) };
+      memcpy(dst + i * stride, h, sizeof(h));
+   }
+}
+
+static inline float
+sign_not_zero(float v)
+{
+   return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static inline void
+pack_octahedral(uint8_t *dst, const glm::vec3 &n)
+{
+   float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+   float x = l1 > 0.0f ? n.x / l1 : 0.0f;
+   float y = l1 > 0.0f ? n.y / l1 : 0.0f;
+   if (n.z < 0.0f) {
+      float ox = x;
+      x = (1.0f - fabsf(y)) * sign_not_zero(ox);
+      y = (1.0f - fabsf(ox)) * sign_not_zero(y);
+   }
+   pack_snorm16x2(dst, x, y);
+}
+
+static inline void
+pack_qtangent(uint8_t *dst,
+              const glm::vec3 &normal,
+              const glm::vec3 &tangent,
+              const glm::vec3 &bitangent)
+{
+   // Orthonormalize the frame. The quaternion can only represent a proper
+   // rotation, so we rebuild the bitangent and keep its handedness aside.
+   glm::vec3 n = glm::normalize(normal);
+   glm::vec3 t = tangent - n * glm::dot(n, tangent);
+   if (glm::dot(t, t) < 1e-12f) {
+      t = fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) :
+                              glm::vec3(0.0f, 1.0f, 0.0f);
+      t = t - n * glm::dot(n, t);
+   }
+   t = glm::normalize(t);
+   glm::vec3 b = glm::cross(n, t);
+   bool reflected = glm::dot(b, bitangent) < 0.0f;
+
+   glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+   if (q.w < 0.0f)
+      q = -q;
+
+   // Make sure w never encodes as 0 so its sign can store the handedness
+   const float bias = 1.0f / 32767.0f;
+   if (q.w < bias) {
+      float s = sqrtf(1.0f - bias * bias);
+      q.x *= s;
+      q.y *= s;
+      q.z *= s;
+      q.w = bias;
+   }
+
+   if (reflected)
+      q = -q;
+
+   pack_snorm16x4(dst, q.x, q.y, q.z, q.w);
+}
+
+static inline void
+pack_vec3(uint8_t *dst, VkFormat format, const glm::vec3 &v)
+{
+   if (format == VK_FORMAT_R32G32B32_SFLOAT)
+      memcpy(dst, &v, sizeof(glm::vec3));
+   else
+      pack_snorm16x4(dst, v.x, v.y, v.z, 0.0f);
+}
+
+uint32_t
+vkdf_vertex_format_pack(const VkdfVertexFormat *fmt,
+                        const VkdfVertexStreams *in,
+                        uint32_t count,
+                        uint8_t *dst)
+{
+   assert(in->positions);
+
+   uint32_t attrib_mask = ATTRIB_BIT(VKDF_VERTEX_ATTRIB_POSITION);
+   if (in->normals)
+      attrib_mask |= ATTRIB_BIT(VKDF_VERTEX_ATTRIB_NORMAL);
+   if (in->tangents)
+      attrib_mask |= ATTRIB_BIT(VKDF_VERTEX_ATTRIB_TANGENT);
+   if (in->bitangents)
+      attrib_mask |= ATTRIB_BIT(VKDF_VERTEX_ATTRIB_BITANGENT);
+   if (in->uvs)
+      attrib_mask |= ATTRIB_BIT(VKDF_VERTEX_ATTRIB_UV);
+   if (in->material_idx != -1)
+      attrib_mask |= ATTRIB_BIT(VKDF_VERTEX_ATTRIB_MATERIAL);
+
+   VkdfVertexLayout l;
+   vkdf_vertex_format_get_layout(fmt, attrib_mask, &l);
+
+   const VkFormat normal_fmt = l.format[VKDF_VERTEX_ATTRIB_NORMAL];
+   const VkFormat tangent_fmt = l.format[VKDF_VERTEX_ATTRIB_TANGENT];
+   const bool has_qtangent = normal_fmt != VK_FORMAT_UNDEFINED &&
+      fmt->tangent == VKDF_VERTEX_ENCODING_QTANGENT &&
+      tangent_fmt == VK_FORMAT_UNDEFINED && in->tangents && in->bitangents;
+   const bool has_octahedral = normal_fmt == VK_FORMAT_R16G16_SNORM;
+   const VkFormat uv_fmt = l.format[VKDF_VERTEX_ATTRIB_UV];
+   const bool has_material =
+      l.format[VKDF_VERTEX_ATTRIB_MATERIAL] != VK_FORMAT_UNDEFINED;
+
+   // Half-float UVs are converted in a separate pass over the whole stream
+   if (uv_fmt == VK_FORMAT_R16G16_SFLOAT)
+      pack_half2_stream(dst + l.offset[VKDF_VERTEX_ATTRIB_UV], l.stride,
+                        in->uvs, count);
+
+   for (uint32_t i = 0; i < count; i++, dst += l.stride) {
+      memcpy(dst, &in->positions[i], sizeof(glm::vec3));
+
+      if (normal_fmt != VK_FORMAT_UNDEFINED) {
+         uint8_t *n = dst + l.offset[VKDF_VERTEX_ATTRIB_NORMAL];
+         if (has_qtangent)
+            pack_qtangent(n, in->normals[i], in->tangents[i], in->bitangents[i]);
+         else if (has_octahedral)
+            pack_octahedral(n, in->normals[i]);
+         else
+            pack_vec3(n, normal_fmt, in->normals[i]);
+      }
+
+      if (tangent_fmt != VK_FORMAT_UNDEFINED) {
+         pack_vec3(dst + l.offset[VKDF_VERTEX_ATTRIB_TANGENT],
+                   tangent_fmt, in->tangents[i]);
+         pack_vec3(dst + l.offset[VKDF_VERTEX_ATTRIB_BITANGENT],
+                   tangent_fmt, in->bitangents[i]);
+      }
+
+      if (uv_fmt == VK_FORMAT_R32G32_SFLOAT)
+         memcpy(dst + l.offset[VKDF_VERTEX_ATTRIB_UV], &in->uvs[i],
+                sizeof(glm::vec2));
+
+      if (has_material)
+         memcpy(dst + l.offset[VKDF_VERTEX_ATTRIB_MATERIAL],
+                &in->material_idx, sizeof(int32_t));
+   }
+
+   return l.stride;
+}
@@ -0,0 +1,147 @@
+#ifndef __VKDF_VERTEX_FORMAT_H__
+#define __VKDF_VERTEX_FORMAT_H__
+
+#include "vkdf-deps.hpp"
+
+/**
+ * Per-vertex attributes supported by the framework's mesh vertex layouts.
+ * Attributes are always interleaved in this order and only the ones present
+ * in a mesh take space in its vertex buffer.
+ *
+ * When the tangent frame is encoded as a quaternion (see
+ * VKDF_VERTEX_ENCODING_QTANGENT) the NORMAL slot holds the quaternion and
+ * the TANGENT and BITANGENT slots are empty.
+ */
+typedef enum {
+   VKDF_VERTEX_ATTRIB_POSITION = 0,
+   VKDF_VERTEX_ATTRIB_NORMAL,
+   VKDF_VERTEX_ATTRIB_TANGENT,
+   VKDF_VERTEX_ATTRIB_BITANGENT,
+   VKDF_VERTEX_ATTRIB_UV,
+   VKDF_VERTEX_ATTRIB_MATERIAL,
+   VKDF_VERTEX_ATTRIB_COUNT,
+} VkdfVertexAttrib;
+
+typedef enum {
+   /* Full 32-bit floats (the default layout) */
+   VKDF_VERTEX_ENCODING_FLOAT = 0,
+
+   /* Normals / tangents: RGBA16_SNORM, w = 0. Fetched as a vec3/vec4 by
+    * fixed function, so shaders don't need any changes.
+    */
+   VKDF_VERTEX_ENCODING_SNORM16,
+
+   /* Normals: octahedral mapping in RG16_SNORM. Shaders must decode it with
+    * oct_decode() from util.glsl.
+    */
+   VKDF_VERTEX_ENCODING_OCTAHEDRAL,
+
+   /* UVs: RG16_SFLOAT. Fetched as a vec2 by fixed function. */
+   VKDF_VERTEX_ENCODING_HALF,
+
+   /* Tangent frames: normal, tangent and bitangent packed as a unit
+    * quaternion in RGBA16_SNORM, with the bitangent handedness in the sign
+    * of w. Shaders must decode it with qtangent_to_tbn() from util.glsl.
+    */
+   VKDF_VERTEX_ENCODING_QTANGENT,
+} VkdfVertexEncoding;
+
+/**
+ * Describes how mesh vertex attributes are encoded in vertex buffers.
+ * A zero-initialized format is the default full precision layout.
+ */
+typedef struct {
+   VkdfVertexEncoding normal;   /* FLOAT, SNORM16 or OCTAHEDRAL */
+   VkdfVertexEncoding tangent;  /* FLOAT, SNORM16 or QTANGENT */
+   VkdfVertexEncoding uv;       /* FLOAT or HALF */
+
+   /* If true, the material index is not stored per-vertex. Applications
+    * are expected to provide it per-draw (push constant, instance data...)
+    */
+   bool per_draw_material;
+} VkdfVertexFormat;
+
+/**
+ * Resolved layout for a vertex format and a set of present attributes.
+ * Absent attributes have VK_FORMAT_UNDEFINED as their format.
+ */
+typedef struct {
+   VkFormat format[VKDF_VERTEX_ATTRIB_COUNT];
+   uint32_t offset[VKDF_VERTEX_ATTRIB_COUNT];
+   uint32_t stride;
+} VkdfVertexLayout;
+
+/**
+ * Source vertex streams for the packer. Optional streams can be NULL.
+ */
+typedef struct {
+   const glm::vec3 *positions;
+   const glm::vec3 *normals;
+   const glm::vec3 *tangents;
+   const glm::vec3 *bitangents;
+   const glm::vec2 *uvs;
+   int32_t material_idx;   /* -1 if there is no material */
+} VkdfVertexStreams;
+
+inline void
+vkdf_vertex_format_init_default(VkdfVertexFormat *fmt)
+{
+   memset(fmt, 0, sizeof(VkdfVertexFormat));
+}
+
+/**
+ * A compact format that requires no shader changes: SNORM16 normals and
+ * tangents, half-float UVs and a per-draw material index.
+ */
+inline void
+vkdf_vertex_format_init_compact(VkdfVertexFormat *fmt)
+{
+   fmt->normal = VKDF_VERTEX_ENCODING_SNORM16;
+   fmt->tangent = VKDF_VERTEX_ENCODING_SNORM16;
+   fmt->uv = VKDF_VERTEX_ENCODING_HALF;
+   fmt->per_draw_material = true;
+}
+
+inline bool
+vkdf_vertex_format_is_default(const VkdfVertexFormat *fmt)
+{
+   return fmt->normal == VKDF_VERTEX_ENCODING_FLOAT &&
+          fmt->tangent == VKDF_VERTEX_ENCODING_FLOAT &&
+          fmt->uv == VKDF_VERTEX_ENCODING_FLOAT &&
+          !fmt->per_draw_material;
+}
+
+/**
+ * 'attrib_mask' is a bitmask of (1 << VkdfVertexAttrib) with the attributes
+ * available in the source data.
+ */
+void
+vkdf_vertex_format_get_layout(const VkdfVertexFormat *fmt,
+                              uint32_t attrib_mask,
+                              VkdfVertexLayout *layout);
+
+/**
+ * Fills 'attribs' with the descriptions of the attributes present in the
+ * layout, assigning consecutive locations starting at 'first_location'.
+ * 'attribs' must have room for VKDF_VERTEX_ATTRIB_COUNT entries.
+ *
+ * Returns the number of attribute descriptions written.
+ */
+uint32_t
+vkdf_vertex_layout_get_attribute_descriptions(
+   const VkdfVertexLayout *layout,
+   uint32_t binding,
+   uint32_t first_location,
+   VkVertexInputAttributeDescription *attribs);
+
+/**
+ * Encodes 'count' vertices from 'in' into 'dst' (typically a pointer into
+ * mapped staging memory) with the given format. Returns the vertex stride.
+ */
+uint32_t
+vkdf_vertex_format_pack(const VkdfVertexFormat *fmt,
+                        const VkdfVertexStreams *in,
+                        uint32_t count,
+                        uint8_t *dst);
+
+#endif
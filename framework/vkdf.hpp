@@ -6,13 +6,19 @@
 #include "vkdf-plane.hpp"
 #include "vkdf-box.hpp"
 #include "vkdf-frustum.hpp"
+#include "vkdf-hiz.hpp"
+#include "vkdf-draw-sort.hpp"
 #include "vkdf-thread-pool.hpp"
 #include "vkdf-error.hpp"
 #include "vkdf-init.hpp"
 #include "vkdf-event-loop.hpp"
+#include "vkdf-headless.hpp"
+#include "vkdf-profiler.hpp"
 #include "vkdf-cmd-buffer.hpp"
 #include "vkdf-buffer.hpp"
 #include "vkdf-memory.hpp"
+#include "vkdf-staging.hpp"
+#include "vkdf-vertex-format.hpp"
 #include "vkdf-shader.hpp"
 #include "vkdf-pipeline.hpp"
 #include "vkdf-image.hpp"
@@ -23,8 +29,12 @@
 #include "vkdf-barrier.hpp"
 #include "vkdf-semaphore.hpp"
 #include "vkdf-mesh.hpp"
+#include "vkdf-mesh-optimize.hpp"
+#include "vkdf-mesh-lod.hpp"
+#include "vkdf-geometry-arena.hpp"
 #include "vkdf-model.hpp"
 #include "vkdf-object.hpp"
+#include "vkdf-sw-occlusion.hpp"
 #include "vkdf-light.hpp"
 #include "vkdf-camera.hpp"
 #include "vkdf-ssao.hpp"
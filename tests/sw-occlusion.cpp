@@ -0,0 +1,203 @@
+#include "vkdf.hpp"
+
+// ----------------------------------------------------------------------------
+// Software occlusion checks
+//
+// Rasterizes a few occluders with VkdfSwOcclusion and checks which boxes
+// behind, in front of and around them are reported occluded. Exits with a
+// non-zero status if any check fails.
+// ----------------------------------------------------------------------------
+
+const uint32_t WIDTH = 256;
+const uint32_t HEIGHT = 144;
+
+static uint32_t failures = 0;
+
+static void
+check_box(VkdfSwOcclusion *occ,
+          const char *name,
+          glm::vec3 center, float size,
+          bool expected)
+{
+   VkdfBox box;
+   box.center = center;
+   box.w = box.h = box.d = size;
+
+   bool occluded = vkdf_sw_occlusion_is_box_occluded(occ, &box);
+   if (occluded != expected) {
+      printf("FAIL: %s: box is %s\n",
+             name, occluded ? "occluded" : "not occluded");
+      failures++;
+   }
+}
+
+static void
+draw_quad(VkdfSwOcclusion *occ,
+          const glm::mat4 &view_proj,
+          glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 v3)
+{
+   const glm::vec3 vertices[4] = { v0, v1, v2, v3 };
+   const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+   vkdf_sw_occlusion_begin(occ, view_proj);
+   vkdf_sw_occlusion_draw_triangles(occ, glm::mat4(1.0f),
+                                    vertices, indices, 6);
+   vkdf_sw_occlusion_end(occ);
+}
+
+/**
+ * A 10x10 quad facing the camera 10 units away.
+ */
+static void
+check_front_quad(VkdfSwOcclusion *occ, const glm::mat4 &view_proj)
+{
+   draw_quad(occ, view_proj,
+             glm::vec3(-5.0f, -5.0f, -10.0f),
+             glm::vec3( 5.0f, -5.0f, -10.0f),
+             glm::vec3( 5.0f,  5.0f, -10.0f),
+             glm::vec3(-5.0f,  5.0f, -10.0f));
+
+   check_box(occ, "box behind the quad",
+             glm::vec3(0.0f, 0.0f, -20.0f), 1.0f, true);
+   check_box(occ, "box behind the quad, off center",
+             glm::vec3(3.0f, 2.0f, -20.0f), 1.0f, true);
+   check_box(occ, "box in front of the quad",
+             glm::vec3(0.0f, 0.0f, -5.0f), 1.0f, false);
+   check_box(occ, "box crossing the quad",
+             glm::vec3(0.0f, 0.0f, -10.0f), 1.0f, false);
+   check_box(occ, "box partly behind the quad",
+             glm::vec3(9.5f, 0.0f, -20.0f), 1.0f, false);
+   check_box(occ, "box next to the quad",
+             glm::vec3(10.5f, 0.0f, -20.0f), 1.0f, false);
+}
+
+/**
+ * The same quad as a non-indexed cube, like the ones vkdf_cube_mesh_new()
+ * creates, so its vertices need to be welded to draw its faces as quads.
+ */
+static void
+check_front_cube(VkdfSwOcclusion *occ, const glm::mat4 &view_proj)
+{
+   const float faces[6][4][3] = {
+      { { -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 } },
+      { {  1, -1, -1 }, { -1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 } },
+      { { -1, -1, -1 }, { -1, -1,  1 }, { -1,  1,  1 }, { -1,  1, -1 } },
+      { {  1, -1,  1 }, {  1, -1, -1 }, {  1,  1, -1 }, {  1,  1,  1 } },
+      { { -1,  1,  1 }, {  1,  1,  1 }, {  1,  1, -1 }, { -1,  1, -1 } },
+      { { -1, -1, -1 }, {  1, -1, -1 }, {  1, -1,  1 }, { -1, -1,  1 } },
+   };
+   const uint32_t corners[6] = { 0, 1, 2, 0, 2, 3 };
+
+   glm::vec3 vertices[36];
+   for (uint32_t f = 0; f < 6; f++) {
+      for (uint32_t i = 0; i < 6; i++) {
+         const float *v = faces[f][corners[i]];
+         vertices[f * 6 + i] = glm::vec3(v[0], v[1], v[2]);
+      }
+   }
+
+   glm::mat4 model = glm::translate(glm::mat4(1.0f),
+                                    glm::vec3(0.0f, 0.0f, -10.0f));
+   model = glm::scale(model, glm::vec3(5.0f, 5.0f, 0.5f));
+
+   vkdf_sw_occlusion_begin(occ, view_proj);
+   vkdf_sw_occlusion_draw_triangles(occ, model, vertices, NULL, 36);
+   vkdf_sw_occlusion_end(occ);
+
+   check_box(occ, "box behind the cube",
+             glm::vec3(0.0f, 0.0f, -20.0f), 1.0f, true);
+   check_box(occ, "box in front of the cube",
+             glm::vec3(0.0f, 0.0f, -5.0f), 1.0f, false);
+   check_box(occ, "box next to the cube",
+             glm::vec3(10.5f, 0.0f, -20.0f), 1.0f, false);
+}
+
+/**
+ * Occluders crossing the near plane are clipped against it, and the ones
+ * behind the camera hide nothing.
+ */
+static void
+check_near_plane(VkdfSwOcclusion *occ, const glm::mat4 &view_proj)
+{
+   // A wall to the left of the camera that starts behind it
+   draw_quad(occ, view_proj,
+             glm::vec3(-1.0f, -50.0f,   5.0f),
+             glm::vec3(-1.0f, -50.0f, -50.0f),
+             glm::vec3(-1.0f,  50.0f, -50.0f),
+             glm::vec3(-1.0f,  50.0f,   5.0f));
+
+   check_box(occ, "box behind the wall",
+             glm::vec3(-10.0f, 0.0f, -20.0f), 1.0f, true);
+   check_box(occ, "box on the open side of the wall",
+             glm::vec3(5.0f, 0.0f, -20.0f), 1.0f, false);
+   check_box(occ, "box in front of the wall",
+             glm::vec3(-0.5f, 0.0f, -20.0f), 0.4f, false);
+
+   // A quad behind the camera
+   draw_quad(occ, view_proj,
+             glm::vec3(-5.0f, -5.0f, 10.0f),
+             glm::vec3( 5.0f, -5.0f, 10.0f),
+             glm::vec3( 5.0f,  5.0f, 10.0f),
+             glm::vec3(-5.0f,  5.0f, 10.0f));
+
+   check_box(occ, "box in front of the camera",
+             glm::vec3(0.0f, 0.0f, -20.0f), 1.0f, false);
+}
+
+/**
+ * Boxes partly outside the view are tested against the part inside it only
+ * when the depth was rendered for the same view (see
+ * VkdfHiZ::clamp_to_view).
+ */
+static void
+check_clamp_to_view(VkdfSwOcclusion *occ, const glm::mat4 &view_proj)
+{
+   // A wall covering the whole view
+   draw_quad(occ, view_proj,
+             glm::vec3(-100.0f, -100.0f, -10.0f),
+             glm::vec3( 100.0f, -100.0f, -10.0f),
+             glm::vec3( 100.0f,  100.0f, -10.0f),
+             glm::vec3(-100.0f,  100.0f, -10.0f));
+
+   // Straddles the right edge of the view
+   glm::vec3 edge = glm::vec3(37.0f, 0.0f, -50.0f);
+
+   check_box(occ, "box behind the wall, at the view edge",
+             edge, 4.0f, true);
+
+   occ->hiz->clamp_to_view = false;
+   check_box(occ, "box behind the wall, at the view edge, not clamped",
+             edge, 4.0f, false);
+   check_box(occ, "box behind the wall, not clamped",
+             glm::vec3(0.0f, 0.0f, -50.0f), 4.0f, true);
+   occ->hiz->clamp_to_view = true;
+}
+
+int
+main()
+{
+   // Camera at the origin looking down -Z
+   VkdfCamera *camera = vkdf_camera_new(0.0f, 0.0f, 0.0f,
+                                        0.0f, 0.0f, 0.0f,
+                                        45.0f, 0.1f, 100.0f,
+                                        (float) WIDTH / HEIGHT);
+   glm::mat4 view_proj = *vkdf_camera_get_projection_ptr(camera) *
+                         vkdf_camera_get_view_matrix(camera);
+
+   VkdfSwOcclusion *occ = vkdf_sw_occlusion_new(WIDTH, HEIGHT);
+
+   check_front_quad(occ, view_proj);
+   check_front_cube(occ, view_proj);
+   check_near_plane(occ, view_proj);
+   check_clamp_to_view(occ, view_proj);
+
+   vkdf_sw_occlusion_free(occ);
+   vkdf_camera_free(NULL, camera);
+
+   if (failures > 0) {
+      printf("%u checks failed\n", failures);
+      return 1;
+   }
+
+   return 0;
+}
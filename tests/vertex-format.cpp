@@ -0,0 +1,346 @@
+#include "vkdf.hpp"
+
+// ----------------------------------------------------------------------------
+// Vertex format checks
+//
+// Packs vertices with each of the compact encodings and decodes them back
+// the way the vertex fetch and the util.glsl helpers do, checking that the
+// results match the original attributes within the precision of the
+// encoding. Exits with a non-zero status if any check fails.
+// ----------------------------------------------------------------------------
+
+// Enough vertices to exercise the vectorized paths and their scalar tails
+const uint32_t NUM_VERTICES = 67;
+
+static uint32_t failures = 0;
+
+static void
+check(bool result, const char *what, uint32_t vertex, float error)
+{
+   if (!result) {
+      printf("FAIL: %s: vertex %u: error %g\n", what, vertex, error);
+      failures++;
+   }
+}
+
+static float
+half_to_float(uint16_t h)
+{
+   uint32_t sign = (h >> 15) & 0x1;
+   uint32_t exp = (h >> 10) & 0x1f;
+   uint32_t mant = h & 0x3ff;
+
+   float f;
+   if (exp == 0)
+      f = ldexpf((float) mant, -24);
+   else if (exp == 31)
+      f = mant ? NAN : INFINITY;
+   else
+      f = ldexpf((float) (mant | 0x400), (int32_t) exp - 25);
+
+   return sign ? -f : f;
+}
+
+static inline float
+snorm16_to_float(int16_t v)
+{
+   return MAX2(v / 32767.0f, -1.0f);
+}
+
+static glm::vec4
+read_snorm16x4(const uint8_t *src)
+{
+   int16_t v[4];
+   memcpy(v, src, sizeof(v));
+   return glm::vec4(snorm16_to_float(v[0]), snorm16_to_float(v[1]),
+                    snorm16_to_float(v[2]), snorm16_to_float(v[3]));
+}
+
+/**
+ * Same as oct_decode() in util.glsl.
+ */
+static glm::vec3
+oct_decode(const uint8_t *src)
+{
+   int16_t v[2];
+   memcpy(v, src, sizeof(v));
+
+   glm::vec3 n = glm::vec3(snorm16_to_float(v[0]), snorm16_to_float(v[1]), 0.0f);
+   n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+   if (n.z < 0.0f) {
+      float x = n.x;
+      n.x = (1.0f - fabsf(n.y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      n.y = (1.0f - fabsf(x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+   }
+   return glm::normalize(n);
+}
+
+/**
+ * Same as qtangent_to_tbn() in util.glsl.
+ */
+static glm::mat3
+qtangent_to_tbn(const glm::vec4 &v)
+{
+   glm::quat q = glm::normalize(glm::quat(v.w, v.x, v.y, v.z));
+   glm::mat3 m = glm::mat3_cast(q);
+
+   glm::vec3 t = m[0];
+   glm::vec3 n = m[2];
+   glm::vec3 b = glm::cross(n, t) * (v.w < 0.0f ? -1.0f : 1.0f);
+   return glm::mat3(t, b, n);
+}
+
+static float
+angle_error(const glm::vec3 &a, const glm::vec3 &b)
+{
+   // More precise than acos() for small angles
+   glm::vec3 na = glm::normalize(a);
+   glm::vec3 nb = glm::normalize(b);
+   return atan2f(glm::length(glm::cross(na, nb)), glm::dot(na, nb));
+}
+
+/**
+ * Builds a set of vertices covering all the octants, the poles, the
+ * octahedron edges, degenerate tangents and mirrored tangent frames.
+ */
+static void
+init_vertices(std::vector<glm::vec3> &positions,
+              std::vector<glm::vec3> &normals,
+              std::vector<glm::vec3> &tangents,
+              std::vector<glm::vec3> &bitangents,
+              std::vector<glm::vec2> &uvs)
+{
+   const glm::vec3 special_normals[] = {
+      glm::vec3( 0.0f,  0.0f,  1.0f),
+      glm::vec3( 0.0f,  0.0f, -1.0f),
+      glm::vec3( 1.0f,  0.0f,  0.0f),
+      glm::vec3(-1.0f,  0.0f,  0.0f),
+      glm::vec3( 0.0f, -1.0f,  0.0f),
+      glm::vec3( 0.7071f,  0.0f, -0.7071f),
+      glm::vec3( 0.0f, -0.7071f, -0.7071f),
+   };
+   const uint32_t num_special = sizeof(special_normals) / sizeof(glm::vec3);
+
+   const float special_uvs[] = {
+      0.0f, 1.0f, -1.0f, 0.5f, 1e-5f, 1000.25f, -65504.0f, 3.14159f
+   };
+   const uint32_t num_special_uvs = sizeof(special_uvs) / sizeof(float);
+
+   // Fixed seed so every run checks the same vertices
+   srandom(1);
+
+   for (uint32_t i = 0; i < NUM_VERTICES; i++) {
+      glm::vec3 n;
+      if (i < num_special) {
+         n = special_normals[i];
+      } else {
+         do {
+            n = glm::vec3(random() % 2001 - 1000.0f,
+                          random() % 2001 - 1000.0f,
+                          random() % 2001 - 1000.0f);
+         } while (glm::dot(n, n) < 1.0f);
+      }
+      n = glm::normalize(n);
+
+      glm::vec3 t = glm::vec3(random() % 2001 - 1000.0f,
+                              random() % 2001 - 1000.0f,
+                              random() % 2001 - 1000.0f);
+      if (glm::dot(t, t) < 1.0f)
+         t = glm::vec3(1.0f, 0.0f, 0.0f);
+      t = glm::normalize(t - n * glm::dot(n, t) * 0.9f);
+      if (i % 11 == 0)
+         t = n;   // Degenerate: the packer has to pick a tangent
+
+      glm::vec3 b = glm::cross(n, t);
+      if (i % 3 == 0)
+         b = -b;  // Mirrored UVs
+
+      glm::vec2 uv;
+      if (i < num_special_uvs)
+         uv = glm::vec2(special_uvs[i], -special_uvs[i]);
+      else
+         uv = glm::vec2((random() % 20001 - 10000) / 1000.0f,
+                        (random() % 20001 - 10000) / 1000.0f);
+
+      positions.push_back(glm::vec3((float) i, 0.0f, 0.0f));
+      normals.push_back(n);
+      tangents.push_back(t);
+      bitangents.push_back(b);
+      uvs.push_back(uv);
+   }
+}
+
+static void
+pack(const VkdfVertexFormat *fmt,
+     const VkdfVertexStreams *streams,
+     std::vector<uint8_t> &data,
+     VkdfVertexLayout *layout)
+{
+   uint32_t attrib_mask = 1 << VKDF_VERTEX_ATTRIB_POSITION;
+   if (streams->normals)
+      attrib_mask |= 1 << VKDF_VERTEX_ATTRIB_NORMAL;
+   if (streams->tangents)
+      attrib_mask |= (1 << VKDF_VERTEX_ATTRIB_TANGENT) |
+                     (1 << VKDF_VERTEX_ATTRIB_BITANGENT);
+   if (streams->uvs)
+      attrib_mask |= 1 << VKDF_VERTEX_ATTRIB_UV;
+
+   vkdf_vertex_format_get_layout(fmt, attrib_mask, layout);
+   data.resize(layout->stride * NUM_VERTICES);
+
+   uint32_t stride =
+      vkdf_vertex_format_pack(fmt, streams, NUM_VERTICES, data.data());
+   if (stride != layout->stride) {
+      printf("FAIL: packed stride %u, layout stride %u\n",
+             stride, layout->stride);
+      failures++;
+   }
+}
+
+/**
+ * The compact format: SNORM16 normals and tangents (pack_snorm16x4) and
+ * half-float UVs (float_to_half).
+ */
+static void
+check_compact(VkdfVertexStreams *streams)
+{
+   VkdfVertexFormat fmt;
+   vkdf_vertex_format_init_compact(&fmt);
+
+   VkdfVertexLayout l;
+   std::vector<uint8_t> data;
+   pack(&fmt, streams, data, &l);
+
+   for (uint32_t i = 0; i < NUM_VERTICES; i++) {
+      const uint8_t *v = &data[i * l.stride];
+
+      glm::vec3 p;
+      memcpy(&p, v, sizeof(p));
+      check(p == streams->positions[i], "position", i, 0.0f);
+
+      const glm::vec3 *src[3] = {
+         &streams->normals[i], &streams->tangents[i], &streams->bitangents[i]
+      };
+      const VkdfVertexAttrib attribs[3] = {
+         VKDF_VERTEX_ATTRIB_NORMAL,
+         VKDF_VERTEX_ATTRIB_TANGENT,
+         VKDF_VERTEX_ATTRIB_BITANGENT,
+      };
+      for (uint32_t a = 0; a < 3; a++) {
+         glm::vec4 d = read_snorm16x4(v + l.offset[attribs[a]]);
+         float error = MAX2(MAX2(fabsf(d.x - src[a]->x),
+                                 fabsf(d.y - src[a]->y)),
+                            MAX2(fabsf(d.z - src[a]->z), fabsf(d.w)));
+         check(error <= 0.5f / 32767.0f + 1e-7f, "snorm16", i, error);
+      }
+
+      uint16_t h[2];
+      memcpy(h, v + l.offset[VKDF_VERTEX_ATTRIB_UV], sizeof(h));
+      for (uint32_t c = 0; c < 2; c++) {
+         float f = streams->uvs[i][c];
+         float error = fabsf(half_to_float(h[c]) - f);
+         // Half a unit in the last place, or half the smallest subnormal
+         float ulp = MAX2(ldexpf(1.0f, -24), ldexpf(fabsf(f), -11));
+         check(error <= ulp, "half", i, error);
+      }
+   }
+}
+
+/**
+ * Octahedral normals (pack_octahedral).
+ */
+static void
+check_octahedral(VkdfVertexStreams *streams)
+{
+   VkdfVertexFormat fmt;
+   vkdf_vertex_format_init_default(&fmt);
+   fmt.normal = VKDF_VERTEX_ENCODING_OCTAHEDRAL;
+
+   VkdfVertexStreams s = *streams;
+   s.tangents = NULL;
+   s.bitangents = NULL;
+
+   VkdfVertexLayout l;
+   std::vector<uint8_t> data;
+   pack(&fmt, &s, data, &l);
+
+   for (uint32_t i = 0; i < NUM_VERTICES; i++) {
+      glm::vec3 n = oct_decode(&data[i * l.stride + l.offset[VKDF_VERTEX_ATTRIB_NORMAL]]);
+      float error = angle_error(n, s.normals[i]);
+      check(error < 1e-4f, "octahedral", i, error);
+   }
+}
+
+/**
+ * QTangent frames (pack_qtangent). The packer orthonormalizes the frame
+ * around the normal, so the tangent is compared against its projection on
+ * the normal's plane.
+ */
+static void
+check_qtangent(VkdfVertexStreams *streams)
+{
+   VkdfVertexFormat fmt;
+   vkdf_vertex_format_init_default(&fmt);
+   fmt.tangent = VKDF_VERTEX_ENCODING_QTANGENT;
+
+   VkdfVertexLayout l;
+   std::vector<uint8_t> data;
+   pack(&fmt, streams, data, &l);
+
+   for (uint32_t i = 0; i < NUM_VERTICES; i++) {
+      glm::vec4 q = read_snorm16x4(&data[i * l.stride + l.offset[VKDF_VERTEX_ATTRIB_NORMAL]]);
+      glm::mat3 tbn = qtangent_to_tbn(q);
+
+      glm::vec3 n = streams->normals[i];
+      glm::vec3 t = streams->tangents[i] - n * glm::dot(n, streams->tangents[i]);
+      bool degenerate = glm::dot(t, t) < 1e-12f;
+
+      float error = angle_error(tbn[2], n);
+      check(error < 1e-3f, "qtangent normal", i, error);
+
+      if (!degenerate) {
+         error = angle_error(tbn[0], t);
+         check(error < 1e-3f, "qtangent tangent", i, error);
+      }
+
+      // Only the handedness of the bitangent is kept
+      bool mirrored = glm::dot(glm::cross(n, t), streams->bitangents[i]) < 0.0f;
+      if (!degenerate) {
+         error = angle_error(tbn[1], glm::cross(n, t) * (mirrored ? -1.0f : 1.0f));
+         check(error < 1e-3f, "qtangent bitangent", i, error);
+      } else {
+         error = fabsf(glm::dot(tbn[0], tbn[2]));
+         check(error < 1e-3f, "qtangent degenerate tangent", i, error);
+      }
+   }
+}
+
+int
+main()
+{
+   std::vector<glm::vec3> positions;
+   std::vector<glm::vec3> normals;
+   std::vector<glm::vec3> tangents;
+   std::vector<glm::vec3> bitangents;
+   std::vector<glm::vec2> uvs;
+   init_vertices(positions, normals, tangents, bitangents, uvs);
+
+   VkdfVertexStreams streams;
+   streams.positions = positions.data();
+   streams.normals = normals.data();
+   streams.tangents = tangents.data();
+   streams.bitangents = bitangents.data();
+   streams.uvs = uvs.data();
+   streams.material_idx = -1;
+
+   check_compact(&streams);
+   check_octahedral(&streams);
+   check_qtangent(&streams);
+
+   if (failures > 0) {
+      printf("%u checks failed\n", failures);
+      return 1;
+   }
+
+   return 0;
+}